@@ -0,0 +1,122 @@
+//
+// Author: Dmitriy Gavryushin (https://github.com/Gawrjuschin)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+
+// Compares throughput of TLS connections carrying a batch of requests: one
+// request at a time over HTTP/1.1 keep-alive against all requests of the batch
+// as concurrent HTTP/2 streams. Each batch is a new connection, so both cases
+// pay the same handshakes. Server accepts up to 100 concurrent streams per
+// connection.
+//
+// Usage: rest_in_beast_http2_multiplexing [connections] [requests/connection]
+
+#include "support/test_clients.hpp"
+#include "support/test_logger.hpp"
+#include "support/test_requests.hpp"
+#include "support/test_respondent.hpp"
+#include "support/test_ssl_util.hpp"
+
+#include <rest_in_beast/alpn.hpp>
+#include <rest_in_beast/server.hpp>
+
+#include <boost/asio/ssl.hpp>
+#include <boost/beast/http.hpp>
+
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+namespace net = boost::asio;
+namespace http = boost::beast::http;
+
+std::vector<test::string_request> make_requests(std::size_t count) {
+  std::vector<test::string_request> requests;
+  requests.reserve(count);
+  for (std::size_t idx{}; idx < count; ++idx) {
+    auto& request = requests.emplace_back(http::verb::get, "/", 11);
+    request.set(http::field::host, "127.0.0.1");
+    request.set(http::field::user_agent, "rest_in_beast_bench");
+    request.set(http::field::accept, "application/json");
+    request.keep_alive(true);
+  }
+  return requests;
+}
+
+void http11_connection(net::io_context& io_ctx, net::ssl::context& ssl_ctx,
+                       const net::ip::tcp::endpoint& endpoint,
+                       const std::vector<test::string_request>& requests) {
+  net::ssl::stream<net::ip::tcp::socket> stream{io_ctx, ssl_ctx};
+  stream.next_layer().connect(endpoint);
+  stream.handshake(net::ssl::stream_base::client);
+
+  boost::beast::flat_buffer buffer;
+  for (const auto& request : requests) {
+    http::write(stream, request);
+    test::string_response response;
+    http::read(stream, buffer, response);
+  }
+
+  boost::beast::error_code ec;
+  stream.shutdown(ec);
+}
+
+void run_case(const char* name, bool http2, std::size_t connections,
+              std::size_t requests_per_connection) {
+  const net::ip::tcp::endpoint endpoint{net::ip::make_address("127.0.0.1"),
+                                        5101};
+  auto logger = test::Logger::make_shared();
+
+  net::ssl::context server_ssl_ctx{test::make_server_ssl_ctx()};
+  net::ssl::context client_ssl_ctx{test::make_client_ssl_ctx()};
+  rest_in_beast::install_alpn(server_ssl_ctx);
+
+  net::io_context server_ctx;
+  rest_in_beast::SecureServer::start(
+      server_ctx, endpoint, logger,
+      {.ssl_ctx = server_ssl_ctx,
+       .respondent =
+           test::ReusableRespondent::make_shared(test::responses_map()),
+       .logger = logger});
+
+  std::thread server_thread{[&server_ctx] { server_ctx.run(); }};
+
+  const auto requests = make_requests(requests_per_connection);
+  net::io_context client_ctx;
+  test::Http2Client http2_client{client_ssl_ctx};
+
+  const auto start = std::chrono::steady_clock::now();
+  for (std::size_t idx{}; idx < connections; ++idx) {
+    if (http2) {
+      http2_client.exchange(endpoint, requests);
+    } else {
+      http11_connection(client_ctx, client_ssl_ctx, endpoint, requests);
+    }
+  }
+  const auto elapsed = std::chrono::steady_clock::now() - start;
+
+  const std::size_t requests_count = connections * requests_per_connection;
+  std::printf("%-10s %6zu connections %10zu requests %10.0f requests/s\n",
+              name, connections, requests_count,
+              static_cast<double>(requests_count) /
+                  std::chrono::duration<double>(elapsed).count());
+
+  server_ctx.stop();
+  server_thread.join();
+}
+} // namespace
+
+int main(int argc, char* argv[]) {
+  const std::size_t connections =
+      argc > 1 ? std::stoul(argv[1]) : std::size_t{200};
+  const std::size_t requests_per_connection =
+      argc > 2 ? std::stoul(argv[2]) : std::size_t{100};
+
+  run_case("http/1.1", false, connections, requests_per_connection);
+  run_case("h2", true, connections, requests_per_connection);
+}
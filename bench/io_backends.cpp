@@ -0,0 +1,178 @@
+//
+// Author: Dmitriy Gavryushin (https://github.com/Gawrjuschin)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+
+// Measures throughput of keep-alive connections on the asio backend the
+// binary is built with: CMake builds it as rest_in_beast_io_backends_epoll and
+// rest_in_beast_io_backends_io_uring, run both on the same machine to compare.
+// Cases are plain and TLS requests answered from memory and plain requests
+// answered with a file by FileRespondent. Every client thread owns one
+// connection, server runs on the given number of threads.
+//
+// Usage: rest_in_beast_io_backends_<backend> [threads] [clients]
+//        [requests/client]
+
+#include "support/test_logger.hpp"
+#include "support/test_requests.hpp"
+#include "support/test_respondent.hpp"
+#include "support/test_ssl_util.hpp"
+
+#include <rest_in_beast/file_respondent.hpp>
+#include <rest_in_beast/runner.hpp>
+#include <rest_in_beast/server.hpp>
+
+#include <boost/asio/ssl.hpp>
+#include <boost/beast/http.hpp>
+
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+namespace {
+namespace net = boost::asio;
+namespace http = boost::beast::http;
+
+#if defined(BOOST_ASIO_HAS_IO_URING) && defined(BOOST_ASIO_DISABLE_EPOLL)
+constexpr const char* backend{"io_uring"};
+#else
+constexpr const char* backend{"epoll"};
+#endif
+
+const net::ip::tcp::endpoint endpoint{net::ip::make_address("127.0.0.1"),
+                                      5103};
+
+template <typename Stream>
+void exchange(Stream& stream, std::string_view target, std::size_t requests) {
+  http::request<http::string_body> request{http::verb::get, target, 11};
+  request.set(http::field::host, "127.0.0.1");
+  request.set(http::field::user_agent, "rest_in_beast_bench");
+  request.keep_alive(true);
+
+  boost::beast::flat_buffer buffer;
+  for (std::size_t idx{}; idx < requests; ++idx) {
+    http::write(stream, request);
+    http::response<http::string_body> response;
+    http::read(stream, buffer, response);
+  }
+}
+
+void plain_client(std::string_view target, std::size_t requests) {
+  net::io_context io_ctx;
+  net::ip::tcp::socket socket{io_ctx};
+  socket.connect(endpoint);
+  exchange(socket, target, requests);
+
+  boost::beast::error_code ec;
+  socket.shutdown(net::ip::tcp::socket::shutdown_both, ec);
+}
+
+void secure_client(net::ssl::context& ssl_ctx, std::size_t requests) {
+  net::io_context io_ctx;
+  net::ssl::stream<net::ip::tcp::socket> stream{io_ctx, ssl_ctx};
+  stream.next_layer().connect(endpoint);
+  stream.handshake(net::ssl::stream_base::client);
+  exchange(stream, "/", requests);
+
+  boost::beast::error_code ec;
+  stream.shutdown(ec);
+}
+
+void measure(const char* name, std::size_t clients,
+             std::size_t requests_per_client,
+             const std::function<void()>& client) {
+  std::vector<std::thread> client_threads;
+  client_threads.reserve(clients);
+  const auto start = std::chrono::steady_clock::now();
+  for (std::size_t idx{}; idx < clients; ++idx) {
+    client_threads.emplace_back(client);
+  }
+  for (auto& thread : client_threads) {
+    thread.join();
+  }
+  const auto elapsed = std::chrono::steady_clock::now() - start;
+
+  const std::size_t requests_count = clients * requests_per_client;
+  std::printf("%-8s %-6s %10zu requests %10.0f requests/s\n", backend, name,
+              requests_count,
+              static_cast<double>(requests_count) /
+                  std::chrono::duration<double>(elapsed).count());
+}
+} // namespace
+
+int main(int argc, char* argv[]) {
+  const std::size_t threads = argc > 1 ? std::stoul(argv[1]) : std::size_t{1};
+  const std::size_t clients = argc > 2 ? std::stoul(argv[2]) : std::size_t{8};
+  const std::size_t requests_per_client =
+      argc > 3 ? std::stoul(argv[3]) : std::size_t{10'000};
+
+  auto logger = test::Logger::make_shared();
+  auto respondent =
+      test::ReusableRespondent::make_shared(test::responses_map());
+
+  {
+    auto runner = rest_in_beast::Runner::start({.threads = threads});
+    auto server = rest_in_beast::PlainServer::start(
+        runner->context(), endpoint, logger,
+        {.respondent = respondent, .logger = logger});
+
+    measure("plain", clients, requests_per_client,
+            [&] { plain_client("/", requests_per_client); });
+
+    server.reset();
+    runner->stop();
+    runner->join();
+  }
+
+  {
+    net::ssl::context server_ssl_ctx{test::make_server_ssl_ctx()};
+    net::ssl::context client_ssl_ctx{test::make_client_ssl_ctx()};
+
+    auto runner = rest_in_beast::Runner::start({.threads = threads});
+    auto server = rest_in_beast::SecureServer::start(
+        runner->context(), endpoint, logger,
+        {.ssl_ctx = server_ssl_ctx,
+         .respondent = respondent,
+         .logger = logger});
+
+    measure("tls", clients, requests_per_client,
+            [&] { secure_client(client_ssl_ctx, requests_per_client); });
+
+    server.reset();
+    runner->stop();
+    runner->join();
+  }
+
+  {
+    const auto root =
+        std::filesystem::temp_directory_path() / "rest_in_beast_io_backends";
+    std::filesystem::create_directories(root);
+    {
+      std::ofstream file{root / "page.html", std::ios::binary};
+      file << std::string(16'384, 'x');
+    }
+
+    auto runner = rest_in_beast::Runner::start({.threads = threads});
+    auto server = rest_in_beast::PlainServer::start(
+        runner->context(), endpoint, logger,
+        {.respondent = rest_in_beast::FileRespondent::make_shared(
+             respondent, runner->context().get_executor(), root),
+         .logger = logger});
+
+    measure("file", clients, requests_per_client,
+            [&] { plain_client("/page.html", requests_per_client); });
+
+    server.reset();
+    runner->stop();
+    runner->join();
+    std::filesystem::remove_all(root);
+  }
+}
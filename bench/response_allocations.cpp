@@ -0,0 +1,171 @@
+//
+// Author: Dmitriy Gavryushin (https://github.com/Gawrjuschin)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+
+// Counts heap allocations made by the server thread per keep-alive request for
+// type-erased (make_response) and reusable (fill_response) response paths with
+// and without per-request arena. Counts depend on the Boost version: run it
+// with the one the server is built with.
+//
+// The reusable path only keeps the response off the heap and the arena only
+// keeps parsed request's fields and body off it. Asio operations and executor
+// copies still allocate per request, so none of the cases is expected to
+// report zero.
+//
+// Usage: rest_in_beast_response_allocations [requests]
+
+#include "support/test_logger.hpp"
+#include "support/test_requests.hpp"
+#include "support/test_respondent.hpp"
+
+#include <rest_in_beast/server.hpp>
+
+#include <boost/asio/connect.hpp>
+#include <boost/beast/http.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <string>
+#include <thread>
+
+namespace bench {
+std::atomic<std::size_t> allocations{};
+thread_local bool count_allocations{false};
+
+void* allocate(std::size_t size, std::size_t alignment) {
+  if (count_allocations) {
+    allocations.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  void* ptr = alignment > alignof(std::max_align_t)
+                  ? std::aligned_alloc(alignment, (size + alignment - 1) /
+                                                      alignment * alignment)
+                  : std::malloc(size ? size : 1);
+  if (ptr == nullptr) {
+    throw std::bad_alloc{};
+  }
+  return ptr;
+}
+} // namespace bench
+
+void* operator new(std::size_t size) {
+  return bench::allocate(size, alignof(std::max_align_t));
+}
+void* operator new[](std::size_t size) {
+  return bench::allocate(size, alignof(std::max_align_t));
+}
+void* operator new(std::size_t size, std::align_val_t alignment) {
+  return bench::allocate(size, static_cast<std::size_t>(alignment));
+}
+void* operator new[](std::size_t size, std::align_val_t alignment) {
+  return bench::allocate(size, static_cast<std::size_t>(alignment));
+}
+void operator delete(void* ptr) noexcept { std::free(ptr); }
+void operator delete[](void* ptr) noexcept { std::free(ptr); }
+void operator delete(void* ptr, std::size_t) noexcept { std::free(ptr); }
+void operator delete[](void* ptr, std::size_t) noexcept { std::free(ptr); }
+void operator delete(void* ptr, std::align_val_t) noexcept { std::free(ptr); }
+void operator delete[](void* ptr, std::align_val_t) noexcept { std::free(ptr); }
+void operator delete(void* ptr, std::size_t, std::align_val_t) noexcept {
+  std::free(ptr);
+}
+void operator delete[](void* ptr, std::size_t, std::align_val_t) noexcept {
+  std::free(ptr);
+}
+
+namespace {
+namespace net = boost::asio;
+namespace http = boost::beast::http;
+
+void run_case(const char* name,
+              std::shared_ptr<rest_in_beast::Respondent> respondent,
+              std::size_t request_arena_size, std::size_t requests_count) {
+  const net::ip::tcp::endpoint endpoint{net::ip::make_address("127.0.0.1"),
+                                        5100};
+  auto logger = test::Logger::make_shared();
+
+  net::io_context server_ctx;
+  rest_in_beast::PlainServer::start(
+      server_ctx, endpoint, logger,
+      {.respondent = std::move(respondent),
+       .logger = logger,
+       .request_arena_size = request_arena_size});
+
+  std::thread server_thread{[&server_ctx] {
+    bench::count_allocations = true;
+    server_ctx.run();
+  }};
+
+  net::io_context client_ctx;
+  net::ip::tcp::socket socket{client_ctx};
+  socket.connect(endpoint);
+
+  http::request<http::string_body> request{http::verb::get, "/", 11};
+  request.set(http::field::host, "127.0.0.1");
+  // Header-heavy API request: every field is a node of basic_fields
+  request.set(http::field::user_agent, "rest_in_beast_bench");
+  request.set(http::field::accept, "application/json");
+  request.set(http::field::accept_encoding, "gzip, deflate");
+  request.set(http::field::authorization, "Bearer 0123456789abcdef");
+  request.set(http::field::cache_control, "no-cache");
+  request.set("X-Request-Id", "4f3c2a1b-0d9e-4c8b-a7f6-e5d4c3b2a190");
+  request.keep_alive(true);
+
+  boost::beast::flat_buffer buffer;
+  auto exchange = [&] {
+    http::write(socket, request);
+    http::response<http::string_body> response;
+    http::read(socket, buffer, response);
+  };
+
+  // Warm up pools and buffers of the connection
+  for (std::size_t idx{}; idx < 1'000; ++idx) {
+    exchange();
+  }
+
+  bench::allocations = 0;
+  const auto start = std::chrono::steady_clock::now();
+  for (std::size_t idx{}; idx < requests_count; ++idx) {
+    exchange();
+  }
+  const auto elapsed = std::chrono::steady_clock::now() - start;
+  const std::size_t allocations = bench::allocations;
+
+  std::printf(
+      "%-20s %10zu requests %8.2f allocations/request %10.0f requests/s\n",
+      name, requests_count,
+      static_cast<double>(allocations) / static_cast<double>(requests_count),
+      static_cast<double>(requests_count) /
+          std::chrono::duration<double>(elapsed).count());
+
+  boost::beast::error_code ec;
+  socket.shutdown(net::ip::tcp::socket::shutdown_both, ec);
+  socket.close(ec);
+
+  server_ctx.stop();
+  server_thread.join();
+}
+} // namespace
+
+int main(int argc, char* argv[]) {
+  const std::size_t requests_count =
+      argc > 1 ? std::stoul(argv[1]) : std::size_t{100'000};
+
+  constexpr std::size_t arena_size{4096};
+
+  run_case("message_generator",
+           test::Respondent::make_shared(test::responses_map()), 0,
+           requests_count);
+  run_case("fill_response",
+           test::ReusableRespondent::make_shared(test::responses_map()), 0,
+           requests_count);
+  run_case("fill_response+arena",
+           test::ReusableRespondent::make_shared(test::responses_map()),
+           arena_size, requests_count);
+}
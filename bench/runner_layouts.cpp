@@ -0,0 +1,133 @@
+//
+// Author: Dmitriy Gavryushin (https://github.com/Gawrjuschin)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+
+// Compares throughput of keep-alive connections served by the Runner's
+// threads: all threads running one shared io_context with one server against
+// io_context per thread with server per context on SO_REUSEPORT listeners.
+// Each layout runs with and without pinning threads to CPUs. Every client
+// thread owns one connection.
+//
+// Usage: rest_in_beast_runner_layouts [threads] [clients] [requests/client]
+
+#include "support/test_logger.hpp"
+#include "support/test_requests.hpp"
+#include "support/test_respondent.hpp"
+
+#include <rest_in_beast/handoff.hpp>
+#include <rest_in_beast/runner.hpp>
+#include <rest_in_beast/server.hpp>
+
+#include <boost/beast/http.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+namespace net = boost::asio;
+namespace http = boost::beast::http;
+
+void client(const net::ip::tcp::endpoint& endpoint, std::size_t requests) {
+  net::io_context io_ctx;
+  net::ip::tcp::socket socket{io_ctx};
+  socket.connect(endpoint);
+
+  http::request<http::string_body> request{http::verb::get, "/", 11};
+  request.set(http::field::host, "127.0.0.1");
+  request.set(http::field::user_agent, "rest_in_beast_bench");
+  request.keep_alive(true);
+
+  boost::beast::flat_buffer buffer;
+  for (std::size_t idx{}; idx < requests; ++idx) {
+    http::write(socket, request);
+    http::response<http::string_body> response;
+    http::read(socket, buffer, response);
+  }
+
+  boost::beast::error_code ec;
+  socket.shutdown(net::ip::tcp::socket::shutdown_both, ec);
+}
+
+void run_case(const char* name, rest_in_beast::RunnerOptions options,
+              std::size_t clients, std::size_t requests_per_client) {
+  const net::ip::tcp::endpoint endpoint{net::ip::make_address("127.0.0.1"),
+                                        5102};
+  auto logger = test::Logger::make_shared();
+  auto respondent =
+      test::ReusableRespondent::make_shared(test::responses_map());
+
+  auto runner = rest_in_beast::Runner::start(std::move(options));
+  std::vector<std::shared_ptr<rest_in_beast::PlainServer>> servers;
+  for (std::size_t idx{}; idx < runner->size(); ++idx) {
+    auto& io_ctx = runner->context(idx);
+    const rest_in_beast::detail::PlainSessionFactory factory{
+        .respondent = respondent, .logger = logger};
+    if (runner->size() == 1) {
+      servers.push_back(
+          rest_in_beast::PlainServer::start(io_ctx, endpoint, logger, factory));
+      continue;
+    }
+
+    boost::system::error_code ec;
+    const auto listener = rest_in_beast::listen_reuse_port(endpoint, ec);
+    if (ec) {
+      throw boost::system::system_error{ec, "listen_reuse_port"};
+    }
+    servers.push_back(
+        rest_in_beast::PlainServer::start(io_ctx, listener, logger, factory));
+  }
+
+  std::vector<std::thread> client_threads;
+  client_threads.reserve(clients);
+  const auto start = std::chrono::steady_clock::now();
+  for (std::size_t idx{}; idx < clients; ++idx) {
+    client_threads.emplace_back(client, endpoint, requests_per_client);
+  }
+  for (auto& thread : client_threads) {
+    thread.join();
+  }
+  const auto elapsed = std::chrono::steady_clock::now() - start;
+
+  const std::size_t requests_count = clients * requests_per_client;
+  std::printf("%-22s %3zu contexts %10zu requests %10.0f requests/s\n", name,
+              runner->size(), requests_count,
+              static_cast<double>(requests_count) /
+                  std::chrono::duration<double>(elapsed).count());
+
+  // Servers are destroyed with the contexts' handlers
+  servers.clear();
+  runner->stop();
+  runner->join();
+}
+} // namespace
+
+int main(int argc, char* argv[]) {
+  const std::size_t threads =
+      argc > 1 ? std::stoul(argv[1])
+               : std::max<std::size_t>(std::thread::hardware_concurrency() / 2,
+                                       1);
+  const std::size_t clients =
+      argc > 2 ? std::stoul(argv[2]) : std::size_t{4 * threads};
+  const std::size_t requests_per_client =
+      argc > 3 ? std::stoul(argv[3]) : std::size_t{10'000};
+  const auto cpus = rest_in_beast::Runner::cpus();
+
+  run_case("single context", {.threads = threads, .contexts = 1}, clients,
+           requests_per_client);
+  run_case("context per thread", {.threads = threads, .contexts = threads},
+           clients, requests_per_client);
+  run_case("single context+pin",
+           {.threads = threads, .contexts = 1, .cpus = cpus}, clients,
+           requests_per_client);
+  run_case("context per thread+pin",
+           {.threads = threads, .contexts = threads, .cpus = cpus}, clients,
+           requests_per_client);
+}
@@ -0,0 +1,214 @@
+//
+// Author: Dmitriy Gavryushin (https://github.com/Gawrjuschin)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#ifndef REST_IN_BEAST_ADMISSION_HPP
+#define REST_IN_BEAST_ADMISSION_HPP
+
+#include "util/shared_proxy.hpp"
+
+#include <boost/asio/ip/address.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <utility>
+
+namespace rest_in_beast {
+
+/**
+ * @brief The AdmissionOptions class - limits of concurrent connections
+ */
+struct AdmissionOptions {
+  // Connections of all addresses, 0 - unlimited
+  std::size_t max_connections{10'000};
+  // Connections of one remote address, 0 - unlimited
+  std::size_t max_per_address{};
+  // Counters of addresses, rounded up to power of two
+  std::size_t address_slots{4096};
+  // Server re-checks the limit with this period while it's reached
+  std::chrono::milliseconds pause_interval{10};
+};
+
+/**
+ * @brief The AdmissionControl class limits concurrent connections of the
+ * server. Connection is admitted with a Ticket owned by it's session: counters
+ * are released in the session's destructor, so connections handed over to
+ * WebSocket or HTTP/2 are counted until they are closed.
+ *
+ * Addresses are counted in a fixed table of atomic counters indexed by hash of
+ * the address: colliding addresses share the limit, which only makes it
+ * stricter. Counting takes no locks.
+ *
+ * Server stops accepting while max_connections is reached, so new connections
+ * wait in the listen backlog. Connections over the limit of their address are
+ * reset.
+ */
+class AdmissionControl : public std::enable_shared_from_this<AdmissionControl> {
+public:
+  /**
+   * @brief The Ticket class - admitted connection, empty if not admitted
+   */
+  class Ticket {
+    std::shared_ptr<AdmissionControl> control_{};
+    std::size_t slot_{};
+
+    friend AdmissionControl;
+
+    Ticket(std::shared_ptr<AdmissionControl> control, std::size_t slot)
+        : control_{std::move(control)}, slot_{slot} {}
+
+  public:
+    Ticket() = default;
+
+    Ticket(const Ticket&) = delete;
+    Ticket& operator=(const Ticket&) = delete;
+
+    Ticket(Ticket&& other) noexcept
+        : control_{std::move(other.control_)}, slot_{other.slot_} {}
+
+    Ticket& operator=(Ticket&& other) noexcept {
+      if (this != &other) {
+        reset();
+        control_ = std::move(other.control_);
+        slot_ = other.slot_;
+      }
+      return *this;
+    }
+
+    ~Ticket() { reset(); }
+
+    explicit operator bool() const noexcept { return control_ != nullptr; }
+
+    void reset() noexcept {
+      if (control_) {
+        control_->release(slot_);
+        control_.reset();
+      }
+    }
+  };
+
+private:
+  const AdmissionOptions options_;
+  // Limits with 0 replaced by the maximum
+  const std::size_t max_connections_;
+  const std::uint32_t max_per_address_;
+  // Number of slots is 1 << slot_bits_
+  const unsigned slot_bits_;
+  std::unique_ptr<std::atomic<std::uint32_t>[]> addresses_;
+
+  alignas(64) std::atomic<std::size_t> active_{};
+  alignas(64) std::atomic<std::uint64_t> admitted_{};
+  std::atomic<std::uint64_t> rejected_{};
+
+  explicit AdmissionControl(AdmissionOptions options)
+      : options_{options}, max_connections_{limit(options.max_connections)},
+        max_per_address_{static_cast<std::uint32_t>(std::min<std::size_t>(
+            limit(options.max_per_address), UINT32_MAX))},
+        slot_bits_{static_cast<unsigned>(std::countr_zero(
+            std::bit_ceil(std::max<std::size_t>(options.address_slots, 1))))},
+        addresses_{new std::atomic<std::uint32_t>[std::size_t{1}
+                                                  << slot_bits_]} {}
+
+  friend util::SharedProxy<AdmissionControl>;
+
+  static constexpr std::size_t limit(std::size_t value) noexcept {
+    return value == 0 ? SIZE_MAX : value;
+  }
+
+  std::size_t slot(const boost::asio::ip::address& address) const noexcept {
+    std::uint64_t key{};
+    if (address.is_v4()) {
+      key = address.to_v4().to_uint();
+    } else {
+      for (const auto byte : address.to_v6().to_bytes()) {
+        key = key * 131 + byte;
+      }
+    }
+    // Fibonacci hashing spreads neighbouring addresses: the top bits of the
+    // product are the best mixed ones
+    if (slot_bits_ == 0)
+      return 0;
+    return static_cast<std::size_t>((key * 0x9E3779B97F4A7C15ull) >>
+                                    (64 - slot_bits_));
+  }
+
+  void release(std::size_t slot) noexcept {
+    addresses_[slot].fetch_sub(1, std::memory_order_relaxed);
+    active_.fetch_sub(1, std::memory_order_relaxed);
+  }
+
+public:
+  AdmissionControl(const AdmissionControl&) = delete;
+  AdmissionControl& operator=(const AdmissionControl&) = delete;
+
+  AdmissionControl(AdmissionControl&&) = delete;
+  AdmissionControl& operator=(AdmissionControl&&) = delete;
+
+  ~AdmissionControl() = default;
+
+  static std::shared_ptr<AdmissionControl>
+  make_shared(AdmissionOptions options = {}) {
+    return std::make_shared<util::SharedProxy<AdmissionControl>>(options);
+  }
+
+  const AdmissionOptions& options() const noexcept { return options_; }
+
+  /**
+   * @brief admit counts connection of the address
+   * @return empty ticket if any limit is reached
+   */
+  Ticket admit(const boost::asio::ip::address& address) {
+    // Counters are taken first and returned if over the limit: concurrent
+    // admissions never exceed it
+    const auto slot = this->slot(address);
+    if (active_.fetch_add(1, std::memory_order_relaxed) >= max_connections_) {
+      active_.fetch_sub(1, std::memory_order_relaxed);
+      rejected_.fetch_add(1, std::memory_order_relaxed);
+      return {};
+    }
+    if (addresses_[slot].fetch_add(1, std::memory_order_relaxed) >=
+        max_per_address_) {
+      addresses_[slot].fetch_sub(1, std::memory_order_relaxed);
+      active_.fetch_sub(1, std::memory_order_relaxed);
+      rejected_.fetch_add(1, std::memory_order_relaxed);
+      return {};
+    }
+
+    admitted_.fetch_add(1, std::memory_order_relaxed);
+    return Ticket{shared_from_this(), slot};
+  }
+
+  /**
+   * @brief full - max_connections is reached
+   */
+  bool full() const noexcept {
+    return active_.load(std::memory_order_relaxed) >= max_connections_;
+  }
+
+  /**
+   * @brief active - connections holding tickets
+   */
+  std::size_t active() const noexcept {
+    return active_.load(std::memory_order_relaxed);
+  }
+
+  std::uint64_t admitted() const noexcept {
+    return admitted_.load(std::memory_order_relaxed);
+  }
+
+  std::uint64_t rejected() const noexcept {
+    return rejected_.load(std::memory_order_relaxed);
+  }
+};
+
+} // namespace rest_in_beast
+
+#endif // REST_IN_BEAST_ADMISSION_HPP
@@ -0,0 +1,63 @@
+//
+// Author: Dmitriy Gavryushin (https://github.com/Gawrjuschin)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#ifndef REST_IN_BEAST_ALPN_HPP
+#define REST_IN_BEAST_ALPN_HPP
+
+#include <boost/asio/ssl/context.hpp>
+
+#include <openssl/ssl.h>
+
+#include <string_view>
+
+namespace rest_in_beast {
+
+namespace detail {
+// Server's preference order in ALPN wire format
+inline constexpr std::string_view alpn_http2{"\x02h2\x08http/1.1"};
+inline constexpr std::string_view alpn_http11{"\x08http/1.1"};
+
+inline int on_alpn_select(SSL*, const unsigned char** out,
+                          unsigned char* out_length, const unsigned char* in,
+                          unsigned int in_length, void* arg) {
+  const auto* protocols = static_cast<const std::string_view*>(arg);
+
+  unsigned char* selected{};
+  if (::SSL_select_next_proto(
+          &selected, out_length,
+          reinterpret_cast<const unsigned char*>(std::data(*protocols)),
+          static_cast<unsigned int>(std::size(*protocols)), in,
+          in_length) != OPENSSL_NPN_NEGOTIATED)
+    return SSL_TLSEXT_ERR_NOACK;
+
+  *out = selected;
+  return SSL_TLSEXT_ERR_OK;
+}
+} // namespace detail
+
+/**
+ * @brief install_alpn - lets TLS clients negotiate application protocol with
+ * ALPN. Sessions of SecureSessionFactory and DetectSSLSessionFactory serve
+ * HTTP/2 when "h2" is selected and HTTP/1.1 otherwise. Clients without ALPN or
+ * without common protocol are served with HTTP/1.1.
+ *
+ * Selection runs on the context of the handshake: install it on the contexts
+ * of SniContexts' hosts too.
+ * @param http2 - offer "h2", only "http/1.1" is selected otherwise
+ */
+inline void install_alpn(boost::asio::ssl::context& ssl_ctx,
+                         bool http2 = true) {
+  ::SSL_CTX_set_alpn_select_cb(ssl_ctx.native_handle(),
+                               &detail::on_alpn_select,
+                               const_cast<std::string_view*>(
+                                   http2 ? &detail::alpn_http2
+                                         : &detail::alpn_http11));
+}
+
+} // namespace rest_in_beast
+
+#endif // REST_IN_BEAST_ALPN_HPP
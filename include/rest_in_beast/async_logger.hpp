@@ -0,0 +1,365 @@
+//
+// Author: Dmitriy Gavryushin (https://github.com/Gawrjuschin)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#ifndef REST_IN_BEAST_ASYNC_LOGGER_HPP
+#define REST_IN_BEAST_ASYNC_LOGGER_HPP
+
+#include "detail/logger.hpp"
+#include "util/shared_proxy.hpp"
+
+#include <boost/beast/http/verb.hpp>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace rest_in_beast {
+
+/**
+ * @brief The AsyncLogger class is a Logger which does not block sessions'
+ * threads. Records are copied in binary form into the calling thread's
+ * single-producer ring and the background thread drains all rings, formats
+ * records and passes them to the writer in batches.
+ *
+ * Records of a full ring are dropped and counted. Rings of finished threads
+ * are kept until the logger is destroyed. Destructor writes the rest of
+ * records and joins the thread.
+ */
+class AsyncLogger : public Logger {
+public:
+  /**
+   * @brief writer_type - writes batch of formatted lines, called from the
+   * logger's thread only
+   */
+  using writer_type = std::function<void(std::string_view)>;
+
+private:
+  struct Record {
+    enum class Kind : std::uint8_t { error, access };
+
+    Kind kind{};
+    std::chrono::system_clock::time_point time{};
+
+    // Error
+    std::array<char, 32> class_name{};
+    std::array<char, 32> function_name{};
+    int value{};
+    const boost::system::error_category* category{};
+
+    // Access
+    boost::beast::http::verb method{};
+    unsigned status{};
+    std::uint64_t bytes_in{};
+    std::uint64_t bytes_out{};
+    std::chrono::nanoseconds latency{};
+    std::array<char, 128> target{};
+    std::uint8_t target_size{};
+  };
+
+  /**
+   * @brief The Ring class is a bounded single-producer single-consumer queue
+   */
+  class Ring {
+    std::unique_ptr<Record[]> records_;
+    const std::size_t mask_;
+
+    alignas(64) std::atomic<std::size_t> head_{};
+    alignas(64) std::atomic<std::size_t> tail_{};
+
+  public:
+    explicit Ring(std::size_t capacity)
+        : records_{new Record[capacity]}, mask_{capacity - 1} {}
+
+    /**
+     * @brief slot - record to fill, nullptr if the ring is full
+     */
+    Record* slot() noexcept {
+      const auto tail = tail_.load(std::memory_order_relaxed);
+      if (tail - head_.load(std::memory_order_acquire) > mask_)
+        return nullptr;
+      return &records_[tail & mask_];
+    }
+
+    void push() noexcept {
+      tail_.store(tail_.load(std::memory_order_relaxed) + 1,
+                  std::memory_order_release);
+    }
+
+    template <typename Handler> void drain(Handler&& handler) {
+      auto head = head_.load(std::memory_order_relaxed);
+      const auto tail = tail_.load(std::memory_order_acquire);
+      for (; head != tail; ++head) {
+        handler(records_[head & mask_]);
+      }
+      head_.store(head, std::memory_order_release);
+    }
+  };
+
+  // Logger is known to the thread by it's id: addresses may be reused
+  inline static std::atomic<std::uint64_t> loggers_{};
+  const std::uint64_t id_{loggers_.fetch_add(1, std::memory_order_relaxed)};
+
+  writer_type writer_;
+  const std::size_t ring_capacity_;
+  const std::chrono::milliseconds flush_interval_;
+  const bool access_log_;
+
+  std::mutex mutex_;
+  std::condition_variable stop_cv_;
+  std::vector<std::shared_ptr<Ring>> rings_;
+  bool stop_{};
+
+  std::atomic<std::uint64_t> dropped_{};
+  std::atomic<std::uint64_t> written_{};
+
+  std::thread thread_;
+
+  AsyncLogger(writer_type writer, std::size_t ring_capacity,
+              std::chrono::milliseconds flush_interval, bool access_log)
+      : writer_{std::move(writer)},
+        ring_capacity_{std::bit_ceil(std::max<std::size_t>(ring_capacity, 2))},
+        flush_interval_{flush_interval}, access_log_{access_log},
+        thread_{[this] { run(); }} {}
+
+  friend util::SharedProxy<AsyncLogger>;
+
+  /**
+   * @brief ring - calling thread's ring, registered on the first record
+   */
+  Ring& ring() {
+    thread_local std::vector<std::pair<std::uint64_t, std::shared_ptr<Ring>>>
+        rings;
+    for (const auto& [id, ring] : rings) {
+      if (id == id_)
+        return *ring;
+    }
+
+    // Rings of destroyed loggers are released
+    std::erase_if(rings, [](const auto& ring) {
+      return ring.second.use_count() == 1;
+    });
+
+    auto ring = std::make_shared<Ring>(ring_capacity_);
+    {
+      const std::scoped_lock lock{mutex_};
+      rings_.push_back(ring);
+    }
+    return *rings.emplace_back(id_, std::move(ring)).second;
+  }
+
+  template <typename Fill> void push(Fill&& fill) noexcept {
+    try {
+      auto& ring = this->ring();
+      auto* record = ring.slot();
+      if (!record) {
+        dropped_.fetch_add(1, std::memory_order_relaxed);
+        return;
+      }
+      record->time = std::chrono::system_clock::now();
+      fill(*record);
+      ring.push();
+    } catch (...) {
+      // Ring is not registered: out of memory
+      dropped_.fetch_add(1, std::memory_order_relaxed);
+    }
+  }
+
+  template <std::size_t N>
+  static std::size_t copy(std::string_view from, std::array<char, N>& to) {
+    const auto size = std::min(std::size(from), N);
+    std::copy_n(std::data(from), size, std::data(to));
+    return size;
+  }
+
+  static std::string_view view(const std::array<char, 32>& name) {
+    return {std::data(name),
+            static_cast<std::size_t>(
+                std::find(std::begin(name), std::end(name), '\0') -
+                std::begin(name))};
+  }
+
+  static void format(const Record& record, std::string& out) {
+    const auto since_epoch =
+        std::chrono::duration_cast<std::chrono::milliseconds>(
+            record.time.time_since_epoch());
+
+    std::array<char, 64> buffer{};
+    int size = std::snprintf(
+        std::data(buffer), std::size(buffer), "%lld.%03lld ",
+        static_cast<long long>(since_epoch.count() / 1000),
+        static_cast<long long>(since_epoch.count() % 1000));
+    out.append(std::data(buffer), static_cast<std::size_t>(size));
+
+    if (record.kind == Record::Kind::error) {
+      const boost::system::error_code ec{record.value, *record.category};
+      out.append("error ").append(view(record.class_name)).append("::");
+      out.append(view(record.function_name)).append(": ");
+      out.append(ec.message()).append(" (").append(ec.category().name());
+      out.append(":").append(std::to_string(ec.value())).append(")\n");
+      return;
+    }
+
+    const auto method = boost::beast::http::to_string(record.method);
+    out.append(std::data(method), std::size(method)).append(" ");
+    out.append(std::data(record.target), record.target_size).append(" ");
+    if (record.status == 0) {
+      out.append("-");
+    } else {
+      out.append(std::to_string(record.status));
+    }
+    size = std::snprintf(
+        std::data(buffer), std::size(buffer), " %llu %llu %.3fms\n",
+        static_cast<unsigned long long>(record.bytes_in),
+        static_cast<unsigned long long>(record.bytes_out),
+        std::chrono::duration<double, std::milli>{record.latency}.count());
+    out.append(std::data(buffer), static_cast<std::size_t>(size));
+  }
+
+  /**
+   * @brief drain formats records of all rings and writes them as one batch
+   */
+  void drain(std::vector<std::shared_ptr<Ring>>& rings, std::string& batch) {
+    {
+      const std::scoped_lock lock{mutex_};
+      rings.assign(std::begin(rings_), std::end(rings_));
+    }
+
+    std::uint64_t records{};
+    for (const auto& ring : rings) {
+      ring->drain([&](const Record& record) {
+        format(record, batch);
+        ++records;
+      });
+    }
+
+    if (std::empty(batch))
+      return;
+
+    writer_(batch);
+    batch.clear();
+    written_.fetch_add(records, std::memory_order_relaxed);
+  }
+
+  void run() {
+    std::vector<std::shared_ptr<Ring>> rings;
+    std::string batch;
+
+    std::unique_lock lock{mutex_};
+    while (!stop_) {
+      stop_cv_.wait_for(lock, flush_interval_);
+      lock.unlock();
+      drain(rings, batch);
+      lock.lock();
+    }
+    lock.unlock();
+
+    // Records made before the stop
+    drain(rings, batch);
+  }
+
+public:
+  AsyncLogger(const AsyncLogger&) = delete;
+  AsyncLogger& operator=(const AsyncLogger&) = delete;
+
+  AsyncLogger(AsyncLogger&&) = delete;
+  AsyncLogger& operator=(AsyncLogger&&) = delete;
+
+  ~AsyncLogger() {
+    {
+      const std::scoped_lock lock{mutex_};
+      stop_ = true;
+    }
+    stop_cv_.notify_one();
+    thread_.join();
+  }
+
+  /**
+   * @brief make_shared starts the logger's thread
+   * @param writer - writes formatted batches
+   * @param access_log - sessions log every served request
+   * @param ring_capacity - records per thread, rounded up to power of two
+   * @param flush_interval - period of draining
+   */
+  static std::shared_ptr<AsyncLogger>
+  make_shared(writer_type writer, bool access_log = true,
+              std::size_t ring_capacity = 4096,
+              std::chrono::milliseconds flush_interval =
+                  std::chrono::milliseconds{10}) {
+    return std::make_shared<util::SharedProxy<AsyncLogger>>(
+        std::move(writer), ring_capacity, flush_interval, access_log);
+  }
+
+  /**
+   * @brief file_writer - writer to the C stream, flushed after each batch
+   */
+  static writer_type file_writer(std::FILE* file) {
+    return [file](std::string_view batch) {
+      std::fwrite(std::data(batch), 1, std::size(batch), file);
+      std::fflush(file);
+    };
+  }
+
+  /**
+   * @brief dropped - records lost because of full rings
+   */
+  std::uint64_t dropped() const noexcept {
+    return dropped_.load(std::memory_order_relaxed);
+  }
+
+  /**
+   * @brief written - records passed to the writer
+   */
+  std::uint64_t written() const noexcept {
+    return written_.load(std::memory_order_relaxed);
+  }
+
+  void log(std::string_view class_name, std::string_view function_name,
+           boost::system::error_code ec) override {
+    push([&](Record& record) {
+      record.kind = Record::Kind::error;
+      record.class_name.fill('\0');
+      record.function_name.fill('\0');
+      copy(class_name, record.class_name);
+      copy(function_name, record.function_name);
+      record.value = ec.value();
+      record.category = &ec.category();
+    });
+  }
+
+  bool access_log() const noexcept override { return access_log_; }
+
+  void access(const AccessRecord& access) override {
+    push([&](Record& record) {
+      record.kind = Record::Kind::access;
+      record.method = access.method;
+      record.status = access.status;
+      record.bytes_in = access.bytes_in;
+      record.bytes_out = access.bytes_out;
+      record.latency = access.latency;
+      record.target_size =
+          static_cast<std::uint8_t>(copy(access.target, record.target));
+    });
+  }
+};
+
+} // namespace rest_in_beast
+
+#endif // REST_IN_BEAST_ASYNC_LOGGER_HPP
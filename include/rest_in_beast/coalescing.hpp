@@ -0,0 +1,208 @@
+//
+// Author: Dmitriy Gavryushin (https://github.com/Gawrjuschin)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#ifndef REST_IN_BEAST_COALESCING_HPP
+#define REST_IN_BEAST_COALESCING_HPP
+
+#include "detail/respondent.hpp"
+#include "util/hasher.hpp"
+#include "util/shared_proxy.hpp"
+
+#include <boost/beast/http/message_generator.hpp>
+#include <boost/beast/http/verb.hpp>
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace rest_in_beast {
+
+/**
+ * @brief The CoalescingRespondent class answers concurrent identical requests
+ * with one load (single-flight). The first request of a key starts the load,
+ * requests of the same key arriving before it completes wait for it, then
+ * the shared response is written by every waiting session in it's own strand.
+ * Completed responses are not kept: it is not a cache.
+ *
+ * Requests without key and failed loads are answered by the wrapped
+ * respondent.
+ */
+class CoalescingRespondent
+    : public Respondent,
+      public std::enable_shared_from_this<CoalescingRespondent> {
+public:
+  /**
+   * @brief key_type - key of coalesced requests, empty string - the request
+   * is not coalesced
+   */
+  using key_type = std::function<std::string(RequestView)>;
+
+  /**
+   * @brief loader_type - loads the response and calls the handler once from
+   * any thread, nullptr on failure. The request is valid until the handler is
+   * called. Slow loaders SHOULD complete asynchronously to leave the
+   * session's thread
+   */
+  using loader_type = std::function<void(RequestView, shared_response_handler)>;
+
+private:
+  std::shared_ptr<Respondent> respondent_;
+  loader_type loader_;
+  key_type key_;
+  // Default key takes GET requests only, others are asked for the key
+  const bool target_keyed_;
+
+  std::mutex mutex_;
+  std::unordered_map<std::string, std::vector<shared_response_handler>,
+                     util::string_view_hash, util::string_view_equal>
+      flights_;
+
+  std::atomic<std::uint64_t> loads_{};
+  std::atomic<std::uint64_t> coalesced_{};
+
+  CoalescingRespondent(std::shared_ptr<Respondent> respondent,
+                       loader_type loader, key_type key)
+      : respondent_{std::move(respondent)}, loader_{std::move(loader)},
+        key_{std::move(key)}, target_keyed_{is_target_key(key_)} {}
+
+  friend util::SharedProxy<CoalescingRespondent>;
+
+  static bool is_target_key(const key_type& key) noexcept {
+    const auto* function = key.target<std::string (*)(RequestView)>();
+    return function && *function == &CoalescingRespondent::target_key;
+  }
+
+  void complete(const std::string& key, shared_response response) {
+    std::vector<shared_response_handler> waiting;
+    {
+      const std::scoped_lock lock{mutex_};
+      auto node = flights_.extract(key);
+      // Loader completed before it threw
+      if (node.empty())
+        return;
+      waiting = std::move(node.mapped());
+    }
+
+    for (auto& handler : waiting) {
+      handler(response);
+    }
+  }
+
+public:
+  ~CoalescingRespondent() = default;
+
+  /**
+   * @brief target_key - GET requests are coalesced by target
+   */
+  static std::string target_key(RequestView request) {
+    if (request.method() != boost::beast::http::verb::get)
+      return {};
+    return std::string{request.target()};
+  }
+
+  /**
+   * @brief make_shared
+   * @param respondent - answers the rest of requests
+   * @param loader - loads responses of coalesced requests
+   * @param key - key of coalesced requests
+   */
+  static std::shared_ptr<CoalescingRespondent>
+  make_shared(std::shared_ptr<Respondent> respondent, loader_type loader,
+              key_type key = &CoalescingRespondent::target_key) {
+    return std::make_shared<util::SharedProxy<CoalescingRespondent>>(
+        std::move(respondent), std::move(loader), std::move(key));
+  }
+
+  /**
+   * @brief loads - number of started loads
+   */
+  std::uint64_t loads() const noexcept {
+    return loads_.load(std::memory_order_relaxed);
+  }
+
+  /**
+   * @brief coalesced - number of requests waited for the load of another one
+   */
+  std::uint64_t coalesced() const noexcept {
+    return coalesced_.load(std::memory_order_relaxed);
+  }
+
+  /**
+   * @brief shares_response - custom keys are computed here and again by
+   * async_shared_response for coalesced requests
+   */
+  bool shares_response(RequestView request) override {
+    if (target_keyed_)
+      return request.method() == boost::beast::http::verb::get;
+    return !std::empty(key_(request));
+  }
+
+  bool async_shared_response(RequestView request,
+                             shared_response_handler handler) override {
+    auto key = key_(request);
+    if (std::empty(key))
+      return false;
+
+    {
+      const std::scoped_lock lock{mutex_};
+      auto [it, inserted] = flights_.try_emplace(key);
+      it->second.push_back(std::move(handler));
+      if (!inserted) {
+        coalesced_.fetch_add(1, std::memory_order_relaxed);
+        return true;
+      }
+    }
+
+    loads_.fetch_add(1, std::memory_order_relaxed);
+    try {
+      loader_(request, [self = shared_from_this(),
+                        key](shared_response response) {
+        self->complete(key, std::move(response));
+      });
+    } catch (...) {
+      // Waiting sessions are answered by the wrapped respondent
+      complete(key, nullptr);
+    }
+    return true;
+  }
+
+  boost::beast::http::message_generator
+  make_response(string_request&& request) override {
+    return respondent_->make_response(std::move(request));
+  }
+
+  bool fill_response(RequestView request,
+                     reusable_response& response) override {
+    return respondent_->fill_response(request, response);
+  }
+
+  boost::beast::http::message_generator
+  make_arena_response(arena_request&& request) override {
+    return respondent_->make_arena_response(std::move(request));
+  }
+
+  std::shared_ptr<WebSocketHandler>
+  accept_websocket(const string_request& request) override {
+    return respondent_->accept_websocket(request);
+  }
+
+  std::shared_ptr<StreamChannel>
+  make_stream(RequestView request, reusable_response& response) override {
+    return respondent_->make_stream(request, response);
+  }
+};
+
+} // namespace rest_in_beast
+
+#endif // REST_IN_BEAST_COALESCING_HPP
@@ -0,0 +1,462 @@
+//
+// Author: Dmitriy Gavryushin (https://github.com/Gawrjuschin)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#ifndef REST_IN_BEAST_COMPRESSION_HPP
+#define REST_IN_BEAST_COMPRESSION_HPP
+
+#include "detail/respondent.hpp"
+#include "util/hasher.hpp"
+#include "util/shared_proxy.hpp"
+
+#include <boost/beast/http/field.hpp>
+#include <boost/beast/http/message.hpp>
+#include <boost/beast/http/message_generator.hpp>
+#include <boost/beast/http/status.hpp>
+#include <boost/beast/http/string_body.hpp>
+
+// Requires zlib: CMake option REST_IN_BEAST_COMPRESSION
+#include <zlib.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <shared_mutex>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+
+namespace rest_in_beast {
+
+/**
+ * @brief The ContentCoding enum - content codings of compressed responses
+ */
+enum class ContentCoding { identity, gzip, deflate };
+
+inline constexpr std::string_view to_string(ContentCoding coding) noexcept {
+  switch (coding) {
+  case ContentCoding::gzip:
+    return "gzip";
+  case ContentCoding::deflate:
+    return "deflate";
+  default:
+    return "identity";
+  }
+}
+
+namespace detail {
+constexpr std::string_view trim(std::string_view text) noexcept {
+  while (!std::empty(text) && (text.front() == ' ' || text.front() == '\t')) {
+    text.remove_prefix(1);
+  }
+  while (!std::empty(text) && (text.back() == ' ' || text.back() == '\t')) {
+    text.remove_suffix(1);
+  }
+  return text;
+}
+
+constexpr bool iequals(std::string_view lhs, std::string_view rhs) noexcept {
+  if (std::size(lhs) != std::size(rhs))
+    return false;
+
+  for (std::size_t idx{}; idx < std::size(lhs); ++idx) {
+    const char lower =
+        lhs[idx] >= 'A' && lhs[idx] <= 'Z' ? lhs[idx] + 32 : lhs[idx];
+    if (lower != rhs[idx])
+      return false;
+  }
+  return true;
+}
+
+/**
+ * @brief zero_quality - "q=0", "q=0.0" ... exclude the coding
+ */
+constexpr bool zero_quality(std::string_view params) noexcept {
+  for (;;) {
+    const auto semicolon = params.find(';');
+    const auto param = trim(params.substr(0, semicolon));
+    if (param.starts_with("q=") || param.starts_with("Q=")) {
+      return param.substr(2).find_first_not_of("0.") ==
+             std::string_view::npos;
+    }
+    if (semicolon == std::string_view::npos)
+      return false;
+    params.remove_prefix(semicolon + 1);
+  }
+}
+
+/**
+ * @brief The Deflater class owns z_stream of one coding. Stream is reset
+ * between bodies instead of initialized again
+ */
+class Deflater {
+  z_stream stream_{};
+  int level_;
+
+public:
+  Deflater(ContentCoding coding, int level) : level_{level} {
+    // 16 selects gzip wrapper
+    const int window_bits = coding == ContentCoding::gzip ? 15 + 16 : 15;
+    if (::deflateInit2(&stream_, level, Z_DEFLATED, window_bits, 8,
+                       Z_DEFAULT_STRATEGY) != Z_OK) {
+      throw std::runtime_error{"deflateInit2 failed"};
+    }
+  }
+
+  Deflater(const Deflater&) = delete;
+  Deflater& operator=(const Deflater&) = delete;
+
+  Deflater(Deflater&&) = delete;
+  Deflater& operator=(Deflater&&) = delete;
+
+  ~Deflater() { ::deflateEnd(&stream_); }
+
+  int level() const noexcept { return level_; }
+
+  /**
+   * @brief compress - single shot compression into out
+   */
+  bool compress(std::string_view in, std::string& out) {
+    ::deflateReset(&stream_);
+
+    out.resize(::deflateBound(&stream_, std::size(in)));
+    stream_.next_in =
+        reinterpret_cast<Bytef*>(const_cast<char*>(std::data(in)));
+    stream_.avail_in = static_cast<uInt>(std::size(in));
+    stream_.next_out = reinterpret_cast<Bytef*>(std::data(out));
+    stream_.avail_out = static_cast<uInt>(std::size(out));
+
+    const int result = ::deflate(&stream_, Z_FINISH);
+    out.resize(std::size(out) - stream_.avail_out);
+    return result == Z_STREAM_END;
+  }
+};
+
+/**
+ * @brief thread_deflater - z_stream of the calling thread, created once per
+ * coding and level
+ */
+inline Deflater& thread_deflater(ContentCoding coding, int level) {
+  thread_local std::optional<Deflater> gzip;
+  thread_local std::optional<Deflater> deflate;
+
+  auto& deflater = coding == ContentCoding::gzip ? gzip : deflate;
+  if (!deflater || deflater->level() != level) {
+    deflater.reset();
+    deflater.emplace(coding, level);
+  }
+  return *deflater;
+}
+} // namespace detail
+
+/**
+ * @brief negotiate_coding picks gzip or deflate accepted by Accept-Encoding
+ * field, gzip is preferred. Qualities are not compared: any non-zero quality
+ * accepts the coding
+ */
+inline constexpr ContentCoding
+negotiate_coding(std::string_view accept_encoding) noexcept {
+  bool gzip{}, deflate{}, any{};
+  bool no_gzip{}, no_deflate{};
+
+  while (!std::empty(accept_encoding)) {
+    const auto comma = accept_encoding.find(',');
+    const auto item = accept_encoding.substr(0, comma);
+    const auto semicolon = item.find(';');
+    const auto coding = detail::trim(item.substr(0, semicolon));
+    const bool accepted = semicolon == std::string_view::npos ||
+                          !detail::zero_quality(item.substr(semicolon + 1));
+
+    if (detail::iequals(coding, "gzip") || detail::iequals(coding, "x-gzip")) {
+      (accepted ? gzip : no_gzip) = true;
+    } else if (detail::iequals(coding, "deflate")) {
+      (accepted ? deflate : no_deflate) = true;
+    } else if (coding == "*") {
+      any = accepted;
+    }
+
+    if (comma == std::string_view::npos)
+      break;
+    accept_encoding.remove_prefix(comma + 1);
+  }
+
+  if (gzip || (any && !no_gzip))
+    return ContentCoding::gzip;
+  if (deflate || (any && !no_deflate))
+    return ContentCoding::deflate;
+  return ContentCoding::identity;
+}
+
+/**
+ * @brief compress - compresses text with z_stream of the calling thread
+ * @param level - zlib compression level
+ * @return false on zlib failure
+ */
+inline bool compress(ContentCoding coding, std::string_view text,
+                     std::string& out, int level = Z_DEFAULT_COMPRESSION) {
+  if (coding == ContentCoding::identity) {
+    out.assign(text);
+    return true;
+  }
+  return detail::thread_deflater(coding, level).compress(text, out);
+}
+
+/**
+ * @brief The CompressionCache class keeps compressed variants of immutable
+ * bodies: static files, rendered templates. Body is compressed once per key
+ * with the best compression level and compressed again only when it changes,
+ * which is detected by it's hash.
+ *
+ * Lookups take shared lock, compression is done outside of the lock.
+ */
+class CompressionCache {
+  struct Entry {
+    std::uint64_t hash;
+    std::size_t size;
+    std::string gzip;
+    std::string deflate;
+  };
+
+  const std::size_t max_entries_;
+  const int level_;
+
+  std::shared_mutex mutex_;
+  std::unordered_map<std::string, std::shared_ptr<const Entry>,
+                     util::string_view_hash, util::string_view_equal>
+      entries_;
+
+  CompressionCache(std::size_t max_entries, int level)
+      : max_entries_{max_entries}, level_{level} {}
+
+  friend util::SharedProxy<CompressionCache>;
+
+public:
+  CompressionCache(const CompressionCache&) = delete;
+  CompressionCache& operator=(const CompressionCache&) = delete;
+
+  CompressionCache(CompressionCache&&) = delete;
+  CompressionCache& operator=(CompressionCache&&) = delete;
+
+  ~CompressionCache() = default;
+
+  /**
+   * @brief make_shared
+   * @param max_entries - arbitrary entry is evicted above it
+   * @param level - zlib compression level of cached variants
+   */
+  static std::shared_ptr<CompressionCache>
+  make_shared(std::size_t max_entries = 1024, int level = Z_BEST_COMPRESSION) {
+    return std::make_shared<util::SharedProxy<CompressionCache>>(max_entries,
+                                                                 level);
+  }
+
+  /**
+   * @brief find_or_compress
+   * @param key - identity of the body: path, ETag, template name
+   * @param body - current body under the key
+   * @return compressed body, nullptr for identity coding or zlib failure
+   */
+  std::shared_ptr<const std::string>
+  find_or_compress(std::string_view key, std::string_view body,
+                   ContentCoding coding) {
+    if (coding == ContentCoding::identity)
+      return nullptr;
+
+    const std::uint64_t hash = util::hash_bytes(body);
+    std::shared_ptr<const Entry> entry;
+    {
+      const std::shared_lock lock{mutex_};
+      if (const auto it = entries_.find(key); it != std::end(entries_)) {
+        entry = it->second;
+      }
+    }
+
+    if (!entry || entry->hash != hash || entry->size != std::size(body)) {
+      auto fresh = std::make_shared<Entry>(
+          Entry{.hash = hash, .size = std::size(body)});
+      if (!compress(ContentCoding::gzip, body, fresh->gzip, level_) ||
+          !compress(ContentCoding::deflate, body, fresh->deflate, level_))
+        return nullptr;
+      entry = std::move(fresh);
+
+      const std::scoped_lock lock{mutex_};
+      if (std::size(entries_) >= max_entries_ && !entries_.contains(key)) {
+        entries_.erase(std::begin(entries_));
+      }
+      entries_.insert_or_assign(std::string{key}, entry);
+    }
+
+    return {entry, coding == ContentCoding::gzip ? &entry->gzip
+                                                 : &entry->deflate};
+  }
+
+  std::size_t size() {
+    const std::shared_lock lock{mutex_};
+    return std::size(entries_);
+  }
+};
+
+/**
+ * @brief The CompressionOptions class
+ */
+struct CompressionOptions {
+  // Smaller bodies are not worth the compression
+  std::size_t min_size{1024};
+  // zlib level of compression on the fly
+  int level{Z_DEFAULT_COMPRESSION};
+  // Variants of responses with ETag, nullptr - compress on the fly
+  std::shared_ptr<CompressionCache> cache{};
+};
+
+/**
+ * @brief compressible - text formats gain from compression, images and
+ * archives are compressed already
+ */
+inline constexpr bool compressible(std::string_view content_type) noexcept {
+  content_type = content_type.substr(0, content_type.find(';'));
+  return content_type.starts_with("text/") ||
+         content_type.ends_with("+json") || content_type.ends_with("+xml") ||
+         content_type == "application/json" ||
+         content_type == "application/javascript" ||
+         content_type == "application/xml" ||
+         content_type == "image/svg+xml";
+}
+
+/**
+ * @brief compress_response compresses body of the response with coding
+ * negotiated by the request. Variant of the response with ETag is taken from
+ * the cache and gets it's own ETag. Payload is prepared when compressed.
+ * @return true if the response is compressed
+ */
+template <typename Request, typename Fields>
+bool compress_response(
+    const Request& request,
+    boost::beast::http::response<boost::beast::http::string_body, Fields>&
+        response,
+    const CompressionOptions& options) {
+  namespace http = boost::beast::http;
+
+  const auto content_type = response[http::field::content_type];
+  if (std::size(response.body()) < options.min_size ||
+      response.result() == http::status::no_content ||
+      response.result() == http::status::not_modified ||
+      response.count(http::field::content_encoding) != 0 ||
+      !compressible({std::data(content_type), std::size(content_type)}))
+    return false;
+
+  // Caches MUST store variants separately
+  response.set(http::field::vary, "Accept-Encoding");
+
+  const auto accept = request[http::field::accept_encoding];
+  const auto coding =
+      negotiate_coding({std::data(accept), std::size(accept)});
+  if (coding == ContentCoding::identity)
+    return false;
+
+  auto& body = response.body();
+  const auto etag_field = response[http::field::etag];
+  const std::string_view etag{std::data(etag_field), std::size(etag_field)};
+  if (options.cache && !std::empty(etag)) {
+    const auto compressed =
+        options.cache->find_or_compress(etag, body, coding);
+    if (!compressed)
+      return false;
+    body.assign(*compressed);
+  } else {
+    // Original body keeps it's memory for the next response of the thread
+    thread_local std::string scratch;
+    if (!compress(coding, body, scratch, options.level) ||
+        std::size(scratch) >= std::size(body))
+      return false;
+    std::swap(body, scratch);
+  }
+
+  // Strong validator differs between codings of the same content
+  if (etag.ends_with('"')) {
+    std::string coded{etag.substr(0, std::size(etag) - 1)};
+    coded.append("-").append(to_string(coding)).push_back('"');
+    response.set(http::field::etag, coded);
+  }
+  response.set(http::field::content_encoding, to_string(coding));
+  response.prepare_payload();
+  return true;
+}
+
+/**
+ * @brief The CompressingRespondent class compresses responses of the
+ * reusable response path of the wrapped respondent. Type-erased responses of
+ * make_response are written as they are: handlers compress them with
+ * compress_response before type erasure. Streams, shared responses and
+ * WebSocket connections are not compressed by it.
+ */
+class CompressingRespondent : public Respondent {
+  std::shared_ptr<Respondent> respondent_;
+  CompressionOptions options_;
+
+  CompressingRespondent(std::shared_ptr<Respondent> respondent,
+                        CompressionOptions options)
+      : respondent_{std::move(respondent)}, options_{std::move(options)} {}
+
+  friend util::SharedProxy<CompressingRespondent>;
+
+public:
+  ~CompressingRespondent() = default;
+
+  static std::shared_ptr<CompressingRespondent>
+  make_shared(std::shared_ptr<Respondent> respondent,
+              CompressionOptions options = {}) {
+    return std::make_shared<util::SharedProxy<CompressingRespondent>>(
+        std::move(respondent), std::move(options));
+  }
+
+  const CompressionOptions& options() const noexcept { return options_; }
+
+  boost::beast::http::message_generator
+  make_response(string_request&& request) override {
+    return respondent_->make_response(std::move(request));
+  }
+
+  bool fill_response(RequestView request,
+                     reusable_response& response) override {
+    if (!respondent_->fill_response(request, response))
+      return false;
+
+    compress_response(request, response, options_);
+    return true;
+  }
+
+  boost::beast::http::message_generator
+  make_arena_response(arena_request&& request) override {
+    return respondent_->make_arena_response(std::move(request));
+  }
+
+  std::shared_ptr<WebSocketHandler>
+  accept_websocket(const string_request& request) override {
+    return respondent_->accept_websocket(request);
+  }
+
+  bool shares_response(RequestView request) override {
+    return respondent_->shares_response(request);
+  }
+
+  bool async_shared_response(RequestView request,
+                             shared_response_handler handler) override {
+    return respondent_->async_shared_response(request, std::move(handler));
+  }
+
+  std::shared_ptr<StreamChannel>
+  make_stream(RequestView request, reusable_response& response) override {
+    return respondent_->make_stream(request, response);
+  }
+};
+
+} // namespace rest_in_beast
+
+#endif // REST_IN_BEAST_COMPRESSION_HPP
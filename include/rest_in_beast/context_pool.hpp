@@ -0,0 +1,220 @@
+//
+// Author: Dmitriy Gavryushin (https://github.com/Gawrjuschin)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#ifndef REST_IN_BEAST_CONTEXT_POOL_HPP
+#define REST_IN_BEAST_CONTEXT_POOL_HPP
+
+#include "runner.hpp"
+#include "util/shared_proxy.hpp"
+
+#include <boost/asio/io_context.hpp>
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+namespace rest_in_beast {
+
+/**
+ * @brief The ContextPool class spreads connections accepted by the server over
+ * io_contexts: session of the connection runs in the context chosen by the
+ * policy. Connection is counted with a Lease owned by it's session until the
+ * session is destroyed, so connections handed over to WebSocket or HTTP/2 are
+ * counted until they are closed.
+ *
+ * Set it as the factory's context_pool of every server sharing the contexts.
+ */
+class ContextPool : public std::enable_shared_from_this<ContextPool> {
+public:
+  /**
+   * @brief policy_type - index of the context for the next connection, called
+   * from acceptor's strand of any server using the pool
+   */
+  using policy_type = std::function<std::size_t(const ContextPool& pool)>;
+
+  /**
+   * @brief The Lease class - connection counted in the context, empty if the
+   * server has no pool
+   */
+  class Lease {
+    std::shared_ptr<ContextPool> pool_{};
+    std::size_t context_{};
+
+    friend ContextPool;
+
+    Lease(std::shared_ptr<ContextPool> pool, std::size_t context)
+        : pool_{std::move(pool)}, context_{context} {}
+
+  public:
+    Lease() = default;
+
+    Lease(const Lease&) = delete;
+    Lease& operator=(const Lease&) = delete;
+
+    Lease(Lease&& other) noexcept
+        : pool_{std::move(other.pool_)}, context_{other.context_} {}
+
+    Lease& operator=(Lease&& other) noexcept {
+      if (this != &other) {
+        reset();
+        pool_ = std::move(other.pool_);
+        context_ = other.context_;
+      }
+      return *this;
+    }
+
+    ~Lease() { reset(); }
+
+    explicit operator bool() const noexcept { return pool_ != nullptr; }
+
+    void reset() noexcept {
+      if (pool_) {
+        pool_->release(context_);
+        pool_.reset();
+      }
+    }
+  };
+
+private:
+  struct alignas(64) Counters {
+    std::atomic<std::size_t> connections{};
+    std::atomic<std::uint64_t> assigned{};
+  };
+
+  std::vector<boost::asio::io_context*> contexts_;
+  std::unique_ptr<Counters[]> counters_;
+  policy_type policy_;
+
+  ContextPool(std::vector<boost::asio::io_context*> contexts,
+              policy_type policy)
+      : contexts_{std::move(contexts)},
+        counters_{new Counters[std::size(contexts_)]},
+        policy_{std::move(policy)} {
+    if (std::empty(contexts_)) {
+      throw std::invalid_argument{"ContextPool without contexts"};
+    }
+  }
+
+  friend util::SharedProxy<ContextPool>;
+
+  void release(std::size_t context) noexcept {
+    counters_[context].connections.fetch_sub(1, std::memory_order_relaxed);
+  }
+
+public:
+  ContextPool(const ContextPool&) = delete;
+  ContextPool& operator=(const ContextPool&) = delete;
+
+  ContextPool(ContextPool&&) = delete;
+  ContextPool& operator=(ContextPool&&) = delete;
+
+  ~ContextPool() = default;
+
+  /**
+   * @brief round_robin - contexts in turn
+   */
+  static policy_type round_robin() {
+    return [next = std::make_shared<std::atomic<std::size_t>>()](
+               const ContextPool& pool) {
+      return next->fetch_add(1, std::memory_order_relaxed) % pool.size();
+    };
+  }
+
+  /**
+   * @brief least_connections - context with the fewest open connections. Scan
+   * starts from the next context each time, so ties are spread evenly
+   */
+  static policy_type least_connections() {
+    return [next = std::make_shared<std::atomic<std::size_t>>()](
+               const ContextPool& pool) {
+      const std::size_t size = pool.size();
+      const std::size_t first =
+          next->fetch_add(1, std::memory_order_relaxed) % size;
+      std::size_t best{first};
+      std::size_t best_connections{pool.connections(first)};
+      for (std::size_t step{1}; step < size && best_connections != 0;
+           ++step) {
+        const std::size_t context = (first + step) % size;
+        if (const auto connections = pool.connections(context);
+            connections < best_connections) {
+          best = context;
+          best_connections = connections;
+        }
+      }
+      return best;
+    };
+  }
+
+  /**
+   * @brief make_shared
+   * @param contexts - MUST outlive sessions of the pool
+   * @param policy - chooses context of the connection
+   * @throw std::invalid_argument if there are no contexts
+   */
+  static std::shared_ptr<ContextPool>
+  make_shared(std::vector<boost::asio::io_context*> contexts,
+              policy_type policy = least_connections()) {
+    return std::make_shared<util::SharedProxy<ContextPool>>(
+        std::move(contexts), std::move(policy));
+  }
+
+  /**
+   * @brief make_shared - pool of the runner's contexts
+   */
+  static std::shared_ptr<ContextPool>
+  make_shared(Runner& runner, policy_type policy = least_connections()) {
+    std::vector<boost::asio::io_context*> contexts;
+    contexts.reserve(runner.size());
+    for (std::size_t idx{}; idx < runner.size(); ++idx) {
+      contexts.push_back(&runner.context(idx));
+    }
+    return make_shared(std::move(contexts), std::move(policy));
+  }
+
+  std::size_t size() const noexcept { return std::size(contexts_); }
+
+  boost::asio::io_context& context(std::size_t idx) const noexcept {
+    return *contexts_[idx];
+  }
+
+  /**
+   * @brief connections - open connections of the context
+   */
+  std::size_t connections(std::size_t idx) const noexcept {
+    return counters_[idx].connections.load(std::memory_order_relaxed);
+  }
+
+  /**
+   * @brief assigned - connections ever assigned to the context
+   */
+  std::uint64_t assigned(std::size_t idx) const noexcept {
+    return counters_[idx].assigned.load(std::memory_order_relaxed);
+  }
+
+  /**
+   * @brief pick - context for the next accepted connection
+   */
+  std::size_t pick() const { return policy_(*this) % size(); }
+
+  /**
+   * @brief lease counts accepted connection in the context
+   */
+  Lease lease(std::size_t idx) {
+    counters_[idx].connections.fetch_add(1, std::memory_order_relaxed);
+    counters_[idx].assigned.fetch_add(1, std::memory_order_relaxed);
+    return Lease{shared_from_this(), idx};
+  }
+};
+
+} // namespace rest_in_beast
+
+#endif // REST_IN_BEAST_CONTEXT_POOL_HPP
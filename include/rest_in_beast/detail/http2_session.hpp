@@ -0,0 +1,1000 @@
+//
+// Author: Dmitriy Gavryushin (https://github.com/Gawrjuschin)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#ifndef REST_IN_BEAST_HTTP2_SESSION_HPP
+#define REST_IN_BEAST_HTTP2_SESSION_HPP
+
+#include "../rate_limit.hpp"
+#include "../util/hpack.hpp"
+#include "../util/shared_proxy.hpp"
+#include "logger.hpp"
+#include "respondent.hpp"
+
+#include <boost/asio/buffer.hpp>
+#include <boost/asio/write.hpp>
+#include <boost/beast/core.hpp>
+#include <boost/beast/http/message_generator.hpp>
+#include <boost/beast/http/parser.hpp>
+#include <boost/beast/http/string_body.hpp>
+
+#include <openssl/ssl.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <map>
+#include <memory>
+#include <memory_resource>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <utility>
+
+namespace rest_in_beast {
+namespace detail {
+
+namespace http2 {
+inline constexpr std::string_view client_preface{
+    "PRI * HTTP/2.0\r\n\r\nSM\r\n\r\n"};
+
+inline constexpr std::size_t frame_header_size{9};
+inline constexpr std::size_t default_frame_size{16'384};
+inline constexpr std::size_t max_frame_size{16'777'215};
+inline constexpr std::int64_t default_window{65'535};
+inline constexpr std::int64_t max_window{0x7fff'ffff};
+
+enum class frame : std::uint8_t {
+  data = 0x0,
+  headers = 0x1,
+  priority = 0x2,
+  rst_stream = 0x3,
+  settings = 0x4,
+  push_promise = 0x5,
+  ping = 0x6,
+  goaway = 0x7,
+  window_update = 0x8,
+  continuation = 0x9
+};
+
+namespace flag {
+inline constexpr std::uint8_t end_stream{0x1};
+inline constexpr std::uint8_t ack{0x1};
+inline constexpr std::uint8_t end_headers{0x4};
+inline constexpr std::uint8_t padded{0x8};
+inline constexpr std::uint8_t priority{0x20};
+} // namespace flag
+
+enum class error : std::uint32_t {
+  no_error = 0x0,
+  protocol_error = 0x1,
+  internal_error = 0x2,
+  flow_control_error = 0x3,
+  stream_closed = 0x5,
+  frame_size_error = 0x6,
+  refused_stream = 0x7,
+  cancel = 0x8,
+  compression_error = 0x9
+};
+
+enum class setting : std::uint16_t {
+  header_table_size = 0x1,
+  enable_push = 0x2,
+  max_concurrent_streams = 0x3,
+  initial_window_size = 0x4,
+  max_frame_size = 0x5,
+  max_header_list_size = 0x6
+};
+
+/**
+ * @brief negotiated - checks if ALPN selected HTTP/2 for the connection
+ */
+inline bool negotiated(const SSL* ssl) noexcept {
+  const unsigned char* protocol{};
+  unsigned int length{};
+  ::SSL_get0_alpn_selected(ssl, &protocol, &length);
+  return std::string_view{reinterpret_cast<const char*>(protocol), length} ==
+         "h2";
+}
+
+inline void append_u32(std::string& out, std::uint32_t value) {
+  out.push_back(static_cast<char>(value >> 24));
+  out.push_back(static_cast<char>(value >> 16));
+  out.push_back(static_cast<char>(value >> 8));
+  out.push_back(static_cast<char>(value));
+}
+
+inline std::uint32_t read_u32(std::string_view in) noexcept {
+  return static_cast<std::uint32_t>(static_cast<unsigned char>(in[0])) << 24 |
+         static_cast<std::uint32_t>(static_cast<unsigned char>(in[1])) << 16 |
+         static_cast<std::uint32_t>(static_cast<unsigned char>(in[2])) << 8 |
+         static_cast<std::uint32_t>(static_cast<unsigned char>(in[3]));
+}
+
+inline void append_frame_header(std::string& out, std::size_t length,
+                                frame type, std::uint8_t flags,
+                                std::uint32_t stream_id) {
+  out.push_back(static_cast<char>(length >> 16));
+  out.push_back(static_cast<char>(length >> 8));
+  out.push_back(static_cast<char>(length));
+  out.push_back(static_cast<char>(type));
+  out.push_back(static_cast<char>(flags));
+  append_u32(out, stream_id & 0x7fff'ffff);
+}
+
+/**
+ * @brief connection_specific - header fields forbidden in HTTP/2 messages
+ */
+inline bool connection_specific(std::string_view name) noexcept {
+  for (const std::string_view forbidden :
+       {"connection", "keep-alive", "proxy-connection", "transfer-encoding",
+        "upgrade"}) {
+    if (util::detail::iequals(name, forbidden))
+      return true;
+  }
+  return false;
+}
+} // namespace http2
+
+/**
+ * @brief The Http2Session class serves HTTP/2 over a TLS stream of the session
+ * which negotiated "h2" with ALPN. Every stream is a request for the
+ * Respondent: the respondent is called when the request is complete and
+ * responses of the streams are interleaved by frames within flow control
+ * windows. Streams over the rate limit of the remote address are answered with
+ * 429 before the respondent is called.
+ *
+ * The session keeps the owner of the stream alive and works in the stream's
+ * strand. Drained session sends GOAWAY without error, finishes open streams,
+ * refuses new ones and shuts the connection down after the last response.
+ * Server push and priorities are not supported.
+ */
+template <typename Stream>
+class Http2Session
+    : public std::enable_shared_from_this<Http2Session<Stream>> {
+  static constexpr std::string_view class_name{"Http2Session"};
+
+  using string_response =
+      boost::beast::http::response<boost::beast::http::string_body>;
+
+  static constexpr std::uint32_t max_concurrent_streams{100};
+  static constexpr std::size_t max_header_block_size{65'536};
+  static constexpr std::size_t max_request_body_size{1'048'576};
+  // Frames are not generated above it until the output is written
+  static constexpr std::size_t max_output_size{262'144};
+
+  struct StreamState {
+    string_request request{};
+    bool request_done{};
+    bool responding{};
+    std::int64_t send_window{};
+    std::string body{};
+    std::size_t body_sent{};
+  };
+
+  // Session which owns the stream
+  std::shared_ptr<void> owner_;
+  Stream& stream_;
+  boost::beast::flat_buffer buffer_;
+  std::shared_ptr<Respondent> respondent_;
+  std::shared_ptr<Logger> logger_;
+  std::chrono::milliseconds read_timeout_;
+  // Remote address in the server's rate limiter, empty if not limited
+  RateLimiter::Client limiter_;
+
+  util::HpackDecoder decoder_{};
+  std::string header_out_{};
+  std::map<std::uint32_t, StreamState> streams_{};
+  std::uint32_t last_stream_id_{};
+
+  // Header block in progress: HEADERS and following CONTINUATION frames
+  std::string header_block_{};
+  std::uint32_t header_stream_id_{};
+  bool header_end_stream_{};
+
+  // Peer's settings and flow control windows of sent data
+  std::int64_t connection_window_{http2::default_window};
+  std::int64_t initial_window_{http2::default_window};
+  std::size_t max_frame_size_{http2::default_frame_size};
+
+  // Memory of reusable response. Declared before the response to outlive it
+  std::pmr::unsynchronized_pool_resource response_pool_{};
+  reusable_response response_{
+      std::piecewise_construct, std::make_tuple(),
+      std::make_tuple(std::pmr::polymorphic_allocator<char>{&response_pool_})};
+
+  std::string output_{};
+  std::string writing_{};
+
+  bool preface_received_{};
+  bool read_in_progress_{};
+  bool write_in_progress_{};
+  // Connection error or end of input: no more reads
+  bool closing_{};
+  bool peer_goaway_{};
+  bool shutdown_started_{};
+  // GOAWAY of drain is sent, streams above it's last stream are refused
+  bool draining_{};
+  std::uint32_t drain_stream_id_{};
+
+  Http2Session(std::shared_ptr<void> owner, Stream& stream,
+               boost::beast::flat_buffer buffer,
+               std::shared_ptr<Respondent> respondent,
+               std::shared_ptr<Logger> logger,
+               std::chrono::milliseconds read_timeout,
+               RateLimiter::Client limiter)
+      : owner_{std::move(owner)}, stream_{stream}, buffer_{std::move(buffer)},
+        respondent_{std::move(respondent)}, logger_{std::move(logger)},
+        read_timeout_{read_timeout}, limiter_{std::move(limiter)} {}
+
+  friend util::SharedProxy<Http2Session>;
+
+public:
+  Http2Session(const Http2Session&) = delete;
+  Http2Session& operator=(const Http2Session&) = delete;
+
+  Http2Session(Http2Session&&) = delete;
+  Http2Session& operator=(Http2Session&&) = delete;
+
+  ~Http2Session() = default;
+
+  /**
+   * @brief start - takes over the stream after TLS handshake, MUST be called
+   * in the stream's strand
+   * @param owner - session which owns the stream
+   * @param buffer - data read after the handshake
+   * @param limiter - remote address in the server's rate limiter
+   * @return the session to drain, it owns itself while the connection is open
+   */
+  static std::shared_ptr<Http2Session>
+  start(std::shared_ptr<void> owner, Stream& stream,
+        boost::beast::flat_buffer buffer,
+        std::shared_ptr<Respondent> respondent, std::shared_ptr<Logger> logger,
+        std::chrono::milliseconds read_timeout,
+        RateLimiter::Client limiter = {}) {
+    std::shared_ptr<Http2Session> session =
+        std::make_shared<util::SharedProxy<Http2Session>>(
+            std::move(owner), stream, std::move(buffer), std::move(respondent),
+            std::move(logger), read_timeout, std::move(limiter));
+    session->run();
+    return session;
+  }
+
+  /**
+   * @brief drain sends GOAWAY without error and cancels the read if no request
+   * is being received. Forced drain closes the socket. MUST be called in the
+   * stream's strand
+   */
+  void drain(bool force) {
+    boost::beast::error_code ec;
+    auto& socket = boost::beast::get_lowest_layer(stream_).socket();
+    if (force) {
+      closing_ = true;
+      socket.close(ec);
+      return;
+    }
+
+    if (closing_ || std::exchange(draining_, true))
+      return;
+
+    drain_stream_id_ = last_stream_id_;
+    goaway(http2::error::no_error);
+    if (read_in_progress_ && !receiving()) {
+      socket.cancel(ec);
+    }
+    flush();
+  }
+
+private:
+  void run() {
+    // Server preface
+    http2::append_frame_header(output_, 6, http2::frame::settings, 0, 0);
+    constexpr auto max_streams = http2::setting::max_concurrent_streams;
+    output_.push_back(0);
+    output_.push_back(static_cast<char>(max_streams));
+    http2::append_u32(output_, max_concurrent_streams);
+
+    process();
+    continue_reading();
+    flush();
+  }
+
+  // ~~~
+  // Input
+  // ~~~
+  void do_read() {
+    read_in_progress_ = true;
+    boost::beast::get_lowest_layer(stream_).expires_after(read_timeout_);
+
+    stream_.async_read_some(
+        buffer_.prepare(http2::frame_header_size + http2::default_frame_size),
+        boost::beast::bind_front_handler(&Http2Session::on_read,
+                                         this->shared_from_this()));
+  }
+
+  void on_read(boost::beast::error_code ec, std::size_t bytes_transferred) {
+    read_in_progress_ = false;
+
+    if (ec == boost::asio::error::eof) {
+      closing_ = true;
+      return flush();
+    }
+
+    // Read is cancelled by drain
+    if (ec == boost::asio::error::operation_aborted && draining_)
+      return flush();
+
+    if (ec) {
+      if (!closing_) {
+        logger_->log(class_name, "on_read", ec);
+      }
+      return;
+    }
+
+    buffer_.commit(bytes_transferred);
+    process();
+    continue_reading();
+    flush();
+  }
+
+  void continue_reading() {
+    if (closing_ || read_in_progress_)
+      return;
+
+    // Peer sends nothing new after GOAWAY but the rest of open requests
+    if ((peer_goaway_ || draining_) && !receiving())
+      return;
+
+    do_read();
+  }
+
+  /**
+   * @brief receiving checks if a request of open stream is not complete
+   */
+  bool receiving() const {
+    return std::any_of(
+        std::cbegin(streams_), std::cend(streams_),
+        [](const auto& stream) { return !stream.second.request_done; });
+  }
+
+  void process() {
+    if (!preface_received_) {
+      if (buffer_.size() < std::size(http2::client_preface))
+        return;
+
+      const std::string_view received{
+          static_cast<const char*>(buffer_.data().data()),
+          std::size(http2::client_preface)};
+      if (received != http2::client_preface)
+        return connection_error(http2::error::protocol_error);
+
+      buffer_.consume(std::size(http2::client_preface));
+      preface_received_ = true;
+    }
+
+    while (!closing_ && buffer_.size() >= http2::frame_header_size) {
+      const std::string_view data{
+          static_cast<const char*>(buffer_.data().data()), buffer_.size()};
+      const auto* header = reinterpret_cast<const unsigned char*>(data.data());
+
+      const std::size_t length = static_cast<std::size_t>(header[0]) << 16 |
+                                 static_cast<std::size_t>(header[1]) << 8 |
+                                 static_cast<std::size_t>(header[2]);
+      if (length > http2::default_frame_size)
+        return connection_error(http2::error::frame_size_error);
+      if (std::size(data) < http2::frame_header_size + length)
+        return;
+
+      const auto type = static_cast<http2::frame>(header[3]);
+      const std::uint8_t flags = header[4];
+      const std::uint32_t stream_id =
+          http2::read_u32(data.substr(5, 4)) & 0x7fff'ffff;
+
+      on_frame(type, flags, stream_id,
+               data.substr(http2::frame_header_size, length));
+      buffer_.consume(http2::frame_header_size + length);
+    }
+  }
+
+  void on_frame(http2::frame type, std::uint8_t flags, std::uint32_t stream_id,
+                std::string_view payload) {
+    if (header_stream_id_ != 0 && type != http2::frame::continuation)
+      return connection_error(http2::error::protocol_error);
+
+    switch (type) {
+    case http2::frame::data:
+      return on_data(flags, stream_id, payload);
+    case http2::frame::headers:
+      return on_headers(flags, stream_id, payload);
+    case http2::frame::continuation:
+      return on_continuation(flags, stream_id, payload);
+    case http2::frame::priority:
+      if (stream_id == 0)
+        return connection_error(http2::error::protocol_error);
+      if (std::size(payload) != 5)
+        return stream_error(stream_id, http2::error::frame_size_error);
+      return;
+    case http2::frame::rst_stream:
+      if (stream_id == 0 || stream_id > last_stream_id_)
+        return connection_error(http2::error::protocol_error);
+      if (std::size(payload) != 4)
+        return connection_error(http2::error::frame_size_error);
+      streams_.erase(stream_id);
+      return;
+    case http2::frame::settings:
+      return on_settings(flags, stream_id, payload);
+    case http2::frame::push_promise:
+      return connection_error(http2::error::protocol_error);
+    case http2::frame::ping:
+      if (stream_id != 0)
+        return connection_error(http2::error::protocol_error);
+      if (std::size(payload) != 8)
+        return connection_error(http2::error::frame_size_error);
+      if (!(flags & http2::flag::ack)) {
+        http2::append_frame_header(output_, 8, http2::frame::ping,
+                                   http2::flag::ack, 0);
+        output_.append(payload);
+      }
+      return;
+    case http2::frame::goaway:
+      if (stream_id != 0)
+        return connection_error(http2::error::protocol_error);
+      peer_goaway_ = true;
+      return;
+    case http2::frame::window_update:
+      return on_window_update(stream_id, payload);
+    default:
+      // Unknown frames are ignored
+      return;
+    }
+  }
+
+  /**
+   * @brief unpad removes padding of DATA and HEADERS frames
+   */
+  static bool unpad(std::uint8_t flags, std::string_view& payload) noexcept {
+    if (!(flags & http2::flag::padded))
+      return true;
+    if (std::empty(payload))
+      return false;
+
+    const std::size_t padding = static_cast<unsigned char>(payload.front());
+    payload.remove_prefix(1);
+    if (padding > std::size(payload))
+      return false;
+    payload.remove_suffix(padding);
+    return true;
+  }
+
+  void on_data(std::uint8_t flags, std::uint32_t stream_id,
+               std::string_view payload) {
+    if (stream_id == 0 || stream_id > last_stream_id_)
+      return connection_error(http2::error::protocol_error);
+
+    // Received data always counts for the connection window
+    if (!std::empty(payload)) {
+      window_update(0, std::size(payload));
+    }
+
+    const std::size_t frame_size = std::size(payload);
+    if (!unpad(flags, payload))
+      return connection_error(http2::error::protocol_error);
+
+    const auto it = streams_.find(stream_id);
+    if (it == std::end(streams_) || it->second.request_done)
+      return stream_error(stream_id, http2::error::stream_closed);
+
+    auto& state = it->second;
+    auto& body = state.request.body();
+    if (std::size(body) + std::size(payload) > max_request_body_size)
+      return stream_error(stream_id, http2::error::cancel);
+    body.append(payload);
+
+    if (flags & http2::flag::end_stream)
+      return respond(stream_id, state);
+
+    if (frame_size != 0) {
+      window_update(stream_id, frame_size);
+    }
+  }
+
+  void on_headers(std::uint8_t flags, std::uint32_t stream_id,
+                  std::string_view payload) {
+    if (stream_id == 0 || stream_id % 2 == 0)
+      return connection_error(http2::error::protocol_error);
+
+    if (!unpad(flags, payload))
+      return connection_error(http2::error::protocol_error);
+
+    if (flags & http2::flag::priority) {
+      if (std::size(payload) < 5)
+        return connection_error(http2::error::frame_size_error);
+      payload.remove_prefix(5);
+    }
+
+    header_stream_id_ = stream_id;
+    header_end_stream_ = flags & http2::flag::end_stream;
+    header_block_.assign(payload);
+
+    if (flags & http2::flag::end_headers) {
+      on_header_block();
+    }
+  }
+
+  void on_continuation(std::uint8_t flags, std::uint32_t stream_id,
+                       std::string_view payload) {
+    if (header_stream_id_ == 0 || stream_id != header_stream_id_)
+      return connection_error(http2::error::protocol_error);
+
+    if (std::size(header_block_) + std::size(payload) > max_header_block_size)
+      return connection_error(http2::error::compression_error);
+    header_block_.append(payload);
+
+    if (flags & http2::flag::end_headers) {
+      on_header_block();
+    }
+  }
+
+  void on_header_block() {
+    const std::uint32_t stream_id = std::exchange(header_stream_id_, 0);
+    const bool end_stream = header_end_stream_;
+
+    auto it = streams_.find(stream_id);
+    const bool is_new = it == std::end(streams_) && stream_id > last_stream_id_;
+
+    string_request request{};
+    request.version(11);
+    std::string authority{};
+    bool regular_seen{};
+    bool malformed{};
+
+    // Block is decoded even for refused streams: it changes the dynamic table
+    const bool decoded =
+        decoder_.decode(header_block_, [&](std::string_view name,
+                                           std::string_view value) {
+          if (!std::empty(name) && name.front() == ':') {
+            if (regular_seen) {
+              malformed = true;
+            } else if (name == ":method") {
+              request.method_string(value);
+            } else if (name == ":path") {
+              request.target(value);
+            } else if (name == ":authority") {
+              authority.assign(value);
+            } else if (name != ":scheme") {
+              malformed = true;
+            }
+            return;
+          }
+
+          regular_seen = true;
+          if (http2::connection_specific(name)) {
+            malformed = true;
+          } else if (name == "cookie" &&
+                     request.find(boost::beast::http::field::cookie) !=
+                         std::end(request)) {
+            // Cookie may be split into several fields
+            std::string cookie{request[boost::beast::http::field::cookie]};
+            cookie.append("; ").append(value);
+            request.set(boost::beast::http::field::cookie, cookie);
+          } else {
+            request.insert(name, value);
+          }
+        });
+    if (!decoded)
+      return connection_error(http2::error::compression_error);
+
+    if (!is_new) {
+      if (it == std::end(streams_) || it->second.request_done)
+        return stream_error(stream_id, http2::error::stream_closed);
+
+      // Trailers end the request, their fields are dropped
+      if (!end_stream)
+        return stream_error(stream_id, http2::error::protocol_error);
+      return respond(stream_id, it->second);
+    }
+
+    last_stream_id_ = stream_id;
+    if (draining_ || std::size(streams_) >= max_concurrent_streams)
+      return stream_error(stream_id, http2::error::refused_stream);
+
+    if (malformed || std::empty(request.method_string()) ||
+        std::empty(request.target()))
+      return stream_error(stream_id, http2::error::protocol_error);
+
+    if (!std::empty(authority) &&
+        request.find(boost::beast::http::field::host) == std::end(request)) {
+      request.set(boost::beast::http::field::host, authority);
+    }
+
+    it = streams_.emplace(stream_id, StreamState{}).first;
+    it->second.request = std::move(request);
+    it->second.send_window = initial_window_;
+
+    if (end_stream) {
+      respond(stream_id, it->second);
+    }
+  }
+
+  void on_settings(std::uint8_t flags, std::uint32_t stream_id,
+                   std::string_view payload) {
+    if (stream_id != 0)
+      return connection_error(http2::error::protocol_error);
+
+    if (flags & http2::flag::ack) {
+      if (!std::empty(payload))
+        return connection_error(http2::error::frame_size_error);
+      return;
+    }
+
+    if (std::size(payload) % 6 != 0)
+      return connection_error(http2::error::frame_size_error);
+
+    for (; !std::empty(payload); payload.remove_prefix(6)) {
+      const auto id = static_cast<http2::setting>(
+          static_cast<unsigned char>(payload[0]) << 8 |
+          static_cast<unsigned char>(payload[1]));
+      const std::uint32_t value = http2::read_u32(payload.substr(2, 4));
+
+      switch (id) {
+      case http2::setting::initial_window_size: {
+        if (value > http2::max_window)
+          return connection_error(http2::error::flow_control_error);
+
+        const std::int64_t delta = value - initial_window_;
+        initial_window_ = value;
+        for (auto& [_, state] : streams_) {
+          state.send_window += delta;
+          if (state.send_window > http2::max_window)
+            return connection_error(http2::error::flow_control_error);
+        }
+        break;
+      }
+      case http2::setting::max_frame_size:
+        if (value < http2::default_frame_size || value > http2::max_frame_size)
+          return connection_error(http2::error::protocol_error);
+        max_frame_size_ = value;
+        break;
+      default:
+        // The encoder does not index fields: peer's table size does not
+        // matter, server does not push
+        break;
+      }
+    }
+
+    http2::append_frame_header(output_, 0, http2::frame::settings,
+                               http2::flag::ack, 0);
+  }
+
+  void on_window_update(std::uint32_t stream_id, std::string_view payload) {
+    if (std::size(payload) != 4)
+      return connection_error(http2::error::frame_size_error);
+
+    const std::int64_t increment = http2::read_u32(payload) & 0x7fff'ffff;
+    if (stream_id == 0) {
+      if (increment == 0)
+        return connection_error(http2::error::protocol_error);
+
+      connection_window_ += increment;
+      if (connection_window_ > http2::max_window)
+        return connection_error(http2::error::flow_control_error);
+      return;
+    }
+
+    if (increment == 0)
+      return stream_error(stream_id, http2::error::protocol_error);
+
+    const auto it = streams_.find(stream_id);
+    if (it == std::end(streams_))
+      return;
+
+    it->second.send_window += increment;
+    if (it->second.send_window > http2::max_window)
+      return stream_error(stream_id, http2::error::flow_control_error);
+  }
+
+  // ~~~
+  // Responses
+  // ~~~
+  /**
+   * @brief fill_response resets reusable response and lets respondent fill it
+   */
+  bool fill_response(const string_request& request) {
+    response_.base().clear();
+    response_.body().clear();
+    response_.result(boost::beast::http::status::ok);
+    response_.version(request.version());
+    response_.keep_alive(request.keep_alive());
+
+    if (!respondent_->fill_response(request, response_))
+      return false;
+
+    response_.prepare_payload();
+    return true;
+  }
+
+  /**
+   * @brief to_response parses HTTP/1.1 message of the generator back
+   */
+  static bool to_response(boost::beast::http::message_generator& generator,
+                          bool head, string_response& response) {
+    std::string raw;
+    boost::beast::error_code ec;
+    for (;;) {
+      const auto buffers = generator.prepare(ec);
+      if (ec)
+        return false;
+
+      const std::size_t size = boost::asio::buffer_size(buffers);
+      if (size == 0)
+        break;
+
+      for (const auto& buffer : buffers) {
+        raw.append(static_cast<const char*>(buffer.data()), buffer.size());
+      }
+      generator.consume(size);
+    }
+
+    return parse_response(raw, head, response);
+  }
+
+  /**
+   * @brief parse_response parses serialized HTTP/1.1 response
+   */
+  static bool parse_response(std::string_view raw, bool head,
+                             string_response& response) {
+    boost::beast::error_code ec;
+    boost::beast::http::response_parser<boost::beast::http::string_body>
+        parser;
+    parser.eager(true);
+    parser.skip(head);
+    parser.body_limit((std::numeric_limits<std::uint64_t>::max)());
+
+    std::string_view rest{raw};
+    while (!parser.is_done() && !std::empty(rest)) {
+      const std::size_t parsed = parser.put(
+          boost::asio::buffer(std::data(rest), std::size(rest)), ec);
+      if (ec)
+        return false;
+      rest.remove_prefix(parsed);
+    }
+
+    if (!parser.is_done()) {
+      parser.put_eof(ec);
+      if (ec)
+        return false;
+    }
+
+    response = parser.release();
+    return true;
+  }
+
+  template <typename Body, typename Fields>
+  void write_headers(std::uint32_t stream_id,
+                     const boost::beast::http::response<Body, Fields>& response,
+                     bool end_stream) {
+    header_out_.clear();
+    util::HpackEncoder::encode_status(header_out_, response.result_int());
+    for (const auto& field : response) {
+      if (http2::connection_specific(field.name_string()))
+        continue;
+      util::HpackEncoder::encode(header_out_, field.name_string(),
+                                 field.value());
+    }
+
+    std::string_view block{header_out_};
+    bool first{true};
+    do {
+      const std::size_t size = std::min(std::size(block), max_frame_size_);
+      std::uint8_t flags{};
+      if (size == std::size(block)) {
+        flags |= http2::flag::end_headers;
+      }
+      if (first && end_stream) {
+        flags |= http2::flag::end_stream;
+      }
+
+      http2::append_frame_header(output_, size,
+                                 first ? http2::frame::headers
+                                       : http2::frame::continuation,
+                                 flags, stream_id);
+      output_.append(block.substr(0, size));
+      block.remove_prefix(size);
+      first = false;
+    } while (!std::empty(block));
+  }
+
+  void respond(std::uint32_t stream_id, StreamState& state) {
+    state.request_done = true;
+
+    auto& request = state.request;
+    if (!std::empty(request.body()) &&
+        request.find(boost::beast::http::field::content_length) ==
+            std::end(request)) {
+      request.prepare_payload();
+    }
+    const bool head = request.method() == boost::beast::http::verb::head;
+
+    if (try_rate_limit(stream_id, request))
+      return;
+
+    if (fill_response(request)) {
+      const bool end_stream = head || std::empty(response_.body());
+      write_headers(stream_id, response_, end_stream);
+      if (!end_stream) {
+        state.body.assign(response_.body());
+      }
+    } else {
+      auto generator = respondent_->make_response(std::move(request));
+      string_response response;
+      if (!to_response(generator, head, response)) {
+        logger_->log(class_name, "respond",
+                     boost::beast::http::error::bad_value);
+        return stream_error(stream_id, http2::error::internal_error);
+      }
+
+      const bool end_stream = head || std::empty(response.body());
+      write_headers(stream_id, response, end_stream);
+      if (!end_stream) {
+        state.body = std::move(response.body());
+      }
+    }
+
+    if (std::empty(state.body)) {
+      streams_.erase(stream_id);
+      return;
+    }
+    state.responding = true;
+  }
+
+  /**
+   * @brief try_rate_limit answers the stream over the client's limit with
+   * headers of limiter's 429, the respondent is not called
+   */
+  bool try_rate_limit(std::uint32_t stream_id, const string_request& request) {
+    if (!limiter_)
+      return false;
+
+    const auto* rejection =
+        limiter_.take(request.method(), request.target(), true);
+    if (!rejection)
+      return false;
+
+    string_response response;
+    if (!parse_response(*rejection, false, response)) {
+      stream_error(stream_id, http2::error::internal_error);
+      return true;
+    }
+
+    write_headers(stream_id, response, true);
+    streams_.erase(stream_id);
+    return true;
+  }
+
+  /**
+   * @brief send_data frames responses' bodies within flow control windows
+   */
+  void send_data() {
+    for (auto it = std::begin(streams_); it != std::end(streams_);) {
+      if (connection_window_ <= 0 || std::size(output_) >= max_output_size)
+        return;
+
+      auto& [stream_id, state] = *it;
+      if (!state.responding) {
+        ++it;
+        continue;
+      }
+
+      while (state.send_window > 0 && connection_window_ > 0 &&
+             state.body_sent < std::size(state.body) &&
+             std::size(output_) < max_output_size) {
+        const std::size_t size = std::min(
+            {std::size(state.body) - state.body_sent, max_frame_size_,
+             static_cast<std::size_t>(state.send_window),
+             static_cast<std::size_t>(connection_window_)});
+        const bool last = state.body_sent + size == std::size(state.body);
+
+        http2::append_frame_header(output_, size, http2::frame::data,
+                                   last ? http2::flag::end_stream : 0,
+                                   stream_id);
+        output_.append(state.body, state.body_sent, size);
+
+        state.body_sent += size;
+        state.send_window -= static_cast<std::int64_t>(size);
+        connection_window_ -= static_cast<std::int64_t>(size);
+      }
+
+      if (state.body_sent == std::size(state.body)) {
+        it = streams_.erase(it);
+      } else {
+        ++it;
+      }
+    }
+  }
+
+  void window_update(std::uint32_t stream_id, std::size_t increment) {
+    http2::append_frame_header(output_, 4, http2::frame::window_update, 0,
+                               stream_id);
+    http2::append_u32(output_, static_cast<std::uint32_t>(increment));
+  }
+
+  void stream_error(std::uint32_t stream_id, http2::error code) {
+    http2::append_frame_header(output_, 4, http2::frame::rst_stream, 0,
+                               stream_id);
+    http2::append_u32(output_, static_cast<std::uint32_t>(code));
+    streams_.erase(stream_id);
+  }
+
+  void goaway(http2::error code) {
+    // Last stream of GOAWAY after the drain's one may not grow
+    http2::append_frame_header(output_, 8, http2::frame::goaway, 0, 0);
+    http2::append_u32(output_, draining_ ? drain_stream_id_ : last_stream_id_);
+    http2::append_u32(output_, static_cast<std::uint32_t>(code));
+  }
+
+  void connection_error(http2::error code) {
+    goaway(code);
+    closing_ = true;
+  }
+
+  // ~~~
+  // Output
+  // ~~~
+  void flush() {
+    if (write_in_progress_)
+      return;
+
+    send_data();
+    if (std::empty(output_)) {
+      const bool done =
+          closing_ || ((peer_goaway_ || draining_) && std::empty(streams_));
+      if (done && !read_in_progress_) {
+        do_shutdown();
+      }
+      return;
+    }
+
+    write_in_progress_ = true;
+    std::swap(output_, writing_);
+    boost::asio::async_write(
+        stream_, boost::asio::buffer(writing_),
+        boost::beast::bind_front_handler(&Http2Session::on_write,
+                                         this->shared_from_this()));
+  }
+
+  void on_write(boost::beast::error_code ec, std::size_t _) {
+    write_in_progress_ = false;
+    writing_.clear();
+
+    if (ec) {
+      closing_ = true;
+      logger_->log(class_name, "on_write", ec);
+      boost::beast::get_lowest_layer(stream_).socket().close(ec);
+      return;
+    }
+
+    flush();
+  }
+
+  void do_shutdown() {
+    if (std::exchange(shutdown_started_, true))
+      return;
+
+    stream_.async_shutdown([self = this->shared_from_this()](
+                               boost::beast::error_code ec, auto&&...) {
+      if (ec) {
+        self->logger_->log(class_name, "on_shutdown", ec);
+      }
+    });
+  }
+};
+
+} // namespace detail
+} // namespace rest_in_beast
+
+#endif // REST_IN_BEAST_HTTP2_SESSION_HPP
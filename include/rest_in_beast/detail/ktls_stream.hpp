@@ -0,0 +1,444 @@
+//
+// Author: Dmitriy Gavryushin (https://github.com/Gawrjuschin)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#ifndef REST_IN_BEAST_KTLS_STREAM_HPP
+#define REST_IN_BEAST_KTLS_STREAM_HPP
+
+#include <boost/asio/async_result.hpp>
+#include <boost/asio/buffer.hpp>
+#include <boost/asio/compose.hpp>
+#include <boost/asio/detail/throw_error.hpp>
+#include <boost/asio/error.hpp>
+#include <boost/asio/ip/tcp.hpp>
+#include <boost/asio/post.hpp>
+#include <boost/asio/ssl/context.hpp>
+#include <boost/asio/ssl/error.hpp>
+#include <boost/asio/steady_timer.hpp>
+#include <boost/beast/core/error.hpp>
+#include <boost/system/error_code.hpp>
+
+#include <openssl/bio.h>
+#include <openssl/err.h>
+#include <openssl/opensslv.h>
+#include <openssl/ssl.h>
+
+// BIO_get_ktls_send, BIO_get_ktls_recv and SSL_sendfile appeared in OpenSSL 3.0
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L && !defined(OPENSSL_NO_KTLS)
+#define REST_IN_BEAST_KTLS
+#endif
+
+#ifdef REST_IN_BEAST_KTLS
+
+#include <pthread.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <ctime>
+#include <memory>
+#include <utility>
+#include <vector>
+
+namespace rest_in_beast {
+
+/**
+ * @brief The KtlsMetrics class counts record paths of kernel TLS connections
+ */
+struct KtlsMetrics {
+  // Connections which send records with kernel TLS
+  std::atomic<std::uint64_t> kernel_send{};
+  // Connections which receive records with kernel TLS
+  std::atomic<std::uint64_t> kernel_receive{};
+  // Connections which encrypt and decrypt records in userspace
+  std::atomic<std::uint64_t> userspace{};
+};
+
+namespace detail {
+
+/**
+ * @brief The SigpipeGuard class blocks SIGPIPE in the calling thread for it's
+ * lifetime and consumes the one raised meanwhile: OpenSSL writes to the socket
+ * (and sendfile's to it) without MSG_NOSIGNAL. Disposition of SIGPIPE in the
+ * process is left to the application
+ */
+class SigpipeGuard {
+  sigset_t previous_{};
+  bool blocked_{};
+
+  static sigset_t sigpipe() noexcept {
+    sigset_t set;
+    sigemptyset(&set);
+    sigaddset(&set, SIGPIPE);
+    return set;
+  }
+
+public:
+  SigpipeGuard() noexcept {
+    const sigset_t set{sigpipe()};
+    // Nothing to consume if the application blocks SIGPIPE itself
+    blocked_ = ::pthread_sigmask(SIG_BLOCK, &set, &previous_) == 0 &&
+               sigismember(&previous_, SIGPIPE) == 0;
+  }
+
+  SigpipeGuard(const SigpipeGuard&) = delete;
+  SigpipeGuard& operator=(const SigpipeGuard&) = delete;
+
+  SigpipeGuard(SigpipeGuard&&) = delete;
+  SigpipeGuard& operator=(SigpipeGuard&&) = delete;
+
+  ~SigpipeGuard() {
+    if (!blocked_)
+      return;
+
+    const sigset_t set{sigpipe()};
+    sigset_t pending;
+    if (::sigpending(&pending) == 0 && sigismember(&pending, SIGPIPE) == 1) {
+      const timespec zero{};
+      ::sigtimedwait(&set, nullptr, &zero);
+    }
+    ::pthread_sigmask(SIG_SETMASK, &previous_, nullptr);
+  }
+};
+
+/**
+ * @brief The KtlsStream class is a TLS stream with OpenSSL attached directly
+ * to the socket, so OpenSSL can hand record encryption over to the kernel
+ * (SSL_OP_ENABLE_KTLS) after the handshake. If the kernel or the negotiated
+ * cipher does not support it, OpenSSL keeps encrypting records in userspace
+ * over the same socket.
+ *
+ * The stream is it's own lowest layer: expires_after/expires_never work as
+ * boost::beast::tcp_stream's ones. Every operation completes with
+ * void(error_code, std::size_t).
+ */
+class KtlsStream {
+public:
+  using executor_type = boost::asio::ip::tcp::socket::executor_type;
+
+private:
+  // Maximum TLS record plaintext: gathered write buffers are coalesced up to it
+  static constexpr std::size_t max_record_size{16'384};
+
+  enum class Want { nothing, read, write };
+
+  boost::asio::ip::tcp::socket socket_;
+  boost::asio::steady_timer timer_;
+  std::unique_ptr<SSL, decltype(&SSL_free)> ssl_{nullptr, &SSL_free};
+  std::vector<char> write_buffer_{};
+
+  /**
+   * @brief The Deadline class is shared with the pending wait of the timer.
+   * Each arm is tagged with the generation: completion of the replaced one,
+   * already queued when the timer was re-armed, is ignored
+   */
+  struct Deadline {
+    std::uint64_t generation{};
+    bool timed_out{};
+  };
+  std::shared_ptr<Deadline> deadline_{std::make_shared<Deadline>()};
+
+  /**
+   * @brief result maps result of SSL_* call to the wait or the error
+   */
+  static Want result(SSL* ssl, int ret, boost::system::error_code& ec) {
+    switch (SSL_get_error(ssl, ret)) {
+    case SSL_ERROR_NONE:
+      return Want::nothing;
+    case SSL_ERROR_WANT_READ:
+      return Want::read;
+    case SSL_ERROR_WANT_WRITE:
+      return Want::write;
+    case SSL_ERROR_ZERO_RETURN:
+      ec = boost::asio::error::eof;
+      return Want::nothing;
+    case SSL_ERROR_SYSCALL:
+      if (errno != 0) {
+        ec = {errno, boost::system::system_category()};
+      } else {
+        ec = boost::asio::ssl::error::stream_truncated;
+      }
+      return Want::nothing;
+    default:
+      ec = {static_cast<int>(ERR_get_error()),
+            boost::asio::error::get_ssl_category()};
+      if (!ec) {
+        ec = boost::asio::ssl::error::unspecified_system_error;
+      }
+      return Want::nothing;
+    }
+  }
+
+  /**
+   * @brief The SslOp class repeats SSL_* call until it stops asking for the
+   * socket readiness. Completion of the first attempt is posted.
+   * @param Operation - Want(SSL*, std::size_t& bytes, error_code& ec)
+   */
+  template <typename Operation> class SslOp {
+    KtlsStream& stream_;
+    Operation operation_;
+    boost::system::error_code ec_{};
+    std::size_t bytes_{};
+    bool started_{};
+    bool completed_{};
+
+  public:
+    SslOp(KtlsStream& stream, Operation operation)
+        : stream_{stream}, operation_{std::move(operation)} {}
+
+    template <typename Self>
+    void operator()(Self& self, boost::system::error_code ec = {}) {
+      if (completed_) {
+        return self.complete(ec_, bytes_);
+      }
+
+      if (stream_.deadline_->timed_out) {
+        ec = boost::beast::error::timeout;
+      }
+
+      Want want{Want::nothing};
+      if (ec) {
+        ec_ = ec;
+      } else {
+#ifndef SO_NOSIGPIPE
+        const SigpipeGuard sigpipe_guard;
+#endif
+        ERR_clear_error();
+        errno = 0;
+        want = operation_(stream_.ssl_.get(), bytes_, ec_);
+      }
+
+      const bool first{!started_};
+      started_ = true;
+
+      switch (want) {
+      case Want::read:
+        return stream_.socket_.async_wait(
+            boost::asio::ip::tcp::socket::wait_read, std::move(self));
+      case Want::write:
+        return stream_.socket_.async_wait(
+            boost::asio::ip::tcp::socket::wait_write, std::move(self));
+      case Want::nothing:
+        break;
+      }
+
+      if (first) {
+        completed_ = true;
+        return boost::asio::post(std::move(self));
+      }
+
+      self.complete(ec_, bytes_);
+    }
+  };
+
+  template <typename Handler, typename Operation>
+  auto async_ssl(Handler&& handler, Operation&& operation) {
+    return boost::asio::async_compose<Handler,
+                                      void(boost::system::error_code,
+                                           std::size_t)>(
+        SslOp<std::decay_t<Operation>>{*this,
+                                       std::forward<Operation>(operation)},
+        handler, socket_);
+  }
+
+public:
+  /**
+   * @param peer - connected socket, it's executor is used for all operations
+   * @param ssl_ctx - context of the server, kernel TLS is enabled per
+   * connection
+   */
+  KtlsStream(boost::asio::ip::tcp::socket&& peer,
+             boost::asio::ssl::context& ssl_ctx)
+      : socket_{std::move(peer)}, timer_{socket_.get_executor()} {
+    ssl_.reset(SSL_new(ssl_ctx.native_handle()));
+    if (!ssl_) {
+      boost::asio::detail::throw_error(
+          {static_cast<int>(ERR_get_error()),
+           boost::asio::error::get_ssl_category()},
+          "KtlsStream");
+    }
+
+    boost::system::error_code ec;
+    socket_.non_blocking(true, ec);
+#ifdef SO_NOSIGPIPE
+    const int on{1};
+    ::setsockopt(socket_.native_handle(), SOL_SOCKET, SO_NOSIGPIPE, &on,
+                 sizeof(on));
+#endif
+    SSL_set_fd(ssl_.get(), static_cast<int>(socket_.native_handle()));
+    SSL_set_accept_state(ssl_.get());
+    SSL_set_mode(ssl_.get(), SSL_MODE_ENABLE_PARTIAL_WRITE);
+    SSL_set_options(ssl_.get(), SSL_OP_ENABLE_KTLS);
+  }
+
+  KtlsStream(const KtlsStream&) = delete;
+  KtlsStream& operator=(const KtlsStream&) = delete;
+
+  KtlsStream(KtlsStream&&) = delete;
+  KtlsStream& operator=(KtlsStream&&) = delete;
+
+  ~KtlsStream() = default;
+
+  executor_type get_executor() noexcept { return socket_.get_executor(); }
+
+  boost::asio::ip::tcp::socket& socket() noexcept { return socket_; }
+
+  SSL* native_handle() noexcept { return ssl_.get(); }
+
+  /**
+   * @brief kernel_send - records are encrypted by the kernel, valid after the
+   * handshake
+   */
+  bool kernel_send() const noexcept {
+    return BIO_get_ktls_send(SSL_get_wbio(ssl_.get()));
+  }
+
+  /**
+   * @brief kernel_receive - records are decrypted by the kernel, valid after
+   * the handshake
+   */
+  bool kernel_receive() const noexcept {
+    return BIO_get_ktls_recv(SSL_get_rbio(ssl_.get()));
+  }
+
+  /**
+   * @brief expires_after - pending and following operations fail with
+   * boost::beast::error::timeout after the duration
+   */
+  void expires_after(std::chrono::steady_clock::duration duration) {
+    deadline_->timed_out = false;
+    timer_.expires_after(duration);
+    timer_.async_wait([this, deadline = std::weak_ptr<Deadline>{deadline_},
+                       generation = ++deadline_->generation](
+                          boost::system::error_code ec) {
+      const auto current = deadline.lock();
+      if (ec || !current || current->generation != generation)
+        return;
+      current->timed_out = true;
+      socket_.cancel(ec);
+    });
+  }
+
+  void expires_never() {
+    deadline_->timed_out = false;
+    ++deadline_->generation;
+    timer_.cancel();
+  }
+
+  template <typename Handler> auto async_handshake(Handler&& handler) {
+    return async_ssl(std::forward<Handler>(handler),
+                     [](SSL* ssl, std::size_t&, boost::system::error_code& ec) {
+                       return result(ssl, SSL_do_handshake(ssl), ec);
+                     });
+  }
+
+  template <typename MutableBufferSequence, typename Handler>
+  auto async_read_some(const MutableBufferSequence& buffers,
+                       Handler&& handler) {
+    boost::asio::mutable_buffer buffer{};
+    for (auto it = boost::asio::buffer_sequence_begin(buffers);
+         it != boost::asio::buffer_sequence_end(buffers); ++it) {
+      if (boost::asio::buffer_size(*it) != 0) {
+        buffer = *it;
+        break;
+      }
+    }
+
+    return async_ssl(
+        std::forward<Handler>(handler),
+        [buffer](SSL* ssl, std::size_t& bytes, boost::system::error_code& ec) {
+          if (buffer.size() == 0)
+            return Want::nothing;
+          return result(
+              ssl, SSL_read_ex(ssl, buffer.data(), buffer.size(), &bytes), ec);
+        });
+  }
+
+  template <typename ConstBufferSequence, typename Handler>
+  auto async_write_some(const ConstBufferSequence& buffers,
+                        Handler&& handler) {
+    boost::asio::const_buffer buffer{};
+    for (auto it = boost::asio::buffer_sequence_begin(buffers);
+         it != boost::asio::buffer_sequence_end(buffers); ++it) {
+      if (boost::asio::buffer_size(*it) != 0) {
+        buffer = *it;
+        break;
+      }
+    }
+
+    // Beast serializes headers into several small buffers: one record for
+    // all of them instead of record per buffer
+    const std::size_t total{boost::asio::buffer_size(buffers)};
+    if (buffer.size() < total && buffer.size() < max_record_size) {
+      write_buffer_.resize(std::min(total, max_record_size));
+      buffer = boost::asio::buffer(
+          write_buffer_.data(),
+          boost::asio::buffer_copy(boost::asio::buffer(write_buffer_),
+                                   buffers));
+    }
+
+    return async_ssl(
+        std::forward<Handler>(handler),
+        [buffer](SSL* ssl, std::size_t& bytes, boost::system::error_code& ec) {
+          if (buffer.size() == 0)
+            return Want::nothing;
+          return result(
+              ssl, SSL_write_ex(ssl, buffer.data(), buffer.size(), &bytes), ec);
+        });
+  }
+
+  /**
+   * @brief async_sendfile sends the file's range with SSL_sendfile, requires
+   * kernel_send(). Completes with operation_not_supported otherwise
+   */
+  template <typename Handler>
+  auto async_sendfile(int file, off_t offset, std::size_t size,
+                      Handler&& handler) {
+    return async_ssl(
+        std::forward<Handler>(handler),
+        [file, offset, size](SSL* ssl, std::size_t& bytes,
+                             boost::system::error_code& ec) {
+          if (!BIO_get_ktls_send(SSL_get_wbio(ssl))) {
+            ec = boost::asio::error::operation_not_supported;
+            return Want::nothing;
+          }
+
+          const auto sent = SSL_sendfile(ssl, file, offset, size, 0);
+          if (sent < 0)
+            return result(ssl, -1, ec);
+
+          bytes = static_cast<std::size_t>(sent);
+          return Want::nothing;
+        });
+  }
+
+  /**
+   * @brief async_shutdown sends close_notify without waiting for the peer's
+   * one
+   */
+  template <typename Handler> auto async_shutdown(Handler&& handler) {
+    return async_ssl(std::forward<Handler>(handler),
+                     [](SSL* ssl, std::size_t&, boost::system::error_code& ec) {
+                       const int ret = SSL_shutdown(ssl);
+                       if (ret >= 0)
+                         return Want::nothing;
+                       return result(ssl, ret, ec);
+                     });
+  }
+};
+
+} // namespace detail
+} // namespace rest_in_beast
+
+#endif // REST_IN_BEAST_KTLS
+
+#endif // REST_IN_BEAST_KTLS_STREAM_HPP
@@ -8,9 +8,30 @@
 #ifndef RESIN_IN_BEAST_LOGGER_HPP
 #define RESIN_IN_BEAST_LOGGER_HPP
 
+#include <boost/beast/http/verb.hpp>
 #include <boost/system/error_code.hpp>
 
+#include <chrono>
+#include <cstdint>
+#include <string_view>
+
 namespace rest_in_beast {
+
+/**
+ * @brief The AccessRecord class is an access log record of served request.
+ * Status of type-erased responses (Respondent::make_response) is unknown: 0
+ */
+struct AccessRecord {
+  boost::beast::http::verb method{};
+  // Valid during Logger::access call
+  std::string_view target{};
+  unsigned status{};
+  std::uint64_t bytes_in{};
+  std::uint64_t bytes_out{};
+  // From the end of request's read to the end of response's write
+  std::chrono::nanoseconds latency{};
+};
+
 /**
  * @brief The Logger class provides interface for any project logger
  */
@@ -22,6 +43,18 @@ public:
 
   virtual void log(std::string_view class_name, std::string_view function_name,
                    boost::system::error_code ec) = 0;
+
+  /**
+   * @brief access_log - sessions call access for every request if true. Asked
+   * once per connection
+   */
+  virtual bool access_log() const noexcept { return false; }
+
+  /**
+   * @brief access is called from session's strand after the response is
+   * written
+   */
+  virtual void access(const AccessRecord& record) {}
 };
 
 } // namespace rest_in_beast
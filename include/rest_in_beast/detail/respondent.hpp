@@ -8,11 +8,151 @@
 #ifndef RESIN_IN_BEAST_RESPONDENT_HPP
 #define RESIN_IN_BEAST_RESPONDENT_HPP
 
-#include <boost/beast/http/message_fwd.hpp>
-#include <boost/beast/http/message_generator_fwd.hpp>
-#include <boost/beast/http/string_body_fwd.hpp>
+#include "stream_channel.hpp"
+#include "websocket_handler.hpp"
+
+#include <boost/beast/core/string.hpp>
+#include <boost/beast/http/field.hpp>
+#include <boost/beast/http/fields.hpp>
+#include <boost/beast/http/message.hpp>
+#include <boost/beast/http/message_generator.hpp>
+#include <boost/beast/http/string_body.hpp>
+#include <boost/beast/http/verb.hpp>
+
+#include <functional>
+#include <memory>
+#include <memory_resource>
+#include <string>
+#include <string_view>
+#include <utility>
 
 namespace rest_in_beast {
+
+/**
+ * @brief string_request is the request type parsed by sessions
+ */
+using string_request =
+    boost::beast::http::request<boost::beast::http::string_body>;
+
+/**
+ * @brief pool_fields are the header fields allocated from session's memory
+ * pool
+ */
+using pool_fields =
+    boost::beast::http::basic_fields<std::pmr::polymorphic_allocator<char>>;
+
+/**
+ * @brief reusable_response is the session-owned response object of the
+ * reusable response path (see Respondent::fill_response)
+ */
+using reusable_response =
+    boost::beast::http::response<boost::beast::http::string_body, pool_fields>;
+
+/**
+ * @brief arena_string_body is the body of requests parsed into session's
+ * per-request arena
+ */
+using arena_string_body = boost::beast::http::basic_string_body<
+    char, std::char_traits<char>, std::pmr::polymorphic_allocator<char>>;
+
+/**
+ * @brief arena_request is the request type parsed by sessions with enabled
+ * request arena. Fields and body are allocated from the arena which is reset
+ * before the next request of the connection, so the request MUST NOT outlive
+ * the response
+ */
+using arena_request =
+    boost::beast::http::request<arena_string_body, pool_fields>;
+
+/**
+ * @brief to_string_request copies arena request into heap allocated one
+ */
+inline string_request to_string_request(const arena_request& request) {
+  string_request copy{request.method(), request.target(), request.version()};
+  for (const auto& field : request) {
+    copy.insert(field.name(), field.name_string(), field.value());
+  }
+  copy.body().assign(request.body().data(), request.body().size());
+  return copy;
+}
+
+/**
+ * @brief The RequestView class - read-only request passed to respondent's
+ * hooks: either string_request or arena_request, depending on the session.
+ * visit calls the function with the request itself, so a hook may be written
+ * once as a template over the request type
+ */
+class RequestView {
+  const string_request* string_{};
+  const arena_request* arena_{};
+
+public:
+  RequestView(const string_request& request) noexcept : string_{&request} {}
+
+  RequestView(const arena_request& request) noexcept : arena_{&request} {}
+
+  template <typename Function>
+  decltype(auto) visit(Function&& function) const {
+    if (string_)
+      return std::forward<Function>(function)(*string_);
+    return std::forward<Function>(function)(*arena_);
+  }
+
+  boost::beast::http::verb method() const {
+    return string_ ? string_->method() : arena_->method();
+  }
+
+  boost::beast::string_view method_string() const {
+    return string_ ? string_->method_string() : arena_->method_string();
+  }
+
+  boost::beast::string_view target() const {
+    return string_ ? string_->target() : arena_->target();
+  }
+
+  unsigned version() const noexcept {
+    return string_ ? string_->version() : arena_->version();
+  }
+
+  bool keep_alive() const {
+    return string_ ? string_->keep_alive() : arena_->keep_alive();
+  }
+
+  boost::beast::string_view operator[](boost::beast::http::field name) const {
+    return string_ ? (*string_)[name] : (*arena_)[name];
+  }
+
+  boost::beast::string_view operator[](boost::beast::string_view name) const {
+    return string_ ? (*string_)[name] : (*arena_)[name];
+  }
+
+  std::string_view body() const noexcept {
+    return string_ ? std::string_view{string_->body()}
+                   : std::string_view{arena_->body()};
+  }
+
+  /**
+   * @brief to_string_request copies the request into heap allocated one
+   */
+  string_request to_string_request() const {
+    return string_ ? *string_
+                   : rest_in_beast::to_string_request(*arena_);
+  }
+};
+
+/**
+ * @brief shared_response is an immutable response which may be written by
+ * many sessions at once
+ */
+using shared_response = std::shared_ptr<
+    const boost::beast::http::response<boost::beast::http::string_body>>;
+
+/**
+ * @brief shared_response_handler is called once from any thread. nullptr lets
+ * the session answer the request as usual
+ */
+using shared_response_handler = std::function<void(shared_response)>;
+
 /**
  * @brief The Respondent is an interface for user-customizable requests
  * handler classes used in session to make response. It is the main point for
@@ -30,8 +170,90 @@ public:
    * @return type-erased http response
    */
   virtual boost::beast::http::message_generator
-  make_response(boost::beast::http::request<boost::beast::http::string_body>&&
-                    request) = 0;
+  make_response(string_request&& request) = 0;
+
+  /**
+   * @brief fill_response is an optional alternative of make_response which
+   * does not allocate the response. Session passes it's own response object
+   * which is reused between requests of the connection: fields are allocated
+   * from session's pool and body keeps it's capacity. Reading the request and
+   * writing the response still allocate.
+   *
+   * Response comes with status ok, request's version and keep-alive, no fields
+   * and empty body. Session calls prepare_payload after this call.
+   * @param request - request of the session
+   * @param response - session-owned response
+   * @return false if response is not filled, make_response is called then
+   */
+  virtual bool fill_response(RequestView request,
+                             reusable_response& response) {
+    return false;
+  }
+
+  /**
+   * @brief make_arena_response is make_response for sessions with enabled
+   * request arena, the only hook which takes the request itself. By default
+   * request is copied by to_string_request and passed to make_response,
+   * override it to make use of the arena
+   * @param request - request allocated from session's arena
+   * @return type-erased http response
+   */
+  virtual boost::beast::http::message_generator
+  make_arena_response(arena_request&& request) {
+    return make_response(to_string_request(request));
+  }
+
+  /**
+   * @brief accept_websocket is called for WebSocket upgrade requests of
+   * HTTP/1.1 sessions. Accepted connection is handed over to WebSocket session
+   * with the bytes already read from it, rejected request is answered as any
+   * other
+   * @param request - upgrade request
+   * @return handler of the connection, nullptr to reject the upgrade
+   */
+  virtual std::shared_ptr<WebSocketHandler>
+  accept_websocket(const string_request& request) {
+    return nullptr;
+  }
+
+  /**
+   * @brief shares_response tells if async_shared_response may take the
+   * request. Session builds the handler and calls async_shared_response only
+   * then, so it SHOULD be cheap and MUST return true for every request
+   * async_shared_response would take
+   * @param request - request of the session
+   * @return false to skip async_shared_response
+   */
+  virtual bool shares_response(RequestView request) { return false; }
+
+  /**
+   * @brief async_shared_response lets respondent answer HTTP/1.1 request with
+   * shared response later. Session waits for the handler without reading and
+   * writes the response in it's strand with request's keep-alive.
+   * @param request - valid until the handler is called
+   * @param handler - MUST be called once if the request is taken
+   * @return false if the request is not taken, fill_response and make_response
+   * are called then
+   */
+  virtual bool async_shared_response(RequestView request,
+                                     shared_response_handler handler) {
+    return false;
+  }
+
+  /**
+   * @brief make_stream lets respondent answer with open-ended chunked response
+   * of HTTP/1.1 sessions: session writes the response's header and then the
+   * chunks pushed to the channel until it is closed. Response comes as in
+   * fill_response, body is ignored. Data received from the client during the
+   * stream ends it.
+   * @param request - request of the session
+   * @param response - session-owned response, header of the stream
+   * @return channel of the response, nullptr to answer as any other request
+   */
+  virtual std::shared_ptr<StreamChannel>
+  make_stream(RequestView request, reusable_response& response) {
+    return nullptr;
+  }
 };
 
 } // namespace rest_in_beast
@@ -14,18 +14,35 @@
 #ifndef REST_IN_BEAST_SESSION_HPP
 #define REST_IN_BEAST_SESSION_HPP
 
+#include "../admission.hpp"
+#include "../context_pool.hpp"
+#include "../handshake_pool.hpp"
+#include "../load_shedding.hpp"
+#include "../metrics.hpp"
+#include "../rate_limit.hpp"
+#include "../tracing.hpp"
 #include "../util/shared_proxy.hpp"
+#include "http2_session.hpp"
+#include "ktls_stream.hpp"
 #include "logger.hpp"
 #include "respondent.hpp"
+#include "session_group.hpp"
+#include "stream_channel.hpp"
+#include "websocket_session.hpp"
 
+#include <boost/asio/bind_executor.hpp>
+#include <boost/asio/buffer.hpp>
 #include <boost/asio/dispatch.hpp>
 #include <boost/asio/io_context.hpp>
 #include <boost/asio/ip/tcp.hpp>
+#include <boost/asio/post.hpp>
 #include <boost/asio/ssl.hpp>
 #include <boost/asio/ssl/context.hpp>
 #include <boost/asio/ssl/context_base.hpp>
 #include <boost/asio/ssl/stream.hpp>
+#include <boost/asio/steady_timer.hpp>
 #include <boost/asio/strand.hpp>
+#include <boost/asio/write.hpp>
 
 #include <boost/beast/core.hpp>
 #include <boost/beast/http.hpp>
@@ -33,124 +50,861 @@
 #include <boost/beast/http/error.hpp>
 #include <boost/beast/http/message_fwd.hpp>
 #include <boost/beast/http/message_generator.hpp>
+#include <boost/beast/http/serializer.hpp>
 #include <boost/beast/http/string_body_fwd.hpp>
 #include <boost/beast/http/write.hpp>
+#include <boost/beast/websocket/rfc6455.hpp>
 
+#include <array>
+#include <charconv>
 #include <chrono>
+#include <cstddef>
+#include <functional>
 #include <memory>
+#include <memory_resource>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+#include <vector>
 
 namespace rest_in_beast {
 namespace detail {
 
 /**
- * @brief The PlainSession class is an INSECURE TCP session
+ * @brief The SessionOptions class - settings shared by sessions of the factory
  */
-class PlainSession : public std::enable_shared_from_this<PlainSession> {
-  boost::beast::tcp_stream stream_;
+struct SessionOptions {
+  std::shared_ptr<Respondent> respondent;
+  std::shared_ptr<Logger> logger;
+  std::chrono::milliseconds read_timeout{30'000};
+  // Size of per-request arena for headers and body, 0 disables it. Requests
+  // exceeding the block take memory from the heap
+  std::size_t request_arena_size{};
+  // Server's metrics, nullptr disables them
+  std::shared_ptr<Metrics> metrics{};
+  // Consumer of requests' traces, nullptr disables tracing
+  std::shared_ptr<TraceSink> trace_sink{};
+};
+
+/**
+ * @brief The ConnectionContext class - state of the accepted connection given
+ * by the server, released with the session
+ */
+struct ConnectionContext {
+  // Admission of the connection, empty if connections are not limited
+  AdmissionControl::Ticket admission{};
+  // Connection counted in the server's context pool, empty if it has none
+  ContextPool::Lease lease{};
+  // Remote address in the server's rate limiter, empty if not limited
+  RateLimiter::Client limiter{};
+  // Server's sessions to join, nullptr if not drained
+  std::shared_ptr<SessionGroup> group{};
+};
+
+/**
+ * @brief The HttpSession class is the CRTP base of PlainSession and
+ * SecureSession: HTTP/1.1 keep-alive loop over Derived::stream() as in
+ * Boost.Beast's server-flex example. WebSocket upgrade accepted by the
+ * respondent hands the stream over to WebSocketSession.
+ *
+ * Stream returned by Respondent::make_stream is written as chunked response:
+ * chunks pushed between writes are taken by one strand operation and written
+ * as one HTTP chunk. Write is bounded by the read timeout, so the slow
+ * consumer is disconnected, and the socket is watched for client's close
+ * while the stream is idle.
+ *
+ * Sessions with metrics record phases' latencies and traffic, and answer GET
+ * of Metrics::path() themselves. Sessions compiled with tracing deliver
+ * requests' phase transitions to the trace sink. Sessions with rate limiter
+ * answer requests over the limit of the remote address with 429 before the
+ * respondent is called. Served requests are passed to Logger::access if the
+ * logger asks for access log. Sessions of draining server finish the current
+ * request and take no more. Reusable responses, stream headers and 429 are
+ * written with Connection: close, while type-erased and shared responses are
+ * written as they are and the connection is closed after them. HTTP/2
+ * connection is drained by it's Http2Session. WebSocket connections are closed
+ * by the drain's deadline.
+ *
+ * Derived class provides:
+ *  - static constexpr std::string_view class_name for logging;
+ *  - stream() returning it's stream;
+ *  - do_eof() closing the stream.
+ */
+template <typename Derived> class HttpSession {
+  Derived& derived() noexcept { return static_cast<Derived&>(*this); }
+
+  using response_serializer =
+      boost::beast::http::serializer<false, boost::beast::http::string_body,
+                                     pool_fields>;
+
+  using arena_parser =
+      boost::beast::http::request_parser<arena_string_body,
+                                         std::pmr::polymorphic_allocator<char>>;
+
+protected:
   boost::beast::flat_buffer buffer_;
   std::shared_ptr<Respondent> respondent_;
   std::shared_ptr<Logger> logger_;
   std::chrono::milliseconds read_timeout_{};
 
-  boost::beast::http::request<boost::beast::http::string_body> request_{};
+  // nullptr disables metrics. Start of the current phase
+  std::shared_ptr<Metrics> metrics_;
+  Metrics::clock::time_point phase_start_{};
+
+  // Trace of the current request, empty if tracing is compiled out
+  [[no_unique_address]] session_tracer tracer_;
+
+  // Admission of the connection, released with the session
+  AdmissionControl::Ticket admission_;
+  // Connection counted in the server's context pool, released with the session
+  ContextPool::Lease lease_;
+  // Remote address in the server's rate limiter, empty if not limited
+  RateLimiter::Client limiter_;
+
+  // Server's sessions, nullptr if not drained. Read of the next request is
+  // pending
+  std::shared_ptr<SessionGroup> group_;
+  std::uint64_t group_id_{};
+  bool reading_{};
+  // Drain of HTTP/2 session which took over the stream, empty for HTTP/1
+  std::function<void(bool force)> http2_drain_{};
+
+  // Access log record of the current request
+  const bool access_log_;
+  AccessRecord access_{};
+  std::string access_target_{};
+  std::chrono::steady_clock::time_point access_start_{};
+
+  string_request request_{};
+
+  // Per-request arena: session-owned block released before each read.
+  // Declared before the parser to outlive it
+  std::unique_ptr<std::byte[]> arena_block_{};
+  std::optional<std::pmr::monotonic_buffer_resource> arena_{};
+  std::optional<arena_parser> arena_parser_{};
+
+  // Memory of reusable response. Declared before the response to outlive it
+  std::pmr::unsynchronized_pool_resource response_pool_{};
+  reusable_response response_{
+      std::piecewise_construct, std::make_tuple(),
+      std::make_tuple(std::pmr::polymorphic_allocator<char>{&response_pool_})};
+  std::optional<response_serializer> serializer_{};
+
+  // Response shared with other sessions while it is written
+  shared_response shared_response_{};
+
+  // Open-ended response, strand's state
+  std::shared_ptr<StreamChannel> stream_channel_{};
+  std::vector<StreamChannel::chunk_type> stream_chunks_{};
+  std::vector<boost::asio::const_buffer> stream_buffers_{};
+  // Hexadecimal chunk size and CRLF
+  std::array<char, 20> stream_chunk_size_{};
+  bool stream_chunked_{};
+  bool stream_writing_{};
 
-  PlainSession(boost::asio::ip::tcp::socket&& peer,
-               boost::beast::flat_buffer buffer,
-               std::shared_ptr<Respondent> respondent,
-               std::shared_ptr<Logger> logger,
-               std::chrono::milliseconds read_timeout)
-      : stream_{std::move(peer)}, buffer_{std::move(buffer)},
-        respondent_{std::move(respondent)}, logger_{std::move(logger)},
-        read_timeout_{read_timeout} {}
+  /**
+   * @param buffer - bytes read from the connection before the session
+   * @param options - settings of the factory
+   * @param connection - state of the connection
+   */
+  HttpSession(boost::beast::flat_buffer buffer, SessionOptions options,
+              ConnectionContext connection)
+      : buffer_{std::move(buffer)}, respondent_{std::move(options.respondent)},
+        logger_{std::move(options.logger)},
+        read_timeout_{options.read_timeout},
+        metrics_{std::move(options.metrics)},
+        tracer_{std::move(options.trace_sink)},
+        admission_{std::move(connection.admission)},
+        lease_{std::move(connection.lease)},
+        limiter_{std::move(connection.limiter)},
+        group_{std::move(connection.group)},
+        access_log_{logger_->access_log()} {
+    if (options.request_arena_size != 0) {
+      arena_block_.reset(new std::byte[options.request_arena_size]);
+      arena_.emplace(arena_block_.get(), options.request_arena_size);
+    }
+    if (metrics_) {
+      metrics_->add(Metrics::Counter::connections_opened);
+    }
+  }
+
+  HttpSession(const HttpSession&) = delete;
+  HttpSession& operator=(const HttpSession&) = delete;
+
+  HttpSession(HttpSession&&) = delete;
+  HttpSession& operator=(HttpSession&&) = delete;
+
+  ~HttpSession() {
+    if (metrics_) {
+      metrics_->add(Metrics::Counter::connections_closed);
+    }
+    if (group_) {
+      group_->leave(group_id_);
+    }
+  }
 
   /**
-   * @brief start_reading - strand dispatch
+   * @brief join_group registers the session in server's group, call once the
+   * session is owned by shared pointer
    */
-  void start_reading() {
-    // ATTENTION! Execude code io operations in stream's strand
-    boost::asio::dispatch(
-        stream_.get_executor(),
-        boost::beast::bind_front_handler(&PlainSession::do_read,
-                                         this->shared_from_this()));
+  void join_group() {
+    if (!group_)
+      return;
+
+    group_id_ = group_->join(
+        [weak = std::weak_ptr{derived().shared_from_this()},
+         executor = derived().stream().get_executor()](bool force) {
+          if (auto self = weak.lock()) {
+            boost::asio::post(executor, boost::beast::bind_front_handler(
+                                            &HttpSession::on_drain,
+                                            std::move(self), force));
+          }
+        });
   }
 
-  friend util::SharedProxy<PlainSession>;
-  static std::shared_ptr<PlainSession> make_shared(
-      boost::asio::ip::tcp::socket&& peer, boost::beast::flat_buffer buffer,
-      std::shared_ptr<Respondent> respondent, std::shared_ptr<Logger> logger,
-      std::chrono::milliseconds read_timeout) {
-    return std::make_shared<util::SharedProxy<PlainSession>>(
-        std::move(peer), std::move(buffer), std::move(respondent),
-        std::move(logger), read_timeout);
+  bool draining() const noexcept { return group_ && group_->draining(); }
+
+  /**
+   * @brief start_http2 hands the stream over to Http2Session, which is
+   * drained instead of the session
+   */
+  void start_http2() {
+    using stream_type = std::remove_reference_t<decltype(derived().stream())>;
+
+    const auto http2 = Http2Session<stream_type>::start(
+        derived().shared_from_this(), derived().stream(), std::move(buffer_),
+        respondent_, logger_, read_timeout_, limiter_);
+    http2_drain_ = [weak = std::weak_ptr{http2}](bool force) {
+      if (auto http2 = weak.lock()) {
+        http2->drain(force);
+      }
+    };
+    if (draining()) {
+      http2->drain(false);
+    }
   }
 
-public:
-  PlainSession(const PlainSession&) = delete;
-  PlainSession& operator=(const PlainSession&) = delete;
+  void do_read() {
+    // Draining server takes no more requests
+    if (draining())
+      return derived().do_eof();
+
+    boost::beast::get_lowest_layer(derived().stream())
+        .expires_after(read_timeout_);
+    tracer_.mark_once(Trace::Point::strand);
+    tracer_.mark(Trace::Point::read_start);
+    reading_ = true;
+
+    if (!metrics_)
+      return read_request();
+
+    // Read phase starts with the first bytes of the request, keep-alive wait
+    // for them is not measured
+    if (buffer_.size() == 0) {
+      return derived().stream().async_read_some(
+          buffer_.prepare(boost::beast::read_size(buffer_, 65'536)),
+          boost::beast::bind_front_handler(&HttpSession::on_first_bytes,
+                                           derived().shared_from_this()));
+    }
 
-  PlainSession(PlainSession&&) = delete;
-  PlainSession& operator=(PlainSession&&) = delete;
+    phase_start_ = Metrics::clock::now();
+    read_request();
+  }
 
-  ~PlainSession() = default;
+private:
+  void on_first_bytes(boost::beast::error_code ec,
+                      std::size_t bytes_transferred) {
+    // Close between requests is not an error of the read
+    if (ec == boost::asio::error::eof)
+      return on_read(boost::beast::http::error::end_of_stream, 0);
+    if (ec)
+      return on_read(ec, 0);
+
+    buffer_.commit(bytes_transferred);
+    phase_start_ = Metrics::clock::now();
+    read_request();
+  }
+
+  void read_request() {
+    if (!arena_) {
+      return boost::beast::http::async_read(
+          derived().stream(), buffer_, request_,
+          boost::beast::bind_front_handler(&HttpSession::on_read,
+                                           derived().shared_from_this()));
+    }
+
+    // Previous request is not used anymore: response is written
+    arena_parser_.reset();
+    arena_->release();
+
+    const std::pmr::polymorphic_allocator<char> allocator{&*arena_};
+    arena_parser_.emplace(std::piecewise_construct,
+                          std::make_tuple(allocator),
+                          std::make_tuple(allocator));
+
+    boost::beast::http::async_read(
+        derived().stream(), buffer_, *arena_parser_,
+        boost::beast::bind_front_handler(&HttpSession::on_read,
+                                         derived().shared_from_this()));
+  }
 
   /**
-   * @brief start - main interface of session
-   * @param peer - incoming connection
-   * @param respondent - shared object that generates responses
-   * @param logger - shared object that handles boost::asio errors
+   * @brief on_drain cancels read of the connection waiting for the next
+   * request: nothing of it is in the buffer. Connection serving a request is
+   * closed after the response by do_read. Forced drain closes the socket
    */
-  static void start(boost::asio::ip::tcp::socket&& peer,
-                    boost::beast::flat_buffer buffer,
-                    std::shared_ptr<Respondent> respondent,
-                    std::shared_ptr<Logger> logger,
-                    std::chrono::milliseconds read_timeout) {
-    return make_shared(std::move(peer), std::move(buffer),
-                       std::move(respondent), std::move(logger), read_timeout)
-        ->start_reading();
+  void on_drain(bool force) {
+    if (http2_drain_)
+      return http2_drain_(force);
+
+    boost::beast::error_code ec;
+    auto& socket = boost::beast::get_lowest_layer(derived().stream()).socket();
+    if (force) {
+      socket.close(ec);
+    } else if (reading_ && buffer_.size() == 0) {
+      socket.cancel(ec);
+    }
   }
 
-private:
-  void on_read(boost::beast::error_code ec, std::size_t _) {
+  void on_read(boost::beast::error_code ec, std::size_t bytes_transferred) {
+    reading_ = false;
+
     // It's not an error
     if (ec == boost::beast::http::error::end_of_stream)
-      return do_eof();
+      return derived().do_eof();
+
+    // Waiting for request is cancelled by drain
+    if (ec == boost::asio::error::operation_aborted && draining())
+      return derived().do_eof();
 
     if (ec) {
-      return logger_->log("PlainSession", "on_read", ec);
+      return logger_->log(Derived::class_name, "on_read", ec);
     }
 
-    do_write(respondent_->make_response(std::move(request_)));
+    if (metrics_) {
+      metrics_->record(Metrics::Phase::read, phase_start_);
+      metrics_->add(Metrics::Counter::requests);
+      metrics_->add(Metrics::Counter::bytes_in, bytes_transferred);
+      phase_start_ = Metrics::clock::now();
+    }
+
+    if (access_log_) {
+      access_start_ = std::chrono::steady_clock::now();
+      access_ = {.bytes_in = bytes_transferred};
+    }
+
+    if (arena_parser_) {
+      return serve(arena_parser_->get());
+    }
+    serve(request_);
   }
 
-  void do_read() {
-    boost::beast::get_lowest_layer(stream_).expires_after(read_timeout_);
+  template <typename Request> void serve(Request& request) {
+    tracer_.begin_request(request);
+    if (access_log_) {
+      const auto target = request.target();
+      access_.method = request.method();
+      access_target_.assign(std::data(target), std::size(target));
+    }
 
-    boost::beast::http::async_read(
-        stream_, buffer_, request_,
-        boost::beast::bind_front_handler(&PlainSession::on_read,
-                                         this->shared_from_this()));
+    if (try_metrics(request))
+      return;
+
+    if (try_rate_limit(request))
+      return;
+
+    if (boost::beast::websocket::is_upgrade(request)) {
+      if constexpr (std::is_same_v<Request, arena_request>) {
+        auto upgrade = to_string_request(request);
+        if (try_upgrade(upgrade))
+          return;
+      } else if (try_upgrade(request)) {
+        return;
+      }
+    }
+
+    if (try_stream(request))
+      return;
+
+    if (try_shared_response(request))
+      return;
+
+    respond(request);
   }
 
-  void on_write(bool keep_alive, boost::beast::error_code ec, std::size_t _) {
+  template <typename Request> void respond(Request& request) {
+    if (fill_response(request)) {
+      return do_write();
+    }
+
+    if constexpr (std::is_same_v<Request, arena_request>) {
+      do_write(respondent_->make_arena_response(std::move(request)));
+    } else {
+      do_write(respondent_->make_response(std::move(request)));
+    }
+  }
+
+  /**
+   * @brief try_shared_response - respondent calls the handler from any thread,
+   * the response is written in session's strand
+   */
+  template <typename Request> bool try_shared_response(const Request& request) {
+    if (!respondent_->shares_response(request))
+      return false;
+
+    shared_response_handler handler{
+        [self = derived().shared_from_this()](shared_response response) {
+          const auto executor = self->stream().get_executor();
+          boost::asio::post(executor,
+                            boost::beast::bind_front_handler(
+                                &HttpSession::on_shared_response,
+                                std::move(self), std::move(response)));
+        }};
+
+    return respondent_->async_shared_response(request, std::move(handler));
+  }
+
+  void on_shared_response(shared_response response) {
+    if (!response) {
+      if (arena_parser_) {
+        return respond(arena_parser_->get());
+      }
+      return respond(request_);
+    }
+
+    start_write_phase();
+    const bool keep_alive = arena_parser_ ? arena_parser_->get().keep_alive()
+                                          : request_.keep_alive();
+    shared_response_ = std::move(response);
+    access_.status = shared_response_->result_int();
+
+    // Waiting for the response is not limited, writing is
+    boost::beast::get_lowest_layer(derived().stream())
+        .expires_after(read_timeout_);
+    boost::beast::http::async_write(
+        derived().stream(), *shared_response_,
+        boost::beast::bind_front_handler(&HttpSession::on_shared_write,
+                                         derived().shared_from_this(),
+                                         keep_alive));
+  }
+
+  void on_shared_write(bool keep_alive, boost::beast::error_code ec,
+                       std::size_t bytes_transferred) {
+    shared_response_.reset();
+    on_write(keep_alive, ec, bytes_transferred);
+  }
+
+  /**
+   * @brief try_metrics answers GET of metrics' path with the exposition
+   */
+  template <typename Request> bool try_metrics(const Request& request) {
+    if (!metrics_ || std::empty(metrics_->path()) ||
+        request.method() != boost::beast::http::verb::get ||
+        request.target() != metrics_->path())
+      return false;
+
+    reset_response(request);
+    response_.set(boost::beast::http::field::content_type,
+                  "text/plain; version=0.0.4");
+    Metrics::expose(metrics_->snapshot(), response_.body());
+    response_.prepare_payload();
+    do_write();
+    return true;
+  }
+
+  /**
+   * @brief try_rate_limit answers request over the client's limit with
+   * limiter's pre-serialized 429, the respondent is not called
+   */
+  template <typename Request> bool try_rate_limit(const Request& request) {
+    if (!limiter_)
+      return false;
+
+    const bool keep_alive =
+        request.version() >= 11 && request.keep_alive() && !draining();
+    const auto* rejection =
+        limiter_.take(request.method(), request.target(), keep_alive);
+    if (!rejection)
+      return false;
+
+    start_write_phase();
+    access_.status = 429;
+    boost::beast::get_lowest_layer(derived().stream())
+        .expires_after(read_timeout_);
+    boost::asio::async_write(
+        derived().stream(), boost::asio::buffer(*rejection),
+        boost::beast::bind_front_handler(&HttpSession::on_write,
+                                         derived().shared_from_this(),
+                                         keep_alive));
+    return true;
+  }
+
+  /**
+   * @brief start_write_phase ends respondent's phase
+   */
+  void start_write_phase() {
+    if (metrics_) {
+      metrics_->record(Metrics::Phase::handler, phase_start_);
+      phase_start_ = Metrics::clock::now();
+    }
+    tracer_.mark(Trace::Point::respond_end);
+  }
+
+  /**
+   * @brief try_upgrade hands the stream and the bytes read after the request
+   * over to WebSocket session if respondent accepts the upgrade
+   */
+  bool try_upgrade(string_request& request) {
+    auto handler = respondent_->accept_websocket(request);
+    if (!handler)
+      return false;
+
+    using stream_type = std::remove_reference_t<decltype(derived().stream())>;
+    WebSocketSession<stream_type>::start(
+        derived().shared_from_this(), derived().stream(), std::move(buffer_),
+        std::move(request), std::move(handler), logger_, read_timeout_);
+    return true;
+  }
+
+  /**
+   * @brief reset_response - fields' memory returns to the pool and body keeps
+   * it's capacity, so the response is not allocated after first requests of
+   * connection
+   */
+  template <typename Request> void reset_response(const Request& request) {
+    serializer_.reset();
+    response_.base().clear();
+    response_.body().clear();
+    response_.result(boost::beast::http::status::ok);
+    response_.version(request.version());
+    response_.keep_alive(request.keep_alive());
+  }
+
+  /**
+   * @brief try_stream writes the header of the stream if respondent returns
+   * one. HTTP/1.0 stream is not chunked and ends with the connection
+   */
+  template <typename Request> bool try_stream(const Request& request) {
+    reset_response(request);
+
+    auto channel = respondent_->make_stream(request, response_);
+    if (!channel)
+      return false;
+
+    start_write_phase();
+    tracer_.server_timing(response_);
+    access_.status = response_.result_int();
+    stream_channel_ = std::move(channel);
+    stream_chunked_ = response_.version() >= 11;
+    response_.body().clear();
+    if (stream_chunked_) {
+      response_.chunked(true);
+    }
+    if (!stream_chunked_ || draining()) {
+      response_.keep_alive(false);
+    }
+
+    serializer_.emplace(response_);
+    boost::beast::get_lowest_layer(derived().stream())
+        .expires_after(read_timeout_);
+    boost::beast::http::async_write_header(
+        derived().stream(), *serializer_,
+        boost::beast::bind_front_handler(&HttpSession::on_stream_header,
+                                         derived().shared_from_this()));
+    return true;
+  }
+
+  void on_stream_header(boost::beast::error_code ec,
+                        std::size_t bytes_transferred) {
+    // Stream is traced until it's header is written
+    tracer_.end_request();
+    access_.bytes_out += bytes_transferred;
+
+    if (ec) {
+      end_stream();
+      return logger_->log(Derived::class_name, "on_stream_header", ec);
+    }
+
+    // Idle stream has no deadline, writes have
+    boost::beast::get_lowest_layer(derived().stream()).expires_never();
+
+    stream_channel_->attach(
+        [weak = std::weak_ptr{derived().shared_from_this()},
+         executor = derived().stream().get_executor()] {
+          if (auto self = weak.lock()) {
+            boost::asio::post(executor,
+                              boost::beast::bind_front_handler(
+                                  &HttpSession::flush_stream, std::move(self)));
+          }
+        });
+
+    boost::beast::get_lowest_layer(derived().stream())
+        .socket()
+        .async_wait(boost::asio::ip::tcp::socket::wait_read,
+                    boost::beast::bind_front_handler(
+                        &HttpSession::on_stream_input,
+                        derived().shared_from_this()));
+
+    flush_stream();
+  }
+
+  /**
+   * @brief on_stream_input - client closed the connection or sent data during
+   * the stream
+   */
+  void on_stream_input(boost::beast::error_code ec) {
+    // Stream is over, waiting is cancelled
+    if (!stream_channel_)
+      return;
+
+    end_stream();
+    boost::beast::get_lowest_layer(derived().stream()).socket().close(ec);
+  }
+
+  /**
+   * @brief flush_stream writes chunks pushed since the last write as one HTTP
+   * chunk, the last one is written with them
+   */
+  void flush_stream() {
+    if (!stream_channel_ || stream_writing_)
+      return;
+
+    const auto state = stream_channel_->take(stream_chunks_);
+    if (state == StreamChannel::State::aborted) {
+      // Slow consumer
+      end_stream();
+      boost::beast::error_code ec;
+      boost::beast::get_lowest_layer(derived().stream()).socket().close(ec);
+      return;
+    }
+
+    const bool last = state == StreamChannel::State::closed;
+    if (std::empty(stream_chunks_) && !last)
+      return;
+
+    std::size_t size{};
+    for (const auto& chunk : stream_chunks_) {
+      size += std::size(*chunk);
+    }
+
+    static constexpr std::string_view crlf{"\r\n"};
+    static constexpr std::string_view last_chunk{"0\r\n\r\n"};
+
+    stream_buffers_.clear();
+    if (stream_chunked_ && size != 0) {
+      char* const begin = std::data(stream_chunk_size_);
+      char* end = std::to_chars(begin, begin + 16, size, 16).ptr;
+      *end++ = '\r';
+      *end++ = '\n';
+      stream_buffers_.push_back(boost::asio::buffer(begin, end - begin));
+    }
+    for (const auto& chunk : stream_chunks_) {
+      stream_buffers_.push_back(boost::asio::buffer(*chunk));
+    }
+    if (stream_chunked_ && size != 0) {
+      stream_buffers_.push_back(boost::asio::buffer(crlf));
+    }
+    if (stream_chunked_ && last) {
+      stream_buffers_.push_back(boost::asio::buffer(last_chunk));
+    }
+
+    stream_writing_ = true;
+    boost::beast::get_lowest_layer(derived().stream())
+        .expires_after(read_timeout_);
+    boost::asio::async_write(
+        derived().stream(), stream_buffers_,
+        boost::beast::bind_front_handler(&HttpSession::on_stream_write,
+                                         derived().shared_from_this(), last));
+  }
+
+  void on_stream_write(bool last, boost::beast::error_code ec,
+                       std::size_t bytes_transferred) {
+    stream_writing_ = false;
+    stream_chunks_.clear();
+    if (metrics_) {
+      metrics_->add(Metrics::Counter::bytes_out, bytes_transferred);
+    }
+    access_.bytes_out += bytes_transferred;
+
+    // Stream is ended by the client
+    if (!stream_channel_)
+      return;
+
     if (ec) {
-      return logger_->log("PlainSession", "on_write", ec);
+      end_stream();
+      return logger_->log(Derived::class_name, "on_stream_write", ec);
+    }
+
+    boost::beast::get_lowest_layer(derived().stream()).expires_never();
+    if (!last) {
+      return flush_stream();
+    }
+
+    end_stream();
+    // Cancel waiting for client's input
+    boost::beast::get_lowest_layer(derived().stream()).socket().cancel(ec);
+
+    if (!stream_chunked_ || !response_.keep_alive()) {
+      return derived().do_eof();
+    }
+
+    do_read();
+  }
+
+  void end_stream() {
+    stream_channel_->detach();
+    stream_channel_.reset();
+    log_access();
+  }
+
+  /**
+   * @brief log_access passes the record of the served request to the logger
+   */
+  void log_access() {
+    if (!access_log_)
+      return;
+
+    access_.target = access_target_;
+    access_.latency = std::chrono::steady_clock::now() - access_start_;
+    logger_->access(access_);
+  }
+
+  /**
+   * @brief fill_response resets reusable response and lets respondent fill it
+   */
+  template <typename Request> bool fill_response(const Request& request) {
+    reset_response(request);
+    if (!respondent_->fill_response(request, response_))
+      return false;
+
+    response_.prepare_payload();
+    return true;
+  }
+
+  void on_write(bool keep_alive, boost::beast::error_code ec,
+                std::size_t bytes_transferred) {
+    if (metrics_) {
+      metrics_->record(Metrics::Phase::write, phase_start_);
+      metrics_->add(Metrics::Counter::bytes_out, bytes_transferred);
+    }
+    tracer_.end_request();
+    access_.bytes_out += bytes_transferred;
+    log_access();
+
+    if (ec) {
+      return logger_->log(Derived::class_name, "on_write", ec);
     }
 
     if (!keep_alive) {
-      return do_eof();
+      return derived().do_eof();
     }
 
     do_read();
   }
 
   void do_write(boost::beast::http::message_generator&& response) {
+    start_write_phase();
+    // Status of type-erased response is unknown
+    access_.status = 0;
+    // save respons'es keep_alive state
     const bool keep_alive = response.keep_alive();
     boost::beast::async_write(
-        stream_, std::move(response),
-        boost::beast::bind_front_handler(&PlainSession::on_write,
-                                         this->shared_from_this(), keep_alive));
+        derived().stream(), std::move(response),
+        boost::beast::bind_front_handler(&HttpSession::on_write,
+                                         derived().shared_from_this(),
+                                         keep_alive));
+  }
+
+  /**
+   * @brief do_write writes reusable response with session-owned serializer
+   */
+  void do_write() {
+    start_write_phase();
+    tracer_.server_timing(response_);
+    access_.status = response_.result_int();
+    if (draining()) {
+      response_.keep_alive(false);
+    }
+    const bool keep_alive = response_.keep_alive();
+    serializer_.emplace(response_);
+    boost::beast::http::async_write(
+        derived().stream(), *serializer_,
+        boost::beast::bind_front_handler(&HttpSession::on_write,
+                                         derived().shared_from_this(),
+                                         keep_alive));
+  }
+};
+
+/**
+ * @brief The PlainSession class is an INSECURE TCP session
+ */
+class PlainSession : public HttpSession<PlainSession>,
+                     public std::enable_shared_from_this<PlainSession> {
+  boost::beast::tcp_stream stream_;
+
+  PlainSession(boost::asio::ip::tcp::socket&& peer,
+               boost::beast::flat_buffer buffer, SessionOptions options,
+               ConnectionContext connection)
+      : HttpSession{std::move(buffer), std::move(options),
+                    std::move(connection)},
+        stream_{std::move(peer)} {}
+
+  /**
+   * @brief start_reading - strand dispatch
+   */
+  void start_reading() {
+    join_group();
+
+    // ATTENTION! Execude code io operations in stream's strand
+    boost::asio::dispatch(
+        stream_.get_executor(),
+        boost::beast::bind_front_handler(&PlainSession::do_read,
+                                         this->shared_from_this()));
+  }
+
+  friend util::SharedProxy<PlainSession>;
+  static std::shared_ptr<PlainSession>
+  make_shared(boost::asio::ip::tcp::socket&& peer,
+              boost::beast::flat_buffer buffer, SessionOptions options,
+              ConnectionContext connection) {
+    return std::make_shared<util::SharedProxy<PlainSession>>(
+        std::move(peer), std::move(buffer), std::move(options),
+        std::move(connection));
   }
 
+  friend HttpSession<PlainSession>;
+  static constexpr std::string_view class_name{"PlainSession"};
+
+  boost::beast::tcp_stream& stream() noexcept { return stream_; }
+
+public:
+  PlainSession(const PlainSession&) = delete;
+  PlainSession& operator=(const PlainSession&) = delete;
+
+  PlainSession(PlainSession&&) = delete;
+  PlainSession& operator=(PlainSession&&) = delete;
+
+  ~PlainSession() = default;
+
+  /**
+   * @brief start - main interface of session
+   * @param peer - incoming connection
+   * @param buffer - bytes read from the connection before the session
+   * @param options - respondent, logger and other settings of the factory
+   * @param connection - admission, lease, rate limit and group of the
+   * connection
+   */
+  static void start(boost::asio::ip::tcp::socket&& peer,
+                    boost::beast::flat_buffer buffer, SessionOptions options,
+                    ConnectionContext connection) {
+    return make_shared(std::move(peer), std::move(buffer), std::move(options),
+                       std::move(connection))
+        ->start_reading();
+  }
+
+private:
   /**
    * @brief on_eof closes stream
    */
@@ -167,43 +921,80 @@ private:
 /**
  * @brief The SecureSession class is an SECURE TCP session
  */
-class SecureSession : public std::enable_shared_from_this<SecureSession> {
+class SecureSession : public HttpSession<SecureSession>,
+                      public std::enable_shared_from_this<SecureSession> {
   boost::asio::ssl::stream<boost::beast::tcp_stream> stream_;
-  boost::beast::flat_buffer buffer_;
-  std::shared_ptr<Respondent> respondent_;
-  std::shared_ptr<Logger> logger_;
-  std::chrono::milliseconds read_timeout_;
   std::chrono::milliseconds handshake_timeout_;
 
-  boost::beast::http::request<boost::beast::http::string_body> request_{};
+  // Handshake on the pool: strand of pool's io_context and it's timer
+  std::shared_ptr<HandshakePool> handshake_pool_;
+  std::optional<boost::asio::steady_timer> handshake_timer_{};
+  bool handshake_started_{};
+  bool handshake_timed_out_{};
 
   // Я вам запрещаю конструировать
   SecureSession(boost::asio::ip::tcp::socket&& peer,
                 boost::asio::ssl::context& ssl_ctx,
                 boost::beast::flat_buffer buffer,
-                std::shared_ptr<Respondent> respondent,
-                std::shared_ptr<Logger> logger,
-                std::chrono::milliseconds read_timeout,
-                std::chrono::milliseconds handshake_timeout)
-      : stream_{std::move(peer), ssl_ctx}, buffer_{std::move(buffer)},
-        respondent_{std::move(respondent)}, logger_{std::move(logger)},
-        read_timeout_{read_timeout}, handshake_timeout_{handshake_timeout} {}
+                std::chrono::milliseconds handshake_timeout,
+                std::shared_ptr<HandshakePool> handshake_pool,
+                SessionOptions options, ConnectionContext connection)
+      : HttpSession{std::move(buffer), std::move(options),
+                    std::move(connection)},
+        stream_{std::move(peer), ssl_ctx},
+        handshake_timeout_{handshake_timeout},
+        handshake_pool_{std::move(handshake_pool)} {}
 
   friend util::SharedProxy<SecureSession>;
-  static std::shared_ptr<SecureSession> make_shared(
-      boost::asio::ip::tcp::socket&& peer, boost::asio::ssl::context& ssl_ctx,
-      boost::beast::flat_buffer buffer, std::shared_ptr<Respondent> respondent,
-      std::shared_ptr<Logger> logger, std::chrono::milliseconds read_timeout,
-      std::chrono::milliseconds handshake_timeout) {
+  static std::shared_ptr<SecureSession>
+  make_shared(boost::asio::ip::tcp::socket&& peer,
+              boost::asio::ssl::context& ssl_ctx,
+              boost::beast::flat_buffer buffer,
+              std::chrono::milliseconds handshake_timeout,
+              std::shared_ptr<HandshakePool> handshake_pool,
+              SessionOptions options, ConnectionContext connection) {
     return std::make_shared<util::SharedProxy<SecureSession>>(
-        std::move(peer), ssl_ctx, std::move(buffer), std::move(respondent),
-        std::move(logger), read_timeout, handshake_timeout);
+        std::move(peer), ssl_ctx, std::move(buffer), handshake_timeout,
+        std::move(handshake_pool), std::move(options), std::move(connection));
   }
 
   /**
-   * @brief start_handshake - strand dispatch
+   * @brief start_handshake - strand dispatch or handshake pool admission
    */
   void start_handshake() {
+    join_group();
+
+    if (handshake_pool_) {
+      const auto strand = boost::asio::make_strand(handshake_pool_->context());
+      // Deadline includes the wait in pool's queue, queued connection is
+      // closed at once
+      handshake_timer_.emplace(strand, handshake_timeout_);
+      handshake_timer_->async_wait(
+          [self = this->shared_from_this()](boost::beast::error_code ec) {
+            if (ec)
+              return;
+            self->handshake_timed_out_ = true;
+            auto& socket =
+                boost::beast::get_lowest_layer(self->stream_).socket();
+            if (self->handshake_started_) {
+              socket.cancel(ec);
+            } else {
+              socket.close(ec);
+            }
+          });
+
+      const bool admitted = handshake_pool_->acquire(boost::asio::bind_executor(
+          strand,
+          boost::beast::bind_front_handler(&SecureSession::do_pooled_handshake,
+                                           this->shared_from_this(), strand)));
+      if (!admitted) {
+        handshake_timer_->cancel();
+        logger_->log(class_name, "start_handshake",
+                     boost::asio::error::no_buffer_space);
+      }
+      return;
+    }
+
     // ATTENTION! Execude code io operations in stream's strand
     boost::asio::dispatch(
         stream_.get_executor(),
@@ -211,6 +1002,13 @@ class SecureSession : public std::enable_shared_from_this<SecureSession> {
                                          this->shared_from_this()));
   }
 
+  friend HttpSession<SecureSession>;
+  static constexpr std::string_view class_name{"SecureSession"};
+
+  boost::asio::ssl::stream<boost::beast::tcp_stream>& stream() noexcept {
+    return stream_;
+  }
+
 public:
   SecureSession(const SecureSession&) = delete;
   SecureSession& operator=(const SecureSession&) = delete;
@@ -224,19 +1022,23 @@ public:
    * @brief start - main interface of session
    * @param peer - incoming connection
    * @param ssl_ctx - ssl context
-   * @param respondent - shared object that generates responses
-   * @param logger - shared object that handles boost::asio errors
+   * @param buffer - bytes read from the connection before the session
+   * @param handshake_timeout - limit of the TLS handshake
+   * @param handshake_pool - pool for handshakes, nullptr to handshake in
+   * stream's strand
+   * @param options - respondent, logger and other settings of the factory
+   * @param connection - admission, lease, rate limit and group of the
+   * connection
    */
   static void start(boost::asio::ip::tcp::socket&& peer,
                     boost::asio::ssl::context& ssl_ctx,
                     boost::beast::flat_buffer buffer,
-                    std::shared_ptr<Respondent> respondent,
-                    std::shared_ptr<Logger> logger,
-                    std::chrono::milliseconds read_timeout,
-                    std::chrono::milliseconds handshake_timeout) {
+                    std::chrono::milliseconds handshake_timeout,
+                    std::shared_ptr<HandshakePool> handshake_pool,
+                    SessionOptions options, ConnectionContext connection) {
     return make_shared(std::move(peer), ssl_ctx, std::move(buffer),
-                       std::move(respondent), std::move(logger), read_timeout,
-                       handshake_timeout)
+                       handshake_timeout, std::move(handshake_pool),
+                       std::move(options), std::move(connection))
         ->start_handshake();
   }
 
@@ -247,14 +1049,27 @@ private:
       return logger_->log("SecureSession", "on_handshake", ec);
     }
 
+    if (metrics_) {
+      metrics_->record(Metrics::Phase::handshake, phase_start_);
+    }
+    tracer_.mark(Trace::Point::handshake_end);
+
     // Nuance of SSL
     buffer_.consume(bytes_transferred);
 
+    if (http2::negotiated(stream_.native_handle()))
+      return start_http2();
+
     do_read();
   }
 
   void do_handshake() {
     boost::beast::get_lowest_layer(stream_).expires_after(handshake_timeout_);
+    if (metrics_) {
+      phase_start_ = Metrics::clock::now();
+    }
+    tracer_.mark(Trace::Point::strand);
+    tracer_.mark(Trace::Point::handshake_start);
 
     stream_.async_handshake(
         boost::asio::ssl::stream_base::server, buffer_.data(),
@@ -262,51 +1077,194 @@ private:
                                          this->shared_from_this()));
   }
 
-  void on_read(boost::beast::error_code ec, std::size_t _) {
-    // It's not an error
-    if (ec == boost::beast::http::error::end_of_stream)
-      return do_eof();
+  /**
+   * @brief do_pooled_handshake runs in the strand of handshake pool. Engine's
+   * work is done in completion handlers of the handshake, so binding them to
+   * the pool's strand moves the cryptography to the pool's threads. Timeout is
+   * handled by own timer in the same strand instead of stream's one, it is
+   * armed when the connection is queued
+   */
+  void do_pooled_handshake(
+      boost::asio::strand<boost::asio::io_context::executor_type> strand) {
+    // Deadline passed in the queue
+    if (handshake_timed_out_)
+      return on_pooled_handshake(boost::beast::error::timeout, 0);
+
+    handshake_started_ = true;
+    if (metrics_) {
+      phase_start_ = Metrics::clock::now();
+    }
+    tracer_.mark(Trace::Point::handshake_start);
+
+    stream_.async_handshake(
+        boost::asio::ssl::stream_base::server, buffer_.data(),
+        boost::asio::bind_executor(
+            strand, boost::beast::bind_front_handler(
+                        &SecureSession::on_pooled_handshake,
+                        this->shared_from_this())));
+  }
+
+  /**
+   * @brief on_pooled_handshake frees the pool and returns to stream's strand
+   */
+  void on_pooled_handshake(boost::beast::error_code ec,
+                           std::size_t bytes_transferred) {
+    handshake_timer_->cancel();
+    handshake_pool_->release();
+
+    if (handshake_timed_out_) {
+      ec = boost::beast::error::timeout;
+    }
+
+    boost::asio::dispatch(
+        stream_.get_executor(),
+        boost::beast::bind_front_handler(&SecureSession::on_handshake,
+                                         this->shared_from_this(), ec,
+                                         bytes_transferred));
+  }
 
+  void on_eof(boost::beast::error_code ec) {
     if (ec) {
-      return logger_->log("SecureSession", "on_read", ec);
+      return logger_->log("SecureSession", "on_eof", ec);
     }
+  }
+
+  /**
+   * @brief on_eof closes stream
+   */
+  void do_eof() {
+    stream_.async_shutdown(boost::beast::bind_front_handler(
+        &SecureSession::on_eof, this->shared_from_this()));
+  }
+};
 
-    do_write(respondent_->make_response(std::move(request_)));
+#ifdef REST_IN_BEAST_KTLS
+/**
+ * @brief The KtlsSession class is a SECURE TCP session which lets the kernel
+ * encrypt records (kTLS) when OpenSSL and the kernel support negotiated cipher
+ * and falls back to userspace encryption otherwise
+ */
+class KtlsSession : public HttpSession<KtlsSession>,
+                    public std::enable_shared_from_this<KtlsSession> {
+  KtlsStream stream_;
+  std::chrono::milliseconds handshake_timeout_;
+  std::shared_ptr<KtlsMetrics> ktls_metrics_;
+
+  KtlsSession(boost::asio::ip::tcp::socket&& peer,
+              boost::asio::ssl::context& ssl_ctx,
+              std::chrono::milliseconds handshake_timeout,
+              std::shared_ptr<KtlsMetrics> ktls_metrics, SessionOptions options,
+              ConnectionContext connection)
+      : HttpSession{boost::beast::flat_buffer{}, std::move(options),
+                    std::move(connection)},
+        stream_{std::move(peer), ssl_ctx},
+        handshake_timeout_{handshake_timeout},
+        ktls_metrics_{std::move(ktls_metrics)} {}
+
+  friend util::SharedProxy<KtlsSession>;
+  static std::shared_ptr<KtlsSession>
+  make_shared(boost::asio::ip::tcp::socket&& peer,
+              boost::asio::ssl::context& ssl_ctx,
+              std::chrono::milliseconds handshake_timeout,
+              std::shared_ptr<KtlsMetrics> ktls_metrics, SessionOptions options,
+              ConnectionContext connection) {
+    return std::make_shared<util::SharedProxy<KtlsSession>>(
+        std::move(peer), ssl_ctx, handshake_timeout, std::move(ktls_metrics),
+        std::move(options), std::move(connection));
   }
 
-  void do_read() {
-    boost::beast::get_lowest_layer(stream_).expires_after(read_timeout_);
+  /**
+   * @brief start_handshake - strand dispatch
+   */
+  void start_handshake() {
+    join_group();
 
-    boost::beast::http::async_read(
-        stream_, buffer_, request_,
-        boost::beast::bind_front_handler(&SecureSession::on_read,
+    // ATTENTION! Execude code io operations in stream's strand
+    boost::asio::dispatch(
+        stream_.get_executor(),
+        boost::beast::bind_front_handler(&KtlsSession::do_handshake,
                                          this->shared_from_this()));
   }
 
-  void on_write(bool keep_alive, boost::beast::error_code ec, std::size_t _) {
+  friend HttpSession<KtlsSession>;
+  static constexpr std::string_view class_name{"KtlsSession"};
+
+  KtlsStream& stream() noexcept { return stream_; }
+
+public:
+  KtlsSession(const KtlsSession&) = delete;
+  KtlsSession& operator=(const KtlsSession&) = delete;
+
+  KtlsSession(KtlsSession&&) = delete;
+  KtlsSession& operator=(KtlsSession&&) = delete;
+
+  ~KtlsSession() = default;
+
+  /**
+   * @brief start - main interface of session
+   * @param peer - incoming connection
+   * @param ssl_ctx - ssl context
+   * @param handshake_timeout - limit of the TLS handshake
+   * @param ktls_metrics - counters of connections' record paths
+   * @param options - respondent, logger and other settings of the factory
+   * @param connection - admission, lease, rate limit and group of the
+   * connection
+   */
+  static void start(boost::asio::ip::tcp::socket&& peer,
+                    boost::asio::ssl::context& ssl_ctx,
+                    std::chrono::milliseconds handshake_timeout,
+                    std::shared_ptr<KtlsMetrics> ktls_metrics,
+                    SessionOptions options, ConnectionContext connection) {
+    return make_shared(std::move(peer), ssl_ctx, handshake_timeout,
+                       std::move(ktls_metrics), std::move(options),
+                       std::move(connection))
+        ->start_handshake();
+  }
+
+private:
+  void on_handshake(boost::beast::error_code ec, std::size_t _) {
     if (ec) {
-      return logger_->log("SecureSession", "on_write", ec);
+      return logger_->log("KtlsSession", "on_handshake", ec);
     }
 
-    if (!keep_alive) {
-      return do_eof();
+    if (metrics_) {
+      metrics_->record(Metrics::Phase::handshake, phase_start_);
     }
+    tracer_.mark(Trace::Point::handshake_end);
+
+    const bool kernel_send{stream_.kernel_send()};
+    const bool kernel_receive{stream_.kernel_receive()};
+    if (kernel_send) {
+      ktls_metrics_->kernel_send.fetch_add(1, std::memory_order_relaxed);
+    }
+    if (kernel_receive) {
+      ktls_metrics_->kernel_receive.fetch_add(1, std::memory_order_relaxed);
+    }
+    if (!kernel_send && !kernel_receive) {
+      ktls_metrics_->userspace.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    if (http2::negotiated(stream_.native_handle()))
+      return start_http2();
 
     do_read();
   }
 
-  void do_write(boost::beast::http::message_generator&& response) {
-    // save respons'es keep_alive state
-    const bool keep_alive = response.keep_alive();
-    boost::beast::async_write(
-        stream_, std::move(response),
-        boost::beast::bind_front_handler(&SecureSession::on_write,
-                                         this->shared_from_this(), keep_alive));
+  void do_handshake() {
+    stream_.expires_after(handshake_timeout_);
+    if (metrics_) {
+      phase_start_ = Metrics::clock::now();
+    }
+    tracer_.mark(Trace::Point::strand);
+    tracer_.mark(Trace::Point::handshake_start);
+
+    stream_.async_handshake(boost::beast::bind_front_handler(
+        &KtlsSession::on_handshake, this->shared_from_this()));
   }
 
-  void on_eof(boost::beast::error_code ec) {
+  void on_eof(boost::beast::error_code ec, std::size_t _) {
     if (ec) {
-      return logger_->log("SecureSession", "on_eof", ec);
+      return logger_->log("KtlsSession", "on_eof", ec);
     }
   }
 
@@ -315,9 +1273,10 @@ private:
    */
   void do_eof() {
     stream_.async_shutdown(boost::beast::bind_front_handler(
-        &SecureSession::on_eof, this->shared_from_this()));
+        &KtlsSession::on_eof, this->shared_from_this()));
   }
 };
+#endif // REST_IN_BEAST_KTLS
 
 /**
  * @brief The SSLDetector class is a wrapper class which starts SecureSession if
@@ -327,30 +1286,32 @@ class DetectSSLSession : public std::enable_shared_from_this<DetectSSLSession> {
   boost::beast::tcp_stream stream_;
   boost::asio::ssl::context& ssl_ctx_;
   boost::beast::flat_buffer buffer_;
-  std::shared_ptr<Respondent> respondent_;
-  std::shared_ptr<Logger> logger_;
-  std::chrono::milliseconds read_timeout_;
   std::chrono::milliseconds handshake_timeout_;
+  std::shared_ptr<HandshakePool> handshake_pool_;
+  // Passed to the detected session
+  SessionOptions options_;
+  ConnectionContext connection_;
 
   DetectSSLSession(boost::asio::ip::tcp::socket&& peer,
                    boost::asio::ssl::context& ssl_ctx,
-                   std::shared_ptr<Respondent> respondent,
-                   std::shared_ptr<Logger> logger,
-                   std::chrono::milliseconds read_timeout,
-                   std::chrono::milliseconds handshake_timeout)
+                   std::chrono::milliseconds handshake_timeout,
+                   std::shared_ptr<HandshakePool> handshake_pool,
+                   SessionOptions options, ConnectionContext connection)
       : stream_{std::move(peer)}, ssl_ctx_{ssl_ctx},
-        respondent_{std::move(respondent)}, logger_{std::move(logger)},
-        read_timeout_{read_timeout}, handshake_timeout_{handshake_timeout} {}
+        handshake_timeout_{handshake_timeout},
+        handshake_pool_{std::move(handshake_pool)},
+        options_{std::move(options)}, connection_{std::move(connection)} {}
 
   friend util::SharedProxy<DetectSSLSession>;
-  static std::shared_ptr<DetectSSLSession> make_shared(
-      boost::asio::ip::tcp::socket&& peer, boost::asio::ssl::context& ssl_ctx,
-      std::shared_ptr<Respondent> respondent, std::shared_ptr<Logger> logger,
-      std::chrono::milliseconds read_timeout,
-      std::chrono::milliseconds handshake_timeout) {
+  static std::shared_ptr<DetectSSLSession>
+  make_shared(boost::asio::ip::tcp::socket&& peer,
+              boost::asio::ssl::context& ssl_ctx,
+              std::chrono::milliseconds handshake_timeout,
+              std::shared_ptr<HandshakePool> handshake_pool,
+              SessionOptions options, ConnectionContext connection) {
     return std::make_shared<util::SharedProxy<DetectSSLSession>>(
-        std::move(peer), ssl_ctx, std::move(respondent), std::move(logger),
-        read_timeout, handshake_timeout);
+        std::move(peer), ssl_ctx, handshake_timeout, std::move(handshake_pool),
+        std::move(options), std::move(connection));
   }
 
   /**
@@ -369,39 +1330,45 @@ public:
    * @brief start - main interface of session
    * @param peer - incoming connection
    * @param ssl_ctx - ssl context
-   * @param respondent - shared object that generates responses
-   * @param logger - shared object that handles boost::asio errors
+   * @param handshake_timeout - limit of the TLS handshake
+   * @param handshake_pool - pool for handshakes, nullptr to handshake in
+   * stream's strand
+   * @param options - respondent, logger and other settings of the factory
+   * @param connection - admission, lease, rate limit and group of the
+   * connection
    */
   static void start(boost::asio::ip::tcp::socket&& peer,
                     boost::asio::ssl::context& ssl_ctx,
-                    std::shared_ptr<Respondent> respondent,
-                    std::shared_ptr<Logger> logger,
-                    std::chrono::milliseconds read_timeout,
-                    std::chrono::milliseconds handshake_timeout) {
-    return make_shared(std::move(peer), ssl_ctx, std::move(respondent),
-                       std::move(logger), read_timeout, handshake_timeout)
+                    std::chrono::milliseconds handshake_timeout,
+                    std::shared_ptr<HandshakePool> handshake_pool,
+                    SessionOptions options, ConnectionContext connection) {
+    return make_shared(std::move(peer), ssl_ctx, handshake_timeout,
+                       std::move(handshake_pool), std::move(options),
+                       std::move(connection))
         ->start_detection();
   };
 
 private:
   void on_detect(boost::beast::error_code ec, bool result) {
     if (ec) {
-      return logger_->log("DetectSSLSession", "on_detect", ec);
+      return options_.logger->log("DetectSSLSession", "on_detect", ec);
     }
 
     if (result) {
       return detail::SecureSession::start(
-          stream_.release_socket(), ssl_ctx_, std::move(buffer_), respondent_,
-          logger_, read_timeout_, handshake_timeout_);
+          stream_.release_socket(), ssl_ctx_, std::move(buffer_),
+          handshake_timeout_, std::move(handshake_pool_), std::move(options_),
+          std::move(connection_));
     }
 
     return detail::PlainSession::start(stream_.release_socket(),
-                                       std::move(buffer_), respondent_, logger_,
-                                       read_timeout_);
+                                       std::move(buffer_), std::move(options_),
+                                       std::move(connection_));
   }
 
   void do_detect() {
-    boost::beast::get_lowest_layer(stream_).expires_after(read_timeout_);
+    boost::beast::get_lowest_layer(stream_).expires_after(
+        options_.read_timeout);
 
     boost::beast::async_detect_ssl(
         stream_, buffer_,
@@ -417,10 +1384,37 @@ struct PlainSessionFactory {
   std::shared_ptr<Respondent> respondent;
   std::shared_ptr<Logger> logger;
   std::chrono::milliseconds read_timeout{30'000};
+  // Size of per-request arena for headers and body, 0 disables it
+  std::size_t request_arena_size{};
+  // Server's metrics, nullptr disables them
+  std::shared_ptr<Metrics> metrics{};
+  // Consumer of requests' traces, used if tracing is compiled in
+  std::shared_ptr<TraceSink> trace_sink{};
+  // Server pauses accepting while it's io_context lags, nullptr - never
+  std::shared_ptr<LagMonitor> lag_monitor{};
+  // Limits of concurrent connections, nullptr - unlimited
+  std::shared_ptr<AdmissionControl> admission{};
+  // io_contexts of accepted connections, nullptr - the server's io_context
+  std::shared_ptr<ContextPool> context_pool{};
+  // Limits of requests per remote address, nullptr - unlimited
+  std::shared_ptr<RateLimiter> rate_limiter{};
+
+  /**
+   * @brief session_options - settings shared by the factory's sessions
+   */
+  SessionOptions session_options() const {
+    return {.respondent = respondent,
+            .logger = logger,
+            .read_timeout = read_timeout,
+            .request_arena_size = request_arena_size,
+            .metrics = metrics,
+            .trace_sink = trace_sink};
+  }
 
-  void start_session(boost::asio::ip::tcp::socket&& peer) {
+  void start_session(boost::asio::ip::tcp::socket&& peer,
+                     ConnectionContext connection) {
     return PlainSession::start(std::move(peer), boost::beast::flat_buffer{},
-                               respondent, logger, read_timeout);
+                               session_options(), std::move(connection));
   }
 };
 
@@ -433,10 +1427,53 @@ struct SecureSessionFactory {
   std::shared_ptr<Logger> logger;
   std::chrono::milliseconds read_timeout{30'000};
   std::chrono::milliseconds handshake_timeout{30'000};
+  // Size of per-request arena for headers and body, 0 disables it
+  std::size_t request_arena_size{};
+
+  // Separate io_context for handshakes, nullptr - handshake in serving one
+  std::shared_ptr<HandshakePool> handshake_pool{};
+#ifdef REST_IN_BEAST_KTLS
+  // Kernel TLS counters, nullptr disables kernel TLS. Handshakes of kernel
+  // TLS sessions are done in serving io_context. Requires OpenSSL 3.0
+  std::shared_ptr<KtlsMetrics> ktls{};
+#endif
+  // Server's metrics, nullptr disables them
+  std::shared_ptr<Metrics> metrics{};
+  // Consumer of requests' traces, used if tracing is compiled in
+  std::shared_ptr<TraceSink> trace_sink{};
+  // Server pauses accepting while it's io_context lags, nullptr - never
+  std::shared_ptr<LagMonitor> lag_monitor{};
+  // Limits of concurrent connections, nullptr - unlimited
+  std::shared_ptr<AdmissionControl> admission{};
+  // io_contexts of accepted connections, nullptr - the server's io_context
+  std::shared_ptr<ContextPool> context_pool{};
+  // Limits of requests per remote address, nullptr - unlimited
+  std::shared_ptr<RateLimiter> rate_limiter{};
 
-  void start_session(boost::asio::ip::tcp::socket&& peer) {
-    return SecureSession::start(std::move(peer), ssl_ctx, {}, respondent,
-                                logger, read_timeout, handshake_timeout);
+  /**
+   * @brief session_options - settings shared by the factory's sessions
+   */
+  SessionOptions session_options() const {
+    return {.respondent = respondent,
+            .logger = logger,
+            .read_timeout = read_timeout,
+            .request_arena_size = request_arena_size,
+            .metrics = metrics,
+            .trace_sink = trace_sink};
+  }
+
+  void start_session(boost::asio::ip::tcp::socket&& peer,
+                     ConnectionContext connection) {
+#ifdef REST_IN_BEAST_KTLS
+    if (ktls) {
+      return KtlsSession::start(std::move(peer), ssl_ctx, handshake_timeout,
+                                ktls, session_options(), std::move(connection));
+    }
+#endif
+
+    return SecureSession::start(std::move(peer), ssl_ctx, {}, handshake_timeout,
+                                handshake_pool, session_options(),
+                                std::move(connection));
   }
 };
 
@@ -449,10 +1486,41 @@ struct DetectSSLSessionFactory {
   std::shared_ptr<Logger> logger;
   std::chrono::milliseconds read_timeout{30'000};
   std::chrono::milliseconds handshake_timeout{30'000};
+  // Size of per-request arena for headers and body, 0 disables it
+  std::size_t request_arena_size{};
+
+  // Separate io_context for handshakes, nullptr - handshake in serving one
+  std::shared_ptr<HandshakePool> handshake_pool{};
+  // Server's metrics, nullptr disables them
+  std::shared_ptr<Metrics> metrics{};
+  // Consumer of requests' traces, used if tracing is compiled in
+  std::shared_ptr<TraceSink> trace_sink{};
+  // Server pauses accepting while it's io_context lags, nullptr - never
+  std::shared_ptr<LagMonitor> lag_monitor{};
+  // Limits of concurrent connections, nullptr - unlimited
+  std::shared_ptr<AdmissionControl> admission{};
+  // io_contexts of accepted connections, nullptr - the server's io_context
+  std::shared_ptr<ContextPool> context_pool{};
+  // Limits of requests per remote address, nullptr - unlimited
+  std::shared_ptr<RateLimiter> rate_limiter{};
+
+  /**
+   * @brief session_options - settings shared by the factory's sessions
+   */
+  SessionOptions session_options() const {
+    return {.respondent = respondent,
+            .logger = logger,
+            .read_timeout = read_timeout,
+            .request_arena_size = request_arena_size,
+            .metrics = metrics,
+            .trace_sink = trace_sink};
+  }
 
-  void start_session(boost::asio::ip::tcp::socket&& peer) {
-    return DetectSSLSession::start(std::move(peer), ssl_ctx, respondent, logger,
-                                   read_timeout, handshake_timeout);
+  void start_session(boost::asio::ip::tcp::socket&& peer,
+                     ConnectionContext connection) {
+    return DetectSSLSession::start(std::move(peer), ssl_ctx, handshake_timeout,
+                                   handshake_pool, session_options(),
+                                   std::move(connection));
   }
 };
 
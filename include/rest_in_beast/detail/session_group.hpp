@@ -0,0 +1,206 @@
+//
+// Author: Dmitriy Gavryushin (https://github.com/Gawrjuschin)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#ifndef REST_IN_BEAST_SESSION_GROUP_HPP
+#define REST_IN_BEAST_SESSION_GROUP_HPP
+
+#include "../util/shared_proxy.hpp"
+
+#include <boost/asio/any_io_executor.hpp>
+#include <boost/asio/error.hpp>
+#include <boost/asio/post.hpp>
+#include <boost/asio/steady_timer.hpp>
+#include <boost/system/error_code.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace rest_in_beast {
+
+/**
+ * @brief drain_handler - called once all sessions are closed: no error if they
+ * finished before the deadline, timed_out if some were closed by it
+ */
+using drain_handler = std::function<void(boost::system::error_code)>;
+
+namespace detail {
+
+/**
+ * @brief The SessionGroup class is the set of server's open sessions. Sessions
+ * join it when started and leave in destructor. Drain asks every session to
+ * finish: keep-alive session waiting for request is closed, session serving
+ * one answers it and closes the connection. Sessions still open at the
+ * deadline are closed forcibly.
+ */
+class SessionGroup : public std::enable_shared_from_this<SessionGroup> {
+public:
+  /**
+   * @brief closer - posts the close to session's strand. Forced close drops
+   * the connection, not forced one closes it after the current request
+   */
+  using closer = std::function<void(bool force)>;
+
+private:
+  // Timer and handler are used in the strand
+  boost::asio::any_io_executor strand_;
+  boost::asio::steady_timer deadline_;
+
+  std::mutex mutex_;
+  std::unordered_map<std::uint64_t, closer> sessions_;
+  std::uint64_t next_id_{};
+  drain_handler drained_{};
+  boost::system::error_code result_{};
+
+  std::atomic<bool> draining_{};
+
+  explicit SessionGroup(boost::asio::any_io_executor strand)
+      : strand_{std::move(strand)}, deadline_{strand_} {}
+
+  friend util::SharedProxy<SessionGroup>;
+
+  /**
+   * @brief closers - copies of closers to call outside of the lock
+   */
+  std::vector<closer> closers() {
+    std::vector<closer> result;
+    result.reserve(std::size(sessions_));
+    for (const auto& [id, close] : sessions_) {
+      result.push_back(close);
+    }
+    return result;
+  }
+
+  /**
+   * @brief complete calls the handler in the strand, called under the lock
+   */
+  void complete() {
+    if (!drained_)
+      return;
+
+    boost::asio::post(strand_, [self = shared_from_this(),
+                                handler = std::move(drained_),
+                                result = result_] {
+      self->deadline_.cancel();
+      handler(result);
+    });
+    drained_ = nullptr;
+  }
+
+  void on_deadline(boost::system::error_code ec) {
+    if (ec)
+      return;
+
+    std::vector<closer> closers;
+    {
+      const std::scoped_lock lock{mutex_};
+      if (!drained_)
+        return;
+      result_ = boost::asio::error::timed_out;
+      closers = this->closers();
+    }
+    for (const auto& close : closers) {
+      close(true);
+    }
+  }
+
+public:
+  SessionGroup(const SessionGroup&) = delete;
+  SessionGroup& operator=(const SessionGroup&) = delete;
+
+  SessionGroup(SessionGroup&&) = delete;
+  SessionGroup& operator=(SessionGroup&&) = delete;
+
+  ~SessionGroup() = default;
+
+  /**
+   * @param strand - strand of the server's acceptor
+   */
+  static std::shared_ptr<SessionGroup>
+  make_shared(boost::asio::any_io_executor strand) {
+    return std::make_shared<util::SharedProxy<SessionGroup>>(
+        std::move(strand));
+  }
+
+  bool draining() const noexcept {
+    return draining_.load(std::memory_order_acquire);
+  }
+
+  /**
+   * @brief size - number of open sessions
+   */
+  std::size_t size() {
+    const std::scoped_lock lock{mutex_};
+    return std::size(sessions_);
+  }
+
+  /**
+   * @brief join registers the session. Session joining the draining group is
+   * asked to close at once
+   * @return id to leave with
+   */
+  std::uint64_t join(closer close) {
+    std::uint64_t id{};
+    {
+      const std::scoped_lock lock{mutex_};
+      id = next_id_++;
+      sessions_.emplace(id, close);
+    }
+    if (draining()) {
+      close(false);
+    }
+    return id;
+  }
+
+  void leave(std::uint64_t id) {
+    const std::scoped_lock lock{mutex_};
+    sessions_.erase(id);
+    if (std::empty(sessions_)) {
+      complete();
+    }
+  }
+
+  /**
+   * @brief drain asks all sessions to close, call from the strand once. Server
+   * stops accepting before
+   * @param deadline - sessions open after it are closed forcibly
+   */
+  void drain(std::chrono::steady_clock::duration deadline,
+             drain_handler handler) {
+    std::vector<closer> closers;
+    {
+      const std::scoped_lock lock{mutex_};
+      draining_.store(true, std::memory_order_release);
+      drained_ = std::move(handler);
+      if (std::empty(sessions_)) {
+        return complete();
+      }
+      closers = this->closers();
+    }
+
+    deadline_.expires_after(deadline);
+    deadline_.async_wait(
+        [self = shared_from_this()](boost::system::error_code ec) {
+          self->on_deadline(ec);
+        });
+
+    for (const auto& close : closers) {
+      close(false);
+    }
+  }
+};
+
+} // namespace detail
+} // namespace rest_in_beast
+
+#endif // REST_IN_BEAST_SESSION_GROUP_HPP
@@ -0,0 +1,57 @@
+//
+// Author: Dmitriy Gavryushin (https://github.com/Gawrjuschin)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#ifndef REST_IN_BEAST_SSL_CONTEXT_HPP
+#define REST_IN_BEAST_SSL_CONTEXT_HPP
+
+#include <openssl/ssl.h>
+
+namespace rest_in_beast {
+namespace detail {
+
+/**
+ * @brief accepted_context_index - index of connection's ex_data with the
+ * context the connection was accepted with, set once SNI switches it
+ */
+inline int accepted_context_index() {
+  static const int index =
+      ::SSL_get_ex_new_index(0, nullptr, nullptr, nullptr, nullptr);
+  return index;
+}
+
+/**
+ * @brief accepted_context - server's context of the connection. OpenSSL calls
+ * session cache and ticket callbacks of it after SSL_set_SSL_CTX, so their
+ * state is looked up here rather than in SSL_get_SSL_CTX
+ */
+inline SSL_CTX* accepted_context(const SSL* ssl) {
+  if (auto* ctx = static_cast<SSL_CTX*>(
+          ::SSL_get_ex_data(ssl, accepted_context_index())))
+    return ctx;
+  return ::SSL_get_SSL_CTX(ssl);
+}
+
+/**
+ * @brief switch_context - SSL_set_SSL_CTX remembering the accepted context.
+ * Info callback of the accepted context is kept for the connection, OpenSSL
+ * would call the one of the new context otherwise
+ * @return false on failure
+ */
+inline bool switch_context(SSL* ssl, SSL_CTX* ctx) {
+  SSL_CTX* accepted = accepted_context(ssl);
+  if (::SSL_set_ex_data(ssl, accepted_context_index(), accepted) != 1)
+    return false;
+  if (::SSL_get_info_callback(ssl) == nullptr) {
+    ::SSL_set_info_callback(ssl, ::SSL_CTX_get_info_callback(accepted));
+  }
+  return ::SSL_set_SSL_CTX(ssl, ctx) != nullptr;
+}
+
+} // namespace detail
+} // namespace rest_in_beast
+
+#endif // REST_IN_BEAST_SSL_CONTEXT_HPP
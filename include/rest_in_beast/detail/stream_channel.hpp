@@ -0,0 +1,279 @@
+//
+// Author: Dmitriy Gavryushin (https://github.com/Gawrjuschin)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#ifndef REST_IN_BEAST_STREAM_CHANNEL_HPP
+#define REST_IN_BEAST_STREAM_CHANNEL_HPP
+
+#include "../util/shared_proxy.hpp"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace rest_in_beast {
+
+/**
+ * @brief The StreamChannel class is an open-ended chunked response body
+ * returned by Respondent::make_stream. Application pushes chunks from any
+ * thread, session writes all chunks queued by the time of write as one HTTP
+ * chunk.
+ *
+ * The queue is bounded by size of chunks: overflow policy decides what
+ * happens to the chunk which does not fit. Chunks are shared, so one event can
+ * be pushed to every subscriber without copies.
+ */
+class StreamChannel {
+public:
+  using chunk_type = std::shared_ptr<const std::string>;
+
+  enum class Overflow {
+    // Chunk is not queued, producer decides what to do
+    reject,
+    // Oldest chunks are dropped to fit the new one
+    drop_oldest,
+    // Connection of slow consumer is closed
+    disconnect
+  };
+
+  enum class PushResult { queued, dropped, closed };
+
+  /**
+   * @brief The State class is the channel's state for the session
+   */
+  enum class State { open, closed, aborted };
+
+private:
+  const std::size_t max_queued_size_;
+  const Overflow overflow_;
+
+  std::mutex mutex_;
+  std::deque<chunk_type> queue_{};
+  std::size_t queued_size_{};
+  State state_{State::open};
+  std::function<void()> notify_{};
+  bool notify_posted_{};
+
+  std::atomic<std::uint64_t> dropped_{};
+
+  StreamChannel(std::size_t max_queued_size, Overflow overflow)
+      : max_queued_size_{max_queued_size}, overflow_{overflow} {}
+
+  friend util::SharedProxy<StreamChannel>;
+
+  /**
+   * @brief enqueue - MUST be called under the lock
+   * @return true if the session should be notified
+   */
+  bool enqueue(chunk_type&& chunk) {
+    queued_size_ += std::size(*chunk);
+    queue_.push_back(std::move(chunk));
+    return notify_ && !std::exchange(notify_posted_, true);
+  }
+
+public:
+  StreamChannel(const StreamChannel&) = delete;
+  StreamChannel& operator=(const StreamChannel&) = delete;
+
+  StreamChannel(StreamChannel&&) = delete;
+  StreamChannel& operator=(StreamChannel&&) = delete;
+
+  ~StreamChannel() = default;
+
+  /**
+   * @brief make_shared
+   * @param max_queued_size - bytes of chunks waiting for write
+   * @param overflow - policy for the chunk which does not fit
+   */
+  static std::shared_ptr<StreamChannel>
+  make_shared(std::size_t max_queued_size = 1'048'576,
+              Overflow overflow = Overflow::reject) {
+    return std::make_shared<util::SharedProxy<StreamChannel>>(max_queued_size,
+                                                              overflow);
+  }
+
+  /**
+   * @brief format_event formats Server-Sent Event, every line of data is a
+   * data field
+   */
+  static std::string format_event(std::string_view data,
+                                  std::string_view event = {},
+                                  std::string_view id = {}) {
+    std::string out;
+    out.reserve(std::size(data) + std::size(event) + std::size(id) + 32);
+    if (!std::empty(id)) {
+      out.append("id: ").append(id).push_back('\n');
+    }
+    if (!std::empty(event)) {
+      out.append("event: ").append(event).push_back('\n');
+    }
+
+    for (;;) {
+      const auto end = data.find('\n');
+      out.append("data: ").append(data.substr(0, end)).push_back('\n');
+      if (end == std::string_view::npos)
+        break;
+      data.remove_prefix(end + 1);
+    }
+    out.push_back('\n');
+    return out;
+  }
+
+  /**
+   * @brief push queues chunk, may be called from any thread. Empty chunks
+   * are ignored: empty HTTP chunk ends the response
+   */
+  PushResult push(chunk_type chunk) {
+    if (!chunk || std::empty(*chunk))
+      return PushResult::queued;
+
+    std::function<void()> notify;
+    PushResult result{PushResult::queued};
+    {
+      const std::scoped_lock lock{mutex_};
+      if (state_ != State::open)
+        return PushResult::closed;
+
+      const std::size_t size = std::size(*chunk);
+      if (queued_size_ + size > max_queued_size_) {
+        dropped_.fetch_add(1, std::memory_order_relaxed);
+
+        switch (overflow_) {
+        case Overflow::reject:
+          return PushResult::dropped;
+        case Overflow::drop_oldest:
+          while (!std::empty(queue_) &&
+                 queued_size_ + size > max_queued_size_) {
+            queued_size_ -= std::size(*queue_.front());
+            queue_.pop_front();
+          }
+          if (size > max_queued_size_)
+            return PushResult::dropped;
+          result = PushResult::dropped;
+          break;
+        case Overflow::disconnect:
+          state_ = State::aborted;
+          queue_.clear();
+          queued_size_ = 0;
+          if (notify_ && !std::exchange(notify_posted_, true)) {
+            notify = notify_;
+          }
+          result = PushResult::closed;
+          break;
+        }
+      }
+
+      if (state_ == State::open && enqueue(std::move(chunk))) {
+        notify = notify_;
+      }
+    }
+
+    if (notify) {
+      notify();
+    }
+    return result;
+  }
+
+  PushResult push(std::string chunk) {
+    return push(std::make_shared<const std::string>(std::move(chunk)));
+  }
+
+  /**
+   * @brief close ends the response after queued chunks
+   */
+  void close() {
+    std::function<void()> notify;
+    {
+      const std::scoped_lock lock{mutex_};
+      if (state_ != State::open)
+        return;
+
+      state_ = State::closed;
+      if (notify_ && !std::exchange(notify_posted_, true)) {
+        notify = notify_;
+      }
+    }
+
+    if (notify) {
+      notify();
+    }
+  }
+
+  /**
+   * @brief is_open - false when the channel is closed or the connection is
+   * gone
+   */
+  bool is_open() {
+    const std::scoped_lock lock{mutex_};
+    return state_ == State::open;
+  }
+
+  /**
+   * @brief dropped - chunks which did not fit the queue
+   */
+  std::uint64_t dropped() const noexcept {
+    return dropped_.load(std::memory_order_relaxed);
+  }
+
+  // ~~~
+  // Session's side
+  // ~~~
+  /**
+   * @brief attach - notify is called when chunks are queued or state changes
+   * and the session did not take the previous ones yet
+   */
+  void attach(std::function<void()> notify) {
+    {
+      const std::scoped_lock lock{mutex_};
+      notify_ = std::move(notify);
+      notify_posted_ = true;
+    }
+  }
+
+  /**
+   * @brief take moves queued chunks out
+   * @return state of the channel at the time of take
+   */
+  State take(std::vector<chunk_type>& chunks) {
+    const std::scoped_lock lock{mutex_};
+    notify_posted_ = false;
+
+    for (auto& chunk : queue_) {
+      chunks.push_back(std::move(chunk));
+    }
+    queue_.clear();
+    queued_size_ = 0;
+    return state_;
+  }
+
+  /**
+   * @brief detach - connection is done, following pushes fail
+   */
+  void detach() {
+    std::function<void()> notify;
+    {
+      const std::scoped_lock lock{mutex_};
+      if (state_ == State::open) {
+        state_ = State::aborted;
+      }
+      queue_.clear();
+      queued_size_ = 0;
+      std::swap(notify, notify_);
+    }
+  }
+};
+
+} // namespace rest_in_beast
+
+#endif // REST_IN_BEAST_STREAM_CHANNEL_HPP
@@ -0,0 +1,81 @@
+//
+// Author: Dmitriy Gavryushin (https://github.com/Gawrjuschin)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#ifndef REST_IN_BEAST_WEBSOCKET_HANDLER_HPP
+#define REST_IN_BEAST_WEBSOCKET_HANDLER_HPP
+
+#include <boost/system/error_code.hpp>
+
+#include <memory>
+#include <string>
+#include <string_view>
+
+namespace rest_in_beast {
+
+/**
+ * @brief The WebSocketConnection is an interface of accepted WebSocket
+ * connection for it's handler
+ */
+class WebSocketConnection {
+public:
+  WebSocketConnection() = default;
+
+  virtual ~WebSocketConnection() = default;
+
+  /**
+   * @brief send queues message, may be called from any thread. Messages are
+   * written in the order of calls
+   * @param text - text or binary message
+   * @return false if the connection is closing or the queue is full, message
+   * is dropped then
+   */
+  virtual bool send(std::string message, bool text = true) = 0;
+
+  /**
+   * @brief close sends close frame after queued messages, may be called from
+   * any thread
+   */
+  virtual void close() = 0;
+};
+
+/**
+ * @brief The WebSocketHandler is an interface for handlers of WebSocket
+ * connections accepted by Respondent::accept_websocket
+ */
+class WebSocketHandler {
+public:
+  WebSocketHandler() = default;
+
+  virtual ~WebSocketHandler() = default;
+
+  /**
+   * @brief on_open is called when handshake is done
+   * @param connection - keep it to send messages outside of on_message
+   */
+  virtual void on_open(std::weak_ptr<WebSocketConnection> connection) {}
+
+  /**
+   * @brief on_message is called for every received message in the
+   * connection's strand
+   * @param message - valid until return
+   * @param text - text or binary message
+   */
+  virtual void on_message(WebSocketConnection& connection,
+                          std::string_view message, bool text) = 0;
+
+  /**
+   * @brief on_close is called once when the connection is closed by any side
+   * or fails
+   * @param ec - boost::beast::websocket::error::closed for the closing
+   * handshake
+   */
+  virtual void on_close(boost::system::error_code ec) {}
+};
+
+} // namespace rest_in_beast
+
+#endif // REST_IN_BEAST_WEBSOCKET_HANDLER_HPP
@@ -0,0 +1,368 @@
+//
+// Author: Dmitriy Gavryushin (https://github.com/Gawrjuschin)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#ifndef REST_IN_BEAST_WEBSOCKET_SESSION_HPP
+#define REST_IN_BEAST_WEBSOCKET_SESSION_HPP
+
+#include "../util/shared_proxy.hpp"
+#include "ktls_stream.hpp"
+#include "logger.hpp"
+#include "respondent.hpp"
+#include "websocket_handler.hpp"
+
+#include <boost/asio/associated_executor.hpp>
+#include <boost/asio/async_result.hpp>
+#include <boost/asio/bind_executor.hpp>
+#include <boost/asio/buffer.hpp>
+#include <boost/asio/post.hpp>
+#include <boost/beast/core.hpp>
+#include <boost/beast/websocket.hpp>
+#include <boost/beast/websocket/ssl.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace rest_in_beast {
+namespace detail {
+
+/**
+ * @brief The PrefixedStream class reads bytes already read from the stream
+ * before reading the stream itself. Writes go to the stream
+ */
+template <typename Stream> class PrefixedStream {
+  Stream& stream_;
+  boost::beast::flat_buffer prefix_;
+
+public:
+  using executor_type = typename Stream::executor_type;
+
+  PrefixedStream(Stream& stream, boost::beast::flat_buffer prefix)
+      : stream_{stream}, prefix_{std::move(prefix)} {}
+
+  executor_type get_executor() noexcept { return stream_.get_executor(); }
+
+  Stream& next_layer() noexcept { return stream_; }
+
+  template <typename MutableBufferSequence, typename ReadHandler>
+  auto async_read_some(const MutableBufferSequence& buffers,
+                       ReadHandler&& handler) {
+    return boost::asio::async_initiate<ReadHandler,
+                                       void(boost::beast::error_code,
+                                            std::size_t)>(
+        [this](auto&& handler, const MutableBufferSequence& buffers) {
+          if (prefix_.size() == 0) {
+            return stream_.async_read_some(
+                buffers, std::forward<decltype(handler)>(handler));
+          }
+
+          const std::size_t size =
+              boost::asio::buffer_copy(buffers, prefix_.data());
+          prefix_.consume(size);
+          boost::asio::post(
+              stream_.get_executor(),
+              boost::beast::bind_handler(
+                  std::forward<decltype(handler)>(handler),
+                  boost::beast::error_code{}, size));
+        },
+        handler, buffers);
+  }
+
+  template <typename ConstBufferSequence, typename WriteHandler>
+  auto async_write_some(const ConstBufferSequence& buffers,
+                        WriteHandler&& handler) {
+    return stream_.async_write_some(buffers,
+                                    std::forward<WriteHandler>(handler));
+  }
+};
+
+template <typename Stream>
+void teardown(boost::beast::role_type role, PrefixedStream<Stream>& stream,
+              boost::beast::error_code& ec) {
+  using boost::beast::websocket::teardown;
+  teardown(role, stream.next_layer(), ec);
+}
+
+template <typename Stream, typename TeardownHandler>
+void async_teardown(boost::beast::role_type role,
+                    PrefixedStream<Stream>& stream, TeardownHandler&& handler) {
+  using boost::beast::websocket::async_teardown;
+  async_teardown(role, stream.next_layer(),
+                 std::forward<TeardownHandler>(handler));
+}
+
+#ifdef REST_IN_BEAST_KTLS
+/**
+ * @brief beast_close_socket closes kernel TLS stream on WebSocket timeout
+ */
+inline void beast_close_socket(KtlsStream& stream) {
+  boost::beast::error_code ec;
+  stream.socket().close(ec);
+}
+
+/**
+ * @brief async_teardown sends close_notify of kernel TLS stream
+ */
+template <typename TeardownHandler>
+void async_teardown(boost::beast::role_type, KtlsStream& stream,
+                    TeardownHandler&& handler) {
+  const auto executor =
+      boost::asio::get_associated_executor(handler, stream.get_executor());
+  stream.async_shutdown(boost::asio::bind_executor(
+      executor,
+      [handler = std::forward<TeardownHandler>(handler)](
+          boost::beast::error_code ec, std::size_t) mutable { handler(ec); }));
+}
+#endif // REST_IN_BEAST_KTLS
+
+/**
+ * @brief The WebSocketSession class serves WebSocket connection accepted from
+ * HTTP/1.1 session. Messages are compressed with permessage-deflate when the
+ * client offers it. Idle connection is pinged and closed by the read timeout
+ * of the HTTP session.
+ *
+ * Messages sent by the handler are collected under the lock and moved to the
+ * write queue by one strand operation per batch, the queue is written message
+ * after message.
+ */
+template <typename Stream>
+class WebSocketSession
+    : public WebSocketConnection,
+      public std::enable_shared_from_this<WebSocketSession<Stream>> {
+  static constexpr std::string_view class_name{"WebSocketSession"};
+
+  // Bytes of messages waiting for write, send fails above it
+  static constexpr std::size_t max_queued_size{16'777'216};
+
+  struct Message {
+    std::string data;
+    bool text;
+  };
+
+  // Session which owns the stream
+  std::shared_ptr<void> owner_;
+  boost::beast::websocket::stream<PrefixedStream<Stream>> ws_;
+  string_request request_;
+  std::shared_ptr<WebSocketHandler> handler_;
+  std::shared_ptr<Logger> logger_;
+  std::chrono::milliseconds timeout_;
+
+  boost::beast::flat_buffer read_buffer_{};
+
+  std::mutex pending_mutex_;
+  std::vector<Message> pending_{};
+  bool flush_posted_{};
+  std::atomic<std::size_t> queued_size_{};
+  std::atomic<bool> closing_{};
+
+  // Strand's state
+  std::deque<Message> queue_{};
+  bool writing_{};
+  bool close_sent_{};
+  bool closed_{};
+
+  WebSocketSession(std::shared_ptr<void> owner, Stream& stream,
+                   boost::beast::flat_buffer buffer, string_request request,
+                   std::shared_ptr<WebSocketHandler> handler,
+                   std::shared_ptr<Logger> logger,
+                   std::chrono::milliseconds timeout)
+      : owner_{std::move(owner)}, ws_{stream, std::move(buffer)},
+        request_{std::move(request)}, handler_{std::move(handler)},
+        logger_{std::move(logger)}, timeout_{timeout} {}
+
+  friend util::SharedProxy<WebSocketSession>;
+
+public:
+  WebSocketSession(const WebSocketSession&) = delete;
+  WebSocketSession& operator=(const WebSocketSession&) = delete;
+
+  WebSocketSession(WebSocketSession&&) = delete;
+  WebSocketSession& operator=(WebSocketSession&&) = delete;
+
+  ~WebSocketSession() = default;
+
+  /**
+   * @brief start - takes over the stream after upgrade request, MUST be
+   * called in the stream's strand
+   * @param owner - session which owns the stream
+   * @param buffer - bytes read after the upgrade request
+   * @param timeout - handshake and idle timeout
+   */
+  static void start(std::shared_ptr<void> owner, Stream& stream,
+                    boost::beast::flat_buffer buffer, string_request request,
+                    std::shared_ptr<WebSocketHandler> handler,
+                    std::shared_ptr<Logger> logger,
+                    std::chrono::milliseconds timeout) {
+    std::make_shared<util::SharedProxy<WebSocketSession>>(
+        std::move(owner), stream, std::move(buffer), std::move(request),
+        std::move(handler), std::move(logger), timeout)
+        ->do_accept();
+  }
+
+  bool send(std::string message, bool text = true) override {
+    const std::size_t size = std::size(message);
+    if (closing_.load(std::memory_order_relaxed) ||
+        queued_size_.fetch_add(size) + size > max_queued_size) {
+      queued_size_.fetch_sub(size);
+      return false;
+    }
+
+    {
+      const std::scoped_lock lock{pending_mutex_};
+      pending_.push_back({std::move(message), text});
+      if (std::exchange(flush_posted_, true))
+        return true;
+    }
+
+    boost::asio::post(ws_.get_executor(),
+                      boost::beast::bind_front_handler(
+                          &WebSocketSession::flush, this->shared_from_this()));
+    return true;
+  }
+
+  void close() override {
+    if (closing_.exchange(true))
+      return;
+
+    boost::asio::post(ws_.get_executor(),
+                      boost::beast::bind_front_handler(
+                          &WebSocketSession::flush, this->shared_from_this()));
+  }
+
+private:
+  void do_accept() {
+    // WebSocket stream has it's own timer
+    boost::beast::get_lowest_layer(ws_).expires_never();
+
+    ws_.set_option(boost::beast::websocket::stream_base::timeout{
+        .handshake_timeout = timeout_,
+        .idle_timeout = timeout_,
+        .keep_alive_pings = true});
+
+    boost::beast::websocket::permessage_deflate deflate;
+    deflate.server_enable = true;
+    ws_.set_option(deflate);
+
+    ws_.async_accept(request_, boost::beast::bind_front_handler(
+                                   &WebSocketSession::on_accept,
+                                   this->shared_from_this()));
+  }
+
+  void on_accept(boost::beast::error_code ec) {
+    if (ec) {
+      return logger_->log(class_name, "on_accept", ec);
+    }
+
+    // Upgrade request is not needed anymore
+    request_ = {};
+
+    handler_->on_open(this->weak_from_this());
+    do_read();
+  }
+
+  void do_read() {
+    ws_.async_read(read_buffer_,
+                   boost::beast::bind_front_handler(&WebSocketSession::on_read,
+                                                    this->shared_from_this()));
+  }
+
+  void on_read(boost::beast::error_code ec, std::size_t _) {
+    if (ec) {
+      return on_close(ec);
+    }
+
+    const auto data = read_buffer_.cdata();
+    handler_->on_message(
+        *this,
+        std::string_view{static_cast<const char*>(data.data()), data.size()},
+        ws_.got_text());
+    read_buffer_.consume(read_buffer_.size());
+
+    do_read();
+  }
+
+  void on_close(boost::beast::error_code ec) {
+    if (std::exchange(closed_, true))
+      return;
+
+    closing_ = true;
+    if (ec != boost::beast::websocket::error::closed &&
+        ec != boost::asio::error::operation_aborted) {
+      logger_->log(class_name, "on_read", ec);
+    }
+    handler_->on_close(ec);
+  }
+
+  /**
+   * @brief flush moves pending messages to the write queue
+   */
+  void flush() {
+    {
+      const std::scoped_lock lock{pending_mutex_};
+      for (auto& message : pending_) {
+        queue_.push_back(std::move(message));
+      }
+      pending_.clear();
+      flush_posted_ = false;
+    }
+
+    do_write();
+  }
+
+  void do_write() {
+    if (writing_ || closed_ || close_sent_)
+      return;
+
+    if (std::empty(queue_)) {
+      if (closing_) {
+        close_sent_ = true;
+        ws_.async_close(boost::beast::websocket::close_code::normal,
+                        boost::beast::bind_front_handler(
+                            &WebSocketSession::on_close_sent,
+                            this->shared_from_this()));
+      }
+      return;
+    }
+
+    writing_ = true;
+    ws_.text(queue_.front().text);
+    ws_.async_write(boost::asio::buffer(queue_.front().data),
+                    boost::beast::bind_front_handler(
+                        &WebSocketSession::on_write, this->shared_from_this()));
+  }
+
+  void on_write(boost::beast::error_code ec, std::size_t _) {
+    writing_ = false;
+    queued_size_.fetch_sub(std::size(queue_.front().data));
+    queue_.pop_front();
+
+    if (ec) {
+      closing_ = true;
+      return logger_->log(class_name, "on_write", ec);
+    }
+
+    do_write();
+  }
+
+  void on_close_sent(boost::beast::error_code ec) {
+    if (ec) {
+      logger_->log(class_name, "on_close", ec);
+    }
+  }
+};
+
+} // namespace detail
+} // namespace rest_in_beast
+
+#endif // REST_IN_BEAST_WEBSOCKET_SESSION_HPP
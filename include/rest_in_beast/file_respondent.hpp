@@ -0,0 +1,259 @@
+//
+// Author: Dmitriy Gavryushin (https://github.com/Gawrjuschin)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#ifndef REST_IN_BEAST_FILE_RESPONDENT_HPP
+#define REST_IN_BEAST_FILE_RESPONDENT_HPP
+
+#include "detail/respondent.hpp"
+#include "util/query.hpp"
+#include "util/shared_proxy.hpp"
+
+#include <boost/asio/any_io_executor.hpp>
+#include <boost/asio/buffer.hpp>
+#include <boost/asio/post.hpp>
+#include <boost/beast/http/field.hpp>
+#include <boost/beast/http/message.hpp>
+#include <boost/beast/http/message_generator.hpp>
+#include <boost/beast/http/status.hpp>
+#include <boost/beast/http/string_body.hpp>
+#include <boost/beast/http/verb.hpp>
+
+#if defined(BOOST_ASIO_HAS_FILE)
+#include <boost/asio/random_access_file.hpp>
+#include <boost/asio/read_at.hpp>
+#else
+#include <fstream>
+#endif
+
+#include <atomic>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <utility>
+
+namespace rest_in_beast {
+
+/**
+ * @brief The FileRespondent class answers GET requests of targets under the
+ * prefix with files of the root directory as shared responses. Files are read
+ * with random_access_file when asio has file support: with io_uring backend
+ * (REST_IN_BEAST_IO_URING) reads are asynchronous and do not block the
+ * session's thread. Without it files are read by a handler posted to the
+ * executor.
+ *
+ * Targets with ".." segments are not served. Missing files, files above
+ * max_size and the rest of requests are answered by the wrapped respondent.
+ * Every request reads the file: wrap into CoalescingRespondent or cache for
+ * hot files.
+ */
+class FileRespondent : public Respondent,
+                       public std::enable_shared_from_this<FileRespondent> {
+  std::shared_ptr<Respondent> respondent_;
+  boost::asio::any_io_executor executor_;
+  const std::filesystem::path root_;
+  const std::string prefix_;
+  const std::size_t max_size_;
+
+  std::atomic<std::uint64_t> served_{};
+
+  FileRespondent(std::shared_ptr<Respondent> respondent,
+                 boost::asio::any_io_executor executor,
+                 std::filesystem::path root, std::string prefix,
+                 std::size_t max_size)
+      : respondent_{std::move(respondent)}, executor_{std::move(executor)},
+        root_{std::move(root)}, prefix_{std::move(prefix)},
+        max_size_{max_size} {}
+
+  friend util::SharedProxy<FileRespondent>;
+
+  /**
+   * @brief resolve - file of the target, empty if the target is not served
+   */
+  std::filesystem::path resolve(boost::beast::http::verb method,
+                                std::string_view target) const {
+    if (method != boost::beast::http::verb::get ||
+        !target.starts_with(prefix_))
+      return {};
+    target = target.substr(0, target.find_first_of("?#"));
+    target.remove_prefix(std::size(prefix_));
+
+    // Path is percent-decoded, '+' is kept
+    std::string relative;
+    relative.reserve(std::size(target));
+    for (std::size_t pos{}; pos < std::size(target);) {
+      const auto [ch, len] = target[pos] == '+'
+                                 ? std::pair<char, std::size_t>{'+', 1}
+                                 : util::detail::decode_at(target, pos);
+      if (ch == '\0' || ch == '\\')
+        return {};
+      relative.push_back(ch);
+      pos += len;
+    }
+
+    const std::filesystem::path path{relative};
+    for (const auto& segment : path) {
+      if (segment == "..")
+        return {};
+    }
+    if (std::empty(relative) || relative.back() == '/') {
+      relative.append("index.html");
+    }
+    return root_ / std::filesystem::path{relative}.relative_path();
+  }
+
+  /**
+   * @brief respond - response with the file's content, nullptr on failure
+   */
+  static shared_response respond(const std::filesystem::path& path,
+                                 std::string&& body) {
+    auto response = std::make_shared<
+        boost::beast::http::response<boost::beast::http::string_body>>(
+        boost::beast::http::status::ok, 11);
+    response->set(boost::beast::http::field::content_type,
+                  content_type(path.extension().string()));
+    response->body() = std::move(body);
+    response->prepare_payload();
+    return response;
+  }
+
+  void load(std::filesystem::path path, shared_response_handler handler) {
+#if defined(BOOST_ASIO_HAS_FILE)
+    boost::system::error_code ec;
+    auto file = std::make_shared<boost::asio::random_access_file>(executor_);
+    file->open(path.string(), boost::asio::random_access_file::read_only, ec);
+    const auto size = ec ? 0 : file->size(ec);
+    if (ec || size > max_size_)
+      return handler(nullptr);
+
+    auto body = std::make_shared<std::string>(size, '\0');
+    boost::asio::async_read_at(
+        *file, 0, boost::asio::buffer(*body),
+        [self = shared_from_this(), file, body, path = std::move(path),
+         handler = std::move(handler)](boost::system::error_code ec,
+                                       std::size_t bytes) {
+          if (ec || bytes != std::size(*body))
+            return handler(nullptr);
+          self->served_.fetch_add(1, std::memory_order_relaxed);
+          handler(respond(path, std::move(*body)));
+        });
+#else
+    boost::asio::post(executor_, [self = shared_from_this(),
+                                  path = std::move(path),
+                                  handler = std::move(handler)] {
+      std::error_code ec;
+      const auto size = std::filesystem::file_size(path, ec);
+      std::ifstream file{path, std::ios::binary};
+      if (ec || size > self->max_size_ || !file)
+        return handler(nullptr);
+
+      std::string body(size, '\0');
+      if (!file.read(std::data(body), static_cast<std::streamsize>(size)))
+        return handler(nullptr);
+      self->served_.fetch_add(1, std::memory_order_relaxed);
+      handler(respond(path, std::move(body)));
+    });
+#endif
+  }
+
+public:
+  ~FileRespondent() = default;
+
+  /**
+   * @brief make_shared
+   * @param respondent - answers the rest of requests
+   * @param executor - executor of file reads
+   * @param root - directory of served files
+   * @param prefix - target prefix mapped to the root
+   * @param max_size - larger files are not served
+   */
+  static std::shared_ptr<FileRespondent>
+  make_shared(std::shared_ptr<Respondent> respondent,
+              boost::asio::any_io_executor executor,
+              std::filesystem::path root, std::string prefix = "/",
+              std::size_t max_size = 16'777'216) {
+    return std::make_shared<util::SharedProxy<FileRespondent>>(
+        std::move(respondent), std::move(executor), std::move(root),
+        std::move(prefix), max_size);
+  }
+
+  /**
+   * @brief content_type - by the file's extension, octet-stream if unknown
+   */
+  static std::string_view content_type(std::string_view extension) noexcept {
+    if (extension == ".html" || extension == ".htm")
+      return "text/html";
+    if (extension == ".css")
+      return "text/css";
+    if (extension == ".js")
+      return "application/javascript";
+    if (extension == ".json")
+      return "application/json";
+    if (extension == ".txt")
+      return "text/plain";
+    if (extension == ".svg")
+      return "image/svg+xml";
+    if (extension == ".png")
+      return "image/png";
+    if (extension == ".jpg" || extension == ".jpeg")
+      return "image/jpeg";
+    if (extension == ".ico")
+      return "image/x-icon";
+    return "application/octet-stream";
+  }
+
+  /**
+   * @brief served - number of requests answered with files
+   */
+  std::uint64_t served() const noexcept {
+    return served_.load(std::memory_order_relaxed);
+  }
+
+  bool shares_response(RequestView request) override {
+    return request.method() == boost::beast::http::verb::get &&
+           request.target().starts_with(prefix_);
+  }
+
+  bool async_shared_response(RequestView request,
+                             shared_response_handler handler) override {
+    auto path = resolve(request.method(), request.target());
+    if (std::empty(path))
+      return false;
+    load(std::move(path), std::move(handler));
+    return true;
+  }
+
+  boost::beast::http::message_generator
+  make_response(string_request&& request) override {
+    return respondent_->make_response(std::move(request));
+  }
+
+  bool fill_response(RequestView request,
+                     reusable_response& response) override {
+    return respondent_->fill_response(request, response);
+  }
+
+  boost::beast::http::message_generator
+  make_arena_response(arena_request&& request) override {
+    return respondent_->make_arena_response(std::move(request));
+  }
+
+  std::shared_ptr<WebSocketHandler>
+  accept_websocket(const string_request& request) override {
+    return respondent_->accept_websocket(request);
+  }
+
+  std::shared_ptr<StreamChannel>
+  make_stream(RequestView request, reusable_response& response) override {
+    return respondent_->make_stream(request, response);
+  }
+};
+
+} // namespace rest_in_beast
+
+#endif // REST_IN_BEAST_FILE_RESPONDENT_HPP
@@ -0,0 +1,140 @@
+//
+// Author: Dmitriy Gavryushin (https://github.com/Gawrjuschin)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#ifndef REST_IN_BEAST_HANDOFF_HPP
+#define REST_IN_BEAST_HANDOFF_HPP
+
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/ip/tcp.hpp>
+#include <boost/asio/local/stream_protocol.hpp>
+#include <boost/system/error_code.hpp>
+
+#include <sys/socket.h>
+#include <sys/uio.h>
+
+#include <array>
+#include <cerrno>
+#include <cstring>
+#include <string>
+
+namespace rest_in_beast {
+
+/**
+ * @brief listener_handle - native handle of the listening socket
+ */
+using listener_handle = boost::asio::ip::tcp::acceptor::native_handle_type;
+
+/**
+ * @brief send_listener passes the listening socket over connected Unix socket
+ * as SCM_RIGHTS: the receiver gets it's own descriptor of the same socket, so
+ * connections in the listen backlog are not lost
+ * @param channel - connected Unix stream socket
+ */
+inline boost::system::error_code send_listener(int channel,
+                                               listener_handle listener) {
+  char byte{'L'};
+  iovec data{&byte, 1};
+  alignas(cmsghdr) std::array<char, CMSG_SPACE(sizeof(int))> control{};
+
+  msghdr message{};
+  message.msg_iov = &data;
+  message.msg_iovlen = 1;
+  message.msg_control = std::data(control);
+  message.msg_controllen = std::size(control);
+
+  cmsghdr* header = CMSG_FIRSTHDR(&message);
+  header->cmsg_level = SOL_SOCKET;
+  header->cmsg_type = SCM_RIGHTS;
+  header->cmsg_len = CMSG_LEN(sizeof(int));
+  std::memcpy(CMSG_DATA(header), &listener, sizeof(int));
+
+  if (::sendmsg(channel, &message, MSG_NOSIGNAL) != 1) {
+    return {errno, boost::system::system_category()};
+  }
+  return {};
+}
+
+/**
+ * @brief receive_listener receives the listening socket sent by send_listener
+ * @param channel - connected Unix stream socket
+ * @return -1 on error
+ */
+inline listener_handle receive_listener(int channel,
+                                        boost::system::error_code& ec) {
+  char byte{};
+  iovec data{&byte, 1};
+  alignas(cmsghdr) std::array<char, CMSG_SPACE(sizeof(int))> control{};
+
+  msghdr message{};
+  message.msg_iov = &data;
+  message.msg_iovlen = 1;
+  message.msg_control = std::data(control);
+  message.msg_controllen = std::size(control);
+
+  const auto received = ::recvmsg(channel, &message, MSG_CMSG_CLOEXEC);
+  if (received < 0) {
+    ec = {errno, boost::system::system_category()};
+    return -1;
+  }
+
+  const cmsghdr* header = CMSG_FIRSTHDR(&message);
+  if (received != 1 || !header || header->cmsg_level != SOL_SOCKET ||
+      header->cmsg_type != SCM_RIGHTS ||
+      header->cmsg_len != CMSG_LEN(sizeof(int))) {
+    ec = boost::asio::error::invalid_argument;
+    return -1;
+  }
+
+  listener_handle listener{};
+  std::memcpy(&listener, CMSG_DATA(header), sizeof(int));
+  ec = {};
+  return listener;
+}
+
+/**
+ * @brief receive_listener connects to the handoff path of the running server
+ * (Server::handoff) and receives it's listening socket. Blocking: call before
+ * starting the new server on the socket
+ * @return -1 on error
+ */
+inline listener_handle receive_listener(const std::string& path,
+                                        boost::system::error_code& ec) {
+  boost::asio::io_context io_ctx;
+  boost::asio::local::stream_protocol::socket channel{io_ctx};
+  channel.connect(path, ec);
+  if (ec)
+    return -1;
+  return receive_listener(channel.native_handle(), ec);
+}
+
+/**
+ * @brief listen_reuse_port opens listening socket with SO_REUSEPORT: sockets
+ * opened on the same endpoint share it's connections, so each io_context of the
+ * Runner may accept with it's own server
+ * @return -1 on error
+ */
+inline listener_handle
+listen_reuse_port(const boost::asio::ip::tcp::endpoint& endpoint,
+                  boost::system::error_code& ec) {
+  using reuse_port = boost::asio::detail::socket_option::boolean<SOL_SOCKET,
+                                                                  SO_REUSEPORT>;
+
+  boost::asio::io_context io_ctx;
+  boost::asio::ip::tcp::acceptor acceptor{io_ctx};
+  if (acceptor.open(endpoint.protocol(), ec) ||
+      acceptor.set_option(boost::asio::socket_base::reuse_address{true}, ec) ||
+      acceptor.set_option(reuse_port{true}, ec) ||
+      acceptor.bind(endpoint, ec) ||
+      acceptor.listen(boost::asio::socket_base::max_listen_connections, ec)) {
+    return -1;
+  }
+  return acceptor.release(ec);
+}
+
+} // namespace rest_in_beast
+
+#endif // REST_IN_BEAST_HANDOFF_HPP
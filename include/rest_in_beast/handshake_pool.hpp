@@ -0,0 +1,185 @@
+//
+// Author: Dmitriy Gavryushin (https://github.com/Gawrjuschin)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#ifndef REST_IN_BEAST_HANDSHAKE_POOL_HPP
+#define REST_IN_BEAST_HANDSHAKE_POOL_HPP
+
+#include "util/shared_proxy.hpp"
+
+#include <boost/asio/associated_executor.hpp>
+#include <boost/asio/dispatch.hpp>
+#include <boost/asio/io_context.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <utility>
+
+namespace rest_in_beast {
+
+/**
+ * @brief The HandshakePool class is a separate io_context for TLS handshakes
+ * with bounded number of concurrent handshakes.
+ *
+ * Sessions of SecureSessionFactory and DetectSSLSessionFactory with the pool
+ * run handshake's cryptography on the pool's threads and return to the serving
+ * io_context when handshake is done, so a reconnect storm does not delay
+ * established connections. Handshakes above the limit wait in the queue,
+ * connections above the queue limit are closed.
+ *
+ * The pool does not own threads: run it's io_context with as many threads as
+ * handshakes should use.
+ */
+class HandshakePool {
+public:
+  /**
+   * @brief The Metrics class - handshakes admission counters
+   */
+  struct Metrics {
+    // Handshakes being performed now
+    std::atomic<std::size_t> in_progress{};
+    // Handshakes waiting in the queue now
+    std::atomic<std::size_t> queued{};
+    // Handshakes started since the pool is created
+    std::atomic<std::uint64_t> started{};
+    // Handshakes which waited in the queue before start
+    std::atomic<std::uint64_t> delayed{};
+    // Connections closed because the queue was full
+    std::atomic<std::uint64_t> rejected{};
+    // Total time spent by handshakes in the queue
+    std::atomic<std::uint64_t> queue_wait_us{};
+  };
+
+private:
+  struct Pending {
+    std::function<void()> start;
+    std::chrono::steady_clock::time_point enqueued;
+  };
+
+  boost::asio::io_context& io_ctx_;
+  const std::size_t max_concurrent_;
+  const std::size_t max_queued_;
+
+  std::mutex mutex_;
+  std::deque<Pending> queue_;
+  std::size_t in_progress_{};
+
+  Metrics metrics_{};
+
+  HandshakePool(boost::asio::io_context& io_ctx, std::size_t max_concurrent,
+                std::size_t max_queued)
+      : io_ctx_{io_ctx}, max_concurrent_{max_concurrent ? max_concurrent : 1},
+        max_queued_{max_queued} {}
+
+  friend util::SharedProxy<HandshakePool>;
+
+  void start(std::function<void()>&& dispatch_handler) {
+    metrics_.started.fetch_add(1, std::memory_order_relaxed);
+    dispatch_handler();
+  }
+
+public:
+  HandshakePool(const HandshakePool&) = delete;
+  HandshakePool& operator=(const HandshakePool&) = delete;
+
+  HandshakePool(HandshakePool&&) = delete;
+  HandshakePool& operator=(HandshakePool&&) = delete;
+
+  ~HandshakePool() = default;
+
+  /**
+   * @brief make_shared
+   * @param io_ctx - io_context for handshakes
+   * @param max_concurrent - handshakes performed at the same time
+   * @param max_queued - handshakes waiting for start
+   */
+  static std::shared_ptr<HandshakePool>
+  make_shared(boost::asio::io_context& io_ctx, std::size_t max_concurrent,
+              std::size_t max_queued) {
+    return std::make_shared<util::SharedProxy<HandshakePool>>(
+        io_ctx, max_concurrent, max_queued);
+  }
+
+  boost::asio::io_context& context() noexcept { return io_ctx_; }
+
+  /**
+   * @brief acquire - starts handshake now or queues it. Handler is dispatched
+   * to it's associated executor, pool's io_context by default, and MUST be
+   * followed by release when handshake is done
+   * @param handler - copy constructible handler without arguments
+   * @return false if the queue is full, handler is not called then
+   */
+  template <typename Handler> bool acquire(Handler&& handler) {
+    // std::function has no associated executor, so it is taken from the
+    // handler itself: strand of the handler is kept
+    std::function<void()> dispatch_handler{
+        [this, handler = std::forward<Handler>(handler)]() mutable {
+          const auto executor = boost::asio::get_associated_executor(
+              handler, io_ctx_.get_executor());
+          boost::asio::dispatch(executor, std::move(handler));
+        }};
+
+    {
+      const std::scoped_lock lock{mutex_};
+      if (in_progress_ == max_concurrent_) {
+        if (std::size(queue_) == max_queued_) {
+          metrics_.rejected.fetch_add(1, std::memory_order_relaxed);
+          return false;
+        }
+
+        queue_.push_back(
+            {std::move(dispatch_handler), std::chrono::steady_clock::now()});
+        metrics_.queued.store(std::size(queue_), std::memory_order_relaxed);
+        return true;
+      }
+
+      ++in_progress_;
+      metrics_.in_progress.store(in_progress_, std::memory_order_relaxed);
+    }
+
+    start(std::move(dispatch_handler));
+    return true;
+  }
+
+  /**
+   * @brief release - finishes handshake and starts the next queued one
+   */
+  void release() {
+    Pending next{};
+    {
+      const std::scoped_lock lock{mutex_};
+      if (std::empty(queue_)) {
+        --in_progress_;
+        metrics_.in_progress.store(in_progress_, std::memory_order_relaxed);
+        return;
+      }
+
+      next = std::move(queue_.front());
+      queue_.pop_front();
+      metrics_.queued.store(std::size(queue_), std::memory_order_relaxed);
+    }
+
+    const auto waited = std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - next.enqueued);
+    metrics_.delayed.fetch_add(1, std::memory_order_relaxed);
+    metrics_.queue_wait_us.fetch_add(
+        static_cast<std::uint64_t>(waited.count()), std::memory_order_relaxed);
+
+    start(std::move(next.start));
+  }
+
+  const Metrics& metrics() const noexcept { return metrics_; }
+};
+
+} // namespace rest_in_beast
+
+#endif // REST_IN_BEAST_HANDSHAKE_POOL_HPP
@@ -0,0 +1,243 @@
+//
+// Author: Dmitriy Gavryushin (https://github.com/Gawrjuschin)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#ifndef REST_IN_BEAST_LOAD_SHEDDING_HPP
+#define REST_IN_BEAST_LOAD_SHEDDING_HPP
+
+#include "detail/respondent.hpp"
+#include "metrics.hpp"
+#include "util/shared_proxy.hpp"
+
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/steady_timer.hpp>
+#include <boost/beast/core/error.hpp>
+#include <boost/beast/http/field.hpp>
+#include <boost/beast/http/message_generator.hpp>
+#include <boost/beast/http/status.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <utility>
+
+namespace rest_in_beast {
+
+/**
+ * @brief The LagMonitorOptions class - probing period and lag thresholds
+ */
+struct LagMonitorOptions {
+  std::chrono::milliseconds interval{100};
+  // SheddingRespondent answers 503 above it
+  std::chrono::milliseconds shed_lag{200};
+  // Server does not accept connections above it
+  std::chrono::milliseconds pause_lag{500};
+};
+
+/**
+ * @brief The LagMonitor class measures scheduling lag of the io_context: the
+ * probe is a timer's handler and the lag is how late it runs. While the probe
+ * waits in the queue lag grows with the wait, so stuck loop is seen without
+ * the probe being run.
+ *
+ * Create one monitor per io_context. Lags are recorded into the metrics.
+ */
+class LagMonitor : public std::enable_shared_from_this<LagMonitor> {
+  using clock = std::chrono::steady_clock;
+
+  boost::asio::steady_timer timer_;
+  const LagMonitorOptions options_;
+  std::shared_ptr<Metrics> metrics_;
+
+  // Nanoseconds since clock's epoch of the probe's expiry, 0 - no probe
+  std::atomic<std::int64_t> probe_expiry_{};
+  std::atomic<std::int64_t> last_lag_{};
+  std::atomic<std::uint64_t> probes_{};
+
+  LagMonitor(boost::asio::io_context& io_ctx, LagMonitorOptions options,
+             std::shared_ptr<Metrics> metrics)
+      : timer_{io_ctx}, options_{options}, metrics_{std::move(metrics)} {}
+
+  friend util::SharedProxy<LagMonitor>;
+
+  static std::int64_t since_epoch(clock::time_point time) noexcept {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               time.time_since_epoch())
+        .count();
+  }
+
+  void do_probe() {
+    timer_.expires_after(options_.interval);
+    probe_expiry_.store(since_epoch(timer_.expiry()),
+                        std::memory_order_relaxed);
+    timer_.async_wait([self = shared_from_this()](boost::beast::error_code ec) {
+      self->on_probe(ec);
+    });
+  }
+
+  void on_probe(boost::beast::error_code ec) {
+    if (ec) {
+      probe_expiry_.store(0, std::memory_order_relaxed);
+      return;
+    }
+
+    const auto lag =
+        std::max(clock::now() - timer_.expiry(), clock::duration{});
+    last_lag_.store(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(lag).count(),
+        std::memory_order_relaxed);
+    probes_.fetch_add(1, std::memory_order_relaxed);
+    if (metrics_) {
+      metrics_->record(Metrics::Phase::loop_lag, lag);
+    }
+
+    do_probe();
+  }
+
+public:
+  LagMonitor(const LagMonitor&) = delete;
+  LagMonitor& operator=(const LagMonitor&) = delete;
+
+  LagMonitor(LagMonitor&&) = delete;
+  LagMonitor& operator=(LagMonitor&&) = delete;
+
+  ~LagMonitor() = default;
+
+  /**
+   * @brief start - probes the io_context until stop
+   * @param metrics - lags are recorded if not nullptr
+   */
+  static std::shared_ptr<LagMonitor>
+  start(boost::asio::io_context& io_ctx, LagMonitorOptions options = {},
+        std::shared_ptr<Metrics> metrics = nullptr) {
+    auto monitor = std::make_shared<util::SharedProxy<LagMonitor>>(
+        io_ctx, options, std::move(metrics));
+    monitor->do_probe();
+    return monitor;
+  }
+
+  /**
+   * @brief stop - cancels probing, call from the io_context's thread
+   */
+  void stop() { timer_.cancel(); }
+
+  const LagMonitorOptions& options() const noexcept { return options_; }
+
+  /**
+   * @brief probes - number of completed probes
+   */
+  std::uint64_t probes() const noexcept {
+    return probes_.load(std::memory_order_relaxed);
+  }
+
+  /**
+   * @brief lag - lag of the last probe or the wait of the current one,
+   * whichever is greater. Called from any thread
+   */
+  std::chrono::nanoseconds lag() const noexcept {
+    const auto expiry = probe_expiry_.load(std::memory_order_relaxed);
+    const auto waiting = expiry == 0 ? 0 : since_epoch(clock::now()) - expiry;
+    return std::chrono::nanoseconds{
+        std::max(last_lag_.load(std::memory_order_relaxed), waiting)};
+  }
+
+  bool shedding() const noexcept { return lag() > options_.shed_lag; }
+
+  bool paused() const noexcept { return lag() > options_.pause_lag; }
+};
+
+/**
+ * @brief The SheddingRespondent class answers 503 with Retry-After through the
+ * reusable response while the monitor's lag is above shed_lag and closes the
+ * connection. Streams, shared responses and WebSocket upgrades are refused
+ * then, so the wrapped respondent does no work.
+ */
+class SheddingRespondent : public Respondent {
+  std::shared_ptr<Respondent> respondent_;
+  std::shared_ptr<LagMonitor> monitor_;
+  std::atomic<std::uint64_t> shed_{};
+
+  SheddingRespondent(std::shared_ptr<Respondent> respondent,
+                     std::shared_ptr<LagMonitor> monitor)
+      : respondent_{std::move(respondent)}, monitor_{std::move(monitor)} {}
+
+  friend util::SharedProxy<SheddingRespondent>;
+
+  bool shed(reusable_response& response) {
+    if (!monitor_->shedding())
+      return false;
+
+    shed_.fetch_add(1, std::memory_order_relaxed);
+    response.result(boost::beast::http::status::service_unavailable);
+    response.set(boost::beast::http::field::retry_after, "1");
+    response.keep_alive(false);
+    response.body().clear();
+    return true;
+  }
+
+public:
+  ~SheddingRespondent() = default;
+
+  static std::shared_ptr<SheddingRespondent>
+  make_shared(std::shared_ptr<Respondent> respondent,
+              std::shared_ptr<LagMonitor> monitor) {
+    return std::make_shared<util::SharedProxy<SheddingRespondent>>(
+        std::move(respondent), std::move(monitor));
+  }
+
+  /**
+   * @brief shed - number of requests answered with 503
+   */
+  std::uint64_t shed() const noexcept {
+    return shed_.load(std::memory_order_relaxed);
+  }
+
+  boost::beast::http::message_generator
+  make_response(string_request&& request) override {
+    return respondent_->make_response(std::move(request));
+  }
+
+  bool fill_response(RequestView request,
+                     reusable_response& response) override {
+    return shed(response) || respondent_->fill_response(request, response);
+  }
+
+  boost::beast::http::message_generator
+  make_arena_response(arena_request&& request) override {
+    return respondent_->make_arena_response(std::move(request));
+  }
+
+  std::shared_ptr<WebSocketHandler>
+  accept_websocket(const string_request& request) override {
+    if (monitor_->shedding())
+      return nullptr;
+    return respondent_->accept_websocket(request);
+  }
+
+  bool shares_response(RequestView request) override {
+    return !monitor_->shedding() && respondent_->shares_response(request);
+  }
+
+  bool async_shared_response(RequestView request,
+                             shared_response_handler handler) override {
+    if (monitor_->shedding())
+      return false;
+    return respondent_->async_shared_response(request, std::move(handler));
+  }
+
+  std::shared_ptr<StreamChannel>
+  make_stream(RequestView request, reusable_response& response) override {
+    if (monitor_->shedding())
+      return nullptr;
+    return respondent_->make_stream(request, response);
+  }
+};
+
+} // namespace rest_in_beast
+
+#endif // REST_IN_BEAST_LOAD_SHEDDING_HPP
@@ -0,0 +1,332 @@
+//
+// Author: Dmitriy Gavryushin (https://github.com/Gawrjuschin)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#ifndef REST_IN_BEAST_METRICS_HPP
+#define REST_IN_BEAST_METRICS_HPP
+
+#include "util/shared_proxy.hpp"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <new>
+#include <string>
+#include <string_view>
+#include <thread>
+
+namespace rest_in_beast {
+
+/**
+ * @brief The Metrics class is the server's metrics: counters and latency
+ * histograms of sessions' phases recorded with relaxed atomics into
+ * cache-line-padded shards. Each thread writes to it's own shard (threads
+ * above the number of shards share them), so recording is an uncontended
+ * atomic add. Shards are summed on snapshot and scrape.
+ *
+ * Sessions with metrics answer GET of path() with Prometheus text exposition
+ * without calling the respondent.
+ */
+class Metrics {
+public:
+  /**
+   * @brief The Phase enum - latency histograms
+   */
+  enum class Phase : std::size_t {
+    // Starting session of accepted connection
+    accept,
+    // TLS handshake
+    handshake,
+    // Reading the request from it's first bytes, keep-alive wait for them is
+    // not included
+    read,
+    // Respondent's work until the response is ready to write
+    handler,
+    // Writing the response
+    write,
+    // Scheduling lag of the io_context measured by LagMonitor
+    loop_lag,
+    count
+  };
+
+  /**
+   * @brief The Counter enum - monotonic counters
+   */
+  enum class Counter : std::size_t {
+    connections_opened,
+    connections_closed,
+    // Reset by admission control
+    connections_rejected,
+    requests,
+    bytes_in,
+    bytes_out,
+    count
+  };
+
+  /**
+   * @brief The Histogram class is a log-linear histogram of nanoseconds with
+   * four buckets per power of two: relative error is below 25%
+   */
+  struct Histogram {
+    static constexpr std::size_t sub_buckets{4};
+    static constexpr std::size_t buckets{188};
+
+    std::array<std::uint64_t, buckets> counts{};
+    std::uint64_t count{};
+    std::uint64_t sum{};
+
+    static constexpr std::size_t bucket(std::uint64_t value) noexcept {
+      if (value < sub_buckets)
+        return value;
+      const std::size_t exponent = std::bit_width(value) - 1;
+      const std::size_t index =
+          (exponent - 1) * sub_buckets + ((value >> (exponent - 2)) & 3);
+      return std::min(index, buckets - 1);
+    }
+
+    static constexpr std::uint64_t lower_bound(std::size_t index) noexcept {
+      if (index < sub_buckets)
+        return index;
+      const std::size_t exponent = index / sub_buckets + 1;
+      return (sub_buckets + index % sub_buckets) << (exponent - 2);
+    }
+
+    /**
+     * @brief quantile - lower bound of the bucket of the quantile
+     * @param q - in [0, 1]
+     */
+    std::uint64_t quantile(double q) const noexcept {
+      if (count == 0)
+        return 0;
+      const auto rank =
+          std::max<std::uint64_t>(1, static_cast<std::uint64_t>(q * count));
+      std::uint64_t seen{};
+      for (std::size_t idx{}; idx < buckets; ++idx) {
+        seen += counts[idx];
+        if (seen >= rank)
+          return lower_bound(idx);
+      }
+      return lower_bound(buckets - 1);
+    }
+  };
+
+  /**
+   * @brief The Snapshot class - sum of all shards
+   */
+  struct Snapshot {
+    std::array<std::uint64_t, static_cast<std::size_t>(Counter::count)>
+        counters{};
+    std::array<Histogram, static_cast<std::size_t>(Phase::count)> histograms{};
+
+    std::uint64_t counter(Counter counter) const noexcept {
+      return counters[static_cast<std::size_t>(counter)];
+    }
+
+    const Histogram& histogram(Phase phase) const noexcept {
+      return histograms[static_cast<std::size_t>(phase)];
+    }
+
+    std::uint64_t active_connections() const noexcept {
+      return counter(Counter::connections_opened) -
+             counter(Counter::connections_closed);
+    }
+  };
+
+  using clock = std::chrono::steady_clock;
+
+private:
+  struct AtomicHistogram {
+    std::array<std::atomic<std::uint64_t>, Histogram::buckets> counts{};
+    std::atomic<std::uint64_t> count{};
+    std::atomic<std::uint64_t> sum{};
+  };
+
+  struct alignas(64) Shard {
+    std::array<std::atomic<std::uint64_t>,
+               static_cast<std::size_t>(Counter::count)>
+        counters{};
+    std::array<AtomicHistogram, static_cast<std::size_t>(Phase::count)>
+        histograms{};
+  };
+
+  std::string path_;
+  const std::size_t mask_;
+  std::unique_ptr<Shard[]> shards_;
+
+  Metrics(std::string path, std::size_t shards)
+      : path_{std::move(path)}, mask_{std::bit_ceil(std::max<std::size_t>(
+                                          shards, 1)) -
+                                      1},
+        shards_{new Shard[mask_ + 1]} {}
+
+  friend util::SharedProxy<Metrics>;
+
+  /**
+   * @brief shard - thread's shard, threads are numbered on first record
+   */
+  Shard& shard() noexcept {
+    static std::atomic<std::size_t> threads{};
+    thread_local const std::size_t thread{
+        threads.fetch_add(1, std::memory_order_relaxed)};
+    return shards_[thread & mask_];
+  }
+
+  static void append_counter(std::string& out, std::string_view name,
+                             std::string_view type, std::string_view help,
+                             std::uint64_t value) {
+    out.append("# HELP ").append(name).append(" ").append(help).append("\n");
+    out.append("# TYPE ").append(name).append(" ").append(type).append("\n");
+    out.append(name).append(" ").append(std::to_string(value)).append("\n");
+  }
+
+  static void append_histogram(std::string& out, std::string_view name,
+                               std::string_view help,
+                               const Histogram& histogram) {
+    out.append("# HELP ").append(name).append(" ").append(help).append("\n");
+    out.append("# TYPE ").append(name).append(" histogram\n");
+
+    // Bounds are powers of two nanoseconds from 1us to 34s: bucket of 2^k
+    // starts at index (k - 1) * 4
+    std::array<char, 32> le{};
+    std::uint64_t cumulative{};
+    std::size_t idx{};
+    for (std::size_t exponent{10}; exponent <= 35; ++exponent) {
+      for (; idx < (exponent - 1) * Histogram::sub_buckets; ++idx) {
+        cumulative += histogram.counts[idx];
+      }
+      std::snprintf(std::data(le), std::size(le), "%g",
+                    static_cast<double>(std::uint64_t{1} << exponent) / 1e9);
+      out.append(name).append("_bucket{le=\"").append(std::data(le));
+      out.append("\"} ").append(std::to_string(cumulative)).append("\n");
+    }
+    out.append(name).append("_bucket{le=\"+Inf\"} ");
+    out.append(std::to_string(histogram.count)).append("\n");
+
+    std::snprintf(std::data(le), std::size(le), "%.9f",
+                  static_cast<double>(histogram.sum) / 1e9);
+    out.append(name).append("_sum ").append(std::data(le)).append("\n");
+    out.append(name).append("_count ");
+    out.append(std::to_string(histogram.count)).append("\n");
+  }
+
+public:
+  Metrics(const Metrics&) = delete;
+  Metrics& operator=(const Metrics&) = delete;
+
+  Metrics(Metrics&&) = delete;
+  Metrics& operator=(Metrics&&) = delete;
+
+  ~Metrics() = default;
+
+  /**
+   * @brief make_shared
+   * @param path - target of exposition endpoint, empty disables it
+   * @param shards - number of shards, rounded up to power of two. Threads
+   * recording metrics SHOULD not exceed it
+   */
+  static std::shared_ptr<Metrics>
+  make_shared(std::string path = "/metrics",
+              std::size_t shards = std::thread::hardware_concurrency()) {
+    return std::make_shared<util::SharedProxy<Metrics>>(std::move(path),
+                                                        shards);
+  }
+
+  const std::string& path() const noexcept { return path_; }
+
+  void add(Counter counter, std::uint64_t value = 1) noexcept {
+    shard()
+        .counters[static_cast<std::size_t>(counter)]
+        .fetch_add(value, std::memory_order_relaxed);
+  }
+
+  void record(Phase phase, clock::duration duration) noexcept {
+    const auto ns = static_cast<std::uint64_t>(std::max<clock::rep>(
+        0, std::chrono::duration_cast<std::chrono::nanoseconds>(duration)
+               .count()));
+    auto& histogram = shard().histograms[static_cast<std::size_t>(phase)];
+    histogram.counts[Histogram::bucket(ns)].fetch_add(
+        1, std::memory_order_relaxed);
+    histogram.count.fetch_add(1, std::memory_order_relaxed);
+    histogram.sum.fetch_add(ns, std::memory_order_relaxed);
+  }
+
+  /**
+   * @brief record - duration since start
+   */
+  void record(Phase phase, clock::time_point start) noexcept {
+    record(phase, clock::now() - start);
+  }
+
+  /**
+   * @brief snapshot sums shards. Shards are read without stopping writers:
+   * histogram's count may differ from sum of it's buckets by records in flight
+   */
+  Snapshot snapshot() const {
+    Snapshot snapshot;
+    for (std::size_t shard{}; shard <= mask_; ++shard) {
+      const auto& source = shards_[shard];
+      for (std::size_t idx{}; idx < std::size(source.counters); ++idx) {
+        snapshot.counters[idx] +=
+            source.counters[idx].load(std::memory_order_relaxed);
+      }
+      for (std::size_t phase{}; phase < std::size(source.histograms);
+           ++phase) {
+        const auto& from = source.histograms[phase];
+        auto& to = snapshot.histograms[phase];
+        for (std::size_t idx{}; idx < Histogram::buckets; ++idx) {
+          to.counts[idx] += from.counts[idx].load(std::memory_order_relaxed);
+        }
+        to.count += from.count.load(std::memory_order_relaxed);
+        to.sum += from.sum.load(std::memory_order_relaxed);
+      }
+    }
+    return snapshot;
+  }
+
+  /**
+   * @brief expose appends Prometheus text exposition of the snapshot
+   */
+  static void expose(const Snapshot& snapshot, std::string& out) {
+    append_counter(out, "rib_connections_active", "gauge",
+                   "Open connections", snapshot.active_connections());
+    append_counter(out, "rib_connections_total", "counter",
+                   "Accepted connections",
+                   snapshot.counter(Counter::connections_opened));
+    append_counter(out, "rib_rejected_connections_total", "counter",
+                   "Connections over admission limits",
+                   snapshot.counter(Counter::connections_rejected));
+    append_counter(out, "rib_requests_total", "counter", "Served requests",
+                   snapshot.counter(Counter::requests));
+    append_counter(out, "rib_received_bytes_total", "counter",
+                   "Bytes of requests", snapshot.counter(Counter::bytes_in));
+    append_counter(out, "rib_sent_bytes_total", "counter",
+                   "Bytes of responses", snapshot.counter(Counter::bytes_out));
+
+    append_histogram(out, "rib_accept_seconds", "Starting accepted session",
+                     snapshot.histogram(Phase::accept));
+    append_histogram(out, "rib_handshake_seconds", "TLS handshake",
+                     snapshot.histogram(Phase::handshake));
+    append_histogram(out, "rib_read_seconds",
+                     "Reading request from it's first bytes",
+                     snapshot.histogram(Phase::read));
+    append_histogram(out, "rib_handler_seconds", "Respondent's work",
+                     snapshot.histogram(Phase::handler));
+    append_histogram(out, "rib_write_seconds", "Writing response",
+                     snapshot.histogram(Phase::write));
+    append_histogram(out, "rib_loop_lag_seconds", "Event loop's scheduling lag",
+                     snapshot.histogram(Phase::loop_lag));
+  }
+};
+
+} // namespace rest_in_beast
+
+#endif // REST_IN_BEAST_METRICS_HPP
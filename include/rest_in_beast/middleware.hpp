@@ -0,0 +1,120 @@
+//
+// Author: Dmitriy Gavryushin (https://github.com/Gawrjuschin)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#ifndef REST_IN_BEAST_MIDDLEWARE_HPP
+#define REST_IN_BEAST_MIDDLEWARE_HPP
+
+#include "detail/respondent.hpp"
+#include "util/shared_proxy.hpp"
+
+#include <boost/beast/http/message.hpp>
+#include <boost/beast/http/message_generator.hpp>
+#include <boost/beast/http/string_body.hpp>
+
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+namespace rest_in_beast {
+/**
+ * @brief The Pipeline class is a Respondent composed in compile time from
+ * filters and the final handler.
+ *
+ * Handler is a callable object: message_generator(request&&).
+ * Filter is a callable object: message_generator(request&&, Next next), where
+ * next is a callable object: message_generator(request&&). Filter passes
+ * request further by calling next or short-circuits by returning it's own
+ * response.
+ *
+ * The first filter is the outermost one. All the calls between filters are
+ * direct calls of known types, so the only indirect call per request is the
+ * Respondent::make_response itself.
+ */
+template <typename Handler, typename... Filters>
+class Pipeline : public Respondent {
+public:
+  using request_type =
+      boost::beast::http::request<boost::beast::http::string_body>;
+
+private:
+  std::tuple<Filters...> filters_;
+  Handler handler_;
+
+  /**
+   * @brief The Next class passes request to the filter with index Idx or to
+   * the handler after the last filter
+   */
+  template <std::size_t Idx> struct Next {
+    Pipeline* pipeline;
+
+    boost::beast::http::message_generator
+    operator()(request_type&& request) const {
+      return pipeline->template call<Idx>(std::move(request));
+    }
+  };
+
+  template <std::size_t Idx>
+  boost::beast::http::message_generator call(request_type&& request) {
+    if constexpr (Idx == sizeof...(Filters)) {
+      return std::invoke(handler_, std::move(request));
+    } else {
+      return std::invoke(std::get<Idx>(filters_), std::move(request),
+                         Next<Idx + 1>{this});
+    }
+  }
+
+  Pipeline(Handler handler, Filters... filters)
+      : filters_{std::move(filters)...}, handler_{std::move(handler)} {}
+
+  friend util::SharedProxy<Pipeline>;
+
+public:
+  ~Pipeline() = default;
+
+  /**
+   * @brief make_shared
+   * @param handler - final handler
+   * @param filters - filters from the outermost to the innermost
+   */
+  static std::shared_ptr<Pipeline> make_shared(Handler handler,
+                                               Filters... filters) {
+    return std::make_shared<util::SharedProxy<Pipeline>>(
+        std::move(handler), std::move(filters)...);
+  }
+
+  boost::beast::http::message_generator
+  make_response(request_type&& request) override {
+    return call<0>(std::move(request));
+  }
+
+  /**
+   * @brief filter - access to filter's state (counters, settings)
+   */
+  template <std::size_t Idx> auto& filter() noexcept {
+    return std::get<Idx>(filters_);
+  }
+
+  Handler& handler() noexcept { return handler_; }
+};
+
+/**
+ * @brief make_pipeline deduces Pipeline type from handler and filters
+ */
+template <typename Handler, typename... Filters>
+std::shared_ptr<Pipeline<std::decay_t<Handler>, std::decay_t<Filters>...>>
+make_pipeline(Handler&& handler, Filters&&... filters) {
+  return Pipeline<std::decay_t<Handler>, std::decay_t<Filters>...>::
+      make_shared(std::forward<Handler>(handler),
+                  std::forward<Filters>(filters)...);
+}
+
+} // namespace rest_in_beast
+
+#endif // REST_IN_BEAST_MIDDLEWARE_HPP
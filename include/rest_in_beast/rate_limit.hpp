@@ -0,0 +1,353 @@
+//
+// Author: Dmitriy Gavryushin (https://github.com/Gawrjuschin)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#ifndef REST_IN_BEAST_RATE_LIMIT_HPP
+#define REST_IN_BEAST_RATE_LIMIT_HPP
+
+#include "util/hasher.hpp"
+#include "util/shared_proxy.hpp"
+
+#include <boost/asio/ip/address.hpp>
+#include <boost/beast/http/verb.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace rest_in_beast {
+
+/**
+ * @brief The RateLimit class - token bucket of a route class
+ */
+struct RateLimit {
+  // Tokens per second, request takes one
+  double rate{10.0};
+  // Bucket size: requests allowed at once after a pause
+  double burst{20.0};
+};
+
+/**
+ * @brief The RateLimiterOptions class - limits of route classes and size of
+ * the table
+ */
+struct RateLimiterOptions {
+  // Limit of the route class with the same index
+  std::vector<RateLimit> limits{RateLimit{}};
+  // Buckets of all clients and classes, rounded up to power of two
+  std::size_t capacity{65'536};
+};
+
+/**
+ * @brief The RateLimiter class limits requests per remote address and route
+ * class. Sessions answer requests over the limit with pre-serialized 429 and
+ * Retry-After before the respondent is called, HTTP/2 sessions send it's
+ * headers as the stream's response.
+ *
+ * Buckets are kept in a fixed table of sets of four, set is one cache line
+ * indexed by hash of the address and the class. Bucket is a single atomic
+ * "theoretical arrival time" of the next request (GCRA): request is allowed if
+ * it is at most burst - 1 intervals ahead of now and moves it one interval
+ * further. Taking a token is one compare-exchange, no locks.
+ *
+ * Client missing in it's set replaces the bucket with the earliest arrival
+ * time, which is the least recently used one. Replacing client claims the
+ * bucket, writes the arrival and then publishes it's key, so the key is never
+ * seen with the arrival of the evicted client. Concurrent first requests of a
+ * client may take two buckets of the set, the unused one is evicted first.
+ *
+ * Memory does not grow with the number of clients: under a flood of unique
+ * addresses buckets are evicted and evicted clients start with full buckets,
+ * so the limit errs towards allowing. Keep capacity above the number of
+ * clients active within a burst.
+ */
+class RateLimiter : public std::enable_shared_from_this<RateLimiter> {
+public:
+  /**
+   * @brief classifier_type - index of the request's limit, index past the
+   * limits is not limited
+   */
+  using classifier_type =
+      std::function<std::size_t(boost::beast::http::verb method,
+                                std::string_view target)>;
+
+  using clock = std::chrono::steady_clock;
+
+  /**
+   * @brief The Client class - remote address of the connection, empty if the
+   * server has no rate limiter
+   */
+  class Client {
+    std::shared_ptr<RateLimiter> limiter_{};
+    std::uint64_t address_{};
+
+    friend RateLimiter;
+
+    Client(std::shared_ptr<RateLimiter> limiter, std::uint64_t address)
+        : limiter_{std::move(limiter)}, address_{address} {}
+
+  public:
+    Client() = default;
+
+    explicit operator bool() const noexcept { return limiter_ != nullptr; }
+
+    /**
+     * @brief take - token of the request's class
+     * @return nullptr if the request is allowed, 429 response otherwise
+     */
+    const std::string* take(boost::beast::http::verb method,
+                            std::string_view target, bool keep_alive) const {
+      const auto route = limiter_->classifier_(method, target);
+      if (limiter_->take(address_, route))
+        return nullptr;
+      return &limiter_->rejection(route, keep_alive);
+    }
+  };
+
+private:
+  struct Limit {
+    // Nanoseconds per token and how far ahead of now arrival time may be
+    std::uint64_t interval;
+    std::uint64_t tolerance;
+    // Pre-serialized 429 with and without Connection: close
+    std::string keep_alive;
+    std::string close;
+  };
+
+  // Key of the bucket while it's arrival is written
+  static constexpr std::uint64_t claimed{1};
+
+  struct Bucket {
+    // Hash of the address and the class, 0 - free, claimed - being replaced
+    std::atomic<std::uint64_t> key{};
+    std::atomic<std::uint64_t> arrival{};
+  };
+
+  struct alignas(64) Set {
+    Bucket buckets[4];
+  };
+
+  const RateLimiterOptions options_;
+  std::vector<Limit> limits_;
+  classifier_type classifier_;
+  const std::size_t mask_;
+  std::unique_ptr<Set[]> sets_;
+  const clock::time_point epoch_{clock::now()};
+
+  alignas(64) std::atomic<std::uint64_t> limited_{};
+  std::atomic<std::uint64_t> evicted_{};
+
+  RateLimiter(RateLimiterOptions options, classifier_type classifier)
+      : options_{std::move(options)}, classifier_{std::move(classifier)},
+        mask_{std::bit_ceil(std::max<std::size_t>(options_.capacity, 4)) / 4 -
+              1},
+        sets_{new Set[mask_ + 1]} {
+    limits_.reserve(std::size(options_.limits));
+    for (const auto& limit : options_.limits) {
+      if (!(limit.rate > 0.0) || !(limit.burst >= 1.0)) {
+        throw std::invalid_argument{"RateLimit with rate <= 0 or burst < 1"};
+      }
+      const auto interval = static_cast<std::uint64_t>(
+          std::max(std::llround(1e9 / limit.rate), 1ll));
+      const auto tolerance = static_cast<std::uint64_t>(
+          std::llround((limit.burst - 1.0) * static_cast<double>(interval)));
+      const auto retry_after = std::to_string(
+          std::max<std::uint64_t>((interval + 999'999'999) / 1'000'000'000, 1));
+      limits_.push_back({.interval = interval,
+                         .tolerance = tolerance,
+                         .keep_alive = serialize(retry_after, false),
+                         .close = serialize(retry_after, true)});
+    }
+    if (!classifier_) {
+      classifier_ = [](boost::beast::http::verb, std::string_view) {
+        return std::size_t{};
+      };
+    }
+  }
+
+  friend util::SharedProxy<RateLimiter>;
+
+  static std::string serialize(const std::string& retry_after, bool close) {
+    std::string response{"HTTP/1.1 429 Too Many Requests\r\n"
+                         "Retry-After: "};
+    response.append(retry_after);
+    response.append("\r\nContent-Length: 0\r\n");
+    if (close) {
+      response.append("Connection: close\r\n");
+    }
+    response.append("\r\n");
+    return response;
+  }
+
+  std::uint64_t now() const noexcept {
+    return static_cast<std::uint64_t>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(clock::now() -
+                                                             epoch_)
+            .count());
+  }
+
+  static std::uint64_t key(std::uint64_t address, std::size_t route) noexcept {
+    const auto key = util::detail::wy_mix(
+        address ^ util::detail::wy_secret[2],
+        static_cast<std::uint64_t>(route) ^ util::detail::wy_secret[3]);
+    return key <= claimed ? key + 2 : key;
+  }
+
+  static bool consume(Bucket& bucket, const Limit& limit,
+                      std::uint64_t now) noexcept {
+    auto arrival = bucket.arrival.load(std::memory_order_relaxed);
+    for (;;) {
+      const auto base = std::max(arrival, now);
+      if (base - now > limit.tolerance)
+        return false;
+      if (bucket.arrival.compare_exchange_weak(arrival, base + limit.interval,
+                                               std::memory_order_relaxed))
+        return true;
+    }
+  }
+
+public:
+  RateLimiter(const RateLimiter&) = delete;
+  RateLimiter& operator=(const RateLimiter&) = delete;
+
+  RateLimiter(RateLimiter&&) = delete;
+  RateLimiter& operator=(RateLimiter&&) = delete;
+
+  ~RateLimiter() = default;
+
+  /**
+   * @brief make_shared
+   * @param options - limits of route classes
+   * @param classifier - class of the request, nullptr - every request is of
+   * the first class
+   * @throw std::invalid_argument if a limit has rate <= 0 or burst < 1
+   */
+  static std::shared_ptr<RateLimiter>
+  make_shared(RateLimiterOptions options = {},
+              classifier_type classifier = nullptr) {
+    return std::make_shared<util::SharedProxy<RateLimiter>>(
+        std::move(options), std::move(classifier));
+  }
+
+  /**
+   * @brief address - hash of the remote address, key of it's buckets
+   */
+  static std::uint64_t address(const boost::asio::ip::address& address) {
+    if (address.is_v4())
+      return address.to_v4().to_uint();
+
+    const auto bytes = address.to_v6().to_bytes();
+    std::uint64_t high, low;
+    std::memcpy(&high, std::data(bytes), 8);
+    std::memcpy(&low, std::data(bytes) + 8, 8);
+    return util::detail::wy_mix(high ^ util::detail::wy_secret[0],
+                                low ^ util::detail::wy_secret[1]);
+  }
+
+  const RateLimiterOptions& options() const noexcept { return options_; }
+
+  /**
+   * @brief client - limits of requests of the connection
+   */
+  Client client(const boost::asio::ip::address& remote) {
+    return Client{shared_from_this(), address(remote)};
+  }
+
+  /**
+   * @brief take - token of the address' bucket of the route class
+   * @return false if the bucket is empty
+   */
+  bool take(std::uint64_t address, std::size_t route) noexcept {
+    if (route >= std::size(limits_))
+      return true;
+
+    const auto& limit = limits_[route];
+    const auto key = this->key(address, route);
+    const auto now = this->now();
+    auto& set = sets_[key & mask_];
+
+    // Concurrent eviction of the chosen bucket is retried once, then the
+    // request is allowed
+    for (int attempt{}; attempt < 2; ++attempt) {
+      Bucket* victim{};
+      std::uint64_t victim_key{};
+      std::uint64_t victim_arrival{UINT64_MAX};
+      for (auto& bucket : set.buckets) {
+        const auto bucket_key = bucket.key.load(std::memory_order_acquire);
+        if (bucket_key == claimed)
+          continue;
+        if (bucket_key == key) {
+          if (consume(bucket, limit, now))
+            return true;
+          limited_.fetch_add(1, std::memory_order_relaxed);
+          return false;
+        }
+        const auto arrival = bucket_key == 0
+                                 ? 0
+                                 : bucket.arrival.load(
+                                       std::memory_order_relaxed);
+        if (arrival < victim_arrival) {
+          victim = &bucket;
+          victim_key = bucket_key;
+          victim_arrival = arrival;
+        }
+      }
+
+      // Every bucket of the set is being replaced
+      if (!victim)
+        return true;
+
+      if (victim->key.compare_exchange_strong(victim_key, claimed,
+                                              std::memory_order_relaxed)) {
+        victim->arrival.store(now + limit.interval, std::memory_order_relaxed);
+        victim->key.store(key, std::memory_order_release);
+        if (victim_key != 0) {
+          evicted_.fetch_add(1, std::memory_order_relaxed);
+        }
+        return true;
+      }
+    }
+    return true;
+  }
+
+  /**
+   * @brief rejection - pre-serialized 429 of the route class
+   */
+  const std::string& rejection(std::size_t route,
+                               bool keep_alive) const noexcept {
+    return keep_alive ? limits_[route].keep_alive : limits_[route].close;
+  }
+
+  /**
+   * @brief limited - number of requests over the limit
+   */
+  std::uint64_t limited() const noexcept {
+    return limited_.load(std::memory_order_relaxed);
+  }
+
+  /**
+   * @brief evicted - number of buckets replaced by other clients
+   */
+  std::uint64_t evicted() const noexcept {
+    return evicted_.load(std::memory_order_relaxed);
+  }
+};
+
+} // namespace rest_in_beast
+
+#endif // REST_IN_BEAST_RATE_LIMIT_HPP
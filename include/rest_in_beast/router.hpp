@@ -0,0 +1,93 @@
+//
+// Author: Dmitriy Gavryushin (https://github.com/Gawrjuschin)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#ifndef REST_IN_BEAST_ROUTER_HPP
+#define REST_IN_BEAST_ROUTER_HPP
+
+#include "detail/respondent.hpp"
+#include "util/route_table.hpp"
+#include "util/shared_proxy.hpp"
+
+#include <boost/beast/http/message.hpp>
+#include <boost/beast/http/message_generator.hpp>
+#include <boost/beast/http/string_body.hpp>
+
+#include <array>
+#include <functional>
+#include <memory>
+#include <string_view>
+#include <utility>
+
+namespace rest_in_beast {
+/**
+ * @brief The StaticRouter class is a Respondent dispatching requests by
+ * request target's path with compile time built StaticRouteTable.
+ *
+ * Handler may be any callable object with signature
+ * message_generator(request&&). Default is a plain function pointer, so
+ * dispatch is a table lookup and one indirect call.
+ */
+template <std::size_t N,
+          typename Handler = boost::beast::http::message_generator (*)(
+              boost::beast::http::request<boost::beast::http::string_body>&&)>
+class StaticRouter : public Respondent {
+public:
+  using request_type =
+      boost::beast::http::request<boost::beast::http::string_body>;
+
+private:
+  util::StaticRouteTable<N> routes_;
+  std::array<Handler, N> handlers_;
+  Handler not_found_;
+
+  StaticRouter(const util::StaticRouteTable<N>& routes,
+               std::array<Handler, N> handlers, Handler not_found)
+      : routes_{routes}, handlers_{std::move(handlers)},
+        not_found_{std::move(not_found)} {}
+
+  friend util::SharedProxy<StaticRouter>;
+
+public:
+  ~StaticRouter() = default;
+
+  /**
+   * @brief make_shared
+   * @param routes - constexpr route table
+   * @param handlers - handlers with the same order as routes' paths
+   * @param not_found - handler of unknown paths
+   */
+  static std::shared_ptr<StaticRouter>
+  make_shared(const util::StaticRouteTable<N>& routes,
+              std::array<Handler, N> handlers, Handler not_found) {
+    return std::make_shared<util::SharedProxy<StaticRouter>>(
+        routes, std::move(handlers), std::move(not_found));
+  }
+
+  /**
+   * @brief path_of - request target without query string
+   */
+  static constexpr std::string_view path_of(std::string_view target) noexcept {
+    return target.substr(0, target.find('?'));
+  }
+
+  boost::beast::http::message_generator
+  make_response(request_type&& request) override {
+    const auto target = request.target();
+    const auto idx = routes_.find(
+        path_of(std::string_view{std::data(target), std::size(target)}));
+
+    if (idx == routes_.npos) {
+      return std::invoke(not_found_, std::move(request));
+    }
+
+    return std::invoke(handlers_[idx], std::move(request));
+  }
+};
+
+} // namespace rest_in_beast
+
+#endif // REST_IN_BEAST_ROUTER_HPP
@@ -0,0 +1,315 @@
+//
+// Author: Dmitriy Gavryushin (https://github.com/Gawrjuschin)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#ifndef REST_IN_BEAST_RUNNER_HPP
+#define REST_IN_BEAST_RUNNER_HPP
+
+#include "util/shared_proxy.hpp"
+
+#include <boost/asio/executor_work_guard.hpp>
+#include <boost/asio/io_context.hpp>
+#include <boost/system/system_error.hpp>
+
+#if defined(__linux__)
+#include <linux/mempolicy.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#include <algorithm>
+#include <cerrno>
+#include <cstddef>
+#include <exception>
+#include <functional>
+#include <latch>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <stdexcept>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace rest_in_beast {
+
+/**
+ * @brief The RunnerOptions class - threads and their placement
+ */
+struct RunnerOptions {
+  std::size_t threads{std::thread::hardware_concurrency()};
+  // 1 - all threads run one shared io_context, threads - io_context per thread
+  std::size_t contexts{1};
+  // io_context's concurrency hint, 0 - number of threads running it
+  int concurrency_hint{};
+  // Thread i is pinned to cpus[i % size], empty - threads are not pinned
+  std::vector<unsigned> cpus{};
+  // Threads allocate from their NUMA node even if the process' policy differs
+  bool numa_local{};
+  // Called in every thread before it runs it's io_context: per-thread pools
+  // created here are allocated on the thread's node
+  std::function<void(std::size_t thread, boost::asio::io_context& io_ctx)>
+      thread_init{};
+};
+
+/**
+ * @brief The Runner class owns threads running one or several io_contexts.
+ * Thread i runs context i % contexts.
+ *
+ * Threads are pinned before anything else, each context is constructed by it's
+ * first thread: with Linux first-touch allocation reactor's and scheduler's
+ * memory lands on the node of the thread running it. Pin threads of one
+ * context to one node.
+ *
+ * Exception escaping io_context::run stops the runner and is rethrown by join.
+ */
+class Runner : public std::enable_shared_from_this<Runner> {
+  using work_guard =
+      boost::asio::executor_work_guard<boost::asio::io_context::executor_type>;
+
+  const RunnerOptions options_;
+  // Filled by threads before start returns
+  std::vector<std::unique_ptr<boost::asio::io_context>> contexts_;
+  std::vector<std::optional<work_guard>> guards_;
+  std::vector<std::thread> threads_;
+  // Threads and start wait for contexts, outlives the waiting threads
+  std::latch ready_;
+
+  std::mutex mutex_;
+  std::exception_ptr exception_{};
+
+  explicit Runner(RunnerOptions options)
+      : options_{normalize(std::move(options))},
+        contexts_(options_.contexts), guards_(options_.contexts),
+        ready_{static_cast<std::ptrdiff_t>(options_.threads) + 1} {}
+
+  friend util::SharedProxy<Runner>;
+
+  static RunnerOptions normalize(RunnerOptions options) {
+    options.threads = std::max<std::size_t>(options.threads, 1);
+    options.contexts =
+        std::clamp<std::size_t>(options.contexts, 1, options.threads);
+    return options;
+  }
+
+  /**
+   * @brief threads_per_context - threads running the context
+   */
+  std::size_t threads_per_context(std::size_t context) const noexcept {
+    return options_.threads / options_.contexts +
+           (context < options_.threads % options_.contexts ? 1 : 0);
+  }
+
+  /**
+   * @brief place pins the calling thread and sets it's memory policy
+   */
+  void place(std::size_t thread) const {
+#if defined(__linux__)
+    if (!std::empty(options_.cpus)) {
+      cpu_set_t set;
+      CPU_ZERO(&set);
+      CPU_SET(options_.cpus[thread % std::size(options_.cpus)], &set);
+      if (const int error =
+              ::pthread_setaffinity_np(::pthread_self(), sizeof(set), &set);
+          error != 0) {
+        throw boost::system::system_error{
+            error, boost::system::system_category(), "pthread_setaffinity_np"};
+      }
+    }
+#if defined(SYS_set_mempolicy)
+    // Without libnuma: MPOL_LOCAL overrides policy inherited from numactl
+    if (options_.numa_local &&
+        ::syscall(SYS_set_mempolicy, MPOL_LOCAL, nullptr, 0) != 0 &&
+        errno != ENOSYS) {
+      throw boost::system::system_error{
+          errno, boost::system::system_category(), "set_mempolicy"};
+    }
+#endif
+#else
+    (void)thread;
+#endif
+  }
+
+  void record(std::exception_ptr exception) {
+    const std::scoped_lock lock{mutex_};
+    if (!exception_) {
+      exception_ = std::move(exception);
+    }
+  }
+
+  void thread_body(std::size_t thread) {
+    const std::size_t context = thread % options_.contexts;
+    try {
+      place(thread);
+      if (thread == context) {
+        const int hint = options_.concurrency_hint != 0
+                             ? options_.concurrency_hint
+                             : static_cast<int>(threads_per_context(context));
+        contexts_[context] = std::make_unique<boost::asio::io_context>(hint);
+        guards_[context].emplace(contexts_[context]->get_executor());
+      }
+    } catch (...) {
+      record(std::current_exception());
+    }
+    ready_.arrive_and_wait();
+
+    // Failed start is rethrown by start
+    if (exception())
+      return;
+
+    try {
+      if (options_.thread_init) {
+        options_.thread_init(thread, *contexts_[context]);
+      }
+      contexts_[context]->run();
+    } catch (...) {
+      record(std::current_exception());
+      stop();
+    }
+  }
+
+  void do_start() {
+    threads_.reserve(options_.threads);
+    for (std::size_t thread{}; thread < options_.threads; ++thread) {
+      threads_.emplace_back([this, thread] { thread_body(thread); });
+    }
+    ready_.arrive_and_wait();
+
+    if (exception()) {
+      join();
+    }
+  }
+
+public:
+  Runner(const Runner&) = delete;
+  Runner& operator=(const Runner&) = delete;
+
+  Runner(Runner&&) = delete;
+  Runner& operator=(Runner&&) = delete;
+
+  /**
+   * @brief ~Runner stops and joins threads, exception is dropped
+   */
+  ~Runner() {
+    stop();
+    for (auto& thread : threads_) {
+      if (thread.joinable()) {
+        thread.join();
+      }
+    }
+  }
+
+  /**
+   * @brief start - starts threads and returns once contexts are constructed.
+   * Contexts run until stop even without work
+   * @throw boost::system::system_error if threads could not be placed
+   */
+  static std::shared_ptr<Runner> start(RunnerOptions options = {}) {
+    auto runner =
+        std::make_shared<util::SharedProxy<Runner>>(std::move(options));
+    runner->do_start();
+    return runner;
+  }
+
+  /**
+   * @brief cpus - CPUs the process may run on, for RunnerOptions::cpus
+   */
+  static std::vector<unsigned> cpus() {
+    std::vector<unsigned> result;
+#if defined(__linux__)
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    if (::sched_getaffinity(0, sizeof(set), &set) == 0) {
+      for (unsigned cpu{}; cpu < CPU_SETSIZE; ++cpu) {
+        if (CPU_ISSET(cpu, &set)) {
+          result.push_back(cpu);
+        }
+      }
+    }
+#endif
+    return result;
+  }
+
+  /**
+   * @brief numa_node - node of the CPU the calling thread runs on, -1 if
+   * unknown
+   */
+  static int numa_node() noexcept {
+#if defined(__linux__) && defined(SYS_getcpu)
+    unsigned cpu{};
+    unsigned node{};
+    if (::syscall(SYS_getcpu, &cpu, &node, nullptr) == 0)
+      return static_cast<int>(node);
+#endif
+    return -1;
+  }
+
+  const RunnerOptions& options() const noexcept { return options_; }
+
+  /**
+   * @brief size - number of contexts
+   */
+  std::size_t size() const noexcept { return std::size(contexts_); }
+
+  /**
+   * @brief context - io_context to start servers on
+   * @throw std::out_of_range
+   */
+  boost::asio::io_context& context(std::size_t idx = 0) {
+    return *contexts_.at(idx);
+  }
+
+  /**
+   * @brief stop - stops contexts, threads exit. Called from any thread
+   */
+  void stop() {
+    for (auto& io_ctx : contexts_) {
+      if (io_ctx) {
+        io_ctx->stop();
+      }
+    }
+  }
+
+  /**
+   * @brief release lets contexts stop once they run out of work
+   */
+  void release() {
+    for (auto& guard : guards_) {
+      if (guard) {
+        guard->reset();
+      }
+    }
+  }
+
+  /**
+   * @brief join waits for threads to exit and rethrows the first exception
+   * escaped any of them. Do not call from runner's threads
+   */
+  void join() {
+    for (auto& thread : threads_) {
+      if (thread.joinable()) {
+        thread.join();
+      }
+    }
+    if (auto exception = this->exception()) {
+      std::rethrow_exception(exception);
+    }
+  }
+
+  /**
+   * @brief exception - first exception escaped the threads
+   */
+  std::exception_ptr exception() {
+    const std::scoped_lock lock{mutex_};
+    return exception_;
+  }
+};
+
+} // namespace rest_in_beast
+
+#endif // REST_IN_BEAST_RUNNER_HPP
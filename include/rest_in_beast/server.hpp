@@ -15,13 +15,17 @@
 #define RESIN_IN_BEAST_SERVER_HPP
 
 #include "rest_in_beast/detail/session.hpp"
+#include "rest_in_beast/detail/session_group.hpp"
+#include "rest_in_beast/handoff.hpp"
 
 #include <boost/asio/dispatch.hpp>
 #include <boost/asio/io_context.hpp>
 #include <boost/asio/ip/address.hpp>
 #include <boost/asio/ip/tcp.hpp>
+#include <boost/asio/local/stream_protocol.hpp>
 #include <boost/asio/ssl.hpp>
 #include <boost/asio/ssl/context.hpp>
+#include <boost/asio/steady_timer.hpp>
 #include <boost/asio/strand.hpp>
 
 #include <boost/beast/core.hpp>
@@ -33,7 +37,15 @@
 #include <boost/beast/core/tcp_stream.hpp>
 #include <boost/beast/http.hpp>
 
+#include <boost/system/errc.hpp>
+
+#include <unistd.h>
+
+#include <cerrno>
+#include <chrono>
 #include <memory>
+#include <optional>
+#include <string>
 #include <utility>
 
 namespace rest_in_beast {
@@ -41,37 +53,144 @@ namespace rest_in_beast {
 namespace detail {
 /**
  * @brief The Server class is a template of server supports PlainSession,
- * SecureSession or DetectSSLSession sessions
+ * SecureSession or DetectSSLSession sessions.
+ *
+ * Sessions run in the server's io_context or, if the factory has a context
+ * pool, in the pool's context chosen for each accepted connection.
+ *
+ * Server is stopped by drain: accepting stops, sessions finish their current
+ * requests and the handler is called once all are closed. Listening socket may
+ * be handed off to the new process before the drain, so restart drops no
+ * connections
+ *
+ * SessionFactory has to provide start_session(tcp::socket&&) or
+ * start_session(tcp::socket&&, ConnectionContext). Sessions are drained only
+ * if they join the context's group. Shared pointers admission, context_pool,
+ * rate_limiter, metrics and lag_monitor are optional members, the server
+ * reads them only if the factory has them
  */
 template <typename SessionFactory>
 class Server : public std::enable_shared_from_this<Server<SessionFactory>> {
+  boost::asio::io_context& io_ctx_;
   boost::asio::ip::tcp::acceptor acceptor_;
   std::shared_ptr<Logger> logger_;
   SessionFactory session_factory_;
+  // Delays accepting while the loop lags, connections are at the limit or the
+  // process is out of descriptors
+  boost::asio::steady_timer pause_timer_;
+  // Open sessions, drained on stop
+  std::shared_ptr<SessionGroup> group_;
+  // Unix socket waiting for the process taking the listening socket over
+  std::optional<boost::asio::local::stream_protocol::acceptor> handoff_{};
+
+  // Accepting is retried after it when accept fails for lack of resources
+  static constexpr std::chrono::milliseconds resources_pause{100};
 
   /**
    * @brief Server constructor is private because Server class uses CRTP.
    * Use Server::start_server instead of creating any instance of Server
    * @param io_ctx
-   * @param endpoint
+   * @param acceptor - listening acceptor in it's own strand
    * @param logger
    * @param SessionFactory may be constructed with universal initialization
    * with requests_handler adjusted bu customer
    */
   Server(boost::asio::io_context& io_ctx,
-         const boost::asio::ip::tcp::endpoint& endpoint,
+         boost::asio::ip::tcp::acceptor acceptor,
          std::shared_ptr<Logger> logger, SessionFactory session_factory)
-      : acceptor_{boost::asio::make_strand(io_ctx), endpoint},
+      : io_ctx_{io_ctx}, acceptor_{std::move(acceptor)},
         logger_{std::move(logger)},
-        session_factory_{std::move(session_factory)} {}
+        session_factory_{std::move(session_factory)},
+        pause_timer_{acceptor_.get_executor()},
+        group_{SessionGroup::make_shared(acceptor_.get_executor())} {}
 
   friend struct util::SharedProxy<Server>;
   static std::shared_ptr<Server>
   make_shared(boost::asio::io_context& io_ctx,
-              const boost::asio::ip::tcp::endpoint& endpoint,
+              boost::asio::ip::tcp::acceptor acceptor,
               std::shared_ptr<Logger> logger, SessionFactory session_factory) {
     return std::make_shared<util::SharedProxy<Server>>(
-        io_ctx, endpoint, std::move(logger), std::move(session_factory));
+        io_ctx, std::move(acceptor), std::move(logger),
+        std::move(session_factory));
+  }
+
+  /**
+   * @brief adopt - acceptor of the listening socket received from another
+   * process
+   */
+  static boost::asio::ip::tcp::acceptor adopt(boost::asio::io_context& io_ctx,
+                                              listener_handle listener) {
+    sockaddr_storage address{};
+    socklen_t size{sizeof(address)};
+    if (::getsockname(listener, reinterpret_cast<sockaddr*>(&address),
+                      &size) != 0) {
+      throw boost::system::system_error{errno,
+                                        boost::system::system_category(),
+                                        "getsockname"};
+    }
+
+    boost::asio::ip::tcp::acceptor acceptor{boost::asio::make_strand(io_ctx)};
+    acceptor.assign(address.ss_family == AF_INET6
+                        ? boost::asio::ip::tcp::v6()
+                        : boost::asio::ip::tcp::v4(),
+                    listener);
+    return acceptor;
+  }
+
+  AdmissionControl* admission_control() const noexcept {
+    if constexpr (requires { session_factory_.admission; }) {
+      return session_factory_.admission.get();
+    } else {
+      return nullptr;
+    }
+  }
+
+  ContextPool* context_pool() const noexcept {
+    if constexpr (requires { session_factory_.context_pool; }) {
+      return session_factory_.context_pool.get();
+    } else {
+      return nullptr;
+    }
+  }
+
+  RateLimiter* rate_limiter() const noexcept {
+    if constexpr (requires { session_factory_.rate_limiter; }) {
+      return session_factory_.rate_limiter.get();
+    } else {
+      return nullptr;
+    }
+  }
+
+  Metrics* metrics() const noexcept {
+    if constexpr (requires { session_factory_.metrics; }) {
+      return session_factory_.metrics.get();
+    } else {
+      return nullptr;
+    }
+  }
+
+  LagMonitor* lag_monitor() const noexcept {
+    if constexpr (requires { session_factory_.lag_monitor; }) {
+      return session_factory_.lag_monitor.get();
+    } else {
+      return nullptr;
+    }
+  }
+
+  /**
+   * @brief start_session passes the connection's context to the factory if
+   * it takes one
+   */
+  void start_session(boost::asio::ip::tcp::socket&& peer,
+                     ConnectionContext&& connection) {
+    if constexpr (requires {
+                    session_factory_.start_session(std::move(peer),
+                                                   std::move(connection));
+                  }) {
+      session_factory_.start_session(std::move(peer), std::move(connection));
+    } else {
+      session_factory_.start_session(std::move(peer));
+    }
   }
 
 public:
@@ -89,30 +208,200 @@ public:
    * @param endpoint
    * @param logger
    * @param session_factory - custom object
+   * @return handle to drain the server
    */
-  static void start(boost::asio::io_context& io_ctx,
-                    const boost::asio::ip::tcp::endpoint& endpoint,
-                    std::shared_ptr<Logger> logger,
-                    SessionFactory session_factory) {
-    make_shared(io_ctx, endpoint, std::move(logger), std::move(session_factory))
-        ->do_accept();
+  static std::shared_ptr<Server>
+  start(boost::asio::io_context& io_ctx,
+        const boost::asio::ip::tcp::endpoint& endpoint,
+        std::shared_ptr<Logger> logger, SessionFactory session_factory) {
+    auto server = make_shared(
+        io_ctx,
+        boost::asio::ip::tcp::acceptor{boost::asio::make_strand(io_ctx),
+                                       endpoint},
+        std::move(logger), std::move(session_factory));
+    server->do_accept();
+    return server;
   }
 
+  /**
+   * @brief start - starts server on the listening socket received with
+   * receive_listener. Server owns the socket
+   * @return handle to drain the server
+   */
+  static std::shared_ptr<Server> start(boost::asio::io_context& io_ctx,
+                                       listener_handle listener,
+                                       std::shared_ptr<Logger> logger,
+                                       SessionFactory session_factory) {
+    auto server = make_shared(io_ctx, adopt(io_ctx, listener),
+                              std::move(logger), std::move(session_factory));
+    server->do_accept();
+    return server;
+  }
+
+  /**
+   * @brief drain stops accepting and closes sessions: waiting ones at once,
+   * serving ones after their responses. Called from any thread
+   * @param deadline - sessions still open after it are closed forcibly
+   * @param handler - called once all sessions are closed
+   */
+  void drain(std::chrono::steady_clock::duration deadline,
+             drain_handler handler) {
+    boost::asio::dispatch(
+        acceptor_.get_executor(),
+        [self = this->shared_from_this(), deadline,
+         handler = std::move(handler)]() mutable {
+          self->do_drain(deadline, std::move(handler));
+        });
+  }
+
+  /**
+   * @brief handoff waits for the new process on the Unix socket path, sends
+   * it the listening socket and drains. Both processes accept from the same
+   * socket until the drain, so connections in the backlog are not dropped.
+   * Called from any thread
+   * @param path - Unix socket path, the existing file is replaced
+   * @param deadline - deadline of the drain
+   * @param handler - called once the drain is over or with the error if the
+   * socket is not handed off: already_started if the server is handing off or
+   * draining
+   */
+  void handoff(std::string path, std::chrono::steady_clock::duration deadline,
+               drain_handler handler) {
+    boost::asio::dispatch(
+        acceptor_.get_executor(),
+        [self = this->shared_from_this(), path = std::move(path), deadline,
+         handler = std::move(handler)]() mutable {
+          self->do_handoff(std::move(path), deadline, std::move(handler));
+        });
+  }
+
+  /**
+   * @brief sessions - number of open sessions
+   */
+  std::size_t sessions() const { return group_->size(); }
+
 private:
   /**
    * @brief on_accept starts new session
+   * @param context - index of the peer's io_context in the context pool
    * @param ec
    * @param peer - incoming connection (tcp socket)
    */
-  void on_accept(boost::beast::error_code ec,
+  void on_accept(std::size_t context, boost::beast::error_code ec,
                  boost::asio::ip::tcp::socket peer) {
+    // Accepting is stopped by drain
+    if (ec == boost::asio::error::operation_aborted && !acceptor_.is_open())
+      return;
+
     if (ec) {
-      return logger_->log("Server", "on_accept", ec);
+      logger_->log("Server", "on_accept", ec);
+      // Out of descriptors or memory: connections wait in the backlog until
+      // sessions are closed
+      if (ec == boost::asio::error::no_descriptors ||
+          ec == boost::system::errc::too_many_files_open_in_system ||
+          ec == boost::asio::error::no_buffer_space ||
+          ec == boost::asio::error::no_memory) {
+        return pause_accept(resources_pause);
+      }
+      return;
+    }
+
+    ConnectionContext connection{.group = group_};
+    if (admission_control()) {
+      connection.admission = admit(peer);
+      if (!connection.admission) {
+        return do_accept_unless_paused();
+      }
+    }
+
+    if (auto* pool = context_pool()) {
+      connection.lease = pool->lease(context);
+    }
+
+    if (auto* limiter = rate_limiter()) {
+      boost::beast::error_code endpoint_ec;
+      const auto endpoint = peer.remote_endpoint(endpoint_ec);
+      if (!endpoint_ec) {
+        connection.limiter = limiter->client(endpoint.address());
+      }
+    }
+
+    if (auto* server_metrics = metrics()) {
+      const auto start = Metrics::clock::now();
+      start_session(std::move(peer), std::move(connection));
+      server_metrics->record(Metrics::Phase::accept, start);
     } else {
-      session_factory_.start_session(std::move(peer));
+      start_session(std::move(peer), std::move(connection));
+    }
+
+    do_accept_unless_paused();
+  }
+
+  /**
+   * @brief admit takes admission of the peer or resets it: zero linger makes
+   * close send RST instead of the orderly shutdown, no response is written
+   */
+  AdmissionControl::Ticket admit(boost::asio::ip::tcp::socket& peer) {
+    boost::beast::error_code ec;
+    const auto endpoint = peer.remote_endpoint(ec);
+    if (!ec) {
+      auto ticket = admission_control()->admit(endpoint.address());
+      if (ticket)
+        return ticket;
+    }
+
+    if (auto* server_metrics = metrics()) {
+      server_metrics->add(Metrics::Counter::connections_rejected);
+    }
+    peer.set_option(boost::asio::socket_base::linger{true, 0}, ec);
+    peer.close(ec);
+    return {};
+  }
+
+  /**
+   * @brief pause_interval - period of re-checking if accepting is paused:
+   * connections are at the admission limit or the io_context lags above the
+   * monitor's pause_lag. Paused server leaves connections in the listen
+   * backlog, so the loop does not take more work than it is able to serve
+   */
+  std::optional<std::chrono::milliseconds> pause_interval() const noexcept {
+    const auto* admission = admission_control();
+    if (admission && admission->full()) {
+      return admission->options().pause_interval;
+    }
+
+    const auto* monitor = lag_monitor();
+    if (monitor && monitor->paused()) {
+      return monitor->options().interval;
+    }
+    return std::nullopt;
+  }
+
+  void do_accept_unless_paused() {
+    if (!acceptor_.is_open())
+      return;
+
+    const auto interval = pause_interval();
+    if (!interval) {
+      return do_accept();
     }
+    pause_accept(*interval);
+  }
 
-    do_accept();
+  /**
+   * @brief pause_accept re-checks accepting after the interval
+   */
+  void pause_accept(std::chrono::milliseconds interval) {
+    pause_timer_.expires_after(interval);
+    pause_timer_.async_wait(
+        [self = this->shared_from_this()](boost::beast::error_code ec) {
+          if (ec == boost::asio::error::operation_aborted)
+            return;
+          if (ec) {
+            return self->logger_->log("Server", "on_pause", ec);
+          }
+          self->do_accept_unless_paused();
+        });
   }
 
   /**
@@ -120,13 +409,93 @@ private:
    * incoming connection in new strand
    */
   void do_accept() {
+    // Context of the next connection is chosen before it is accepted: the
+    // socket is created in it
+    auto* pool = context_pool();
+    std::size_t context{};
+    if (pool) {
+      context = pool->pick();
+    }
+
     acceptor_.async_accept(
-        boost::asio::make_strand(
-            acceptor_.get_executor()), // Create separate strand for incoming
-                                       // connection. New session MUST switch to
-                                       // it new strand
+        // Create separate strand for incoming connection. New session MUST
+        // switch to it new strand. Strand is made over io_context's executor,
+        // not over acceptor's strand: nested strands make every executor copy
+        // of the session's operations allocate
+        boost::asio::make_strand(pool ? pool->context(context) : io_ctx_),
         boost::beast::bind_front_handler(&Server<SessionFactory>::on_accept,
-                                         this->shared_from_this()));
+                                         this->shared_from_this(), context));
+  }
+
+  void do_drain(std::chrono::steady_clock::duration deadline,
+                drain_handler handler) {
+    boost::beast::error_code ec;
+    acceptor_.close(ec);
+    pause_timer_.cancel();
+    if (handoff_) {
+      handoff_->close(ec);
+      handoff_.reset();
+    }
+
+    group_->drain(deadline, std::move(handler));
+  }
+
+  void do_handoff(std::string path,
+                  std::chrono::steady_clock::duration deadline,
+                  drain_handler handler) {
+    // Second handoff would cancel the pending one's accept
+    if (handoff_ || !acceptor_.is_open())
+      return handler(boost::asio::error::already_started);
+
+    ::unlink(path.c_str());
+    const boost::asio::local::stream_protocol::endpoint endpoint{path};
+    boost::beast::error_code ec;
+    handoff_.emplace(acceptor_.get_executor());
+    handoff_->open(endpoint.protocol(), ec);
+    if (!ec) {
+      handoff_->bind(endpoint, ec);
+    }
+    if (!ec) {
+      handoff_->listen(1, ec);
+    }
+    if (ec) {
+      handoff_.reset();
+      logger_->log("Server", "do_handoff", ec);
+      return handler(ec);
+    }
+
+    handoff_->async_accept(
+        [self = this->shared_from_this(), deadline,
+         handler = std::move(handler)](
+            boost::beast::error_code ec,
+            boost::asio::local::stream_protocol::socket channel) mutable {
+          self->on_handoff(ec, std::move(channel), deadline,
+                           std::move(handler));
+        });
+  }
+
+  /**
+   * @brief on_handoff sends the listening socket to the connected process and
+   * drains the server. Server keeps serving if the socket is not sent
+   */
+  void on_handoff(boost::beast::error_code ec,
+                  boost::asio::local::stream_protocol::socket channel,
+                  std::chrono::steady_clock::duration deadline,
+                  drain_handler handler) {
+    // Handoff is cancelled by drain
+    if (!handoff_)
+      return handler(boost::asio::error::operation_aborted);
+
+    handoff_.reset();
+    if (!ec) {
+      ec = send_listener(channel.native_handle(), acceptor_.native_handle());
+    }
+    if (ec) {
+      logger_->log("Server", "on_handoff", ec);
+      return handler(ec);
+    }
+
+    do_drain(deadline, std::move(handler));
   }
 };
 
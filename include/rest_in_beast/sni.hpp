@@ -0,0 +1,296 @@
+//
+// Author: Dmitriy Gavryushin (https://github.com/Gawrjuschin)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#ifndef REST_IN_BEAST_SNI_HPP
+#define REST_IN_BEAST_SNI_HPP
+
+#include "detail/ssl_context.hpp"
+#include "util/flat_map.hpp"
+#include "util/shared_proxy.hpp"
+
+#include <boost/asio/detail/throw_error.hpp>
+#include <boost/asio/ssl/context.hpp>
+#include <boost/asio/ssl/error.hpp>
+#include <boost/system/error_code.hpp>
+
+#include <openssl/err.h>
+#include <openssl/ssl.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace rest_in_beast {
+
+/**
+ * @brief The SniHost class binds host name or wildcard ("*.example.com"
+ * matches exactly one label) to it's pre-built context
+ */
+struct SniHost {
+  std::string name;
+  std::shared_ptr<boost::asio::ssl::context> ssl_ctx;
+};
+
+/**
+ * @brief The SniContexts class installs Server Name Indication on server's
+ * context: handshake switches to the context of requested host, unknown hosts
+ * and clients without SNI get server's context.
+ *
+ * Lookup is lock-free: handshakes read the current immutable table, reload
+ * publishes new table and frees the previous one when handshakes leave it.
+ * Established connections keep their contexts alive.
+ *
+ * Only certificate and key are taken from host's context, other settings come
+ * from server's one. Session resumption and info callback of server's context
+ * serve connections of all hosts.
+ */
+class SniContexts {
+public:
+  using hosts_type = std::vector<SniHost>;
+
+  /**
+   * @brief The Metrics class counts server name lookups
+   */
+  struct Metrics {
+    std::atomic<std::uint64_t> exact_matches{};
+    std::atomic<std::uint64_t> wildcard_matches{};
+    // Unknown host or no SNI: server's context
+    std::atomic<std::uint64_t> default_matches{};
+    std::atomic<std::uint64_t> reloads{};
+  };
+
+private:
+  using context_ptr = std::shared_ptr<boost::asio::ssl::context>;
+
+  // RFC 1035 limit of the domain name
+  static constexpr std::size_t max_name_size{255};
+
+  struct Table {
+    util::FlatMap<std::string, context_ptr> exact;
+    // Suffix after "*." to it's context
+    util::FlatMap<std::string, context_ptr> wildcard;
+  };
+
+  Metrics metrics_{};
+
+  // Current table is read by handshakes. Readers register in the counter of
+  // the epoch, reload waits for the readers of the previous epoch before
+  // freeing the previous table
+  std::atomic<const Table*> table_{};
+  std::atomic<std::size_t> epoch_{};
+  std::atomic<std::size_t> readers_[2]{};
+
+  std::mutex reload_mutex_;
+  std::unique_ptr<const Table> owned_table_{};
+
+  SniContexts() = default;
+
+  friend util::SharedProxy<SniContexts>;
+
+  static void throw_ssl_error(const char* location) {
+    const boost::system::error_code ec{static_cast<int>(::ERR_get_error()),
+                                       boost::asio::error::get_ssl_category()};
+    boost::asio::detail::throw_error(ec, location);
+  }
+
+  static void free_context_ex_data(void*, void* ptr, CRYPTO_EX_DATA*, int,
+                                   long, void*) {
+    delete static_cast<std::shared_ptr<SniContexts>*>(ptr);
+  }
+
+  static void free_connection_ex_data(void*, void* ptr, CRYPTO_EX_DATA*, int,
+                                      long, void*) {
+    delete static_cast<context_ptr*>(ptr);
+  }
+
+  static int context_index() {
+    static const int index = ::SSL_CTX_get_ex_new_index(
+        0, nullptr, nullptr, nullptr, free_context_ex_data);
+    return index;
+  }
+
+  // Host's context of the connection, released with the connection
+  static int connection_index() {
+    static const int index = ::SSL_get_ex_new_index(
+        0, nullptr, nullptr, nullptr, free_connection_ex_data);
+    return index;
+  }
+
+  /**
+   * @brief normalize - lower case without trailing dot
+   * @return empty view if name is not a host name
+   */
+  static std::string_view normalize(std::string_view name, char* out) noexcept {
+    if (!std::empty(name) && name.back() == '.') {
+      name.remove_suffix(1);
+    }
+    if (std::empty(name) || std::size(name) > max_name_size)
+      return {};
+
+    std::transform(std::begin(name), std::end(name), out, [](char c) {
+      return c >= 'A' && c <= 'Z' ? static_cast<char>(c - 'A' + 'a') : c;
+    });
+    return {out, std::size(name)};
+  }
+
+  static std::unique_ptr<const Table> build(const hosts_type& hosts) {
+    auto table = std::make_unique<Table>();
+    table->exact.reserve(std::size(hosts));
+    table->wildcard.reserve(std::size(hosts));
+
+    char buffer[max_name_size];
+    for (const auto& host : hosts) {
+      auto name = normalize(host.name, buffer);
+      if (std::empty(name) || !host.ssl_ctx)
+        continue;
+
+      if (name.starts_with("*.")) {
+        name.remove_prefix(2);
+        table->wildcard.try_emplace(std::string{name}, host.ssl_ctx);
+      } else {
+        table->exact.try_emplace(std::string{name}, host.ssl_ctx);
+      }
+    }
+    return table;
+  }
+
+  /**
+   * @brief find - context of the host, nullptr for server's one
+   */
+  const context_ptr* find(const Table& table, std::string_view name) {
+    if (const auto it = table.exact.find(name); it != std::end(table.exact)) {
+      metrics_.exact_matches.fetch_add(1, std::memory_order_relaxed);
+      return &it->second;
+    }
+
+    if (const auto dot = name.find('.'); dot != std::string_view::npos) {
+      const auto it = table.wildcard.find(name.substr(dot + 1));
+      if (it != std::end(table.wildcard)) {
+        metrics_.wildcard_matches.fetch_add(1, std::memory_order_relaxed);
+        return &it->second;
+      }
+    }
+
+    metrics_.default_matches.fetch_add(1, std::memory_order_relaxed);
+    return nullptr;
+  }
+
+  static int on_server_name(SSL* ssl, int*, void* arg) {
+    auto* self = static_cast<SniContexts*>(arg);
+
+    char buffer[max_name_size];
+    const char* requested =
+        ::SSL_get_servername(ssl, TLSEXT_NAMETYPE_host_name);
+    const auto name =
+        requested ? normalize(requested, buffer) : std::string_view{};
+    if (std::empty(name)) {
+      self->metrics_.default_matches.fetch_add(1, std::memory_order_relaxed);
+      return SSL_TLSEXT_ERR_OK;
+    }
+
+    // Register in the epoch which can't pass while the table is read
+    std::size_t epoch{};
+    do {
+      epoch = self->epoch_.load();
+      self->readers_[epoch % 2].fetch_add(1);
+      if (self->epoch_.load() == epoch)
+        break;
+      self->readers_[epoch % 2].fetch_sub(1);
+    } while (true);
+
+    int result{SSL_TLSEXT_ERR_OK};
+    if (const auto* ssl_ctx = self->find(*self->table_.load(), name)) {
+      // Callback is repeated after HelloRetryRequest
+      auto* previous = static_cast<context_ptr*>(
+          ::SSL_get_ex_data(ssl, connection_index()));
+      auto* owner = new context_ptr{*ssl_ctx};
+      if (!detail::switch_context(ssl, (*ssl_ctx)->native_handle()) ||
+          ::SSL_set_ex_data(ssl, connection_index(), owner) != 1) {
+        delete owner;
+        result = SSL_TLSEXT_ERR_ALERT_FATAL;
+      } else {
+        delete previous;
+      }
+    }
+
+    self->readers_[epoch % 2].fetch_sub(1);
+    return result;
+  }
+
+public:
+  SniContexts(const SniContexts&) = delete;
+  SniContexts& operator=(const SniContexts&) = delete;
+
+  SniContexts(SniContexts&&) = delete;
+  SniContexts& operator=(SniContexts&&) = delete;
+
+  ~SniContexts() = default;
+
+  /**
+   * @brief install - configures SNI of server's context. Call it before the
+   * server is started
+   * @param ssl_ctx - server's context, owns installed object
+   * @param hosts - host names and wildcards with their contexts
+   * @return installed object
+   */
+  static std::shared_ptr<SniContexts>
+  install(boost::asio::ssl::context& ssl_ctx, const hosts_type& hosts) {
+    auto self = std::make_shared<util::SharedProxy<SniContexts>>();
+    self->owned_table_ = build(hosts);
+    self->table_.store(self->owned_table_.get());
+
+    SSL_CTX* ctx = ssl_ctx.native_handle();
+
+    // Context owns the copy of pointer, it's freed with the context
+    auto* previous = static_cast<std::shared_ptr<SniContexts>*>(
+        ::SSL_CTX_get_ex_data(ctx, context_index()));
+    auto* owner = new std::shared_ptr<SniContexts>{self};
+    if (::SSL_CTX_set_ex_data(ctx, context_index(), owner) != 1) {
+      delete owner;
+      throw_ssl_error("SniContexts::install");
+    }
+    delete previous;
+
+    ::SSL_CTX_set_tlsext_servername_callback(ctx, &SniContexts::on_server_name);
+    ::SSL_CTX_set_tlsext_servername_arg(ctx, self.get());
+
+    return self;
+  }
+
+  /**
+   * @brief reload - atomically replaces hosts. Handshakes in progress finish
+   * with the previous table, established connections are not affected
+   */
+  void reload(const hosts_type& hosts) {
+    auto table = build(hosts);
+
+    const std::scoped_lock lock{reload_mutex_};
+    table_.store(table.get());
+
+    const std::size_t previous_epoch = epoch_.fetch_add(1);
+    while (readers_[previous_epoch % 2].load() != 0) {
+      std::this_thread::yield();
+    }
+
+    owned_table_ = std::move(table);
+    metrics_.reloads.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  const Metrics& metrics() const noexcept { return metrics_; }
+};
+
+} // namespace rest_in_beast
+
+#endif // REST_IN_BEAST_SNI_HPP
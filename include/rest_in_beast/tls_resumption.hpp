@@ -0,0 +1,539 @@
+//
+// Author: Dmitriy Gavryushin (https://github.com/Gawrjuschin)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#ifndef REST_IN_BEAST_TLS_RESUMPTION_HPP
+#define REST_IN_BEAST_TLS_RESUMPTION_HPP
+
+#include "detail/ssl_context.hpp"
+#include "util/flat_map.hpp"
+#include "util/hasher.hpp"
+#include "util/shared_proxy.hpp"
+
+#include <boost/asio/detail/throw_error.hpp>
+#include <boost/asio/ssl/context.hpp>
+#include <boost/asio/ssl/error.hpp>
+#include <boost/system/error_code.hpp>
+
+#include <openssl/err.h>
+#include <openssl/evp.h>
+#include <openssl/rand.h>
+#include <openssl/ssl.h>
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+#include <openssl/core_names.h>
+#include <openssl/params.h>
+#else
+#include <openssl/hmac.h>
+#endif
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace rest_in_beast {
+
+/**
+ * @brief The TlsResumptionSettings class configures server-side TLS session
+ * resumption
+ */
+struct TlsResumptionSettings {
+  // Sessions kept in the in-process cache, 0 disables the cache
+  std::size_t cache_capacity{20'480};
+  // Independently locked parts of the cache
+  std::size_t cache_shards{16};
+  // Lifetime of cached sessions and tickets
+  std::chrono::seconds session_timeout{7'200};
+  // Stateless session tickets, TLSv1.3 uses stateful tickets (the cache) if
+  // disabled
+  bool enable_tickets{true};
+  // Period of ticket key rotation
+  std::chrono::seconds ticket_key_rotation{3'600};
+  // Previous ticket keys still accepted for decryption. Tickets decrypted with
+  // them are renewed with the current key
+  std::size_t previous_ticket_keys{2};
+  // Session id context, sessions are resumed only with the same context
+  std::string_view session_id_context{"rest_in_beast"};
+};
+
+/**
+ * @brief The TlsResumption class installs server-side session resumption on
+ * shared ssl::context: an in-process sharded session cache and stateless
+ * session tickets with rotating keys. Handshakes done with the context are
+ * counted as full or resumed ones.
+ *
+ * The context owns installed TlsResumption, the returned pointer is for
+ * metrics and manual key rotation.
+ */
+class TlsResumption {
+public:
+  /**
+   * @brief The Metrics class counts completed handshakes
+   */
+  struct Metrics {
+    std::atomic<std::uint64_t> full_handshakes{};
+    std::atomic<std::uint64_t> resumed_handshakes{};
+  };
+
+private:
+  static constexpr std::size_t key_name_size{16};
+  static constexpr std::size_t aes_key_size{32};
+  static constexpr std::size_t hmac_key_size{32};
+
+  struct TicketKey {
+    unsigned char name[key_name_size];
+    unsigned char aes_key[aes_key_size];
+    unsigned char hmac_key[hmac_key_size];
+  };
+
+  struct Slot {
+    std::string id;
+    std::vector<unsigned char> der;
+  };
+
+  /**
+   * @brief The Shard class is a part of session cache: fixed ring of DER
+   * encoded sessions indexed by session id. New session replaces the oldest
+   * one and reuses it's buffer
+   */
+  struct Shard {
+    std::mutex mutex;
+    util::FlatMap<std::string, std::size_t> index;
+    std::vector<Slot> slots;
+    std::size_t next{};
+  };
+
+  TlsResumptionSettings settings_;
+  Metrics metrics_{};
+  // Info callback of the context replaced on install
+  void (*previous_info_)(const SSL*, int, int){};
+
+  std::vector<Shard> shards_;
+
+  mutable std::shared_mutex keys_mutex_;
+  std::deque<TicketKey> keys_; // front is the current key
+  std::atomic<std::chrono::steady_clock::rep> next_rotation_{};
+
+  TlsResumption(TlsResumptionSettings settings)
+      : settings_{settings},
+        shards_(settings_.cache_capacity == 0
+                    ? 0
+                    : std::max<std::size_t>(settings_.cache_shards, 1)) {
+    const std::size_t shard_capacity =
+        std::empty(shards_)
+            ? 0
+            : (settings_.cache_capacity + std::size(shards_) - 1) /
+                  std::size(shards_);
+    for (auto& shard : shards_) {
+      shard.slots.resize(shard_capacity);
+      shard.index.reserve(shard_capacity);
+    }
+
+    if (settings_.enable_tickets) {
+      rotate_ticket_keys();
+    }
+  }
+
+  friend util::SharedProxy<TlsResumption>;
+
+  // Failures like RAND_bytes' may leave no error in the queue
+  static void throw_ssl_error(const char* location) {
+    const auto error = ::ERR_get_error();
+    const boost::system::error_code ec =
+        error != 0
+            ? boost::system::error_code{static_cast<int>(error),
+                                        boost::asio::error::get_ssl_category()}
+            : boost::asio::ssl::error::unspecified_system_error;
+    boost::asio::detail::throw_error(ec, location);
+  }
+
+  static void free_ex_data(void*, void* ptr, CRYPTO_EX_DATA*, int, long,
+                           void*) {
+    delete static_cast<std::shared_ptr<TlsResumption>*>(ptr);
+  }
+
+  static int context_index() {
+    static const int index =
+        ::SSL_CTX_get_ex_new_index(0, nullptr, nullptr, nullptr, free_ex_data);
+    return index;
+  }
+
+  static int counted_index() {
+    static const int index =
+        ::SSL_get_ex_new_index(0, nullptr, nullptr, nullptr, nullptr);
+    return index;
+  }
+
+  // Owner is installed on server's context, SNI may switch the connection to
+  // host's one
+  static TlsResumption* from(const SSL* ssl) {
+    const auto* owner = static_cast<std::shared_ptr<TlsResumption>*>(
+        ::SSL_CTX_get_ex_data(detail::accepted_context(ssl), context_index()));
+    return owner ? owner->get() : nullptr;
+  }
+
+  static std::string_view id_of(const unsigned char* id,
+                                unsigned int length) noexcept {
+    return {reinterpret_cast<const char*>(id), length};
+  }
+
+  Shard& shard_of(std::string_view id) noexcept {
+    // Seed differs from the one of FlatMap to spread ids across shards
+    // independently from slots of shard's index
+    return shards_[util::hash_bytes(id, std::size(shards_)) %
+                   std::size(shards_)];
+  }
+
+  // ~~~
+  // Session cache
+  // ~~~
+  void store(std::string_view id, SSL_SESSION* session) {
+    const int length = ::i2d_SSL_SESSION(session, nullptr);
+    if (length <= 0)
+      return;
+
+    auto& shard = shard_of(id);
+    const std::scoped_lock lock{shard.mutex};
+
+    std::size_t pos{};
+    if (const auto it = shard.index.find(id); it != std::end(shard.index)) {
+      pos = it->second;
+    } else {
+      pos = shard.next;
+      shard.next = (shard.next + 1) % std::size(shard.slots);
+
+      auto& slot = shard.slots[pos];
+      if (!std::empty(slot.id)) {
+        shard.index.erase(slot.id);
+      }
+      slot.id.assign(id);
+      shard.index.emplace(slot.id, pos);
+    }
+
+    auto& der = shard.slots[pos].der;
+    der.resize(static_cast<std::size_t>(length));
+    unsigned char* out = std::data(der);
+    ::i2d_SSL_SESSION(session, &out);
+  }
+
+  SSL_SESSION* load(std::string_view id) {
+    auto& shard = shard_of(id);
+    const std::scoped_lock lock{shard.mutex};
+
+    const auto it = shard.index.find(id);
+    if (it == std::end(shard.index))
+      return nullptr;
+
+    const auto& der = shard.slots[it->second].der;
+    const unsigned char* in = std::data(der);
+    return ::d2i_SSL_SESSION(nullptr, &in, static_cast<long>(std::size(der)));
+  }
+
+  void remove(std::string_view id) {
+    auto& shard = shard_of(id);
+    const std::scoped_lock lock{shard.mutex};
+
+    const auto it = shard.index.find(id);
+    if (it == std::end(shard.index))
+      return;
+
+    auto& slot = shard.slots[it->second];
+    shard.index.erase(id);
+    slot.id.clear();
+    slot.der.clear();
+  }
+
+  // Exceptions must not leave OpenSSL's callbacks: session which fails to be
+  // stored or loaded is not cached
+  static int on_new_session(SSL* ssl, SSL_SESSION* session) {
+    unsigned int length{};
+    const unsigned char* id = ::SSL_SESSION_get_id(session, &length);
+    if (auto* self = from(ssl)) {
+      try {
+        self->store(id_of(id, length), session);
+      } catch (...) {
+      }
+    }
+    // Session is not referenced by the cache
+    return 0;
+  }
+
+  static SSL_SESSION* on_get_session(SSL* ssl, const unsigned char* id,
+                                     int length, int* copy) {
+    *copy = 0;
+    auto* self = from(ssl);
+    if (self == nullptr)
+      return nullptr;
+
+    try {
+      return self->load(id_of(id, static_cast<unsigned int>(length)));
+    } catch (...) {
+      return nullptr;
+    }
+  }
+
+  static void on_remove_session(SSL_CTX* ctx, SSL_SESSION* session) {
+    const auto* owner = static_cast<std::shared_ptr<TlsResumption>*>(
+        ::SSL_CTX_get_ex_data(ctx, context_index()));
+    if (owner == nullptr)
+      return;
+
+    unsigned int length{};
+    const unsigned char* id = ::SSL_SESSION_get_id(session, &length);
+    (*owner)->remove(id_of(id, length));
+  }
+
+  // ~~~
+  // Session tickets
+  // ~~~
+  void rotate_if_needed() {
+    const auto now = std::chrono::steady_clock::now().time_since_epoch();
+    if (now.count() < next_rotation_.load(std::memory_order_relaxed))
+      return;
+
+    const std::unique_lock lock{keys_mutex_};
+    // Other thread may have rotated keys already
+    if (now.count() < next_rotation_.load(std::memory_order_relaxed))
+      return;
+
+    rotate_locked();
+  }
+
+  void rotate_locked() {
+    TicketKey key{};
+    if (::RAND_bytes(key.name, sizeof(key.name)) != 1 ||
+        ::RAND_bytes(key.aes_key, sizeof(key.aes_key)) != 1 ||
+        ::RAND_bytes(key.hmac_key, sizeof(key.hmac_key)) != 1) {
+      throw_ssl_error("TlsResumption::rotate_ticket_keys");
+    }
+
+    keys_.push_front(key);
+    while (std::size(keys_) > settings_.previous_ticket_keys + 1) {
+      keys_.pop_back();
+    }
+
+    const auto rotation =
+        std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+            settings_.ticket_key_rotation);
+    next_rotation_.store(
+        (std::chrono::steady_clock::now().time_since_epoch() + rotation)
+            .count(),
+        std::memory_order_relaxed);
+  }
+
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+  using mac_context = EVP_MAC_CTX;
+
+  static bool init_mac(mac_context* mac_ctx, const TicketKey& key) {
+    OSSL_PARAM params[] = {
+        ::OSSL_PARAM_construct_utf8_string(OSSL_MAC_PARAM_DIGEST,
+                                           const_cast<char*>("SHA256"), 0),
+        ::OSSL_PARAM_construct_end()};
+    return ::EVP_MAC_init(mac_ctx, key.hmac_key, sizeof(key.hmac_key),
+                          params) == 1;
+  }
+#else
+  using mac_context = HMAC_CTX;
+
+  static bool init_mac(mac_context* mac_ctx, const TicketKey& key) {
+    return ::HMAC_Init_ex(mac_ctx, key.hmac_key, sizeof(key.hmac_key),
+                          ::EVP_sha256(), nullptr) == 1;
+  }
+#endif
+
+  /**
+   * @brief on_ticket_key encrypts new tickets with the current key and
+   * decrypts received tickets with the current or previous keys. Exceptions
+   * must not leave OpenSSL's callback: failed key rotation issues no ticket,
+   * since error (-1) would abort the handshake
+   * @return 1 - ticket is encrypted or decrypted, 2 - ticket is decrypted and
+   * must be renewed, 0 - unknown key: full handshake or no ticket is issued,
+   * -1 - error
+   */
+  static int on_ticket_key(SSL* ssl, unsigned char* key_name,
+                           unsigned char* iv, EVP_CIPHER_CTX* cipher_ctx,
+                           mac_context* mac_ctx, int encrypt) {
+    try {
+      return ticket_key(ssl, key_name, iv, cipher_ctx, mac_ctx, encrypt);
+    } catch (...) {
+      return 0;
+    }
+  }
+
+  static int ticket_key(SSL* ssl, unsigned char* key_name, unsigned char* iv,
+                        EVP_CIPHER_CTX* cipher_ctx, mac_context* mac_ctx,
+                        int encrypt) {
+    auto* self = from(ssl);
+    if (self == nullptr)
+      return 0;
+
+    if (encrypt) {
+      self->rotate_if_needed();
+
+      const std::shared_lock lock{self->keys_mutex_};
+      const auto& key = self->keys_.front();
+      std::copy_n(key.name, key_name_size, key_name);
+
+      if (::RAND_bytes(iv, ::EVP_CIPHER_iv_length(::EVP_aes_256_cbc())) != 1 ||
+          ::EVP_EncryptInit_ex(cipher_ctx, ::EVP_aes_256_cbc(), nullptr,
+                               key.aes_key, iv) != 1 ||
+          !init_mac(mac_ctx, key)) {
+        return -1;
+      }
+      return 1;
+    }
+
+    const std::shared_lock lock{self->keys_mutex_};
+    const auto key_it = std::find_if(
+        std::cbegin(self->keys_), std::cend(self->keys_),
+        [key_name](const TicketKey& key) {
+          return std::equal(key.name, key.name + key_name_size, key_name);
+        });
+    if (key_it == std::cend(self->keys_))
+      return 0;
+
+    if (::EVP_DecryptInit_ex(cipher_ctx, ::EVP_aes_256_cbc(), nullptr,
+                             key_it->aes_key, iv) != 1 ||
+        !init_mac(mac_ctx, *key_it)) {
+      return -1;
+    }
+    return key_it == std::cbegin(self->keys_) ? 1 : 2;
+  }
+
+  // ~~~
+  // Metrics
+  // ~~~
+  static void on_info(const SSL* ssl, int where, int ret) {
+    auto* self = from(ssl);
+    if (self && self->previous_info_) {
+      self->previous_info_(ssl, where, ret);
+    }
+    if (self == nullptr || !(where & SSL_CB_HANDSHAKE_DONE))
+      return;
+
+    // TLSv1.3 reports post-handshake messages as handshakes too
+    auto* mutable_ssl = const_cast<SSL*>(ssl);
+    if (::SSL_get_ex_data(mutable_ssl, counted_index()) != nullptr)
+      return;
+    ::SSL_set_ex_data(mutable_ssl, counted_index(), mutable_ssl);
+
+    auto& counter = ::SSL_session_reused(mutable_ssl)
+                        ? self->metrics_.resumed_handshakes
+                        : self->metrics_.full_handshakes;
+    counter.fetch_add(1, std::memory_order_relaxed);
+  }
+
+public:
+  TlsResumption(const TlsResumption&) = delete;
+  TlsResumption& operator=(const TlsResumption&) = delete;
+
+  TlsResumption(TlsResumption&&) = delete;
+  TlsResumption& operator=(TlsResumption&&) = delete;
+
+  ~TlsResumption() = default;
+
+  /**
+   * @brief install - configures session resumption of server's context. Call
+   * it before the server is started. Info callback set on the context before
+   * is still called
+   * @param ssl_ctx - server's context, owns installed object
+   * @param settings - cache and tickets settings
+   * @return installed object
+   */
+  static std::shared_ptr<TlsResumption>
+  install(boost::asio::ssl::context& ssl_ctx,
+          TlsResumptionSettings settings = {}) {
+    auto self = std::make_shared<util::SharedProxy<TlsResumption>>(settings);
+    SSL_CTX* ctx = ssl_ctx.native_handle();
+
+    const auto& id_context = settings.session_id_context;
+    if (::SSL_CTX_set_session_id_context(
+            ctx, reinterpret_cast<const unsigned char*>(std::data(id_context)),
+            static_cast<unsigned int>(std::size(id_context))) != 1) {
+      throw_ssl_error("TlsResumption::install");
+    }
+    ::SSL_CTX_set_timeout(ctx,
+                          static_cast<long>(settings.session_timeout.count()));
+
+    if (settings.cache_capacity == 0) {
+      ::SSL_CTX_set_session_cache_mode(ctx, SSL_SESS_CACHE_OFF);
+    } else {
+      ::SSL_CTX_set_session_cache_mode(ctx, SSL_SESS_CACHE_SERVER |
+                                                SSL_SESS_CACHE_NO_INTERNAL);
+      ::SSL_CTX_sess_set_new_cb(ctx, &TlsResumption::on_new_session);
+      ::SSL_CTX_sess_set_get_cb(ctx, &TlsResumption::on_get_session);
+      ::SSL_CTX_sess_set_remove_cb(ctx, &TlsResumption::on_remove_session);
+    }
+
+    if (settings.enable_tickets) {
+      ::SSL_CTX_clear_options(ctx, SSL_OP_NO_TICKET);
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+      ::SSL_CTX_set_tlsext_ticket_key_evp_cb(ctx,
+                                             &TlsResumption::on_ticket_key);
+#else
+      ::SSL_CTX_set_tlsext_ticket_key_cb(ctx, &TlsResumption::on_ticket_key);
+#endif
+    } else {
+      ::SSL_CTX_set_options(ctx, SSL_OP_NO_TICKET);
+    }
+
+    // Previous callback is chained, repeated install does not chain itself
+    self->previous_info_ = ::SSL_CTX_get_info_callback(ctx);
+    if (self->previous_info_ == &TlsResumption::on_info) {
+      const auto* installed = static_cast<std::shared_ptr<TlsResumption>*>(
+          ::SSL_CTX_get_ex_data(ctx, context_index()));
+      self->previous_info_ = installed ? (*installed)->previous_info_ : nullptr;
+    }
+    ::SSL_CTX_set_info_callback(ctx, &TlsResumption::on_info);
+
+    // Context owns the copy of pointer, it's freed with the context
+    auto* previous = static_cast<std::shared_ptr<TlsResumption>*>(
+        ::SSL_CTX_get_ex_data(ctx, context_index()));
+    auto* owner = new std::shared_ptr<TlsResumption>{self};
+    if (::SSL_CTX_set_ex_data(ctx, context_index(), owner) != 1) {
+      delete owner;
+      throw_ssl_error("TlsResumption::install");
+    }
+    delete previous;
+
+    return self;
+  }
+
+  const Metrics& metrics() const noexcept { return metrics_; }
+
+  /**
+   * @brief cached_sessions - number of sessions in the cache
+   */
+  std::size_t cached_sessions() {
+    std::size_t count{};
+    for (auto& shard : shards_) {
+      const std::scoped_lock lock{shard.mutex};
+      count += std::size(shard.index);
+    }
+    return count;
+  }
+
+  /**
+   * @brief rotate_ticket_keys - makes new current ticket key now, the current
+   * one becomes previous
+   */
+  void rotate_ticket_keys() {
+    const std::unique_lock lock{keys_mutex_};
+    rotate_locked();
+  }
+};
+
+} // namespace rest_in_beast
+
+#endif // REST_IN_BEAST_TLS_RESUMPTION_HPP
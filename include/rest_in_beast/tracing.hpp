@@ -0,0 +1,352 @@
+//
+// Author: Dmitriy Gavryushin (https://github.com/Gawrjuschin)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#ifndef REST_IN_BEAST_TRACING_HPP
+#define REST_IN_BEAST_TRACING_HPP
+
+#include "util/shared_proxy.hpp"
+
+#include <boost/beast/http/verb.hpp>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace rest_in_beast {
+
+/**
+ * @brief tracing_enabled - sessions trace requests only if the library is
+ * compiled with REST_IN_BEAST_ENABLE_TRACING (CMake option
+ * REST_IN_BEAST_TRACING), otherwise tracing code is compiled out
+ */
+#ifdef REST_IN_BEAST_ENABLE_TRACING
+inline constexpr bool tracing_enabled{true};
+#else
+inline constexpr bool tracing_enabled{false};
+#endif
+
+/**
+ * @brief The Trace class is a record of phase transitions of one request.
+ * Connection's points are the same for all it's requests, point which is not
+ * reached is the clock's epoch
+ */
+class Trace {
+public:
+  using clock = std::chrono::steady_clock;
+
+  enum class Point : std::size_t {
+    // Session is created for the connection
+    accepted,
+    // First session's handler runs in it's strand
+    strand,
+    handshake_start,
+    handshake_end,
+    read_start,
+    read_end,
+    // Respondent's response is ready to write
+    respond_end,
+    write_end,
+    count
+  };
+
+  std::array<clock::time_point, static_cast<std::size_t>(Point::count)>
+      points{};
+  // Number of the request in the connection, starting from 1
+  std::uint64_t request{};
+  boost::beast::http::verb method{};
+
+private:
+  std::array<char, 64> target_{};
+  std::size_t target_size_{};
+
+public:
+  clock::time_point point(Point point) const noexcept {
+    return points[static_cast<std::size_t>(point)];
+  }
+
+  bool reached(Point point) const noexcept {
+    return this->point(point) != clock::time_point{};
+  }
+
+  /**
+   * @brief duration - between two reached points, zero otherwise
+   */
+  clock::duration duration(Point from, Point to) const noexcept {
+    if (!reached(from) || !reached(to))
+      return {};
+    return point(to) - point(from);
+  }
+
+  /**
+   * @brief target - first 64 characters of request's target
+   */
+  std::string_view target() const noexcept {
+    return {std::data(target_), target_size_};
+  }
+
+  void target(std::string_view target) noexcept {
+    target_size_ = std::min(std::size(target), std::size(target_));
+    std::copy_n(std::data(target), target_size_, std::data(target_));
+  }
+};
+
+/**
+ * @brief The TraceSink class is an interface of traces' consumer. Sessions ask
+ * it to sample each request and deliver traces of sampled ones after the
+ * response is written
+ */
+class TraceSink {
+  const bool server_timing_;
+
+protected:
+  /**
+   * @param server_timing - sampled responses of the reusable path get
+   * Server-Timing header
+   */
+  explicit TraceSink(bool server_timing) : server_timing_{server_timing} {}
+
+public:
+  virtual ~TraceSink() = default;
+
+  bool server_timing() const noexcept { return server_timing_; }
+
+  /**
+   * @brief sample is called from any thread for each read request
+   */
+  virtual bool sample() noexcept { return true; }
+
+  /**
+   * @brief trace is called from session's strand, SHOULD return quickly
+   */
+  virtual void trace(const Trace& trace) = 0;
+};
+
+/**
+ * @brief The RingTraceSink class keeps the last traces
+ */
+class RingTraceSink : public TraceSink {
+  mutable std::mutex mutex_;
+  std::vector<Trace> ring_;
+  std::uint64_t written_{};
+
+  RingTraceSink(std::size_t capacity, bool server_timing)
+      : TraceSink{server_timing}, ring_(std::max<std::size_t>(capacity, 1)) {}
+
+  friend util::SharedProxy<RingTraceSink>;
+
+public:
+  /**
+   * @brief make_shared
+   * @param capacity - number of kept traces
+   * @param server_timing - sampled responses get Server-Timing header
+   */
+  static std::shared_ptr<RingTraceSink>
+  make_shared(std::size_t capacity, bool server_timing = false) {
+    return std::make_shared<util::SharedProxy<RingTraceSink>>(capacity,
+                                                              server_timing);
+  }
+
+  void trace(const Trace& trace) override {
+    const std::scoped_lock lock{mutex_};
+    ring_[written_++ % std::size(ring_)] = trace;
+  }
+
+  /**
+   * @brief traces - kept traces from the oldest one
+   */
+  std::vector<Trace> traces() const {
+    const std::scoped_lock lock{mutex_};
+    const auto capacity = std::size(ring_);
+    const auto size = std::min<std::uint64_t>(written_, capacity);
+
+    std::vector<Trace> traces;
+    traces.reserve(size);
+    for (auto idx = written_ - size; idx < written_; ++idx) {
+      traces.push_back(ring_[idx % capacity]);
+    }
+    return traces;
+  }
+};
+
+/**
+ * @brief The SamplingTraceSink class passes each n-th sampled request to the
+ * wrapped sink
+ */
+class SamplingTraceSink : public TraceSink {
+  std::shared_ptr<TraceSink> sink_;
+  const std::uint64_t every_;
+  std::atomic<std::uint64_t> requests_{};
+
+  SamplingTraceSink(std::shared_ptr<TraceSink> sink, std::uint64_t every)
+      : TraceSink{sink->server_timing()}, sink_{std::move(sink)},
+        every_{std::max<std::uint64_t>(every, 1)} {}
+
+  friend util::SharedProxy<SamplingTraceSink>;
+
+public:
+  static std::shared_ptr<SamplingTraceSink>
+  make_shared(std::shared_ptr<TraceSink> sink, std::uint64_t every) {
+    return std::make_shared<util::SharedProxy<SamplingTraceSink>>(
+        std::move(sink), every);
+  }
+
+  bool sample() noexcept override {
+    return requests_.fetch_add(1, std::memory_order_relaxed) % every_ == 0 &&
+           sink_->sample();
+  }
+
+  void trace(const Trace& trace) override { sink_->trace(trace); }
+};
+
+namespace detail {
+
+template <bool Enabled> class SessionTracer;
+
+/**
+ * @brief The SessionTracer class of sessions compiled without tracing does
+ * nothing and takes no space
+ */
+template <> class SessionTracer<false> {
+public:
+  explicit SessionTracer(const std::shared_ptr<TraceSink>&) noexcept {}
+
+  void mark(Trace::Point) noexcept {}
+  void mark_once(Trace::Point) noexcept {}
+
+  template <typename Request> void begin_request(const Request&) noexcept {}
+
+  template <typename Response> void server_timing(Response&) noexcept {}
+
+  void end_request() noexcept {}
+};
+
+/**
+ * @brief The SessionTracer class is session's trace of the current request
+ */
+template <> class SessionTracer<true> {
+  std::shared_ptr<TraceSink> sink_;
+  Trace trace_{};
+  bool sampled_{};
+
+  struct Timing {
+    std::string_view name;
+    Trace::Point from;
+    Trace::Point to;
+  };
+
+  // Connection's timings go first
+  static constexpr std::size_t connection_timings{2};
+  static constexpr std::array<Timing, 4> timings{
+      {{"strand", Trace::Point::accepted, Trace::Point::strand},
+       {"handshake", Trace::Point::handshake_start,
+        Trace::Point::handshake_end},
+       {"read", Trace::Point::read_start, Trace::Point::read_end},
+       {"handler", Trace::Point::read_end, Trace::Point::respond_end}}};
+
+public:
+  /**
+   * @param sink - nullptr disables tracing of the session
+   */
+  explicit SessionTracer(std::shared_ptr<TraceSink> sink)
+      : sink_{std::move(sink)} {
+    mark(Trace::Point::accepted);
+  }
+
+  void mark(Trace::Point point) noexcept {
+    if (sink_) {
+      trace_.points[static_cast<std::size_t>(point)] = Trace::clock::now();
+    }
+  }
+
+  void mark_once(Trace::Point point) noexcept {
+    if (!trace_.reached(point)) {
+      mark(point);
+    }
+  }
+
+  /**
+   * @brief begin_request - the request is read
+   */
+  template <typename Request> void begin_request(const Request& request) {
+    if (!sink_)
+      return;
+
+    mark(Trace::Point::read_end);
+    ++trace_.request;
+    trace_.method = request.method();
+    const auto target = request.target();
+    trace_.target({std::data(target), std::size(target)});
+    sampled_ = sink_->sample();
+  }
+
+  /**
+   * @brief server_timing sets Server-Timing header of sampled request.
+   * Connection's phases are timed in the first response only
+   */
+  template <typename Response> void server_timing(Response& response) {
+    if (!sampled_ || !sink_->server_timing())
+      return;
+
+    std::string value;
+    std::array<char, 64> timing{};
+    const std::size_t first = trace_.request == 1 ? 0 : connection_timings;
+    for (std::size_t idx{first}; idx < std::size(timings); ++idx) {
+      const auto& [name, from, to] = timings[idx];
+      if (!trace_.reached(from) || !trace_.reached(to))
+        continue;
+
+      const std::chrono::duration<double, std::milli> duration{
+          trace_.duration(from, to)};
+      const int size = std::snprintf(
+          std::data(timing), std::size(timing), "%s%.*s;dur=%.3f",
+          std::empty(value) ? "" : ", ", static_cast<int>(std::size(name)),
+          std::data(name), duration.count());
+      value.append(std::data(timing), static_cast<std::size_t>(size));
+    }
+
+    if (!std::empty(value)) {
+      response.set("Server-Timing", value);
+    }
+  }
+
+  /**
+   * @brief end_request - the response is written, sampled trace is delivered
+   */
+  void end_request() {
+    if (!sink_)
+      return;
+
+    mark(Trace::Point::write_end);
+    if (sampled_) {
+      sink_->trace(trace_);
+    }
+
+    sampled_ = false;
+    for (auto point : {Trace::Point::read_start, Trace::Point::read_end,
+                       Trace::Point::respond_end, Trace::Point::write_end}) {
+      trace_.points[static_cast<std::size_t>(point)] = {};
+    }
+  }
+};
+
+using session_tracer = SessionTracer<tracing_enabled>;
+
+} // namespace detail
+
+} // namespace rest_in_beast
+
+#endif // REST_IN_BEAST_TRACING_HPP
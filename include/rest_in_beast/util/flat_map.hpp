@@ -0,0 +1,438 @@
+//
+// Author: Dmitriy Gavryushin (https://github.com/Gawrjuschin)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#ifndef REST_IN_BEAST_FLAT_MAP_HPP
+#define REST_IN_BEAST_FLAT_MAP_HPP
+
+#include "hasher.hpp"
+
+#include <bit>
+#include <cstddef>
+#include <iterator>
+#include <memory>
+#include <new>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace rest_in_beast {
+namespace util {
+
+/**
+ * @brief The FlatMap class is an open-addressing hash map with linear probing
+ * and backward shift deletion. Elements are stored in one contiguous array and
+ * the hashes are stored in separate dense array, so lookup is a scan of
+ * neighbouring hashes followed by a single key comparison.
+ *
+ * Supports heterogeneous lookup (std::string_view, boost::string_view, const
+ * char*) when Hash and KeyEqual are transparent, which is the case for the
+ * defaults.
+ *
+ * Unlike std::unordered_map, any insertion or erase invalidates iterators and
+ * references. Mutating key through value_type is undefined behaviour.
+ */
+template <typename Key, typename T, typename Hash = string_view_hash,
+          typename KeyEqual = string_view_equal>
+class FlatMap {
+public:
+  using key_type = Key;
+  using mapped_type = T;
+  using value_type = std::pair<Key, T>;
+  using size_type = std::size_t;
+  using hasher = Hash;
+  using key_equal = KeyEqual;
+
+private:
+  // 0 is reserved as "empty slot" mark
+  static constexpr std::size_t empty_hash{0};
+
+  struct Slot {
+    alignas(value_type) std::byte storage[sizeof(value_type)];
+
+    value_type& value() noexcept {
+      return *std::launder(reinterpret_cast<value_type*>(storage));
+    }
+    const value_type& value() const noexcept {
+      return *std::launder(reinterpret_cast<const value_type*>(storage));
+    }
+  };
+
+  std::vector<std::size_t> hashes_;
+  std::unique_ptr<Slot[]> slots_;
+  size_type size_{};
+  [[no_unique_address]] Hash hash_;
+  [[no_unique_address]] KeyEqual equal_;
+
+  template <typename K> std::size_t hash_of(const K& key) const {
+    const std::size_t h = hash_(key);
+    return h == empty_hash ? 1 : h;
+  }
+
+  size_type mask() const noexcept { return std::size(hashes_) - 1; }
+
+  // Max load factor is 3/4: linear probing degrades fast on higher loads
+  bool needs_grow(size_type count) const noexcept {
+    return std::empty(hashes_) || count * 4 > std::size(hashes_) * 3;
+  }
+
+  template <typename K>
+  size_type find_index(const K& key, std::size_t h) const {
+    if (std::empty(hashes_))
+      return npos;
+
+    for (size_type idx = h & mask();; idx = (idx + 1) & mask()) {
+      if (hashes_[idx] == empty_hash)
+        return npos;
+
+      if (hashes_[idx] == h && equal_(slots_[idx].value().first, key))
+        return idx;
+    }
+  }
+
+  // Places element into the table without any checks. Table must have free
+  // slots
+  template <typename V> size_type place(std::size_t h, V&& value) {
+    size_type idx = h & mask();
+    while (hashes_[idx] != empty_hash) {
+      idx = (idx + 1) & mask();
+    }
+    ::new (static_cast<void*>(slots_[idx].storage))
+        value_type(std::forward<V>(value));
+    hashes_[idx] = h;
+    return idx;
+  }
+
+  // Elements are copied unless their move is noexcept, so an exception leaves
+  // the map as it was
+  void rehash(size_type capacity) {
+    std::vector<std::size_t> old_hashes(capacity, empty_hash);
+    std::unique_ptr<Slot[]> old_slots{new Slot[capacity]};
+    old_hashes.swap(hashes_);
+    old_slots.swap(slots_);
+
+    try {
+      for (size_type idx{}; idx < std::size(old_hashes); ++idx) {
+        if (old_hashes[idx] != empty_hash) {
+          place(old_hashes[idx],
+                std::move_if_noexcept(old_slots[idx].value()));
+        }
+      }
+    } catch (...) {
+      for (size_type idx{}; idx < std::size(hashes_); ++idx) {
+        if (hashes_[idx] != empty_hash) {
+          slots_[idx].value().~value_type();
+        }
+      }
+      old_hashes.swap(hashes_);
+      old_slots.swap(slots_);
+      throw;
+    }
+
+    for (size_type idx{}; idx < std::size(old_hashes); ++idx) {
+      if (old_hashes[idx] != empty_hash) {
+        old_slots[idx].value().~value_type();
+      }
+    }
+  }
+
+  void destroy() noexcept {
+    for (size_type idx{}; idx < std::size(hashes_); ++idx) {
+      if (hashes_[idx] != empty_hash) {
+        slots_[idx].value().~value_type();
+        hashes_[idx] = empty_hash;
+      }
+    }
+    size_ = 0;
+  }
+
+  template <typename K, typename... Args>
+  std::pair<size_type, bool> emplace_impl(K&& key, Args&&... args) {
+    const std::size_t h = hash_of(key);
+    if (const auto idx = find_index(key, h); idx != npos)
+      return {idx, false};
+
+    if (needs_grow(size_ + 1)) {
+      rehash(std::empty(hashes_) ? 8 : std::size(hashes_) * 2);
+    }
+
+    const auto idx = place(h, value_type(std::piecewise_construct,
+                                         std::forward_as_tuple(
+                                             std::forward<K>(key)),
+                                         std::forward_as_tuple(
+                                             std::forward<Args>(args)...)));
+    ++size_;
+    return {idx, true};
+  }
+
+  static constexpr size_type npos = static_cast<size_type>(-1);
+
+public:
+  /**
+   * @brief The basic_iterator class is a forward iterator over occupied slots
+   */
+  template <bool IsConst> class basic_iterator {
+    using map_type = std::conditional_t<IsConst, const FlatMap, FlatMap>;
+
+    map_type* map_{};
+    size_type idx_{};
+
+    void skip_empty() noexcept {
+      while (idx_ < std::size(map_->hashes_) &&
+             map_->hashes_[idx_] == empty_hash) {
+        ++idx_;
+      }
+    }
+
+    friend class FlatMap;
+    friend class basic_iterator<!IsConst>;
+    basic_iterator(map_type* map, size_type idx) : map_{map}, idx_{idx} {}
+
+  public:
+    using value_type = FlatMap::value_type;
+    using difference_type = std::ptrdiff_t;
+    using pointer =
+        std::conditional_t<IsConst, const value_type*, value_type*>;
+    using reference =
+        std::conditional_t<IsConst, const value_type&, value_type&>;
+    using iterator_category = std::forward_iterator_tag;
+
+    basic_iterator() = default;
+
+    operator basic_iterator<true>() const noexcept { return {map_, idx_}; }
+
+    reference operator*() const noexcept {
+      return map_->slots_[idx_].value();
+    }
+    pointer operator->() const noexcept { return &**this; }
+
+    basic_iterator& operator++() noexcept {
+      ++idx_;
+      skip_empty();
+      return *this;
+    }
+
+    basic_iterator operator++(int) noexcept {
+      auto it = *this;
+      ++(*this);
+      return it;
+    }
+
+    bool operator==(const basic_iterator& other) const noexcept {
+      return idx_ == other.idx_;
+    }
+
+    bool operator!=(const basic_iterator& other) const noexcept {
+      return !(*this == other);
+    }
+  };
+
+  using iterator = basic_iterator<false>;
+  using const_iterator = basic_iterator<true>;
+
+  FlatMap() = default;
+
+  explicit FlatMap(size_type capacity, Hash hash = Hash{},
+                   KeyEqual equal = KeyEqual{})
+      : hash_{std::move(hash)}, equal_{std::move(equal)} {
+    reserve(capacity);
+  }
+
+  FlatMap(std::initializer_list<value_type> values) {
+    reserve(std::size(values));
+    for (const auto& value : values) {
+      emplace(value.first, value.second);
+    }
+  }
+
+  FlatMap(const FlatMap& other)
+      : hash_{other.hash_}, equal_{other.equal_} {
+    if (std::empty(other.hashes_))
+      return;
+
+    hashes_.assign(std::size(other.hashes_), empty_hash);
+    slots_.reset(new Slot[std::size(other.hashes_)]);
+    // Destructor is not called if the constructor throws
+    try {
+      for (size_type idx{}; idx < std::size(other.hashes_); ++idx) {
+        if (other.hashes_[idx] != empty_hash) {
+          ::new (static_cast<void*>(slots_[idx].storage))
+              value_type(other.slots_[idx].value());
+          hashes_[idx] = other.hashes_[idx];
+          ++size_;
+        }
+      }
+    } catch (...) {
+      destroy();
+      slots_.reset();
+      hashes_.clear();
+      throw;
+    }
+  }
+
+  FlatMap& operator=(const FlatMap& other) {
+    if (this != &other) {
+      FlatMap tmp{other};
+      swap(tmp);
+    }
+    return *this;
+  }
+
+  FlatMap(FlatMap&& other) noexcept
+      : hashes_{std::move(other.hashes_)}, slots_{std::move(other.slots_)},
+        size_{std::exchange(other.size_, 0)}, hash_{std::move(other.hash_)},
+        equal_{std::move(other.equal_)} {
+    other.hashes_.clear();
+  }
+
+  FlatMap& operator=(FlatMap&& other) noexcept {
+    if (this != &other) {
+      destroy();
+      hashes_ = std::move(other.hashes_);
+      slots_ = std::move(other.slots_);
+      size_ = std::exchange(other.size_, 0);
+      hash_ = std::move(other.hash_);
+      equal_ = std::move(other.equal_);
+      other.hashes_.clear();
+    }
+    return *this;
+  }
+
+  ~FlatMap() { destroy(); }
+
+  void swap(FlatMap& other) noexcept {
+    using std::swap;
+    swap(hashes_, other.hashes_);
+    swap(slots_, other.slots_);
+    swap(size_, other.size_);
+    swap(hash_, other.hash_);
+    swap(equal_, other.equal_);
+  }
+
+  iterator begin() noexcept {
+    iterator it{this, 0};
+    it.skip_empty();
+    return it;
+  }
+  iterator end() noexcept { return {this, std::size(hashes_)}; }
+
+  const_iterator begin() const noexcept {
+    const_iterator it{this, 0};
+    it.skip_empty();
+    return it;
+  }
+  const_iterator end() const noexcept { return {this, std::size(hashes_)}; }
+
+  const_iterator cbegin() const noexcept { return begin(); }
+  const_iterator cend() const noexcept { return end(); }
+
+  [[nodiscard]] bool empty() const noexcept { return size_ == 0; }
+  [[nodiscard]] size_type size() const noexcept { return size_; }
+  [[nodiscard]] size_type capacity() const noexcept {
+    return std::size(hashes_);
+  }
+
+  /**
+   * @brief reserve - makes room for count elements without rehashing
+   * @param count
+   */
+  void reserve(size_type count) {
+    if (!needs_grow(count))
+      return;
+
+    const size_type capacity = std::bit_ceil(count + count / 3 + 1);
+    rehash(capacity < 8 ? 8 : capacity);
+  }
+
+  void clear() noexcept { destroy(); }
+
+  template <typename K, typename... Args>
+  std::pair<iterator, bool> try_emplace(K&& key, Args&&... args) {
+    const auto [idx, inserted] =
+        emplace_impl(std::forward<K>(key), std::forward<Args>(args)...);
+    return {iterator{this, idx}, inserted};
+  }
+
+  template <typename K, typename... Args>
+  std::pair<iterator, bool> emplace(K&& key, Args&&... args) {
+    return try_emplace(std::forward<K>(key), std::forward<Args>(args)...);
+  }
+
+  std::pair<iterator, bool> insert(value_type value) {
+    return try_emplace(std::move(value.first), std::move(value.second));
+  }
+
+  template <typename K> T& operator[](K&& key) {
+    return try_emplace(std::forward<K>(key)).first->second;
+  }
+
+  template <typename K> [[nodiscard]] iterator find(const K& key) {
+    const auto idx = find_index(key, hash_of(key));
+    return idx == npos ? end() : iterator{this, idx};
+  }
+
+  template <typename K> [[nodiscard]] const_iterator find(const K& key) const {
+    const auto idx = find_index(key, hash_of(key));
+    return idx == npos ? end() : const_iterator{this, idx};
+  }
+
+  template <typename K> [[nodiscard]] bool contains(const K& key) const {
+    return find_index(key, hash_of(key)) != npos;
+  }
+
+  template <typename K> [[nodiscard]] T& at(const K& key) {
+    const auto idx = find_index(key, hash_of(key));
+    if (idx == npos)
+      throw std::out_of_range{"FlatMap::at"};
+    return slots_[idx].value().second;
+  }
+
+  template <typename K> [[nodiscard]] const T& at(const K& key) const {
+    const auto idx = find_index(key, hash_of(key));
+    if (idx == npos)
+      throw std::out_of_range{"FlatMap::at"};
+    return slots_[idx].value().second;
+  }
+
+  /**
+   * @brief erase - removes element and shifts following elements of the probe
+   * sequence back, so no tombstones are left
+   * @param key
+   * @return number of erased elements
+   */
+  template <typename K> size_type erase(const K& key) {
+    auto idx = find_index(key, hash_of(key));
+    if (idx == npos)
+      return 0;
+
+    slots_[idx].value().~value_type();
+    hashes_[idx] = empty_hash;
+    --size_;
+
+    for (auto next = (idx + 1) & mask(); hashes_[next] != empty_hash;
+         next = (next + 1) & mask()) {
+      const auto home = hashes_[next] & mask();
+      // Element at next may be moved to idx only if idx lies on its probe path
+      // from home to next (cyclic)
+      if (((next - home) & mask()) >= ((next - idx) & mask())) {
+        ::new (static_cast<void*>(slots_[idx].storage))
+            value_type(std::move(slots_[next].value()));
+        slots_[next].value().~value_type();
+        hashes_[idx] = std::exchange(hashes_[next], empty_hash);
+        idx = next;
+      }
+    }
+
+    return 1;
+  }
+};
+
+} // namespace util
+} // namespace rest_in_beast
+
+#endif // REST_IN_BEAST_FLAT_MAP_HPP
@@ -9,34 +9,218 @@
 #define RESIN_IN_BEAST_HASHER_HPP
 
 #include <boost/utility/string_view.hpp>
+#include <boost/version.hpp>
+#if BOOST_VERSION >= 108100
+#include <boost/core/detail/string_view.hpp>
+#endif
+
+#include <cstdint>
+#include <cstring>
+#include <random>
 #include <string>
 #include <string_view>
+#include <type_traits>
 
 namespace rest_in_beast {
 namespace util {
+
+namespace detail {
+// wyhash (final version 4) by Wang Yi, public domain:
+// https://github.com/wangyi-fudan/wyhash
+inline constexpr std::uint64_t wy_secret[4]{
+    0x2d358dccaa6c78a5ull, 0x8bb84b93962eacc9ull, 0x4b33a62ed433d4a3ull,
+    0x4d5a2da51de1aa47ull};
+
+constexpr void wy_mum(std::uint64_t& a, std::uint64_t& b) noexcept {
+#if defined(__SIZEOF_INT128__)
+  const unsigned __int128 r = static_cast<unsigned __int128>(a) * b;
+  a = static_cast<std::uint64_t>(r);
+  b = static_cast<std::uint64_t>(r >> 64);
+#else
+  const std::uint64_t ha = a >> 32, hb = b >> 32;
+  const std::uint64_t la = static_cast<std::uint32_t>(a);
+  const std::uint64_t lb = static_cast<std::uint32_t>(b);
+  const std::uint64_t rh = ha * hb, rm0 = ha * lb, rm1 = hb * la, rl = la * lb;
+  const std::uint64_t t = rl + (rm0 << 32);
+  std::uint64_t c = t < rl;
+  const std::uint64_t lo = t + (rm1 << 32);
+  c += lo < t;
+  const std::uint64_t hi = rh + (rm0 >> 32) + (rm1 >> 32) + c;
+  a = lo;
+  b = hi;
+#endif
+}
+
+constexpr std::uint64_t wy_mix(std::uint64_t a, std::uint64_t b) noexcept {
+  wy_mum(a, b);
+  return a ^ b;
+}
+
+// Little-endian reads. Byte loop in constant evaluation, single load otherwise
+constexpr std::uint64_t wy_read(const char* p, std::size_t n) noexcept {
+  if (std::is_constant_evaluated()) {
+    std::uint64_t v{};
+    for (std::size_t i{}; i < n; ++i) {
+      v |= std::uint64_t{static_cast<unsigned char>(p[i])} << (8 * i);
+    }
+    return v;
+  }
+
+  if (n == 8) {
+    std::uint64_t v;
+    std::memcpy(&v, p, 8);
+    return v;
+  }
+
+  std::uint32_t v;
+  std::memcpy(&v, p, 4);
+  return v;
+}
+
+constexpr std::uint64_t wy_read3(const char* p, std::size_t k) noexcept {
+  return (std::uint64_t{static_cast<unsigned char>(p[0])} << 16) |
+         (std::uint64_t{static_cast<unsigned char>(p[k >> 1])} << 8) |
+         std::uint64_t{static_cast<unsigned char>(p[k - 1])};
+}
+
+// Supported string types of the hashers. Every overload is an exact match, so
+// string types convertible to several others are not ambiguous
+constexpr std::string_view to_string_view(std::string_view text) noexcept {
+  return text;
+}
+
+constexpr std::string_view to_string_view(boost::string_view text) noexcept {
+  return {std::data(text), std::size(text)};
+}
+
+#if BOOST_VERSION >= 108100
+constexpr std::string_view
+to_string_view(boost::core::string_view text) noexcept {
+  return {std::data(text), std::size(text)};
+}
+#endif
+
+constexpr std::string_view to_string_view(const char* text) noexcept {
+  return text;
+}
+
+inline std::string_view to_string_view(const std::string& text) noexcept {
+  return text;
+}
+} // namespace detail
+
+/**
+ * @brief hash_bytes is a wyhash implementation. Usable in constant expressions
+ * @param text - bytes to hash
+ * @param seed - per-table secret against hash flooding
+ * @return 64-bit hash
+ */
+constexpr std::uint64_t hash_bytes(std::string_view text,
+                                   std::uint64_t seed = 0) noexcept {
+  using detail::wy_mix;
+  using detail::wy_read;
+  using detail::wy_secret;
+
+  const char* p = std::data(text);
+  const std::size_t len = std::size(text);
+
+  seed ^= wy_mix(seed ^ wy_secret[0], wy_secret[1]);
+
+  std::uint64_t a{};
+  std::uint64_t b{};
+
+  if (len <= 16) {
+    if (len >= 4) {
+      a = (wy_read(p, 4) << 32) | wy_read(p + ((len >> 3) << 2), 4);
+      b = (wy_read(p + len - 4, 4) << 32) |
+          wy_read(p + len - 4 - ((len >> 3) << 2), 4);
+    } else if (len > 0) {
+      a = detail::wy_read3(p, len);
+    }
+  } else {
+    std::size_t i = len;
+    if (i >= 48) {
+      std::uint64_t see1 = seed;
+      std::uint64_t see2 = seed;
+      do {
+        seed = wy_mix(wy_read(p, 8) ^ wy_secret[1], wy_read(p + 8, 8) ^ seed);
+        see1 = wy_mix(wy_read(p + 16, 8) ^ wy_secret[2],
+                      wy_read(p + 24, 8) ^ see1);
+        see2 = wy_mix(wy_read(p + 32, 8) ^ wy_secret[3],
+                      wy_read(p + 40, 8) ^ see2);
+        p += 48;
+        i -= 48;
+      } while (i >= 48);
+      seed ^= see1 ^ see2;
+    }
+    while (i > 16) {
+      seed = wy_mix(wy_read(p, 8) ^ wy_secret[1], wy_read(p + 8, 8) ^ seed);
+      i -= 16;
+      p += 16;
+    }
+    a = wy_read(p + i - 16, 8);
+    b = wy_read(p + i - 8, 8);
+  }
+
+  a ^= wy_secret[1];
+  b ^= seed;
+  detail::wy_mum(a, b);
+  return wy_mix(a ^ wy_secret[0] ^ len, b ^ wy_secret[1]);
+}
+
 /**
  * @brief The string_view_hash class is an advanced hasher supports string_view
  */
 struct string_view_hash {
   using is_transparent = void;
 
-  [[nodiscard]] std::size_t operator()(boost::string_view text) const noexcept {
-    return std::hash<std::string_view>{}(
-        std::string_view{std::data(text), std::size(text)});
+  template <typename Text>
+  [[nodiscard]] constexpr std::size_t
+  operator()(const Text& text) const noexcept {
+    return static_cast<std::size_t>(hash_bytes(detail::to_string_view(text)));
   }
+};
+
+/**
+ * @brief The seeded_string_view_hash class is the string_view_hash with per
+ * instance secret. Default constructed instance takes random seed, so the hash
+ * values of the same keys differ between processes and tables (protection
+ * against hash flooding by crafted request targets)
+ */
+struct seeded_string_view_hash {
+  using is_transparent = void;
+
+  std::uint64_t seed{random_seed()};
 
-  [[nodiscard]] std::size_t operator()(const char* text) const noexcept {
-    return std::hash<std::string_view>{}(text);
+  /**
+   * @brief random_seed - seed from std::random_device
+   */
+  static std::uint64_t random_seed() {
+    std::random_device rd;
+    return (std::uint64_t{rd()} << 32) ^ rd();
   }
 
-  [[nodiscard]] std::size_t operator()(std::string_view text) const noexcept {
-    return std::hash<std::string_view>{}(text);
+  template <typename Text>
+  [[nodiscard]] std::size_t operator()(const Text& text) const noexcept {
+    return static_cast<std::size_t>(
+        hash_bytes(detail::to_string_view(text), seed));
   }
+};
 
-  [[nodiscard]] std::size_t operator()(const std::string& text) const noexcept {
-    return std::hash<std::string>{}(text);
+/**
+ * @brief The string_view_equal class is a transparent comparator pairs with
+ * string_view_hash
+ */
+struct string_view_equal {
+  using is_transparent = void;
+
+  template <typename Lhs, typename Rhs>
+  [[nodiscard]] constexpr bool operator()(const Lhs& lhs,
+                                          const Rhs& rhs) const noexcept {
+    return detail::to_string_view(lhs) == detail::to_string_view(rhs);
   }
 };
+
 } // namespace util
 } // namespace rest_in_beast
 
@@ -0,0 +1,553 @@
+//
+// Author: Dmitriy Gavryushin (https://github.com/Gawrjuschin)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#ifndef REST_IN_BEAST_HPACK_HPP
+#define REST_IN_BEAST_HPACK_HPP
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+namespace rest_in_beast {
+namespace util {
+
+namespace detail {
+struct HuffmanCode {
+  std::uint32_t code;
+  std::uint8_t bits;
+};
+
+// RFC 7541 Appendix B, the last one is EOS
+inline constexpr std::array<HuffmanCode, 257> huffman_codes{{
+    {0x1ff8, 13}, {0x7fffd8, 23}, {0xfffffe2, 28}, {0xfffffe3, 28},
+    {0xfffffe4, 28}, {0xfffffe5, 28}, {0xfffffe6, 28}, {0xfffffe7, 28},
+    {0xfffffe8, 28}, {0xffffea, 24}, {0x3ffffffc, 30}, {0xfffffe9, 28},
+    {0xfffffea, 28}, {0x3ffffffd, 30}, {0xfffffeb, 28}, {0xfffffec, 28},
+    {0xfffffed, 28}, {0xfffffee, 28}, {0xfffffef, 28}, {0xffffff0, 28},
+    {0xffffff1, 28}, {0xffffff2, 28}, {0x3ffffffe, 30}, {0xffffff3, 28},
+    {0xffffff4, 28}, {0xffffff5, 28}, {0xffffff6, 28}, {0xffffff7, 28},
+    {0xffffff8, 28}, {0xffffff9, 28}, {0xffffffa, 28}, {0xffffffb, 28},
+    {0x14, 6}, {0x3f8, 10}, {0x3f9, 10}, {0xffa, 12}, {0x1ff9, 13}, {0x15, 6},
+    {0xf8, 8}, {0x7fa, 11}, {0x3fa, 10}, {0x3fb, 10}, {0xf9, 8}, {0x7fb, 11},
+    {0xfa, 8}, {0x16, 6}, {0x17, 6}, {0x18, 6}, {0x0, 5}, {0x1, 5}, {0x2, 5},
+    {0x19, 6}, {0x1a, 6}, {0x1b, 6}, {0x1c, 6}, {0x1d, 6}, {0x1e, 6}, {0x1f, 6},
+    {0x5c, 7}, {0xfb, 8}, {0x7ffc, 15}, {0x20, 6}, {0xffb, 12}, {0x3fc, 10},
+    {0x1ffa, 13}, {0x21, 6}, {0x5d, 7}, {0x5e, 7}, {0x5f, 7}, {0x60, 7},
+    {0x61, 7}, {0x62, 7}, {0x63, 7}, {0x64, 7}, {0x65, 7}, {0x66, 7}, {0x67, 7},
+    {0x68, 7}, {0x69, 7}, {0x6a, 7}, {0x6b, 7}, {0x6c, 7}, {0x6d, 7}, {0x6e, 7},
+    {0x6f, 7}, {0x70, 7}, {0x71, 7}, {0x72, 7}, {0xfc, 8}, {0x73, 7}, {0xfd, 8},
+    {0x1ffb, 13}, {0x7fff0, 19}, {0x1ffc, 13}, {0x3ffc, 14}, {0x22, 6},
+    {0x7ffd, 15}, {0x3, 5}, {0x23, 6}, {0x4, 5}, {0x24, 6}, {0x5, 5}, {0x25, 6},
+    {0x26, 6}, {0x27, 6}, {0x6, 5}, {0x74, 7}, {0x75, 7}, {0x28, 6}, {0x29, 6},
+    {0x2a, 6}, {0x7, 5}, {0x2b, 6}, {0x76, 7}, {0x2c, 6}, {0x8, 5}, {0x9, 5},
+    {0x2d, 6}, {0x77, 7}, {0x78, 7}, {0x79, 7}, {0x7a, 7}, {0x7b, 7},
+    {0x7ffe, 15}, {0x7fc, 11}, {0x3ffd, 14}, {0x1ffd, 13}, {0xffffffc, 28},
+    {0xfffe6, 20}, {0x3fffd2, 22}, {0xfffe7, 20}, {0xfffe8, 20}, {0x3fffd3, 22},
+    {0x3fffd4, 22}, {0x3fffd5, 22}, {0x7fffd9, 23}, {0x3fffd6, 22},
+    {0x7fffda, 23}, {0x7fffdb, 23}, {0x7fffdc, 23}, {0x7fffdd, 23},
+    {0x7fffde, 23}, {0xffffeb, 24}, {0x7fffdf, 23}, {0xffffec, 24},
+    {0xffffed, 24}, {0x3fffd7, 22}, {0x7fffe0, 23}, {0xffffee, 24},
+    {0x7fffe1, 23}, {0x7fffe2, 23}, {0x7fffe3, 23}, {0x7fffe4, 23},
+    {0x1fffdc, 21}, {0x3fffd8, 22}, {0x7fffe5, 23}, {0x3fffd9, 22},
+    {0x7fffe6, 23}, {0x7fffe7, 23}, {0xffffef, 24}, {0x3fffda, 22},
+    {0x1fffdd, 21}, {0xfffe9, 20}, {0x3fffdb, 22}, {0x3fffdc, 22},
+    {0x7fffe8, 23}, {0x7fffe9, 23}, {0x1fffde, 21}, {0x7fffea, 23},
+    {0x3fffdd, 22}, {0x3fffde, 22}, {0xfffff0, 24}, {0x1fffdf, 21},
+    {0x3fffdf, 22}, {0x7fffeb, 23}, {0x7fffec, 23}, {0x1fffe0, 21},
+    {0x1fffe1, 21}, {0x3fffe0, 22}, {0x1fffe2, 21}, {0x7fffed, 23},
+    {0x3fffe1, 22}, {0x7fffee, 23}, {0x7fffef, 23}, {0xfffea, 20},
+    {0x3fffe2, 22}, {0x3fffe3, 22}, {0x3fffe4, 22}, {0x7ffff0, 23},
+    {0x3fffe5, 22}, {0x3fffe6, 22}, {0x7ffff1, 23}, {0x3ffffe0, 26},
+    {0x3ffffe1, 26}, {0xfffeb, 20}, {0x7fff1, 19}, {0x3fffe7, 22},
+    {0x7ffff2, 23}, {0x3fffe8, 22}, {0x1ffffec, 25}, {0x3ffffe2, 26},
+    {0x3ffffe3, 26}, {0x3ffffe4, 26}, {0x7ffffde, 27}, {0x7ffffdf, 27},
+    {0x3ffffe5, 26}, {0xfffff1, 24}, {0x1ffffed, 25}, {0x7fff2, 19},
+    {0x1fffe3, 21}, {0x3ffffe6, 26}, {0x7ffffe0, 27}, {0x7ffffe1, 27},
+    {0x3ffffe7, 26}, {0x7ffffe2, 27}, {0xfffff2, 24}, {0x1fffe4, 21},
+    {0x1fffe5, 21}, {0x3ffffe8, 26}, {0x3ffffe9, 26}, {0xffffffd, 28},
+    {0x7ffffe3, 27}, {0x7ffffe4, 27}, {0x7ffffe5, 27}, {0xfffec, 20},
+    {0xfffff3, 24}, {0xfffed, 20}, {0x1fffe6, 21}, {0x3fffe9, 22},
+    {0x1fffe7, 21}, {0x1fffe8, 21}, {0x7ffff3, 23}, {0x3fffea, 22},
+    {0x3fffeb, 22}, {0x1ffffee, 25}, {0x1ffffef, 25}, {0xfffff4, 24},
+    {0xfffff5, 24}, {0x3ffffea, 26}, {0x7ffff4, 23}, {0x3ffffeb, 26},
+    {0x7ffffe6, 27}, {0x3ffffec, 26}, {0x3ffffed, 26}, {0x7ffffe7, 27},
+    {0x7ffffe8, 27}, {0x7ffffe9, 27}, {0x7ffffea, 27}, {0x7ffffeb, 27},
+    {0xffffffe, 28}, {0x7ffffec, 27}, {0x7ffffed, 27}, {0x7ffffee, 27},
+    {0x7ffffef, 27}, {0x7fffff0, 27}, {0x3ffffee, 26}, {0x3fffffff, 30},
+}};
+
+// RFC 7541 Appendix A
+inline constexpr std::array<std::pair<std::string_view, std::string_view>, 61>
+    static_table{{
+    {":authority", ""},
+    {":method", "GET"},
+    {":method", "POST"},
+    {":path", "/"},
+    {":path", "/index.html"},
+    {":scheme", "http"},
+    {":scheme", "https"},
+    {":status", "200"},
+    {":status", "204"},
+    {":status", "206"},
+    {":status", "304"},
+    {":status", "400"},
+    {":status", "404"},
+    {":status", "500"},
+    {"accept-charset", ""},
+    {"accept-encoding", "gzip, deflate"},
+    {"accept-language", ""},
+    {"accept-ranges", ""},
+    {"accept", ""},
+    {"access-control-allow-origin", ""},
+    {"age", ""},
+    {"allow", ""},
+    {"authorization", ""},
+    {"cache-control", ""},
+    {"content-disposition", ""},
+    {"content-encoding", ""},
+    {"content-language", ""},
+    {"content-length", ""},
+    {"content-location", ""},
+    {"content-range", ""},
+    {"content-type", ""},
+    {"cookie", ""},
+    {"date", ""},
+    {"etag", ""},
+    {"expect", ""},
+    {"expires", ""},
+    {"from", ""},
+    {"host", ""},
+    {"if-match", ""},
+    {"if-modified-since", ""},
+    {"if-none-match", ""},
+    {"if-range", ""},
+    {"if-unmodified-since", ""},
+    {"last-modified", ""},
+    {"link", ""},
+    {"location", ""},
+    {"max-forwards", ""},
+    {"proxy-authenticate", ""},
+    {"proxy-authorization", ""},
+    {"range", ""},
+    {"referer", ""},
+    {"refresh", ""},
+    {"retry-after", ""},
+    {"server", ""},
+    {"set-cookie", ""},
+    {"strict-transport-security", ""},
+    {"transfer-encoding", ""},
+    {"user-agent", ""},
+    {"vary", ""},
+    {"via", ""},
+    {"www-authenticate", ""},
+    }};
+
+constexpr char to_lower(char ch) noexcept {
+  return ch >= 'A' && ch <= 'Z' ? static_cast<char>(ch - 'A' + 'a') : ch;
+}
+
+constexpr bool iequals(std::string_view lhs, std::string_view rhs) noexcept {
+  if (std::size(lhs) != std::size(rhs))
+    return false;
+  for (std::size_t idx{}; idx < std::size(lhs); ++idx) {
+    if (to_lower(lhs[idx]) != to_lower(rhs[idx]))
+      return false;
+  }
+  return true;
+}
+
+/**
+ * @brief The HuffmanTree class is a decoding trie of huffman_codes: node 0 is
+ * the root, child 0 means "no child"
+ */
+struct HuffmanTree {
+  struct Node {
+    std::uint16_t child[2]{};
+    std::int16_t symbol{-1};
+  };
+  std::vector<Node> nodes;
+
+  HuffmanTree() : nodes(1) {
+    nodes.reserve(2 * std::size(huffman_codes));
+    for (std::size_t symbol{}; symbol < std::size(huffman_codes); ++symbol) {
+      const auto [code, bits] = huffman_codes[symbol];
+      std::size_t node{};
+      for (int bit = bits - 1; bit >= 0; --bit) {
+        const auto branch = (code >> bit) & 1;
+        if (nodes[node].child[branch] == 0) {
+          nodes[node].child[branch] = static_cast<std::uint16_t>(nodes.size());
+          nodes.emplace_back();
+        }
+        node = nodes[node].child[branch];
+      }
+      nodes[node].symbol = static_cast<std::int16_t>(symbol);
+    }
+  }
+};
+
+inline const HuffmanTree& huffman_tree() {
+  static const HuffmanTree tree{};
+  return tree;
+}
+} // namespace detail
+
+/**
+ * @brief huffman_size - length of the text encoded with HPACK Huffman code
+ */
+constexpr std::size_t huffman_size(std::string_view text) noexcept {
+  std::size_t bits{};
+  for (const unsigned char ch : text) {
+    bits += detail::huffman_codes[ch].bits;
+  }
+  return (bits + 7) / 8;
+}
+
+/**
+ * @brief huffman_encode appends the text encoded with HPACK Huffman code
+ */
+inline void huffman_encode(std::string_view text, std::string& out) {
+  std::uint64_t pending{};
+  int pending_bits{};
+  for (const unsigned char ch : text) {
+    const auto [code, bits] = detail::huffman_codes[ch];
+    pending = (pending << bits) | code;
+    pending_bits += bits;
+    while (pending_bits >= 8) {
+      pending_bits -= 8;
+      out.push_back(static_cast<char>(pending >> pending_bits));
+    }
+  }
+  // Padding is the most significant bits of EOS
+  if (pending_bits > 0) {
+    out.push_back(static_cast<char>((pending << (8 - pending_bits)) |
+                                    (0xff >> pending_bits)));
+  }
+}
+
+/**
+ * @brief huffman_decode appends the text decoded from HPACK Huffman code
+ * @return false if the code is malformed: EOS, unknown code or padding longer
+ * than 7 bits or not of ones
+ */
+inline bool huffman_decode(std::string_view encoded, std::string& out) {
+  const auto& nodes = detail::huffman_tree().nodes;
+
+  std::size_t node{};
+  std::size_t padding_bits{};
+  bool padding_ones{true};
+  for (const unsigned char byte : encoded) {
+    for (int bit = 7; bit >= 0; --bit) {
+      const auto branch = (byte >> bit) & 1;
+      node = nodes[node].child[branch];
+      if (node == 0)
+        return false;
+
+      ++padding_bits;
+      padding_ones = padding_ones && branch;
+
+      const auto symbol = nodes[node].symbol;
+      if (symbol < 0)
+        continue;
+      if (symbol == 256)
+        return false;
+
+      out.push_back(static_cast<char>(symbol));
+      node = 0;
+      padding_bits = 0;
+      padding_ones = true;
+    }
+  }
+  return padding_bits <= 7 && padding_ones;
+}
+
+/**
+ * @brief hpack_encode_integer appends HPACK integer with N-bit prefix
+ * @param flags - bits of the first byte above the prefix
+ */
+inline void hpack_encode_integer(std::string& out, std::uint8_t flags,
+                                 int prefix_bits, std::size_t value) {
+  const std::size_t max_prefix = (std::size_t{1} << prefix_bits) - 1;
+  if (value < max_prefix) {
+    out.push_back(static_cast<char>(flags | value));
+    return;
+  }
+
+  out.push_back(static_cast<char>(flags | max_prefix));
+  value -= max_prefix;
+  while (value >= 0x80) {
+    out.push_back(static_cast<char>((value & 0x7f) | 0x80));
+    value >>= 7;
+  }
+  out.push_back(static_cast<char>(value));
+}
+
+/**
+ * @brief hpack_decode_integer decodes HPACK integer with N-bit prefix from the
+ * front of input and removes it
+ * @return false if input is truncated or the integer exceeds 32 bits
+ */
+inline bool hpack_decode_integer(std::string_view& in, int prefix_bits,
+                                 std::size_t& value) noexcept {
+  if (std::empty(in))
+    return false;
+
+  const std::size_t max_prefix = (std::size_t{1} << prefix_bits) - 1;
+  value = static_cast<unsigned char>(in.front()) & max_prefix;
+  in.remove_prefix(1);
+  if (value < max_prefix)
+    return true;
+
+  for (int shift{}; shift <= 28; shift += 7) {
+    if (std::empty(in))
+      return false;
+
+    const auto byte = static_cast<unsigned char>(in.front());
+    in.remove_prefix(1);
+    value += static_cast<std::size_t>(byte & 0x7f) << shift;
+    if (!(byte & 0x80))
+      return value <= 0xffff'ffff;
+  }
+  return false;
+}
+
+/**
+ * @brief The HpackEncoder class encodes header fields as literals without
+ * indexing: the encoder has no dynamic table, so peer's table size does not
+ * matter. Names are lower cased, static table names are referenced by index
+ * and strings are Huffman encoded when it's shorter
+ */
+class HpackEncoder {
+  static void encode_string(std::string& out, std::string_view text) {
+    const std::size_t encoded_size = huffman_size(text);
+    if (encoded_size < std::size(text)) {
+      hpack_encode_integer(out, 0x80, 7, encoded_size);
+      return huffman_encode(text, out);
+    }
+
+    hpack_encode_integer(out, 0x00, 7, std::size(text));
+    out.append(text);
+  }
+
+  static void encode_name(std::string& out, std::string_view name) {
+    char lower[256];
+    if (std::size(name) > sizeof(lower)) {
+      std::string long_name(name);
+      for (auto& ch : long_name) {
+        ch = detail::to_lower(ch);
+      }
+      return encode_string(out, long_name);
+    }
+
+    for (std::size_t idx{}; idx < std::size(name); ++idx) {
+      lower[idx] = detail::to_lower(name[idx]);
+    }
+    encode_string(out, {lower, std::size(name)});
+  }
+
+public:
+  /**
+   * @brief encode_status appends :status, indexed for the statuses of the
+   * static table
+   */
+  static void encode_status(std::string& out, unsigned status) {
+    char digits[3]{static_cast<char>('0' + status / 100 % 10),
+                   static_cast<char>('0' + status / 10 % 10),
+                   static_cast<char>('0' + status % 10)};
+    const std::string_view value{digits, 3};
+
+    // :status entries are 8..14
+    for (std::size_t idx{7}; idx < 14; ++idx) {
+      if (detail::static_table[idx].second == value) {
+        return hpack_encode_integer(out, 0x80, 7, idx + 1);
+      }
+    }
+
+    hpack_encode_integer(out, 0x00, 4, 8);
+    encode_string(out, value);
+  }
+
+  /**
+   * @brief encode appends the field as literal without indexing
+   */
+  static void encode(std::string& out, std::string_view name,
+                     std::string_view value) {
+    std::size_t name_index{};
+    for (std::size_t idx{}; idx < std::size(detail::static_table); ++idx) {
+      if (detail::iequals(detail::static_table[idx].first, name)) {
+        name_index = idx + 1;
+        break;
+      }
+    }
+
+    hpack_encode_integer(out, 0x00, 4, name_index);
+    if (name_index == 0) {
+      encode_name(out, name);
+    }
+    encode_string(out, value);
+  }
+};
+
+/**
+ * @brief The HpackDecoder class decodes header blocks of one direction of a
+ * connection: it keeps the dynamic table between blocks
+ */
+class HpackDecoder {
+  std::deque<std::pair<std::string, std::string>> table_{};
+  std::size_t table_size_{};
+  std::size_t max_table_size_;
+  // SETTINGS_HEADER_TABLE_SIZE of the decoder's side
+  std::size_t table_size_limit_;
+
+  std::string name_{};
+  std::string value_{};
+
+  static constexpr std::size_t entry_overhead{32};
+
+  void evict(std::size_t max_size) {
+    while (table_size_ > max_size) {
+      const auto& [name, value] = table_.back();
+      table_size_ -= std::size(name) + std::size(value) + entry_overhead;
+      table_.pop_back();
+    }
+  }
+
+  void insert(std::string_view name, std::string_view value) {
+    const std::size_t entry_size =
+        std::size(name) + std::size(value) + entry_overhead;
+    if (entry_size > max_table_size_) {
+      // Not an error: the table becomes empty
+      evict(0);
+      return;
+    }
+
+    evict(max_table_size_ - entry_size);
+    table_.emplace_front(name, value);
+    table_size_ += entry_size;
+  }
+
+  bool field(std::size_t index, std::string_view& name,
+             std::string_view& value) const noexcept {
+    if (index == 0)
+      return false;
+    if (index <= std::size(detail::static_table)) {
+      std::tie(name, value) = detail::static_table[index - 1];
+      return true;
+    }
+
+    index -= std::size(detail::static_table) + 1;
+    if (index >= std::size(table_))
+      return false;
+    name = table_[index].first;
+    value = table_[index].second;
+    return true;
+  }
+
+  static bool decode_string(std::string_view& in, std::string& out) {
+    if (std::empty(in))
+      return false;
+
+    const bool huffman = static_cast<unsigned char>(in.front()) & 0x80;
+    std::size_t length{};
+    if (!hpack_decode_integer(in, 7, length) || length > std::size(in))
+      return false;
+
+    const auto encoded = in.substr(0, length);
+    in.remove_prefix(length);
+
+    out.clear();
+    if (huffman)
+      return huffman_decode(encoded, out);
+
+    out.assign(encoded);
+    return true;
+  }
+
+public:
+  /**
+   * @param table_size_limit - SETTINGS_HEADER_TABLE_SIZE sent to the peer
+   */
+  explicit HpackDecoder(std::size_t table_size_limit = 4096)
+      : max_table_size_{table_size_limit},
+        table_size_limit_{table_size_limit} {}
+
+  std::size_t table_size() const noexcept { return table_size_; }
+
+  /**
+   * @brief decode decodes complete header block
+   * @param on_field - void(std::string_view name, std::string_view value),
+   * views are valid during the call
+   * @return false on compression error: the connection can't be used anymore
+   */
+  template <typename Callback>
+  bool decode(std::string_view block, Callback&& on_field) {
+    bool fields_seen{};
+    while (!std::empty(block)) {
+      const auto first = static_cast<unsigned char>(block.front());
+
+      // Indexed field
+      if (first & 0x80) {
+        std::size_t index{};
+        std::string_view name, value;
+        if (!hpack_decode_integer(block, 7, index) ||
+            !field(index, name, value))
+          return false;
+        on_field(name, value);
+        fields_seen = true;
+        continue;
+      }
+
+      // Dynamic table size update, only at the beginning of the block
+      if ((first & 0xe0) == 0x20) {
+        std::size_t size{};
+        if (fields_seen || !hpack_decode_integer(block, 5, size) ||
+            size > table_size_limit_)
+          return false;
+        max_table_size_ = size;
+        evict(max_table_size_);
+        continue;
+      }
+
+      // Literal with incremental indexing, without indexing or never indexed
+      const bool indexing = (first & 0xc0) == 0x40;
+      std::size_t name_index{};
+      if (!hpack_decode_integer(block, indexing ? 6 : 4, name_index))
+        return false;
+
+      if (name_index == 0) {
+        if (!decode_string(block, name_))
+          return false;
+      } else {
+        std::string_view name, _;
+        if (!field(name_index, name, _))
+          return false;
+        name_.assign(name);
+      }
+
+      if (!decode_string(block, value_))
+        return false;
+
+      on_field(std::string_view{name_}, std::string_view{value_});
+      fields_seen = true;
+
+      if (indexing) {
+        insert(name_, value_);
+      }
+    }
+    return true;
+  }
+};
+
+} // namespace util
+} // namespace rest_in_beast
+
+#endif // REST_IN_BEAST_HPACK_HPP
@@ -0,0 +1,243 @@
+//
+// Author: Dmitriy Gavryushin (https://github.com/Gawrjuschin)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#ifndef REST_IN_BEAST_QUERY_HPP
+#define REST_IN_BEAST_QUERY_HPP
+
+#include <cstddef>
+#include <iterator>
+#include <optional>
+#include <string_view>
+#include <utility>
+
+namespace rest_in_beast {
+namespace util {
+
+namespace detail {
+constexpr int hex_value(char ch) noexcept {
+  if (ch >= '0' && ch <= '9')
+    return ch - '0';
+  if (ch >= 'a' && ch <= 'f')
+    return ch - 'a' + 10;
+  if (ch >= 'A' && ch <= 'F')
+    return ch - 'A' + 10;
+  return -1;
+}
+
+/**
+ * @brief decode_at decodes one character of urlencoded text at pos
+ * @return decoded character and length of it's encoding. Malformed escape
+ * sequences are kept as is
+ */
+constexpr std::pair<char, std::size_t> decode_at(std::string_view raw,
+                                                 std::size_t pos) noexcept {
+  if (raw[pos] == '+')
+    return {' ', 1};
+
+  if (raw[pos] == '%' && pos + 2 < std::size(raw)) {
+    const int hi = hex_value(raw[pos + 1]);
+    const int lo = hex_value(raw[pos + 2]);
+    if (hi >= 0 && lo >= 0)
+      return {static_cast<char>((hi << 4) | lo), 3};
+  }
+
+  return {raw[pos], 1};
+}
+} // namespace detail
+
+/**
+ * @brief query_of extracts query string from request target
+ * @param target - request target like "/path?key=value#fragment"
+ * @return "key=value" or empty view
+ */
+constexpr std::string_view query_of(std::string_view target) noexcept {
+  const auto question = target.find('?');
+  if (question == std::string_view::npos)
+    return {};
+
+  const auto query = target.substr(question + 1);
+  return query.substr(0, query.find('#'));
+}
+
+/**
+ * @brief needs_decoding - checks if urlencoded text contains escapes
+ */
+constexpr bool needs_decoding(std::string_view raw) noexcept {
+  return raw.find_first_of("%+") != std::string_view::npos;
+}
+
+/**
+ * @brief url_decode decodes urlencoded text ('+' is a space, %XX is a byte)
+ * @param raw - encoded text
+ * @param out_it - output iterator
+ * @return output iterator past the last written character
+ */
+template <typename OutputIt>
+constexpr OutputIt url_decode(std::string_view raw, OutputIt out_it) {
+  for (std::size_t pos{}; pos < std::size(raw);) {
+    const auto [ch, len] = detail::decode_at(raw, pos);
+    *out_it++ = ch;
+    pos += len;
+  }
+  return out_it;
+}
+
+/**
+ * @brief url_decode decodes urlencoded text into caller's buffer. Decoded text
+ * is never longer than encoded one, so buffer of std::size(raw) is enough
+ * @param raw - encoded text
+ * @param buffer - at least std::size(raw) characters
+ * @return decoded text in the buffer
+ */
+constexpr std::string_view url_decode(std::string_view raw, char* buffer) {
+  const char* last = url_decode<char*>(raw, buffer);
+  return {buffer, static_cast<std::size_t>(last - buffer)};
+}
+
+/**
+ * @brief decoded_equal compares urlencoded text with plain text without
+ * decoding it into any buffer
+ */
+constexpr bool decoded_equal(std::string_view raw,
+                             std::string_view plain) noexcept {
+  std::size_t idx{};
+  for (std::size_t pos{}; pos < std::size(raw); ++idx) {
+    if (idx == std::size(plain))
+      return false;
+
+    const auto [ch, len] = detail::decode_at(raw, pos);
+    if (ch != plain[idx])
+      return false;
+    pos += len;
+  }
+  return idx == std::size(plain);
+}
+
+/**
+ * @brief The QueryIterator class tokenizes query string or
+ * application/x-www-form-urlencoded body into raw (still encoded) key-value
+ * pairs. Empty pairs ("a=1&&b=2") are skipped, pair without '=' has empty value
+ */
+class QueryIterator {
+  std::string_view tail_{};
+  std::string_view current_{};
+
+  constexpr void next() noexcept {
+    while (!std::empty(tail_)) {
+      const auto amp = tail_.find('&');
+      current_ = tail_.substr(0, amp);
+      tail_ = amp == std::string_view::npos ? std::string_view{}
+                                            : tail_.substr(amp + 1);
+      if (!std::empty(current_))
+        return;
+    }
+    current_ = {};
+  }
+
+public:
+  /**
+   * @brief The Param class is a key-value pair of views into the source text
+   */
+  struct Param {
+    std::string_view key;
+    std::string_view value;
+  };
+
+  using value_type = Param;
+  using difference_type = std::ptrdiff_t;
+  using pointer = const Param*;
+  using reference = Param;
+  using iterator_category = std::input_iterator_tag;
+
+  constexpr QueryIterator() = default;
+
+  constexpr QueryIterator(std::string_view query) : tail_{query} { next(); }
+
+  constexpr QueryIterator& operator++() noexcept {
+    next();
+    return *this;
+  }
+
+  constexpr QueryIterator operator++(int) noexcept {
+    const auto it = *this;
+    ++(*this);
+    return it;
+  }
+
+  constexpr value_type operator*() const noexcept {
+    const auto eq = current_.find('=');
+    if (eq == std::string_view::npos)
+      return {current_, {}};
+
+    return {current_.substr(0, eq), current_.substr(eq + 1)};
+  }
+
+  constexpr bool operator==(const QueryIterator& other) const noexcept {
+    return std::data(current_) == std::data(other.current_) &&
+           std::size(current_) == std::size(other.current_);
+  }
+
+  constexpr bool operator!=(const QueryIterator& other) const noexcept {
+    return !(*this == other);
+  }
+};
+// free functions like in std::filesystem::directory_iterator
+constexpr inline QueryIterator begin(QueryIterator it) noexcept { return it; }
+constexpr inline QueryIterator end(QueryIterator) noexcept { return {}; }
+
+/**
+ * @brief The QueryView class is a non-owning view of query string or
+ * application/x-www-form-urlencoded body with lookup by key. Lookup never
+ * allocates: encoded keys are compared character by character
+ */
+class QueryView {
+  std::string_view query_{};
+
+public:
+  constexpr QueryView() = default;
+
+  constexpr explicit QueryView(std::string_view query) : query_{query} {}
+
+  /**
+   * @brief from_target - view of request target's query string
+   */
+  static constexpr QueryView from_target(std::string_view target) noexcept {
+    return QueryView{query_of(target)};
+  }
+
+  constexpr QueryIterator begin() const noexcept {
+    return QueryIterator{query_};
+  }
+  constexpr QueryIterator end() const noexcept { return {}; }
+
+  constexpr bool empty() const noexcept { return std::empty(query_); }
+
+  /**
+   * @brief find - first value of the key
+   * @param key - plain (decoded) key
+   * @return raw (encoded) value, decode it with url_decode if needs_decoding
+   */
+  constexpr std::optional<std::string_view>
+  find(std::string_view key) const noexcept {
+    for (const auto [raw_key, raw_value] : *this) {
+      const bool equal = needs_decoding(raw_key) ? decoded_equal(raw_key, key)
+                                                 : raw_key == key;
+      if (equal)
+        return raw_value;
+    }
+    return std::nullopt;
+  }
+
+  constexpr bool contains(std::string_view key) const noexcept {
+    return find(key).has_value();
+  }
+};
+
+} // namespace util
+} // namespace rest_in_beast
+
+#endif // REST_IN_BEAST_QUERY_HPP
@@ -0,0 +1,188 @@
+//
+// Author: Dmitriy Gavryushin (https://github.com/Gawrjuschin)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#ifndef REST_IN_BEAST_ROUTE_TABLE_HPP
+#define REST_IN_BEAST_ROUTE_TABLE_HPP
+
+#include "hasher.hpp"
+
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <string_view>
+#include <utility>
+
+namespace rest_in_beast {
+namespace util {
+
+/**
+ * @brief The StaticRouteTable class is a perfect hash of a fixed set of paths
+ * built in compile time (hash and displace scheme).
+ *
+ * Path hash selects a bucket and the bucket's displacement moves the path to
+ * it's own slot, so lookup is one hash, two array reads and one string
+ * comparison. No runtime table construction when declared constexpr:
+ *
+ * constexpr StaticRouteTable routes{std::array<std::string_view, 3>{
+ *     "/", "/users", "/orders"}};
+ * static_assert(routes.find("/users") == 1);
+ */
+template <std::size_t N> class StaticRouteTable {
+  static_assert(N > 0, "route table must contain at least one path");
+
+public:
+  using index_type = std::uint32_t;
+
+  // Load factor <= 1/2 and ~4 paths per bucket make displacement search fast
+  static constexpr std::size_t slots_count{std::bit_ceil(N) * 2};
+  static constexpr std::size_t buckets_count{std::bit_ceil((N + 3) / 4)};
+
+  /**
+   * @brief npos is returned by find for unknown paths
+   */
+  static constexpr std::size_t npos{N};
+
+private:
+  static constexpr std::uint64_t max_seeds{1 << 16};
+
+  std::array<std::string_view, N> paths_{};
+  std::array<index_type, slots_count> slots_{};
+  std::array<index_type, buckets_count> displacements_{};
+  std::uint64_t seed_{};
+
+  static constexpr std::size_t bucket_of(std::uint64_t h) noexcept {
+    return static_cast<std::size_t>(h >> 32) & (buckets_count - 1);
+  }
+
+  static constexpr std::size_t slot_of(std::uint64_t h,
+                                       index_type displacement) noexcept {
+    return (static_cast<index_type>(h) ^ displacement) & (slots_count - 1);
+  }
+
+  // Tries to place all paths with the seed. Returns false if the seed does not
+  // produce perfect hash
+  constexpr bool try_build(std::uint64_t seed) {
+    std::array<std::uint64_t, N> hashes{};
+    std::array<std::size_t, buckets_count> bucket_sizes{};
+    for (std::size_t idx{}; idx < N; ++idx) {
+      hashes[idx] = hash_bytes(paths_[idx], seed);
+      ++bucket_sizes[bucket_of(hashes[idx])];
+    }
+
+    // The biggest buckets first: they are the hardest to place
+    std::array<std::size_t, buckets_count> order{};
+    for (std::size_t idx{}; idx < buckets_count; ++idx) {
+      order[idx] = idx;
+    }
+    for (std::size_t idx{1}; idx < buckets_count; ++idx) {
+      for (std::size_t pos{idx};
+           pos > 0 && bucket_sizes[order[pos - 1]] < bucket_sizes[order[pos]];
+           --pos) {
+        std::swap(order[pos - 1], order[pos]);
+      }
+    }
+
+    slots_.fill(static_cast<index_type>(npos));
+    displacements_.fill(0);
+
+    for (const auto bucket : order) {
+      if (bucket_sizes[bucket] == 0)
+        break;
+
+      bool placed{false};
+      for (index_type displacement{}; displacement < slots_count && !placed;
+           ++displacement) {
+        placed = true;
+        for (std::size_t idx{}; idx < N && placed; ++idx) {
+          if (bucket_of(hashes[idx]) != bucket)
+            continue;
+
+          auto& slot = slots_[slot_of(hashes[idx], displacement)];
+          if (slot == npos) {
+            slot = static_cast<index_type>(idx);
+          } else {
+            placed = false;
+          }
+        }
+
+        if (placed) {
+          displacements_[bucket] = displacement;
+        } else {
+          // rollback partially placed bucket
+          for (auto& slot : slots_) {
+            if (slot != npos && bucket_of(hashes[slot]) == bucket)
+              slot = static_cast<index_type>(npos);
+          }
+        }
+      }
+
+      if (!placed)
+        return false;
+    }
+
+    seed_ = seed;
+    return true;
+  }
+
+public:
+  /**
+   * @brief StaticRouteTable constructor builds perfect hash of paths. Throws
+   * std::invalid_argument on duplicated paths (compile error in constant
+   * evaluation)
+   * @param paths - routes, index of the path in array is the result of find
+   */
+  constexpr explicit StaticRouteTable(
+      const std::array<std::string_view, N>& paths)
+      : paths_{paths} {
+    for (std::size_t lhs{}; lhs < N; ++lhs) {
+      for (std::size_t rhs{lhs + 1}; rhs < N; ++rhs) {
+        if (paths_[lhs] == paths_[rhs])
+          throw std::invalid_argument{"duplicated path in route table"};
+      }
+    }
+
+    for (std::uint64_t seed{}; seed < max_seeds; ++seed) {
+      if (try_build(seed))
+        return;
+    }
+
+    throw std::invalid_argument{"failed to build route table"};
+  }
+
+  /**
+   * @brief find - perfect hash lookup
+   * @param path - request target without query
+   * @return index of path or npos
+   */
+  [[nodiscard]] constexpr std::size_t
+  find(std::string_view path) const noexcept {
+    const auto h = hash_bytes(path, seed_);
+    const auto idx = slots_[slot_of(h, displacements_[bucket_of(h)])];
+
+    if (idx != npos && paths_[idx] == path)
+      return idx;
+
+    return npos;
+  }
+
+  [[nodiscard]] constexpr std::string_view path(std::size_t idx) const {
+    return paths_[idx];
+  }
+
+  [[nodiscard]] static constexpr std::size_t size() noexcept { return N; }
+};
+
+template <std::size_t N>
+StaticRouteTable(const std::array<std::string_view, N>&)
+    -> StaticRouteTable<N>;
+
+} // namespace util
+} // namespace rest_in_beast
+
+#endif // REST_IN_BEAST_ROUTE_TABLE_HPP
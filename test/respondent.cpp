@@ -0,0 +1,349 @@
+//
+// Author: Dmitriy Gavryushin (https://github.com/Gawrjuschin)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#define BOOST_TEST_MODULE RespondentTests
+#include <boost/test/unit_test.hpp>
+
+#include <rest_in_beast/coalescing.hpp>
+#ifdef REST_IN_BEAST_ENABLE_COMPRESSION
+#include <rest_in_beast/compression.hpp>
+#endif
+#include <rest_in_beast/middleware.hpp>
+#include <rest_in_beast/router.hpp>
+
+#include <boost/asio/buffer.hpp>
+#include <boost/beast/http.hpp>
+#include <boost/beast/version.hpp>
+
+#include <memory>
+#include <memory_resource>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <utility>
+
+namespace rib = rest_in_beast;
+namespace http = boost::beast::http;
+
+using namespace std::string_view_literals;
+
+namespace test {
+using string_request = http::request<http::string_body>;
+using string_response = http::response<http::string_body>;
+
+/**
+ * @brief serialize - writes message generator's output to string
+ */
+inline std::string serialize(http::message_generator&& generator) {
+  std::string out;
+  boost::beast::error_code ec;
+  for (;;) {
+    const auto buffers = generator.prepare(ec);
+    BOOST_REQUIRE(not ec.failed());
+
+    const auto size = boost::asio::buffer_size(buffers);
+    if (size == 0)
+      break;
+
+    for (const auto& buffer : buffers) {
+      out.append(static_cast<const char*>(buffer.data()), buffer.size());
+    }
+    generator.consume(size);
+  }
+  return out;
+}
+
+inline http::message_generator text_response(http::status status,
+                                             std::string_view text) {
+  string_response response{status, 11};
+  response.body() = text;
+  response.prepare_payload();
+  return response;
+}
+
+inline http::message_generator index_handler(string_request&&) {
+  return text_response(http::status::ok, "index");
+}
+
+inline http::message_generator users_handler(string_request&&) {
+  return text_response(http::status::ok, "users");
+}
+
+inline http::message_generator not_found_handler(string_request&&) {
+  return text_response(http::status::not_found, "not found");
+}
+
+/**
+ * @brief The AuthFilter class rejects requests without authorization
+ */
+struct AuthFilter {
+  std::size_t rejected{};
+
+  template <typename Next>
+  http::message_generator operator()(string_request&& request, Next next) {
+    if (request[http::field::authorization] != "secret") {
+      ++rejected;
+      return text_response(http::status::unauthorized, "denied");
+    }
+    return next(std::move(request));
+  }
+};
+
+inline bool body_is(http::message_generator&& generator,
+                    std::string_view body) {
+  return serialize(std::move(generator)).ends_with(body);
+}
+
+#ifdef REST_IN_BEAST_ENABLE_COMPRESSION
+/**
+ * @brief inflate - decompresses gzip or deflate body
+ */
+inline std::string inflate(std::string_view compressed) {
+  z_stream stream{};
+  // 32 detects gzip or zlib wrapper
+  BOOST_REQUIRE(::inflateInit2(&stream, 15 + 32) == Z_OK);
+
+  std::string out(1 << 20, '\0');
+  stream.next_in =
+      reinterpret_cast<Bytef*>(const_cast<char*>(std::data(compressed)));
+  stream.avail_in = static_cast<uInt>(std::size(compressed));
+  stream.next_out = reinterpret_cast<Bytef*>(std::data(out));
+  stream.avail_out = static_cast<uInt>(std::size(out));
+
+  const int result = ::inflate(&stream, Z_FINISH);
+  out.resize(stream.total_out);
+  ::inflateEnd(&stream);
+  BOOST_REQUIRE(result == Z_STREAM_END);
+  return out;
+}
+#endif // REST_IN_BEAST_ENABLE_COMPRESSION
+
+inline std::string page_text() {
+  std::string text;
+  for (int idx{}; idx < 200; ++idx) {
+    text += "<li>item " + std::to_string(idx) + "</li>\n";
+  }
+  return text;
+}
+
+/**
+ * @brief The PageRespondent class fills text page with ETag
+ */
+class PageRespondent : public rib::Respondent {
+public:
+  std::string page{page_text()};
+
+  http::message_generator make_response(string_request&&) override {
+    return text_response(http::status::ok, "unused");
+  }
+
+  bool fill_response(rib::RequestView,
+                     rib::reusable_response& response) override {
+    response.set(http::field::content_type, "text/html; charset=utf-8");
+    response.set(http::field::etag, "\"v1\"");
+    response.body() = page;
+    return true;
+  }
+};
+} // namespace test
+
+BOOST_AUTO_TEST_SUITE(router)
+
+BOOST_AUTO_TEST_CASE(dispatch_by_path) {
+  constexpr rib::util::StaticRouteTable routes{std::array{"/"sv, "/users"sv}};
+
+  auto router = rib::StaticRouter<2>::make_shared(
+      routes, {&test::index_handler, &test::users_handler},
+      &test::not_found_handler);
+
+  BOOST_REQUIRE(test::body_is(
+      router->make_response({http::verb::get, "/", 11}), "index"));
+  BOOST_REQUIRE(test::body_is(
+      router->make_response({http::verb::get, "/users?id=1", 11}), "users"));
+  BOOST_REQUIRE(test::body_is(
+      router->make_response({http::verb::get, "/orders", 11}), "not found"));
+}
+
+BOOST_AUTO_TEST_SUITE_END();
+
+BOOST_AUTO_TEST_SUITE(middleware)
+
+BOOST_AUTO_TEST_CASE(filters_order) {
+  std::string trace;
+
+  auto pipeline = rib::make_pipeline(
+      [&trace](test::string_request&& request) {
+        trace += "handler;";
+        return test::index_handler(std::move(request));
+      },
+      [&trace](test::string_request&& request, auto next) {
+        trace += "outer;";
+        return next(std::move(request));
+      },
+      [&trace](test::string_request&& request, auto next) {
+        trace += "inner;";
+        return next(std::move(request));
+      });
+
+  BOOST_REQUIRE(test::body_is(
+      pipeline->make_response({http::verb::get, "/", 11}), "index"));
+  BOOST_REQUIRE(trace == "outer;inner;handler;");
+}
+
+BOOST_AUTO_TEST_CASE(short_circuit) {
+  std::size_t handled{};
+  auto pipeline = rib::make_pipeline(
+      [&handled](test::string_request&& request) {
+        ++handled;
+        return test::index_handler(std::move(request));
+      },
+      test::AuthFilter{});
+
+  BOOST_REQUIRE(test::body_is(
+      pipeline->make_response({http::verb::get, "/", 11}), "denied"));
+
+  test::string_request authorized{http::verb::get, "/", 11};
+  authorized.set(http::field::authorization, "secret");
+  BOOST_REQUIRE(test::body_is(pipeline->make_response(std::move(authorized)),
+                              "index"));
+
+  BOOST_REQUIRE(handled == 1);
+  BOOST_REQUIRE(pipeline->filter<0>().rejected == 1);
+}
+
+BOOST_AUTO_TEST_SUITE_END();
+
+#ifdef REST_IN_BEAST_ENABLE_COMPRESSION
+BOOST_AUTO_TEST_SUITE(compression)
+
+BOOST_AUTO_TEST_CASE(negotiation) {
+  using rib::ContentCoding;
+  static_assert(rib::negotiate_coding("gzip, deflate, br") ==
+                ContentCoding::gzip);
+
+  BOOST_REQUIRE(rib::negotiate_coding("deflate") == ContentCoding::deflate);
+  BOOST_REQUIRE(rib::negotiate_coding("GZIP") == ContentCoding::gzip);
+  BOOST_REQUIRE(rib::negotiate_coding("gzip;q=0, deflate;q=0.5") ==
+                ContentCoding::deflate);
+  BOOST_REQUIRE(rib::negotiate_coding("gzip; q=0.0") ==
+                ContentCoding::identity);
+  BOOST_REQUIRE(rib::negotiate_coding("*") == ContentCoding::gzip);
+  BOOST_REQUIRE(rib::negotiate_coding("gzip;q=0, *") ==
+                ContentCoding::deflate);
+  BOOST_REQUIRE(rib::negotiate_coding("*;q=0") == ContentCoding::identity);
+  BOOST_REQUIRE(rib::negotiate_coding("br") == ContentCoding::identity);
+  BOOST_REQUIRE(rib::negotiate_coding("") == ContentCoding::identity);
+}
+
+BOOST_AUTO_TEST_CASE(compress_on_the_fly) {
+  const auto page = test::page_text();
+  const rib::CompressionOptions options{};
+
+  for (const auto& [accept, coding] :
+       {std::pair{"gzip", "gzip"}, std::pair{"deflate", "deflate"}}) {
+    test::string_request request{http::verb::get, "/", 11};
+    request.set(http::field::accept_encoding, accept);
+
+    test::string_response response{http::status::ok, 11};
+    response.set(http::field::content_type, "text/html");
+    response.body() = page;
+
+    BOOST_REQUIRE(rib::compress_response(request, response, options));
+    BOOST_REQUIRE(response[http::field::content_encoding] == coding);
+    BOOST_REQUIRE(response[http::field::vary] == "Accept-Encoding");
+    BOOST_REQUIRE(std::size(response.body()) < std::size(page));
+    BOOST_REQUIRE(response[http::field::content_length] ==
+                  std::to_string(std::size(response.body())));
+    BOOST_REQUIRE(test::inflate(response.body()) == page);
+  }
+
+  test::string_request request{http::verb::get, "/", 11};
+  request.set(http::field::accept_encoding, "gzip");
+
+  // Small body
+  test::string_response small{http::status::ok, 11};
+  small.set(http::field::content_type, "text/plain");
+  small.body() = "small";
+  BOOST_REQUIRE(!rib::compress_response(request, small, options));
+  BOOST_REQUIRE(small.body() == "small");
+
+  // Compressed format
+  test::string_response image{http::status::ok, 11};
+  image.set(http::field::content_type, "image/png");
+  image.body() = page;
+  BOOST_REQUIRE(!rib::compress_response(request, image, options));
+  BOOST_REQUIRE(image.count(http::field::content_encoding) == 0);
+}
+
+BOOST_AUTO_TEST_CASE(cached_variants) {
+  const auto cache = rib::CompressionCache::make_shared();
+  const auto page_respondent = std::make_shared<test::PageRespondent>();
+  const auto respondent = rib::CompressingRespondent::make_shared(
+      page_respondent, {.cache = cache});
+
+  test::string_request request{http::verb::get, "/", 11};
+  request.set(http::field::accept_encoding, "gzip, deflate");
+
+  std::pmr::unsynchronized_pool_resource pool;
+  rib::reusable_response response{
+      std::piecewise_construct, std::make_tuple(),
+      std::make_tuple(std::pmr::polymorphic_allocator<char>{&pool})};
+
+  std::string first;
+  for (int idx{}; idx < 2; ++idx) {
+    response.base().clear();
+    response.body().clear();
+    BOOST_REQUIRE(respondent->fill_response(request, response));
+    BOOST_REQUIRE(response[http::field::content_encoding] == "gzip");
+    BOOST_REQUIRE(response[http::field::etag] == "\"v1-gzip\"");
+    BOOST_REQUIRE(test::inflate(response.body()) == page_respondent->page);
+    if (idx == 0) {
+      first = response.body();
+    }
+    BOOST_REQUIRE(response.body() == first);
+  }
+  BOOST_REQUIRE(cache->size() == 1);
+
+  // Changed body under the same key is compressed again
+  page_respondent->page += "<li>new item</li>\n";
+  response.base().clear();
+  BOOST_REQUIRE(respondent->fill_response(request, response));
+  BOOST_REQUIRE(test::inflate(response.body()) == page_respondent->page);
+  BOOST_REQUIRE(cache->size() == 1);
+}
+
+BOOST_AUTO_TEST_SUITE_END();
+#endif // REST_IN_BEAST_ENABLE_COMPRESSION
+
+BOOST_AUTO_TEST_SUITE(coalescing)
+
+BOOST_AUTO_TEST_CASE(shares_response) {
+  const auto loader = [](rib::RequestView, rib::shared_response_handler) {};
+  const test::string_request get{http::verb::get, "/popular", 11};
+  const test::string_request post{http::verb::post, "/popular", 11};
+
+  // Default key takes GET requests only
+  const auto by_target = rib::CoalescingRespondent::make_shared(
+      std::make_shared<test::PageRespondent>(), loader);
+  BOOST_REQUIRE(by_target->shares_response(get));
+  BOOST_REQUIRE(!by_target->shares_response(post));
+
+  // Custom key is asked
+  const auto by_key = rib::CoalescingRespondent::make_shared(
+      std::make_shared<test::PageRespondent>(), loader,
+      [](rib::RequestView request) {
+        return request.method() == http::verb::post ? std::string{"post"}
+                                                    : std::string{};
+      });
+  BOOST_REQUIRE(!by_key->shares_response(get));
+  BOOST_REQUIRE(by_key->shares_response(post));
+
+  // Plain respondent never takes shared responses
+  BOOST_REQUIRE(!test::PageRespondent{}.shares_response(get));
+}
+
+BOOST_AUTO_TEST_SUITE_END();
@@ -21,31 +21,177 @@
 #include "support/test_signal_handler.hpp"
 #include "support/test_ssl_util.hpp"
 
+#include <rest_in_beast/admission.hpp>
+#include <rest_in_beast/alpn.hpp>
+#include <rest_in_beast/async_logger.hpp>
+#include <rest_in_beast/coalescing.hpp>
+#include <rest_in_beast/context_pool.hpp>
 #include <rest_in_beast/detail/logger.hpp>
 #include <rest_in_beast/detail/respondent.hpp>
+#include <rest_in_beast/file_respondent.hpp>
+#include <rest_in_beast/handoff.hpp>
+#include <rest_in_beast/handshake_pool.hpp>
+#include <rest_in_beast/load_shedding.hpp>
+#include <rest_in_beast/metrics.hpp>
+#include <rest_in_beast/rate_limit.hpp>
+#include <rest_in_beast/runner.hpp>
 #include <rest_in_beast/server.hpp>
+#include <rest_in_beast/sni.hpp>
+#include <rest_in_beast/tls_resumption.hpp>
 
 #include <boost/asio/ip/address.hpp>
+#include <boost/asio/post.hpp>
 #include <boost/asio/signal_set.hpp>
 #include <boost/beast/http.hpp>
 #include <boost/beast/version.hpp>
+#include <boost/beast/websocket.hpp>
+#include <boost/beast/websocket/ssl.hpp>
 
+#include <openssl/rand.h>
+
+#include <signal.h>
+
+#include <array>
+#include <atomic>
+#include <filesystem>
+#include <fstream>
 #include <future>
 #include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
 #include <thread>
+#include <vector>
 
 namespace rib = rest_in_beast;
 namespace net = boost::asio;
 namespace beast = boost::beast;
 
+/**
+ * @brief session_factory - session factory type of the server
+ */
+template <typename Server> struct session_factory;
+
+template <typename SessionFactory>
+struct session_factory<rib::detail::Server<SessionFactory>> {
+  using type = SessionFactory;
+};
+
 struct ServerFixture {
   const net::ip::tcp::endpoint endpoint{net::ip::make_address("127.0.0.1"),
                                         5000};
 
   std::shared_ptr<test::Respondent> respondent{
       test::Respondent::make_shared(test::responses_map())};
+
+  std::shared_ptr<test::ReusableRespondent> reusable_respondent{
+      test::ReusableRespondent::make_shared(test::responses_map())};
+
+  /**
+   * @brief serve starts the server with the factory and runs io_ctx in the
+   * server's thread while the client works. Then io_ctx is stopped and
+   * exception of the thread is rethrown
+   * @param client - called with io_ctx and the server
+   */
+  template <typename Server, typename Client>
+  void serve(net::io_context& io_ctx,
+             typename session_factory<Server>::type factory, Client client) {
+    auto logger = factory.logger;
+
+    net::signal_set signals(io_ctx, SIGINT);
+    signals.async_wait(test::SignalsHandler{io_ctx, logger});
+
+    test::ASIOThread server_worker{io_ctx};
+    std::thread server_thread{server_worker.thread_body()};
+
+    // Server's thread is joined when the client fails too
+    try {
+      client(io_ctx, Server::start(io_ctx, endpoint, std::move(logger),
+                                   std::move(factory)));
+    } catch (...) {
+      io_ctx.stop();
+      server_thread.join();
+      throw;
+    }
+
+    io_ctx.stop();
+    server_thread.join();
+
+    BOOST_REQUIRE(not server_worker.thread_exception);
+    if (server_worker.thread_exception) {
+      std::rethrow_exception(server_worker.thread_exception);
+    }
+  }
+
+  /**
+   * @brief serve - as above with io_context of it's own
+   */
+  template <typename Server, typename Client>
+  void serve(typename session_factory<Server>::type factory, Client client) {
+    net::io_context io_ctx;
+    serve<Server>(io_ctx, std::move(factory), std::move(client));
+  }
 };
 
+/**
+ * @brief wait_ready - result of the client, required within five seconds
+ */
+template <typename T> T wait_ready(std::future<T> future) {
+  BOOST_REQUIRE(future.valid());
+  BOOST_REQUIRE(std::future_status::ready ==
+                future.wait_for(std::chrono::seconds{5}));
+  return future.get();
+}
+
+/**
+ * @brief require_responses compares statuses and bodies of the responses
+ */
+void require_responses(const std::vector<test::string_response>& expected,
+                       const std::vector<test::string_response>& received) {
+  BOOST_REQUIRE(std::size(received) == std::size(expected));
+
+  for (std::size_t idx{}; idx < std::size(expected); ++idx) {
+    BOOST_REQUIRE(expected[idx].result() == received[idx].result());
+    BOOST_REQUIRE(expected[idx].body() == received[idx].body());
+  }
+}
+
+/**
+ * @brief websocket_echo sends text and binary messages and checks echo
+ */
+template <typename Stream>
+void websocket_echo(beast::websocket::stream<Stream>& ws) {
+  beast::flat_buffer buffer;
+  for (const auto& message : std::initializer_list<std::string>{
+           "hello", std::string(100'000, 'a'), "world"}) {
+    ws.text(true);
+    ws.write(net::buffer(message));
+    ws.read(buffer);
+    BOOST_REQUIRE(ws.got_text());
+    BOOST_REQUIRE(beast::buffers_to_string(buffer.data()) == message);
+    buffer.consume(buffer.size());
+  }
+
+  const std::string binary{"\x00\x01\x02", 3};
+  ws.binary(true);
+  ws.write(net::buffer(binary));
+  ws.read(buffer);
+  BOOST_REQUIRE(ws.got_binary());
+  BOOST_REQUIRE(beast::buffers_to_string(buffer.data()) == binary);
+
+  ws.close(beast::websocket::close_code::normal);
+}
+
+/**
+ * @brief wait_closed waits for the server side of WebSocket connections
+ */
+bool wait_closed(const test::EchoHandler& echo, std::size_t count) {
+  for (int idx{}; idx < 500 && echo.closed != count; ++idx) {
+    std::this_thread::sleep_for(std::chrono::milliseconds{10});
+  }
+  return echo.closed == count;
+}
+
 BOOST_FIXTURE_TEST_SUITE(server_tests, ServerFixture);
 
 BOOST_AUTO_TEST_CASE(plain_to_plain) {
@@ -92,6 +238,1016 @@ BOOST_AUTO_TEST_CASE(plain_to_plain) {
   }
 }
 
+BOOST_AUTO_TEST_CASE(plain_to_plain_reusable) {
+  auto server_logger = test::Logger::make_shared();
+  auto client_logger = test::MemoLogger::make_shared();
+
+  const auto [requests, responses] = test::requests_test_data();
+
+  serve<rib::PlainServer>(
+      {.respondent = reusable_respondent, .logger = server_logger},
+      [&](auto& io_ctx, const auto&) {
+        require_responses(responses,
+                          wait_ready(test::PlainClient::send(
+                              io_ctx, client_logger, endpoint, requests)));
+      });
+
+  BOOST_REQUIRE(not client_logger->last_ec().failed());
+}
+
+BOOST_AUTO_TEST_CASE(plain_to_plain_arena) {
+  auto server_logger = test::Logger::make_shared();
+  auto client_logger = test::MemoLogger::make_shared();
+
+  const auto [requests, responses] = test::requests_test_data();
+
+  serve<rib::PlainServer>(
+      {.respondent = respondent,
+       .logger = server_logger,
+       .request_arena_size = 4096},
+      [&](auto& io_ctx, const auto&) {
+        require_responses(responses,
+                          wait_ready(test::PlainClient::send(
+                              io_ctx, client_logger, endpoint, requests)));
+      });
+
+  BOOST_REQUIRE(not client_logger->last_ec().failed());
+}
+
+BOOST_AUTO_TEST_CASE(plain_to_plain_reusable_arena) {
+  auto server_logger = test::Logger::make_shared();
+  auto client_logger = test::MemoLogger::make_shared();
+
+  const auto [requests, responses] = test::requests_test_data();
+
+  serve<rib::PlainServer>(
+      {.respondent = reusable_respondent,
+       .logger = server_logger,
+       .request_arena_size = 4096},
+      [&](auto& io_ctx, const auto&) {
+        require_responses(responses,
+                          wait_ready(test::PlainClient::send(
+                              io_ctx, client_logger, endpoint, requests)));
+      });
+
+  BOOST_REQUIRE(not client_logger->last_ec().failed());
+}
+
+/**
+ * @brief The BaselineFactory class is a custom factory written against
+ * start_session(socket): it has no optional members of the library's ones
+ */
+struct BaselineFactory {
+  std::shared_ptr<rib::Respondent> respondent;
+  std::shared_ptr<rib::Logger> logger;
+
+  void start_session(net::ip::tcp::socket&& peer) {
+    rib::detail::PlainSessionFactory{.respondent = respondent, .logger = logger}
+        .start_session(std::move(peer), {});
+  }
+};
+
+BOOST_AUTO_TEST_CASE(plain_custom_factory) {
+  auto server_logger = test::Logger::make_shared();
+  auto client_logger = test::MemoLogger::make_shared();
+
+  const auto [requests, responses] = test::requests_test_data();
+
+  serve<rib::detail::Server<BaselineFactory>>(
+      {.respondent = respondent, .logger = server_logger},
+      [&](auto& io_ctx, const auto&) {
+        require_responses(responses,
+                          wait_ready(test::PlainClient::send(
+                              io_ctx, client_logger, endpoint, requests)));
+      });
+
+  BOOST_REQUIRE(not client_logger->last_ec().failed());
+}
+
+BOOST_AUTO_TEST_CASE(plain_websocket) {
+  auto server_logger = test::Logger::make_shared();
+
+  const auto ws_respondent{
+      test::WebSocketRespondent::make_shared(test::responses_map())};
+
+  serve<rib::PlainServer>(
+      {.respondent = ws_respondent, .logger = server_logger},
+      [&](auto&, const auto&) {
+        net::io_context client_ctx;
+        {
+          beast::websocket::stream<net::ip::tcp::socket> ws{client_ctx};
+          beast::websocket::permessage_deflate deflate;
+          deflate.client_enable = true;
+          ws.set_option(deflate);
+
+          ws.next_layer().connect(endpoint);
+          beast::websocket::response_type response;
+          ws.handshake(response, "127.0.0.1", "/echo");
+          BOOST_REQUIRE(
+              response[beast::http::field::sec_websocket_extensions]
+                  .starts_with("permessage-deflate"));
+          websocket_echo(ws);
+        }
+
+        // Rejected upgrade is answered by make_response
+        {
+          beast::websocket::stream<net::ip::tcp::socket> ws{client_ctx};
+          ws.next_layer().connect(endpoint);
+
+          beast::websocket::response_type response;
+          beast::error_code ec;
+          ws.handshake(response, "127.0.0.1", "/", ec);
+          BOOST_REQUIRE(ec == beast::websocket::error::upgrade_declined);
+          BOOST_REQUIRE(response.result() == beast::http::status::ok);
+        }
+
+        BOOST_REQUIRE(wait_closed(*ws_respondent->echo, 1));
+      });
+}
+
+BOOST_AUTO_TEST_CASE(plain_websocket_buffered) {
+  auto server_logger = test::Logger::make_shared();
+
+  const auto ws_respondent{
+      test::WebSocketRespondent::make_shared(test::responses_map())};
+
+  serve<rib::PlainServer>(
+      {.respondent = ws_respondent,
+       .logger = server_logger,
+       .request_arena_size = 4096},
+      [&](auto&, const auto&) {
+        net::io_context client_ctx;
+        net::ip::tcp::socket socket{client_ctx};
+        socket.connect(endpoint);
+
+        // Upgrade request and the first frame ("hi" masked with zero key) are
+        // read by the HTTP session together
+        const std::string upgrade{
+            "GET /echo HTTP/1.1\r\n"
+            "Host: 127.0.0.1\r\n"
+            "Upgrade: websocket\r\n"
+            "Connection: Upgrade\r\n"
+            "Sec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\n"
+            "Sec-WebSocket-Version: 13\r\n\r\n"};
+        const std::string frame{"\x81\x82\x00\x00\x00\x00hi", 8};
+        net::write(socket, net::buffer(upgrade + frame));
+
+        beast::flat_buffer buffer;
+        beast::http::response_parser<beast::http::empty_body> parser;
+        parser.skip(true);
+        beast::http::read(socket, buffer, parser);
+        BOOST_REQUIRE(parser.get().result() ==
+                      beast::http::status::switching_protocols);
+
+        while (buffer.size() < 4) {
+          buffer.commit(socket.read_some(buffer.prepare(64)));
+        }
+        BOOST_REQUIRE(beast::buffers_to_string(buffer.data()) == "\x81\x02hi");
+
+        socket.close();
+        BOOST_REQUIRE(wait_closed(*ws_respondent->echo, 1));
+      });
+}
+
+BOOST_AUTO_TEST_CASE(secure_websocket) {
+  auto server_logger = test::Logger::make_shared();
+
+  boost::asio::ssl::context server_ssl_ctx{test::make_server_ssl_ctx()};
+  boost::asio::ssl::context client_ssl_ctx{test::make_client_ssl_ctx()};
+
+  const auto ws_respondent{
+      test::WebSocketRespondent::make_shared(test::responses_map())};
+
+  serve<rib::SecureServer>(
+      {.ssl_ctx = server_ssl_ctx,
+       .respondent = ws_respondent,
+       .logger = server_logger},
+      [&]([[maybe_unused]] auto& io_ctx, const auto&) {
+        std::vector<net::ip::tcp::endpoint> servers{endpoint};
+#ifdef REST_IN_BEAST_KTLS
+        servers.emplace_back(endpoint.address(), endpoint.port() + 1);
+        rib::SecureServer::start(
+            io_ctx, servers.back(), server_logger,
+            {.ssl_ctx = server_ssl_ctx,
+             .respondent = ws_respondent,
+             .logger = server_logger,
+             .ktls = std::make_shared<rib::KtlsMetrics>()});
+#endif
+
+        net::io_context client_ctx;
+        for (const auto& server : servers) {
+          beast::websocket::stream<net::ssl::stream<net::ip::tcp::socket>> ws{
+              client_ctx, client_ssl_ctx};
+          beast::websocket::permessage_deflate deflate;
+          deflate.client_enable = true;
+          ws.set_option(deflate);
+
+          beast::get_lowest_layer(ws).connect(server);
+          ws.next_layer().handshake(net::ssl::stream_base::client);
+          ws.handshake("127.0.0.1", "/echo");
+          websocket_echo(ws);
+        }
+
+        BOOST_REQUIRE(wait_closed(*ws_respondent->echo, servers.size()));
+      });
+}
+
+BOOST_AUTO_TEST_CASE(plain_stream) {
+  auto server_logger = test::Logger::make_shared();
+
+  const auto stream_respondent{
+      test::StreamRespondent::make_shared(test::responses_map())};
+
+  serve<rib::PlainServer>(
+      {.respondent = stream_respondent, .logger = server_logger},
+      [&](auto&, const auto&) {
+        net::io_context client_ctx;
+        beast::http::request<beast::http::string_body> request{
+            beast::http::verb::get, "/events", 11};
+        request.set(beast::http::field::host, "127.0.0.1");
+        request.keep_alive(true);
+
+        {
+          net::ip::tcp::socket socket{client_ctx};
+          socket.connect(endpoint);
+          beast::http::write(socket, request);
+
+          beast::flat_buffer buffer;
+          beast::http::response_parser<beast::http::string_body> parser;
+          beast::http::read_header(socket, buffer, parser);
+          BOOST_REQUIRE(parser.get().chunked());
+          BOOST_REQUIRE(parser.get()[beast::http::field::content_type] ==
+                        "text/event-stream");
+
+          const auto channel = stream_respondent->wait_channel(0);
+          BOOST_REQUIRE(channel);
+
+          std::string expected;
+          for (const auto& data : {"first", "second\nline", "third"}) {
+            auto event = rib::StreamChannel::format_event(data, "update");
+            expected += event;
+            BOOST_REQUIRE(channel->push(std::move(event)) ==
+                          rib::StreamChannel::PushResult::queued);
+          }
+          channel->close();
+          BOOST_REQUIRE(channel->push("late") ==
+                        rib::StreamChannel::PushResult::closed);
+
+          beast::http::read(socket, buffer, parser);
+          BOOST_REQUIRE(parser.get().body() == expected);
+          BOOST_REQUIRE(expected.starts_with(
+              "event: update\ndata: first\n\nevent: update\ndata: second\n"
+              "data: line\n\n"));
+
+          // Connection is kept alive after the stream
+          request.target("/");
+          beast::http::write(socket, request);
+          test::string_response response;
+          beast::http::read(socket, buffer, response);
+          BOOST_REQUIRE(response.result() == beast::http::status::ok);
+        }
+
+        // Client's close ends idle stream
+        {
+          net::ip::tcp::socket socket{client_ctx};
+          socket.connect(endpoint);
+          request.target("/events");
+          beast::http::write(socket, request);
+
+          const auto channel = stream_respondent->wait_channel(1);
+          BOOST_REQUIRE(channel);
+          socket.close();
+
+          for (int idx{}; idx < 500 && channel->is_open(); ++idx) {
+            std::this_thread::sleep_for(std::chrono::milliseconds{10});
+          }
+          BOOST_REQUIRE(!channel->is_open());
+        }
+      });
+}
+
+BOOST_AUTO_TEST_CASE(plain_stream_slow_consumer) {
+  auto server_logger = test::Logger::make_shared();
+
+  const auto stream_respondent{
+      test::StreamRespondent::make_shared(test::responses_map())};
+  stream_respondent->max_queued_size = 65'536;
+  stream_respondent->overflow = rib::StreamChannel::Overflow::disconnect;
+
+  serve<rib::PlainServer>(
+      {.respondent = stream_respondent,
+       .logger = server_logger,
+       .request_arena_size = 4096},
+      [&](auto&, const auto&) {
+        net::io_context client_ctx;
+        net::ip::tcp::socket socket{client_ctx};
+        socket.connect(endpoint);
+
+        beast::http::request<beast::http::string_body> request{
+            beast::http::verb::get, "/events", 11};
+        request.set(beast::http::field::host, "127.0.0.1");
+        beast::http::write(socket, request);
+
+        const auto channel = stream_respondent->wait_channel(0);
+        BOOST_REQUIRE(channel);
+
+        // Client does not read: socket's buffers and then the queue are
+        // filled
+        const auto event = std::make_shared<const std::string>(
+            rib::StreamChannel::format_event(std::string(16'384, 'a')));
+        auto result = rib::StreamChannel::PushResult::queued;
+        for (int idx{}; idx < 100'000 &&
+                        result != rib::StreamChannel::PushResult::closed;
+             ++idx) {
+          result = channel->push(event);
+        }
+        BOOST_REQUIRE(result == rib::StreamChannel::PushResult::closed);
+        BOOST_REQUIRE(channel->dropped() == 1);
+        BOOST_REQUIRE(!channel->is_open());
+
+        // Stream is cut without the last chunk
+        beast::flat_buffer buffer;
+        beast::http::response_parser<beast::http::string_body> parser;
+        parser.body_limit(boost::none);
+        beast::error_code ec;
+        beast::http::read(socket, buffer, parser, ec);
+        BOOST_REQUIRE(ec);
+        BOOST_REQUIRE(!parser.is_done());
+      });
+}
+
+/**
+ * @brief get_body - GET request on a new connection
+ */
+std::string get_body(const net::ip::tcp::endpoint& endpoint,
+                     std::string_view target, beast::http::status& status) {
+  net::io_context client_ctx;
+  net::ip::tcp::socket socket{client_ctx};
+  socket.connect(endpoint);
+
+  beast::http::request<beast::http::string_body> request{
+      beast::http::verb::get, target, 11};
+  request.set(beast::http::field::host, "127.0.0.1");
+  beast::http::write(socket, request);
+
+  beast::flat_buffer buffer;
+  test::string_response response;
+  beast::http::read(socket, buffer, response);
+  status = response.result();
+  return response.body();
+}
+
+BOOST_AUTO_TEST_CASE(plain_coalescing) {
+  auto server_logger = test::Logger::make_shared();
+
+  // Loads are completed by the test
+  std::mutex loads_mutex;
+  std::vector<rib::shared_response_handler> loads;
+  const auto loads_count = [&] {
+    const std::scoped_lock lock{loads_mutex};
+    return std::size(loads);
+  };
+
+  const auto coalescing = rib::CoalescingRespondent::make_shared(
+      respondent,
+      [&](rib::RequestView, rib::shared_response_handler handler) {
+        const std::scoped_lock lock{loads_mutex};
+        loads.push_back(std::move(handler));
+      },
+      [](rib::RequestView request) {
+        return request.target() == "/popular" ? std::string{"popular"}
+                                              : std::string{};
+      });
+
+  serve<rib::PlainServer>(
+      {.respondent = coalescing,
+       .logger = server_logger,
+       .request_arena_size = 4096},
+      [&](auto&, const auto&) {
+        constexpr std::size_t clients{16};
+        std::vector<std::future<std::string>> bodies;
+        for (std::size_t idx{}; idx < clients; ++idx) {
+          bodies.push_back(std::async(std::launch::async, [this] {
+            beast::http::status status;
+            auto body = get_body(endpoint, "/popular", status);
+            BOOST_REQUIRE(status == beast::http::status::ok);
+            return body;
+          }));
+        }
+
+        for (int idx{}; idx < 500 && coalescing->coalesced() != clients - 1;
+             ++idx) {
+          std::this_thread::sleep_for(std::chrono::milliseconds{10});
+        }
+        BOOST_REQUIRE(coalescing->coalesced() == clients - 1);
+        BOOST_REQUIRE(loads_count() == 1);
+
+        // Not coalesced request is answered while the load is going on
+        beast::http::status status;
+        get_body(endpoint, "/", status);
+        BOOST_REQUIRE(status == beast::http::status::ok);
+
+        auto popular = std::make_shared<test::string_response>(
+            beast::http::status::ok, 11);
+        popular->body() = "popular";
+        popular->prepare_payload();
+        loads.front()(std::move(popular));
+
+        for (auto& body : bodies) {
+          BOOST_REQUIRE(body.get() == "popular");
+        }
+
+        // Completed load is not kept, failed load is answered by the
+        // respondent
+        auto failed = std::async(std::launch::async, [this, &status] {
+          return get_body(endpoint, "/popular", status);
+        });
+        for (int idx{}; idx < 500 && loads_count() != 2; ++idx) {
+          std::this_thread::sleep_for(std::chrono::milliseconds{10});
+        }
+        BOOST_REQUIRE(loads_count() == 2);
+        loads.back()(nullptr);
+        failed.get();
+        BOOST_REQUIRE(status == beast::http::status::not_found);
+        BOOST_REQUIRE(coalescing->loads() == 2);
+      });
+}
+
+BOOST_AUTO_TEST_CASE(plain_file_respondent) {
+  auto server_logger = test::Logger::make_shared();
+
+  const auto root =
+      std::filesystem::temp_directory_path() / "rest_in_beast_files";
+  std::filesystem::create_directories(root / "docs");
+  {
+    std::ofstream file{root / "docs" / "index.html", std::ios::binary};
+    file << "<p>index</p>";
+  }
+  {
+    std::ofstream file{root / "data.json", std::ios::binary};
+    file << R"({"file":true})";
+  }
+
+  boost::asio::io_context io_ctx;
+
+  const auto files = rib::FileRespondent::make_shared(
+      reusable_respondent, io_ctx.get_executor(), root, "/static/");
+  serve<rib::PlainServer>(
+      io_ctx, {.respondent = files, .logger = server_logger},
+      [&](auto&, const auto&) {
+        beast::http::status status;
+        BOOST_REQUIRE(get_body(endpoint, "/static/data.json", status) ==
+                      R"({"file":true})");
+        BOOST_REQUIRE(status == beast::http::status::ok);
+        BOOST_REQUIRE(get_body(endpoint, "/static/docs/", status) ==
+                      "<p>index</p>");
+        BOOST_REQUIRE(get_body(endpoint, "/static/d%61ta.json?v=1", status) ==
+                      R"({"file":true})");
+        BOOST_REQUIRE(files->served() == 3);
+
+        // Escaping the root, missing files and other targets go to the
+        // respondent
+        get_body(endpoint, "/static/docs/../../secret", status);
+        BOOST_REQUIRE(status == beast::http::status::not_found);
+        get_body(endpoint, "/static/missing.txt", status);
+        BOOST_REQUIRE(status == beast::http::status::not_found);
+        get_body(endpoint, "/", status);
+        BOOST_REQUIRE(status == beast::http::status::ok);
+        BOOST_REQUIRE(files->served() == 3);
+      });
+
+  std::filesystem::remove_all(root);
+}
+
+BOOST_AUTO_TEST_CASE(plain_metrics) {
+  auto server_logger = test::Logger::make_shared();
+
+  const auto metrics = rib::Metrics::make_shared();
+  constexpr std::size_t requests{3};
+
+  serve<rib::PlainServer>(
+      {.respondent = respondent, .logger = server_logger, .metrics = metrics},
+      [&](auto&, const auto&) {
+        beast::http::status status;
+        for (std::size_t idx{}; idx < requests; ++idx) {
+          get_body(endpoint, "/", status);
+          BOOST_REQUIRE(status == beast::http::status::ok);
+        }
+
+        // Exposition is not answered by the respondent
+        const auto exposition = get_body(endpoint, metrics->path(), status);
+        BOOST_REQUIRE(status == beast::http::status::ok);
+        BOOST_REQUIRE(exposition.find("rib_requests_total 4\n") !=
+                      std::string::npos);
+        BOOST_REQUIRE(exposition.find("rib_write_seconds_count 3\n") !=
+                      std::string::npos);
+      });
+
+  const auto snapshot = metrics->snapshot();
+  BOOST_REQUIRE(snapshot.counter(rib::Metrics::Counter::connections_opened) ==
+                requests + 1);
+  BOOST_REQUIRE(snapshot.histogram(rib::Metrics::Phase::accept).count ==
+                requests + 1);
+  BOOST_REQUIRE(snapshot.histogram(rib::Metrics::Phase::handler).count ==
+                requests + 1);
+  BOOST_REQUIRE(snapshot.counter(rib::Metrics::Counter::bytes_in) != 0);
+  BOOST_REQUIRE(snapshot.counter(rib::Metrics::Counter::bytes_out) != 0);
+
+  const auto& write = snapshot.histogram(rib::Metrics::Phase::write);
+  BOOST_REQUIRE(write.quantile(0.5) <= write.quantile(1.0));
+}
+
+BOOST_AUTO_TEST_CASE(plain_metrics_keep_alive) {
+  auto server_logger = test::Logger::make_shared();
+
+  const auto metrics = rib::Metrics::make_shared();
+
+  serve<rib::PlainServer>(
+      {.respondent = respondent, .logger = server_logger, .metrics = metrics},
+      [&](auto&, const auto&) {
+        // Wait for the next request of keep-alive connection is not read's
+        // latency
+        net::io_context client_ctx;
+        net::ip::tcp::socket socket{client_ctx};
+        socket.connect(endpoint);
+        beast::flat_buffer buffer;
+        for (int idx{}; idx < 2; ++idx) {
+          std::this_thread::sleep_for(std::chrono::milliseconds{200});
+
+          beast::http::request<beast::http::string_body> request{
+              beast::http::verb::get, "/", 11};
+          request.set(beast::http::field::host, "127.0.0.1");
+          beast::http::write(socket, request);
+
+          test::string_response response;
+          beast::http::read(socket, buffer, response);
+          BOOST_REQUIRE(response.result() == beast::http::status::ok);
+        }
+
+        boost::beast::error_code ec;
+        socket.shutdown(net::ip::tcp::socket::shutdown_both, ec);
+      });
+
+  const auto snapshot = metrics->snapshot();
+  const auto& read = snapshot.histogram(rib::Metrics::Phase::read);
+  BOOST_REQUIRE(read.count == 2);
+  BOOST_REQUIRE(read.quantile(1.0) < 100'000'000);
+}
+
+BOOST_AUTO_TEST_CASE(plain_async_logger) {
+  std::mutex log_mutex;
+  std::string log;
+  auto server_logger = rib::AsyncLogger::make_shared(
+      [&](std::string_view batch) {
+        const std::scoped_lock lock{log_mutex};
+        log.append(batch);
+      });
+
+  serve<rib::PlainServer>(
+      {.respondent = reusable_respondent, .logger = server_logger},
+      [&](auto&, const auto&) {
+        beast::http::status status;
+        get_body(endpoint, "/", status);
+        BOOST_REQUIRE(status == beast::http::status::ok);
+        get_body(endpoint, "/not_exist", status);
+        BOOST_REQUIRE(status == beast::http::status::not_found);
+
+        // Records are written by the logger's thread
+        for (int idx{}; idx < 500 && server_logger->written() < 2; ++idx) {
+          std::this_thread::sleep_for(std::chrono::milliseconds{10});
+        }
+      });
+
+  BOOST_REQUIRE(server_logger->dropped() == 0);
+
+  const std::scoped_lock lock{log_mutex};
+  BOOST_REQUIRE(log.find(" GET / 200 ") != std::string::npos);
+  BOOST_REQUIRE(log.find(" GET /not_exist 404 ") != std::string::npos);
+}
+
+BOOST_AUTO_TEST_CASE(plain_load_shedding) {
+  auto server_logger = test::Logger::make_shared();
+
+  boost::asio::io_context io_ctx;
+
+  const auto metrics = rib::Metrics::make_shared();
+  const auto monitor = rib::LagMonitor::start(
+      io_ctx,
+      {.interval = std::chrono::milliseconds{50},
+       .shed_lag = std::chrono::milliseconds{100},
+       .pause_lag = std::chrono::milliseconds{10'000}},
+      metrics);
+  const auto shedding =
+      rib::SheddingRespondent::make_shared(reusable_respondent, monitor);
+
+  std::uint64_t probes{};
+  serve<rib::PlainServer>(
+      io_ctx,
+      {.respondent = shedding,
+       .logger = server_logger,
+       .lag_monitor = monitor},
+      [&](auto&, const auto&) {
+        beast::http::status status;
+        get_body(endpoint, "/", status);
+        BOOST_REQUIRE(status == beast::http::status::ok);
+
+        // Blocked loop is seen before the probe runs
+        net::post(io_ctx, [] {
+          std::this_thread::sleep_for(std::chrono::milliseconds{300});
+        });
+        std::this_thread::sleep_for(std::chrono::milliseconds{200});
+        BOOST_REQUIRE(monitor->shedding());
+
+        get_body(endpoint, "/", status);
+        BOOST_REQUIRE(status == beast::http::status::service_unavailable);
+        BOOST_REQUIRE(shedding->shed() == 1);
+
+        // Lag of the next probes is back to normal
+        probes = monitor->probes();
+        for (int idx{}; idx < 500 && monitor->probes() < probes + 2; ++idx) {
+          std::this_thread::sleep_for(std::chrono::milliseconds{10});
+        }
+        get_body(endpoint, "/", status);
+        BOOST_REQUIRE(status == beast::http::status::ok);
+        BOOST_REQUIRE(shedding->shed() == 1);
+      });
+
+  const auto snapshot = metrics->snapshot();
+  BOOST_REQUIRE(snapshot.histogram(rib::Metrics::Phase::loop_lag).count >=
+                probes + 2);
+}
+
+BOOST_AUTO_TEST_CASE(plain_admission) {
+  auto server_logger = test::Logger::make_shared();
+
+  const auto metrics = rib::Metrics::make_shared();
+  const auto admission = rib::AdmissionControl::make_shared(
+      {.max_connections = 3, .max_per_address = 2});
+
+  serve<rib::PlainServer>(
+      {.respondent = reusable_respondent,
+       .logger = server_logger,
+       .metrics = metrics,
+       .admission = admission},
+      [&](auto&, const auto&) {
+        const auto wait_active = [&](std::size_t active) {
+          for (int idx{}; idx < 500 && admission->active() != active; ++idx) {
+            std::this_thread::sleep_for(std::chrono::milliseconds{10});
+          }
+          return admission->active() == active;
+        };
+
+        // Loopback accepts any 127.0.0.0/8 source address
+        net::io_context client_ctx;
+        const auto connect = [&](const char* address) {
+          net::ip::tcp::socket socket{client_ctx};
+          socket.open(net::ip::tcp::v4());
+          socket.bind({net::ip::make_address(address), 0});
+          socket.connect(endpoint);
+          return socket;
+        };
+
+        std::vector<net::ip::tcp::socket> idle;
+        idle.push_back(connect("127.0.0.1"));
+        idle.push_back(connect("127.0.0.1"));
+        BOOST_REQUIRE(wait_active(2));
+
+        // Third connection of the address is reset
+        {
+          auto socket = connect("127.0.0.1");
+          std::array<char, 1> byte{};
+          beast::error_code ec;
+          socket.read_some(net::buffer(byte), ec);
+          BOOST_REQUIRE(ec == net::error::connection_reset ||
+                        ec == net::error::eof);
+        }
+        BOOST_REQUIRE(admission->rejected() == 1);
+
+        // Another address reaches the global limit: next connection waits in
+        // the listen backlog until one is closed
+        idle.push_back(connect("127.0.0.2"));
+        BOOST_REQUIRE(wait_active(3));
+
+        beast::http::status status{};
+        auto waiting = std::async(std::launch::async, [this, &status] {
+          return get_body(endpoint, "/", status);
+        });
+        BOOST_REQUIRE(waiting.wait_for(std::chrono::milliseconds{200}) ==
+                      std::future_status::timeout);
+
+        idle.front().close();
+        waiting.get();
+        BOOST_REQUIRE(status == beast::http::status::ok);
+        BOOST_REQUIRE(admission->rejected() == 1);
+
+        idle.clear();
+        BOOST_REQUIRE(wait_active(0));
+      });
+
+  BOOST_REQUIRE(admission->admitted() == 4);
+  const auto snapshot = metrics->snapshot();
+  BOOST_REQUIRE(
+      snapshot.counter(rib::Metrics::Counter::connections_rejected) == 1);
+}
+
+BOOST_AUTO_TEST_CASE(plain_drain) {
+  auto server_logger = test::Logger::make_shared();
+
+  const auto stream_respondent{
+      test::StreamRespondent::make_shared(test::responses_map())};
+
+  serve<rib::PlainServer>(
+      {.respondent = stream_respondent, .logger = server_logger},
+      [&](auto&, const auto& server) {
+        net::io_context client_ctx;
+        beast::http::request<beast::http::string_body> request{
+            beast::http::verb::get, "/", 11};
+        request.set(beast::http::field::host, "127.0.0.1");
+        request.keep_alive(true);
+
+        // Keep-alive connection waiting for the next request
+        net::ip::tcp::socket idle{client_ctx};
+        idle.connect(endpoint);
+        beast::flat_buffer idle_buffer;
+        beast::http::write(idle, request);
+        test::string_response response;
+        beast::http::read(idle, idle_buffer, response);
+        BOOST_REQUIRE(response.keep_alive());
+
+        // Connection serving a stream
+        net::ip::tcp::socket serving{client_ctx};
+        serving.connect(endpoint);
+        request.target("/events");
+        beast::http::write(serving, request);
+        beast::flat_buffer buffer;
+        beast::http::response_parser<beast::http::string_body> parser;
+        beast::http::read_header(serving, buffer, parser);
+        const auto channel = stream_respondent->wait_channel(0);
+        BOOST_REQUIRE(channel);
+
+        std::promise<beast::error_code> drained;
+        auto drained_future = drained.get_future();
+        server->drain(std::chrono::seconds{10}, [&](beast::error_code ec) {
+          drained.set_value(ec);
+        });
+
+        // Waiting connection is closed at once, new ones are refused
+        beast::error_code ec;
+        beast::http::read(idle, idle_buffer, response, ec);
+        BOOST_REQUIRE(ec == beast::http::error::end_of_stream);
+
+        net::ip::tcp::socket late{client_ctx};
+        late.connect(endpoint, ec);
+        BOOST_REQUIRE(ec == net::error::connection_refused);
+
+        // Serving connection finishes it's response and is closed after it
+        BOOST_REQUIRE(drained_future.wait_for(std::chrono::milliseconds{100}) ==
+                      std::future_status::timeout);
+        const auto event = rib::StreamChannel::format_event("last", "update");
+        BOOST_REQUIRE(channel->push(event) ==
+                      rib::StreamChannel::PushResult::queued);
+        channel->close();
+        beast::http::read(serving, buffer, parser);
+        BOOST_REQUIRE(parser.get().body() == event);
+        beast::http::response_parser<beast::http::string_body> next;
+        beast::http::read_header(serving, buffer, next, ec);
+        BOOST_REQUIRE(ec == beast::http::error::end_of_stream);
+
+        BOOST_REQUIRE(not wait_ready(std::move(drained_future)));
+        BOOST_REQUIRE(server->sessions() == 0);
+      });
+}
+
+BOOST_AUTO_TEST_CASE(plain_listener_handoff) {
+  auto server_logger = test::Logger::make_shared();
+
+  // Old and new processes' servers, contexts run before the servers start
+  boost::asio::io_context old_ctx;
+  auto old_guard{net::make_work_guard(old_ctx)};
+  test::ASIOThread old_worker{old_ctx};
+  std::thread old_thread{old_worker.thread_body()};
+
+  boost::asio::io_context new_ctx;
+  auto new_guard{net::make_work_guard(new_ctx)};
+  test::ASIOThread new_worker{new_ctx};
+  std::thread new_thread{new_worker.thread_body()};
+
+  const auto old_server = rib::PlainServer::start(
+      old_ctx, endpoint, server_logger,
+      {.respondent = reusable_respondent, .logger = server_logger});
+
+  beast::http::status status;
+  get_body(endpoint, "/", status);
+  BOOST_REQUIRE(status == beast::http::status::ok);
+
+  const auto path =
+      (std::filesystem::temp_directory_path() / "rest_in_beast_handoff.sock")
+          .string();
+  std::promise<beast::error_code> drained;
+  old_server->handoff(path, std::chrono::seconds{10},
+                      [&](beast::error_code ec) { drained.set_value(ec); });
+
+  // One handoff at a time
+  std::promise<beast::error_code> rejected;
+  old_server->handoff(path, std::chrono::seconds{10},
+                      [&](beast::error_code ec) { rejected.set_value(ec); });
+  BOOST_REQUIRE(rejected.get_future().get() == net::error::already_started);
+
+  // Handoff socket is opened asynchronously
+  beast::error_code ec;
+  rib::listener_handle listener{-1};
+  for (int idx{}; idx < 500 && listener < 0; ++idx) {
+    listener = rib::receive_listener(path, ec);
+    if (listener < 0) {
+      std::this_thread::sleep_for(std::chrono::milliseconds{10});
+    }
+  }
+  BOOST_REQUIRE(listener >= 0);
+
+  rib::PlainServer::start(
+      new_ctx, listener, server_logger,
+      {.respondent = reusable_respondent, .logger = server_logger});
+  BOOST_REQUIRE(not drained.get_future().get());
+
+  // Old server does not accept anymore
+  get_body(endpoint, "/", status);
+  BOOST_REQUIRE(status == beast::http::status::ok);
+  BOOST_REQUIRE(old_server->sessions() == 0);
+
+  old_ctx.stop();
+  old_thread.join();
+  new_ctx.stop();
+  new_thread.join();
+  std::filesystem::remove(path);
+
+  BOOST_REQUIRE(not old_worker.thread_exception);
+  BOOST_REQUIRE(not new_worker.thread_exception);
+}
+
+BOOST_AUTO_TEST_CASE(plain_context_pool) {
+  auto server_logger = test::Logger::make_shared();
+
+  boost::asio::io_context accept_ctx;
+  test::ASIOThread accept_worker{accept_ctx};
+  boost::asio::io_context other_ctx;
+  test::ASIOThread other_worker{other_ctx};
+  // Nothing runs in the other context until a connection is assigned to it
+  auto other_guard{net::make_work_guard(other_ctx)};
+
+  const auto pool = rib::ContextPool::make_shared(
+      {&accept_ctx, &other_ctx}, rib::ContextPool::round_robin());
+  rib::PlainServer::start(accept_ctx, endpoint, server_logger,
+                          {.respondent = reusable_respondent,
+                           .logger = server_logger,
+                           .context_pool = pool});
+
+  std::thread accept_thread{accept_worker.thread_body()};
+  std::thread other_thread{other_worker.thread_body()};
+
+  // Keep-alive connections stay open after the response
+  net::io_context client_ctx;
+  std::vector<net::ip::tcp::socket> clients;
+  for (int idx{}; idx < 4; ++idx) {
+    auto& socket = clients.emplace_back(client_ctx);
+    socket.connect(endpoint);
+
+    beast::http::request<beast::http::string_body> request{
+        beast::http::verb::get, "/", 11};
+    request.set(beast::http::field::host, "127.0.0.1");
+    beast::http::write(socket, request);
+
+    beast::flat_buffer buffer;
+    test::string_response response;
+    beast::http::read(socket, buffer, response);
+    BOOST_REQUIRE(response.result() == beast::http::status::ok);
+  }
+
+  BOOST_REQUIRE(pool->connections(0) == 2);
+  BOOST_REQUIRE(pool->connections(1) == 2);
+  BOOST_REQUIRE(pool->assigned(0) + pool->assigned(1) == 4);
+
+  clients.clear();
+  for (int idx{};
+       idx < 500 && pool->connections(0) + pool->connections(1) != 0; ++idx) {
+    std::this_thread::sleep_for(std::chrono::milliseconds{10});
+  }
+  BOOST_REQUIRE(pool->connections(0) + pool->connections(1) == 0);
+
+  // Least connections policy picks the context with fewer leases
+  const auto least = rib::ContextPool::make_shared({&accept_ctx, &other_ctx});
+  const auto first = least->lease(0);
+  const auto second = least->lease(0);
+  const auto third = least->lease(1);
+  BOOST_REQUIRE(least->pick() == 1);
+  BOOST_REQUIRE(least->pick() == 1);
+
+  accept_ctx.stop();
+  accept_thread.join();
+  other_ctx.stop();
+  other_thread.join();
+
+  BOOST_REQUIRE(not accept_worker.thread_exception);
+  BOOST_REQUIRE(not other_worker.thread_exception);
+}
+
+BOOST_AUTO_TEST_CASE(plain_rate_limit) {
+  auto server_logger = test::Logger::make_shared();
+
+  // Only GET of the root is limited
+  const auto limiter = rib::RateLimiter::make_shared(
+      {.limits = {{.rate = 0.1, .burst = 2.0}}},
+      [](beast::http::verb method, std::string_view target) {
+        return method == beast::http::verb::get && target == "/"
+                   ? std::size_t{}
+                   : std::size_t{1};
+      });
+
+  serve<rib::PlainServer>(
+      {.respondent = reusable_respondent,
+       .logger = server_logger,
+       .rate_limiter = limiter},
+      [&](auto&, const auto&) {
+        net::io_context client_ctx;
+        net::ip::tcp::socket socket{client_ctx};
+        socket.connect(endpoint);
+        beast::flat_buffer buffer;
+        const auto exchange = [&](std::string_view target) {
+          beast::http::request<beast::http::string_body> request{
+              beast::http::verb::get, target, 11};
+          request.set(beast::http::field::host, "127.0.0.1");
+          beast::http::write(socket, request);
+
+          test::string_response response;
+          beast::http::read(socket, buffer, response);
+          return response;
+        };
+
+        // Burst is served, the next request is limited and the connection is
+        // kept
+        BOOST_REQUIRE(exchange("/").result() == beast::http::status::ok);
+        BOOST_REQUIRE(exchange("/").result() == beast::http::status::ok);
+        const auto limited = exchange("/");
+        BOOST_REQUIRE(limited.result() ==
+                      beast::http::status::too_many_requests);
+        BOOST_REQUIRE(limited[beast::http::field::retry_after] == "10");
+        BOOST_REQUIRE(limited.keep_alive());
+        BOOST_REQUIRE(exchange("/missing").result() !=
+                      beast::http::status::too_many_requests);
+        BOOST_REQUIRE(limiter->limited() == 1);
+
+        boost::beast::error_code ec;
+        socket.shutdown(net::ip::tcp::socket::shutdown_both, ec);
+      });
+
+  // Table keeps it's size under unique addresses: the oldest buckets go
+  const auto table = rib::RateLimiter::make_shared(
+      {.limits = {{.rate = 1.0, .burst = 1.0}}, .capacity = 8});
+  for (std::uint64_t address{}; address < 64; ++address) {
+    BOOST_REQUIRE(table->take(address, 0));
+  }
+  BOOST_REQUIRE(table->evicted() >= 56);
+  BOOST_REQUIRE(table->take(64, 0));
+  BOOST_REQUIRE(not table->take(64, 0));
+}
+
+BOOST_AUTO_TEST_CASE(plain_runner) {
+  auto server_logger = test::Logger::make_shared();
+
+  std::atomic<std::size_t> initialized{};
+  auto runner = rib::Runner::start(
+      {.threads = 2,
+       .contexts = 2,
+       .cpus = rib::Runner::cpus(),
+       .thread_init = [&](std::size_t, boost::asio::io_context&) {
+         initialized.fetch_add(1);
+       }});
+  BOOST_REQUIRE(runner->size() == 2);
+
+  // Server per context on one endpoint
+  std::vector<std::shared_ptr<rib::PlainServer>> servers;
+  for (std::size_t idx{}; idx < runner->size(); ++idx) {
+    beast::error_code ec;
+    const auto listener = rib::listen_reuse_port(endpoint, ec);
+    BOOST_REQUIRE(not ec);
+    servers.push_back(rib::PlainServer::start(
+        runner->context(idx), listener, server_logger,
+        {.respondent = reusable_respondent, .logger = server_logger}));
+  }
+
+  for (int idx{}; idx < 10; ++idx) {
+    beast::http::status status;
+    get_body(endpoint, "/", status);
+    BOOST_REQUIRE(status == beast::http::status::ok);
+  }
+  BOOST_REQUIRE(initialized == 2);
+
+  // Exception of any thread stops the runner and is rethrown by join
+  boost::asio::post(runner->context(1),
+                    [] { throw std::runtime_error{"runner"}; });
+  servers.clear();
+  BOOST_REQUIRE_THROW(runner->join(), std::runtime_error);
+}
+
 BOOST_AUTO_TEST_CASE(secure_to_secur) {
   auto server_logger = test::Logger::make_shared();
   auto client_logger = test::MemoLogger::make_shared();
@@ -191,6 +1347,657 @@ BOOST_AUTO_TEST_CASE(secure_to_secure_wrong_ca) {
   BOOST_REQUIRE(std::empty(responses_ret));
 }
 
+BOOST_AUTO_TEST_CASE(secure_session_tickets) {
+  auto server_logger = test::Logger::make_shared();
+
+  boost::asio::ssl::context server_ssl_ctx{test::make_server_ssl_ctx()};
+  boost::asio::ssl::context client_ssl_ctx{test::make_client_ssl_ctx()};
+
+  const auto resumption = rib::TlsResumption::install(
+      server_ssl_ctx, {.cache_capacity = 0, .previous_ticket_keys = 1});
+
+  test::string_response response;
+  serve<rib::SecureServer>(
+      {.ssl_ctx = server_ssl_ctx,
+       .respondent = respondent,
+       .logger = server_logger},
+      [&](auto&, const auto&) {
+        test::ResumingClient client{client_ssl_ctx};
+        const test::string_request request{beast::http::verb::get, "/", 11};
+
+        BOOST_REQUIRE(not client.exchange(endpoint, request, response));
+        BOOST_REQUIRE(client.exchange(endpoint, request, response));
+
+        // Ticket of the previous key is still accepted
+        resumption->rotate_ticket_keys();
+        BOOST_REQUIRE(client.exchange(endpoint, request, response));
+
+        // Ticket of the dropped key is not
+        resumption->rotate_ticket_keys();
+        resumption->rotate_ticket_keys();
+        BOOST_REQUIRE(not client.exchange(endpoint, request, response));
+      });
+
+  BOOST_REQUIRE(response.result() == beast::http::status::ok);
+  BOOST_REQUIRE(resumption->metrics().full_handshakes == 2);
+  BOOST_REQUIRE(resumption->metrics().resumed_handshakes == 2);
+}
+
+/**
+ * @brief The FailingRand class fails random requests of ticket key names and
+ * ticket IVs (16 bytes) while set, others are served by OpenSSL
+ */
+struct FailingRand {
+  static inline std::atomic<bool> fail{};
+
+#if defined(__GNUC__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wdeprecated-declarations"
+#endif
+  static int bytes(unsigned char* buffer, int size) {
+    if (fail && size == 16)
+      return 0;
+    return ::RAND_OpenSSL()->bytes(buffer, size);
+  }
+
+  RAND_METHOD method{*::RAND_OpenSSL()};
+
+  FailingRand() {
+    method.bytes = &FailingRand::bytes;
+    method.pseudorand = &FailingRand::bytes;
+    ::RAND_set_rand_method(&method);
+  }
+  ~FailingRand() { ::RAND_set_rand_method(nullptr); }
+#if defined(__GNUC__)
+#pragma GCC diagnostic pop
+#endif
+};
+
+BOOST_AUTO_TEST_CASE(secure_session_tickets_key_failure) {
+  auto server_logger = test::Logger::make_shared();
+
+  boost::asio::ssl::context server_ssl_ctx{test::make_server_ssl_ctx()};
+  boost::asio::ssl::context client_ssl_ctx{test::make_client_ssl_ctx()};
+
+  // Every ticket rotates the key
+  const auto resumption = rib::TlsResumption::install(
+      server_ssl_ctx,
+      {.cache_capacity = 0, .ticket_key_rotation = std::chrono::seconds{0}});
+
+  FailingRand rand;
+  serve<rib::SecureServer>(
+      {.ssl_ctx = server_ssl_ctx,
+       .respondent = respondent,
+       .logger = server_logger},
+      [&](auto&, const auto&) {
+        test::ResumingClient client{client_ssl_ctx};
+        const test::string_request request{beast::http::verb::get, "/", 11};
+        test::string_response response;
+
+        // Failed key rotation issues no ticket, connection is still served
+        FailingRand::fail = true;
+        BOOST_REQUIRE(not client.exchange(endpoint, request, response));
+        BOOST_REQUIRE(response.result() == beast::http::status::ok);
+        FailingRand::fail = false;
+        BOOST_REQUIRE(not client.exchange(endpoint, request, response));
+        BOOST_REQUIRE(response.result() == beast::http::status::ok);
+
+        BOOST_REQUIRE(client.exchange(endpoint, request, response));
+        BOOST_REQUIRE(response.result() == beast::http::status::ok);
+      });
+
+  BOOST_REQUIRE(resumption->metrics().full_handshakes == 2);
+  BOOST_REQUIRE(resumption->metrics().resumed_handshakes == 1);
+}
+
+BOOST_AUTO_TEST_CASE(secure_session_cache) {
+  auto server_logger = test::Logger::make_shared();
+
+  boost::asio::ssl::context server_ssl_ctx{test::make_server_ssl_ctx()};
+  boost::asio::ssl::context client_ssl_ctx{test::make_client_ssl_ctx()};
+
+  const auto resumption = rib::TlsResumption::install(
+      server_ssl_ctx,
+      {.cache_capacity = 64, .cache_shards = 4, .enable_tickets = false});
+
+  test::string_response response;
+  serve<rib::SecureServer>(
+      {.ssl_ctx = server_ssl_ctx,
+       .respondent = respondent,
+       .logger = server_logger},
+      [&](auto&, const auto&) {
+        test::ResumingClient client{client_ssl_ctx};
+        const test::string_request request{beast::http::verb::get, "/", 11};
+
+        BOOST_REQUIRE(not client.exchange(endpoint, request, response));
+        BOOST_REQUIRE(resumption->cached_sessions() != 0);
+        BOOST_REQUIRE(client.exchange(endpoint, request, response));
+        BOOST_REQUIRE(client.exchange(endpoint, request, response));
+      });
+
+  BOOST_REQUIRE(response.result() == beast::http::status::ok);
+  BOOST_REQUIRE(resumption->metrics().full_handshakes == 1);
+  BOOST_REQUIRE(resumption->metrics().resumed_handshakes == 2);
+}
+
+BOOST_AUTO_TEST_CASE(secure_sni) {
+  auto server_logger = test::Logger::make_shared();
+
+  boost::asio::ssl::context server_ssl_ctx{test::make_server_ssl_ctx()};
+  boost::asio::ssl::context client_ssl_ctx{test::make_client_ssl_ctx()};
+
+  auto api_ssl_ctx{
+      std::make_shared<boost::asio::ssl::context>(test::make_server_ssl_ctx())};
+  auto org_ssl_ctx{
+      std::make_shared<boost::asio::ssl::context>(test::make_server_ssl_ctx())};
+
+  const auto sni = rib::SniContexts::install(
+      server_ssl_ctx, {{.name = "api.example.com", .ssl_ctx = api_ssl_ctx},
+                       {.name = "*.Example.org", .ssl_ctx = org_ssl_ctx}});
+
+  serve<rib::SecureServer>(
+      {.ssl_ctx = server_ssl_ctx,
+       .respondent = respondent,
+       .logger = server_logger},
+      [&](auto&, const auto&) {
+        const test::string_request request{beast::http::verb::get, "/", 11};
+        test::string_response response;
+        const auto exchange = [&](const char* server_name) {
+          test::ResumingClient client{client_ssl_ctx};
+          client.exchange(endpoint, request, response, server_name);
+          BOOST_REQUIRE(response.result() == beast::http::status::ok);
+        };
+
+        exchange("API.example.com.");
+        exchange("www.example.org");
+        exchange("a.www.example.org");
+        exchange(nullptr);
+
+        BOOST_REQUIRE(sni->metrics().exact_matches == 1);
+        BOOST_REQUIRE(sni->metrics().wildcard_matches == 1);
+        BOOST_REQUIRE(sni->metrics().default_matches == 2);
+
+        // Only new handshakes see reloaded hosts
+        sni->reload({{.name = "www.example.org", .ssl_ctx = api_ssl_ctx}});
+        api_ssl_ctx.reset();
+        org_ssl_ctx.reset();
+
+        exchange("www.example.org");
+        exchange("api.example.com");
+      });
+
+  BOOST_REQUIRE(sni->metrics().exact_matches == 2);
+  BOOST_REQUIRE(sni->metrics().wildcard_matches == 1);
+  BOOST_REQUIRE(sni->metrics().default_matches == 3);
+  BOOST_REQUIRE(sni->metrics().reloads == 1);
+}
+
+BOOST_AUTO_TEST_CASE(secure_sni_resumption) {
+  // Resumption of server's context serves hosts switched to by SNI, with
+  // tickets and with the session cache
+  for (const bool tickets : {true, false}) {
+    auto server_logger = test::Logger::make_shared();
+
+    boost::asio::ssl::context server_ssl_ctx{test::make_server_ssl_ctx()};
+    boost::asio::ssl::context client_ssl_ctx{test::make_client_ssl_ctx()};
+    auto api_ssl_ctx{std::make_shared<boost::asio::ssl::context>(
+        test::make_server_ssl_ctx())};
+
+    const auto resumption = rib::TlsResumption::install(
+        server_ssl_ctx, {.cache_capacity = tickets ? 0u : 64u,
+                         .enable_tickets = tickets});
+    const auto sni = rib::SniContexts::install(
+        server_ssl_ctx, {{.name = "api.example.com", .ssl_ctx = api_ssl_ctx}});
+
+    serve<rib::SecureServer>(
+        {.ssl_ctx = server_ssl_ctx,
+         .respondent = respondent,
+         .logger = server_logger},
+        [&](auto&, const auto&) {
+          test::ResumingClient client{client_ssl_ctx};
+          const test::string_request request{beast::http::verb::get, "/", 11};
+          test::string_response response;
+
+          BOOST_REQUIRE(not client.exchange(endpoint, request, response,
+                                            "api.example.com"));
+          BOOST_REQUIRE(response.result() == beast::http::status::ok);
+          BOOST_REQUIRE(
+              client.exchange(endpoint, request, response, "api.example.com"));
+          BOOST_REQUIRE(response.result() == beast::http::status::ok);
+        });
+
+    BOOST_REQUIRE(sni->metrics().exact_matches == 2);
+    BOOST_REQUIRE(resumption->metrics().full_handshakes == 1);
+    BOOST_REQUIRE(resumption->metrics().resumed_handshakes == 1);
+  }
+}
+
+BOOST_AUTO_TEST_CASE(secure_handshake_pool) {
+  auto server_logger = test::Logger::make_shared();
+  auto client_logger = test::MemoLogger::make_shared();
+
+  boost::asio::io_context handshake_ctx;
+  auto handshake_guard{net::make_work_guard(handshake_ctx)};
+
+  boost::asio::ssl::context server_ssl_ctx{test::make_server_ssl_ctx()};
+  boost::asio::ssl::context client_ssl_ctx{test::make_client_ssl_ctx()};
+
+  test::ASIOThread handshake_worker{handshake_ctx};
+  std::thread handshake_thread{handshake_worker.thread_body()};
+
+  const auto handshake_pool{
+      rib::HandshakePool::make_shared(handshake_ctx, 1, 16)};
+
+  const auto [requests, responses] = test::requests_test_data();
+
+  // Handshake thread is joined when the test fails too
+  try {
+    serve<rib::SecureServer>(
+        {.ssl_ctx = server_ssl_ctx,
+         .respondent = respondent,
+         .logger = server_logger,
+         .handshake_pool = handshake_pool},
+        [&](auto& io_ctx, const auto&) {
+          require_responses(responses, wait_ready(test::SecureClient::send(
+                                           io_ctx, client_ssl_ctx,
+                                           client_logger, endpoint, requests)));
+        });
+  } catch (...) {
+    handshake_ctx.stop();
+    handshake_thread.join();
+    throw;
+  }
+
+  handshake_ctx.stop();
+  handshake_thread.join();
+
+  BOOST_REQUIRE(not handshake_worker.thread_exception);
+  BOOST_REQUIRE(not client_logger->last_ec().failed());
+
+  const auto& metrics{handshake_pool->metrics()};
+  BOOST_REQUIRE(metrics.started >= 1);
+  BOOST_REQUIRE(metrics.in_progress == 0);
+  BOOST_REQUIRE(metrics.rejected == 0);
+}
+
+BOOST_AUTO_TEST_CASE(secure_handshake_pool_queue_timeout) {
+  auto server_logger = test::Logger::make_shared();
+
+  boost::asio::io_context handshake_ctx;
+  auto handshake_guard{net::make_work_guard(handshake_ctx)};
+
+  boost::asio::ssl::context server_ssl_ctx{test::make_server_ssl_ctx()};
+  boost::asio::ssl::context client_ssl_ctx{test::make_client_ssl_ctx()};
+
+  // Two threads: handler of the pool runs in the session's strand anyway
+  test::ASIOThread handshake_worker{handshake_ctx};
+  std::thread handshake_thread{handshake_worker.thread_body()};
+  test::ASIOThread second_handshake_worker{handshake_ctx};
+  std::thread second_handshake_thread{second_handshake_worker.thread_body()};
+
+  // Single handshake at a time, shared by servers with different timeouts
+  const auto handshake_pool{
+      rib::HandshakePool::make_shared(handshake_ctx, 1, 16)};
+  const net::ip::tcp::endpoint short_endpoint{endpoint.address(), 5001};
+
+  // Handshake threads are joined when the test fails too
+  try {
+    serve<rib::SecureServer>(
+        {.ssl_ctx = server_ssl_ctx,
+         .respondent = respondent,
+         .logger = server_logger,
+         .handshake_timeout = std::chrono::seconds{3},
+         .handshake_pool = handshake_pool},
+        [&](auto& io_ctx, const auto&) {
+          rib::SecureServer::start(
+              io_ctx, short_endpoint, server_logger,
+              {.ssl_ctx = server_ssl_ctx,
+               .respondent = respondent,
+               .logger = server_logger,
+               .handshake_timeout = std::chrono::milliseconds{200},
+               .handshake_pool = handshake_pool});
+
+          // Silent connection takes the only handshake
+          net::io_context client_ctx;
+          net::ip::tcp::socket silent{client_ctx};
+          silent.connect(endpoint);
+          for (int idx{}; idx < 500 && handshake_pool->metrics().started == 0;
+               ++idx) {
+            std::this_thread::sleep_for(std::chrono::milliseconds{10});
+          }
+          BOOST_REQUIRE(handshake_pool->metrics().in_progress == 1);
+
+          // Queued connection is closed by it's own deadline, not after
+          // the silent one's
+          net::ssl::stream<net::ip::tcp::socket> queued{client_ctx,
+                                                        client_ssl_ctx};
+          const auto start = std::chrono::steady_clock::now();
+          queued.next_layer().connect(short_endpoint);
+          beast::error_code ec;
+          queued.handshake(net::ssl::stream_base::client, ec);
+          BOOST_REQUIRE(ec);
+          BOOST_REQUIRE(std::chrono::steady_clock::now() - start <
+                        std::chrono::seconds{2});
+        });
+  } catch (...) {
+    handshake_ctx.stop();
+    handshake_thread.join();
+    second_handshake_thread.join();
+    throw;
+  }
+
+  handshake_ctx.stop();
+  handshake_thread.join();
+  second_handshake_thread.join();
+
+  BOOST_REQUIRE(not handshake_worker.thread_exception);
+  BOOST_REQUIRE(not second_handshake_worker.thread_exception);
+  BOOST_REQUIRE(handshake_pool->metrics().rejected == 0);
+}
+
+#ifdef REST_IN_BEAST_KTLS
+BOOST_AUTO_TEST_CASE(secure_ktls) {
+  auto server_logger = test::Logger::make_shared();
+  auto client_logger = test::MemoLogger::make_shared();
+
+  boost::asio::ssl::context server_ssl_ctx{test::make_server_ssl_ctx()};
+  boost::asio::ssl::context client_ssl_ctx{test::make_client_ssl_ctx()};
+
+  const auto ktls{std::make_shared<rib::KtlsMetrics>()};
+
+  struct sigaction sigpipe_before {};
+  ::sigaction(SIGPIPE, nullptr, &sigpipe_before);
+
+  const auto [requests, responses] = test::requests_test_data();
+
+  serve<rib::SecureServer>(
+      {.ssl_ctx = server_ssl_ctx,
+       .respondent = respondent,
+       .logger = server_logger,
+       .ktls = ktls},
+      [&](auto& io_ctx, const auto&) {
+        require_responses(responses, wait_ready(test::SecureClient::send(
+                                         io_ctx, client_ssl_ctx, client_logger,
+                                         endpoint, requests)));
+      });
+
+  BOOST_REQUIRE(not client_logger->last_ec().failed());
+
+  // Kernel TLS depends on the kernel's tls module, any path must be reported
+  BOOST_REQUIRE(ktls->kernel_send + ktls->userspace == 1);
+
+  // SIGPIPE of OpenSSL's writes is kept in the session's thread
+  struct sigaction sigpipe_after {};
+  ::sigaction(SIGPIPE, nullptr, &sigpipe_after);
+  BOOST_REQUIRE(sigpipe_after.sa_handler == sigpipe_before.sa_handler);
+}
+#endif // REST_IN_BEAST_KTLS
+
+BOOST_AUTO_TEST_CASE(secure_http2) {
+  auto server_logger = test::Logger::make_shared();
+
+  boost::asio::ssl::context server_ssl_ctx{test::make_server_ssl_ctx()};
+  boost::asio::ssl::context client_ssl_ctx{test::make_client_ssl_ctx()};
+
+  rib::install_alpn(server_ssl_ctx);
+
+  // Bodies above the default window of the stream and of the connection
+  auto responses_map{test::responses_map()};
+  test::string_response large{beast::http::status::ok, 11};
+  large.body().assign(100'000, 'x');
+  responses_map.emplace("/large", large);
+
+  const auto large_respondent{
+      test::Respondent::make_shared(std::move(responses_map))};
+
+  auto [requests, responses] = test::requests_test_data();
+  for (int idx{}; idx < 3; ++idx) {
+    requests.emplace_back(beast::http::verb::get, "/large", 11);
+    requests.back().set(beast::http::field::host, "127.0.0.1");
+    responses.push_back(large);
+  }
+
+  serve<rib::SecureServer>(
+      {.ssl_ctx = server_ssl_ctx,
+       .respondent = large_respondent,
+       .logger = server_logger},
+      [&](auto&, const auto&) {
+        test::Http2Client client{client_ssl_ctx};
+        require_responses(responses, client.exchange(endpoint, requests));
+      });
+}
+
+#ifdef REST_IN_BEAST_KTLS
+BOOST_AUTO_TEST_CASE(secure_http2_reusable_ktls) {
+  auto server_logger = test::Logger::make_shared();
+
+  boost::asio::ssl::context server_ssl_ctx{test::make_server_ssl_ctx()};
+  boost::asio::ssl::context client_ssl_ctx{test::make_client_ssl_ctx()};
+
+  rib::install_alpn(server_ssl_ctx);
+
+  const auto [requests, responses] = test::requests_test_data();
+
+  serve<rib::SecureServer>(
+      {.ssl_ctx = server_ssl_ctx,
+       .respondent = reusable_respondent,
+       .logger = server_logger,
+       .ktls = std::make_shared<rib::KtlsMetrics>()},
+      [&](auto&, const auto&) {
+        test::Http2Client client{client_ssl_ctx};
+        require_responses(responses, client.exchange(endpoint, requests));
+      });
+}
+#endif // REST_IN_BEAST_KTLS
+
+BOOST_AUTO_TEST_CASE(secure_http2_fallback) {
+  auto server_logger = test::Logger::make_shared();
+  auto client_logger = test::MemoLogger::make_shared();
+
+  boost::asio::ssl::context server_ssl_ctx{test::make_server_ssl_ctx()};
+  boost::asio::ssl::context client_ssl_ctx{test::make_client_ssl_ctx()};
+
+  rib::install_alpn(server_ssl_ctx);
+
+  const auto [requests, responses] = test::requests_test_data();
+
+  serve<rib::SecureServer>(
+      {.ssl_ctx = server_ssl_ctx,
+       .respondent = respondent,
+       .logger = server_logger},
+      [&](auto& io_ctx, const auto&) {
+        // Client without ALPN is served with HTTP/1.1
+        require_responses(responses, wait_ready(test::SecureClient::send(
+                                         io_ctx, client_ssl_ctx, client_logger,
+                                         endpoint, requests)));
+      });
+
+  BOOST_REQUIRE(not client_logger->last_ec().failed());
+}
+
+BOOST_AUTO_TEST_CASE(secure_http2_rate_limit) {
+  auto server_logger = test::Logger::make_shared();
+
+  boost::asio::ssl::context server_ssl_ctx{test::make_server_ssl_ctx()};
+  boost::asio::ssl::context client_ssl_ctx{test::make_client_ssl_ctx()};
+
+  rib::install_alpn(server_ssl_ctx);
+
+  // Only GET of the root is limited
+  const auto limiter = rib::RateLimiter::make_shared(
+      {.limits = {{.rate = 0.1, .burst = 2.0}}},
+      [](beast::http::verb method, std::string_view target) {
+        return method == beast::http::verb::get && target == "/"
+                   ? std::size_t{}
+                   : std::size_t{1};
+      });
+
+  // Streams of the connection are limited one by one
+  std::vector<test::string_request> requests;
+  for (const std::string_view target : {"/", "/", "/", "/missing"}) {
+    requests.emplace_back(beast::http::verb::get, target, 11);
+    requests.back().set(beast::http::field::host, "127.0.0.1");
+  }
+
+  std::vector<test::string_response> responses;
+  serve<rib::SecureServer>(
+      {.ssl_ctx = server_ssl_ctx,
+       .respondent = respondent,
+       .logger = server_logger,
+       .rate_limiter = limiter},
+      [&](auto&, const auto&) {
+        test::Http2Client client{client_ssl_ctx};
+        responses = client.exchange(endpoint, requests);
+      });
+
+  BOOST_REQUIRE(std::size(responses) == std::size(requests));
+  BOOST_REQUIRE(responses[0].result() == beast::http::status::ok);
+  BOOST_REQUIRE(responses[1].result() == beast::http::status::ok);
+  BOOST_REQUIRE(responses[2].result() ==
+                beast::http::status::too_many_requests);
+  BOOST_REQUIRE(responses[2][beast::http::field::retry_after] == "10");
+  BOOST_REQUIRE(std::empty(responses[2].body()));
+  BOOST_REQUIRE(responses[3].result() !=
+                beast::http::status::too_many_requests);
+  BOOST_REQUIRE(limiter->limited() == 1);
+}
+
+BOOST_AUTO_TEST_CASE(secure_http2_drain) {
+  namespace http2 = rib::detail::http2;
+
+  auto server_logger = test::Logger::make_shared();
+
+  boost::asio::ssl::context server_ssl_ctx{test::make_server_ssl_ctx()};
+  boost::asio::ssl::context client_ssl_ctx{test::make_client_ssl_ctx()};
+
+  rib::install_alpn(server_ssl_ctx);
+
+  net::io_context client_ctx;
+  net::ssl::stream<net::ip::tcp::socket> stream{client_ctx, client_ssl_ctx};
+
+  std::string input;
+  const auto read_frame = [&] {
+    for (;;) {
+      if (std::size(input) >= http2::frame_header_size) {
+        const std::size_t length =
+            static_cast<unsigned char>(input[0]) << 16 |
+            static_cast<unsigned char>(input[1]) << 8 |
+            static_cast<unsigned char>(input[2]);
+        if (std::size(input) >= http2::frame_header_size + length) {
+          const auto frame = std::make_tuple(
+              static_cast<http2::frame>(input[3]),
+              static_cast<std::uint8_t>(input[4]),
+              http2::read_u32(std::string_view{input}.substr(5, 4)),
+              input.substr(http2::frame_header_size, length));
+          input.erase(0, http2::frame_header_size + length);
+          return frame;
+        }
+      }
+      char chunk[4'096];
+      input.append(chunk, stream.read_some(net::buffer(chunk)));
+    }
+  };
+
+  std::string block;
+  const auto headers = [&](std::uint32_t stream_id, std::uint8_t flags) {
+    block.clear();
+    rib::util::HpackEncoder::encode(block, ":method", "GET");
+    rib::util::HpackEncoder::encode(block, ":scheme", "https");
+    rib::util::HpackEncoder::encode(block, ":path", "/");
+    rib::util::HpackEncoder::encode(block, ":authority", "127.0.0.1");
+
+    std::string output;
+    http2::append_frame_header(output, std::size(block), http2::frame::headers,
+                               http2::flag::end_headers | flags, stream_id);
+    output.append(block);
+    return output;
+  };
+
+  serve<rib::SecureServer>(
+      {.ssl_ctx = server_ssl_ctx,
+       .respondent = respondent,
+       .logger = server_logger},
+      [&](auto&, const auto& server) {
+        stream.next_layer().connect(endpoint);
+        static constexpr unsigned char protocols[]{2, 'h', '2'};
+        ::SSL_set_alpn_protos(stream.native_handle(), protocols,
+                              sizeof(protocols));
+        stream.handshake(net::ssl::stream_base::client);
+        BOOST_REQUIRE(http2::negotiated(stream.native_handle()));
+
+        // Request of the first stream is not complete when the drain starts,
+        // ping is answered after it's headers
+        std::string output{http2::client_preface};
+        http2::append_frame_header(output, 0, http2::frame::settings, 0, 0);
+        output.append(headers(1, 0));
+        http2::append_frame_header(output, 8, http2::frame::ping, 0, 0);
+        output.append(8, '\0');
+        net::write(stream, net::buffer(output));
+
+        for (;;) {
+          const auto [type, flags, stream_id, payload] = read_frame();
+          if (type == http2::frame::ping) {
+            BOOST_REQUIRE(flags & http2::flag::ack);
+            break;
+          }
+        }
+
+        std::promise<beast::error_code> drained;
+        auto drained_future = drained.get_future();
+        server->drain(std::chrono::seconds{10}, [&](beast::error_code ec) {
+          drained.set_value(ec);
+        });
+
+        for (;;) {
+          const auto [type, flags, stream_id, payload] = read_frame();
+          if (type == http2::frame::goaway) {
+            BOOST_REQUIRE(http2::read_u32(payload) == 1);
+            BOOST_REQUIRE(
+                http2::read_u32(std::string_view{payload}.substr(4)) ==
+                static_cast<std::uint32_t>(http2::error::no_error));
+            break;
+          }
+        }
+
+        // Open stream is finished, new one is refused
+        output.clear();
+        http2::append_frame_header(output, 0, http2::frame::data,
+                                   http2::flag::end_stream, 1);
+        output.append(headers(3, http2::flag::end_stream));
+        net::write(stream, net::buffer(output));
+
+        bool responded{};
+        bool refused{};
+        while (!responded || !refused) {
+          const auto [type, flags, stream_id, payload] = read_frame();
+          if (type == http2::frame::rst_stream) {
+            BOOST_REQUIRE(stream_id == 3);
+            BOOST_REQUIRE(
+                http2::read_u32(payload) ==
+                static_cast<std::uint32_t>(http2::error::refused_stream));
+            refused = true;
+          } else if ((type == http2::frame::headers ||
+                      type == http2::frame::data) &&
+                     (flags & http2::flag::end_stream)) {
+            BOOST_REQUIRE(stream_id == 1);
+            responded = true;
+          }
+        }
+
+        // Connection is shut down after the last response
+        beast::error_code ec;
+        char chunk[4'096];
+        while (!ec) {
+          stream.read_some(net::buffer(chunk), ec);
+        }
+        BOOST_REQUIRE(ec == net::error::eof);
+        stream.shutdown(ec);
+
+        BOOST_REQUIRE(not wait_ready(std::move(drained_future)));
+        BOOST_REQUIRE(server->sessions() == 0);
+      });
+}
+
 BOOST_AUTO_TEST_CASE(plain_to_flex) {
   auto server_logger = test::Logger::make_shared();
   auto client_logger = test::MemoLogger::make_shared();
@@ -288,6 +2095,54 @@ BOOST_AUTO_TEST_CASE(secure_to_flex) {
   }
 }
 
+BOOST_AUTO_TEST_CASE(flex_handshake_pool) {
+  auto server_logger = test::Logger::make_shared();
+  auto client_logger = test::MemoLogger::make_shared();
+
+  boost::asio::io_context handshake_ctx;
+  auto handshake_guard{net::make_work_guard(handshake_ctx)};
+
+  boost::asio::ssl::context server_ssl_ctx{test::make_server_ssl_ctx()};
+  boost::asio::ssl::context client_ssl_ctx{test::make_client_ssl_ctx()};
+
+  test::ASIOThread handshake_worker{handshake_ctx};
+  std::thread handshake_thread{handshake_worker.thread_body()};
+
+  const auto handshake_pool{
+      rib::HandshakePool::make_shared(handshake_ctx, 1, 16)};
+
+  const auto [requests, responses] = test::requests_test_data();
+
+  // Handshake thread is joined when the test fails too
+  try {
+    serve<rib::FlexServer>(
+        {.ssl_ctx = server_ssl_ctx,
+         .respondent = respondent,
+         .logger = server_logger,
+         .handshake_pool = handshake_pool},
+        [&](auto& io_ctx, const auto&) {
+          require_responses(responses, wait_ready(test::SecureClient::send(
+                                           io_ctx, client_ssl_ctx,
+                                           client_logger, endpoint, requests)));
+        });
+  } catch (...) {
+    handshake_ctx.stop();
+    handshake_thread.join();
+    throw;
+  }
+
+  handshake_ctx.stop();
+  handshake_thread.join();
+
+  BOOST_REQUIRE(not handshake_worker.thread_exception);
+  BOOST_REQUIRE(not client_logger->last_ec().failed());
+
+  const auto& metrics{handshake_pool->metrics()};
+  BOOST_REQUIRE(metrics.started >= 1);
+  BOOST_REQUIRE(metrics.in_progress == 0);
+  BOOST_REQUIRE(metrics.rejected == 0);
+}
+
 BOOST_AUTO_TEST_CASE(secure_to_flex_wrong_ca) {
   auto server_logger = test::Logger::make_shared();
   auto client_logger = test::MemoLogger::make_shared();
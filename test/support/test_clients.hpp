@@ -8,15 +8,22 @@
 #ifndef TEST_CLIENTS_HPP
 #define TEST_CLIENTS_HPP
 
+#include <rest_in_beast/detail/http2_session.hpp>
 #include <rest_in_beast/detail/logger.hpp>
+#include <rest_in_beast/util/hpack.hpp>
 #include <rest_in_beast/util/shared_proxy.hpp>
 
 #include <boost/asio.hpp>
 #include <boost/asio/ssl.hpp>
 #include <boost/beast.hpp>
 
+#include <cstdint>
 #include <future>
 #include <memory>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
 
 namespace test {
 using string_request =
@@ -328,5 +335,253 @@ private:
         &SecureClient::on_shutdown, this->shared_from_this()));
   }
 };
+
+/**
+ * @brief The ResumingClient class - test client that sends one request per
+ * connection synchronously and resumes TLS session of the previous connection
+ */
+class ResumingClient {
+  boost::asio::io_context io_ctx_;
+  boost::asio::ssl::context& ssl_ctx_;
+  SSL_SESSION* session_{};
+
+public:
+  ResumingClient(boost::asio::ssl::context& ssl_ctx) : ssl_ctx_{ssl_ctx} {}
+
+  ResumingClient(const ResumingClient&) = delete;
+  ResumingClient& operator=(const ResumingClient&) = delete;
+
+  ~ResumingClient() {
+    if (session_) {
+      ::SSL_SESSION_free(session_);
+    }
+  }
+
+  /**
+   * @brief exchange - connects, sends request and reads response
+   * @param server_name - SNI host name, nullptr to send no SNI
+   * @return true if TLS session was resumed
+   */
+  bool exchange(const boost::asio::ip::tcp::endpoint& endpoint,
+                const string_request& request, string_response& response,
+                const char* server_name = nullptr) {
+    boost::asio::ssl::stream<boost::asio::ip::tcp::socket> stream{io_ctx_,
+                                                                  ssl_ctx_};
+    stream.next_layer().connect(endpoint);
+
+    if (server_name) {
+      ::SSL_set_tlsext_host_name(stream.native_handle(), server_name);
+    }
+
+    if (session_) {
+      ::SSL_set_session(stream.native_handle(), session_);
+    }
+    stream.handshake(boost::asio::ssl::stream_base::client);
+    const bool reused = ::SSL_session_reused(stream.native_handle());
+
+    boost::beast::flat_buffer buffer;
+    boost::beast::http::write(stream, request);
+    boost::beast::http::read(stream, buffer, response);
+
+    // TLSv1.3 tickets are received after the handshake
+    if (session_) {
+      ::SSL_SESSION_free(session_);
+    }
+    session_ = ::SSL_get1_session(stream.native_handle());
+
+    boost::beast::error_code ec;
+    stream.shutdown(ec);
+    return reused;
+  }
+};
+
+/**
+ * @brief The Http2Client class - test client that negotiates HTTP/2 and sends
+ * all requests of the connection at once as concurrent streams
+ */
+class Http2Client {
+  boost::asio::io_context io_ctx_;
+  boost::asio::ssl::context& ssl_ctx_;
+
+public:
+  Http2Client(boost::asio::ssl::context& ssl_ctx) : ssl_ctx_{ssl_ctx} {}
+
+  Http2Client(const Http2Client&) = delete;
+  Http2Client& operator=(const Http2Client&) = delete;
+
+  /**
+   * @brief exchange - connects, sends requests and reads responses
+   * @return responses in the order of requests, empty if "h2" is not
+   * negotiated
+   */
+  std::vector<string_response>
+  exchange(const boost::asio::ip::tcp::endpoint& endpoint,
+           const std::vector<string_request>& requests) {
+    namespace http2 = rest_in_beast::detail::http2;
+
+    boost::asio::ssl::stream<boost::asio::ip::tcp::socket> stream{io_ctx_,
+                                                                  ssl_ctx_};
+    stream.next_layer().connect(endpoint);
+
+    static constexpr unsigned char protocols[]{2, 'h', '2'};
+    ::SSL_set_alpn_protos(stream.native_handle(), protocols,
+                          sizeof(protocols));
+    stream.handshake(boost::asio::ssl::stream_base::client);
+
+    if (!http2::negotiated(stream.native_handle())) {
+      boost::beast::error_code ec;
+      stream.shutdown(ec);
+      return {};
+    }
+
+    std::string output{http2::client_preface};
+    http2::append_frame_header(output, 0, http2::frame::settings, 0, 0);
+
+    std::string block;
+    for (std::size_t idx{}; idx < std::size(requests); ++idx) {
+      const auto& request = requests[idx];
+      const auto stream_id = static_cast<std::uint32_t>(idx * 2 + 1);
+
+      block.clear();
+      rest_in_beast::util::HpackEncoder::encode(block, ":method",
+                                                request.method_string());
+      rest_in_beast::util::HpackEncoder::encode(block, ":scheme", "https");
+      rest_in_beast::util::HpackEncoder::encode(block, ":path",
+                                                request.target());
+      for (const auto& field : request) {
+        if (field.name() == boost::beast::http::field::host) {
+          rest_in_beast::util::HpackEncoder::encode(block, ":authority",
+                                                    field.value());
+        } else if (!http2::connection_specific(field.name_string())) {
+          rest_in_beast::util::HpackEncoder::encode(block, field.name_string(),
+                                                    field.value());
+        }
+      }
+
+      const bool has_body = !std::empty(request.body());
+      http2::append_frame_header(
+          output, std::size(block), http2::frame::headers,
+          http2::flag::end_headers | (has_body ? 0 : http2::flag::end_stream),
+          stream_id);
+      output.append(block);
+
+      if (has_body) {
+        http2::append_frame_header(output, std::size(request.body()),
+                                   http2::frame::data, http2::flag::end_stream,
+                                   stream_id);
+        output.append(request.body());
+      }
+    }
+    boost::asio::write(stream, boost::asio::buffer(output));
+
+    std::vector<string_response> responses(std::size(requests));
+    std::vector<bool> done(std::size(requests));
+    std::size_t remaining{std::size(requests)};
+
+    rest_in_beast::util::HpackDecoder decoder;
+    std::string buffer;
+    block.clear();
+
+    const auto response_of = [&](std::uint32_t stream_id) -> string_response& {
+      const std::size_t idx = stream_id / 2;
+      if (stream_id % 2 == 0 || idx >= std::size(responses) || done[idx])
+        throw std::runtime_error{"Http2Client: unexpected stream"};
+      return responses[idx];
+    };
+    const auto end_stream = [&](std::uint32_t stream_id) {
+      done[stream_id / 2] = true;
+      --remaining;
+    };
+
+    char chunk[16'384];
+    while (remaining != 0) {
+      buffer.append(chunk, stream.read_some(boost::asio::buffer(chunk)));
+
+      output.clear();
+      std::string_view data{buffer};
+      while (std::size(data) >= http2::frame_header_size) {
+        const auto* header =
+            reinterpret_cast<const unsigned char*>(std::data(data));
+        const std::size_t length = static_cast<std::size_t>(header[0]) << 16 |
+                                   static_cast<std::size_t>(header[1]) << 8 |
+                                   static_cast<std::size_t>(header[2]);
+        if (std::size(data) < http2::frame_header_size + length)
+          break;
+
+        const auto type = static_cast<http2::frame>(header[3]);
+        const std::uint8_t flags = header[4];
+        const std::uint32_t stream_id =
+            http2::read_u32(data.substr(5, 4)) & 0x7fff'ffff;
+        const auto payload = data.substr(http2::frame_header_size, length);
+        data.remove_prefix(http2::frame_header_size + length);
+
+        switch (type) {
+        case http2::frame::settings:
+          if (!(flags & http2::flag::ack)) {
+            http2::append_frame_header(output, 0, http2::frame::settings,
+                                       http2::flag::ack, 0);
+          }
+          break;
+        case http2::frame::headers:
+        case http2::frame::continuation:
+          block.append(payload);
+          if (flags & http2::flag::end_headers) {
+            auto& response = response_of(stream_id);
+            response.version(11);
+            const bool decoded = decoder.decode(
+                block, [&](std::string_view name, std::string_view value) {
+                  if (name == ":status") {
+                    response.result(std::stoi(std::string{value}));
+                  } else {
+                    response.insert(name, value);
+                  }
+                });
+            if (!decoded)
+              throw std::runtime_error{"Http2Client: bad header block"};
+            block.clear();
+          }
+          if (flags & http2::flag::end_stream) {
+            end_stream(stream_id);
+          }
+          break;
+        case http2::frame::data:
+          response_of(stream_id).body().append(payload);
+          if (!std::empty(payload)) {
+            http2::append_frame_header(output, 4, http2::frame::window_update,
+                                       0, 0);
+            http2::append_u32(output, std::size(payload));
+            http2::append_frame_header(output, 4, http2::frame::window_update,
+                                       0, stream_id);
+            http2::append_u32(output, std::size(payload));
+          }
+          if (flags & http2::flag::end_stream) {
+            end_stream(stream_id);
+          }
+          break;
+        case http2::frame::rst_stream:
+        case http2::frame::goaway:
+          throw std::runtime_error{"Http2Client: stream is reset"};
+        default:
+          break;
+        }
+      }
+      buffer.erase(0, std::size(buffer) - std::size(data));
+
+      if (!std::empty(output)) {
+        boost::asio::write(stream, boost::asio::buffer(output));
+      }
+    }
+
+    output.clear();
+    http2::append_frame_header(output, 8, http2::frame::goaway, 0, 0);
+    http2::append_u32(output, 0);
+    http2::append_u32(output, 0);
+    boost::asio::write(stream, boost::asio::buffer(output));
+
+    boost::beast::error_code ec;
+    stream.shutdown(ec);
+    return responses;
+  }
+};
 } // namespace test
 #endif // TEST_CLIENTS_HPP
@@ -10,8 +10,14 @@
 
 #include <boost/beast/http.hpp>
 #include <boost/beast/version.hpp>
+#include <atomic>
+#include <chrono>
 #include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
 #include <rest_in_beast/detail/respondent.hpp>
+#include <rest_in_beast/util/flat_map.hpp>
 #include <rest_in_beast/util/shared_proxy.hpp>
 
 namespace test {
@@ -22,10 +28,17 @@ using string_response =
     boost::beast::http::response<boost::beast::http::string_body>;
 
 class Respondent : public rest_in_beast::Respondent {
-  std::unordered_map<std::string_view, string_response> responses_;
+  rest_in_beast::util::FlatMap<std::string, string_response> responses_;
 
+  friend rest_in_beast::util::SharedProxy<Respondent>;
+
+protected:
   Respondent(std::unordered_map<std::string_view, string_response>&& responses)
-      : responses_{std::move(responses)} {
+      : responses_(std::size(responses)) {
+    for (auto& [target, response] : responses) {
+      responses_.emplace(target, std::move(response));
+    }
+
     if (!responses_.contains("not_found")) {
       throw std::runtime_error{"responses does not contain 'not_found'"};
     }
@@ -35,7 +48,27 @@ class Respondent : public rest_in_beast::Respondent {
     // TODO: other responses
   };
 
-  friend rest_in_beast::util::SharedProxy<Respondent>;
+  template <typename Request>
+  const string_response& select_response(const Request& request) const {
+    switch (request.method()) {
+    case boost::beast::http::verb::get: {
+      auto response_it = responses_.find(request.target());
+
+      if (response_it == std::cend(responses_)) {
+        response_it = responses_.find("not_found");
+        assert(response_it != std::cend(responses_));
+      }
+
+      return response_it->second;
+    }
+    default: {
+      const auto response_it = responses_.find("not_implemented");
+      assert(response_it != std::cend(responses_));
+
+      return response_it->second;
+    }
+    }
+  }
 
 public:
   ~Respondent() = default;
@@ -48,32 +81,157 @@ public:
 
   boost::beast::http::message_generator
   make_response(string_request&& request) override {
-    switch (request.method()) {
-    case boost::beast::http::verb::get: {
-      auto response_it = responses_.find(request.target());
+    auto response = select_response(request);
+    // IMPORTANT!
+    response.prepare_payload();
 
-      if (response_it == std::cend(responses_)) {
-        response_it = responses_.find("not_found");
-        assert(response_it != std::end(responses_));
-      }
+    return response;
+  }
+};
 
-      auto response = response_it->second;
-      // IMPORTANT!
-      response.prepare_payload();
+/**
+ * @brief The ReusableRespondent class fills session-owned response instead of
+ * making type-erased one
+ */
+class ReusableRespondent : public Respondent {
+  using Respondent::Respondent;
 
-      return response;
-    }
-    default: {
-      const auto response_it = responses_.find("not_implemented");
-      assert(response_it != std::cend(responses_));
+  friend rest_in_beast::util::SharedProxy<ReusableRespondent>;
 
-      auto response = response_it->second;
-      // IMPORTANT!
-      response.prepare_payload();
+public:
+  ~ReusableRespondent() = default;
 
-      return response;
+  static std::shared_ptr<ReusableRespondent>
+  make_shared(std::unordered_map<std::string_view, string_response> responses) {
+    return std::make_shared<
+        rest_in_beast::util::SharedProxy<ReusableRespondent>>(
+        std::move(responses));
+  }
+
+  bool fill_response(rest_in_beast::RequestView request,
+                     rest_in_beast::reusable_response& response) override {
+    return fill(select_response(request), response);
+  }
+
+private:
+  static bool fill(const string_response& prototype,
+                   rest_in_beast::reusable_response& response) {
+    response.result(prototype.result());
+    for (const auto& field : prototype) {
+      response.set(field.name_string(), field.value());
     }
+    response.body() = prototype.body();
+
+    return true;
+  }
+};
+
+/**
+ * @brief The EchoHandler class sends WebSocket messages back and counts
+ * closed connections
+ */
+class EchoHandler : public rest_in_beast::WebSocketHandler {
+public:
+  std::atomic<std::size_t> closed{};
+
+  void on_message(rest_in_beast::WebSocketConnection& connection,
+                  std::string_view message, bool text) override {
+    connection.send(std::string{message}, text);
+  }
+
+  void on_close(boost::system::error_code) override { ++closed; }
+};
+
+/**
+ * @brief The WebSocketRespondent class accepts WebSocket upgrades of "/echo"
+ */
+class WebSocketRespondent : public Respondent {
+  using Respondent::Respondent;
+
+  friend rest_in_beast::util::SharedProxy<WebSocketRespondent>;
+
+public:
+  std::shared_ptr<EchoHandler> echo{std::make_shared<EchoHandler>()};
+
+  ~WebSocketRespondent() = default;
+
+  static std::shared_ptr<WebSocketRespondent>
+  make_shared(std::unordered_map<std::string_view, string_response> responses) {
+    return std::make_shared<
+        rest_in_beast::util::SharedProxy<WebSocketRespondent>>(
+        std::move(responses));
+  }
+
+  std::shared_ptr<rest_in_beast::WebSocketHandler>
+  accept_websocket(const string_request& request) override {
+    if (request.target() != "/echo")
+      return nullptr;
+    return echo;
+  }
+};
+
+/**
+ * @brief The StreamRespondent class answers "/events" with Server-Sent Events
+ * stream and keeps the channels for the test
+ */
+class StreamRespondent : public Respondent {
+  using Respondent::Respondent;
+
+  friend rest_in_beast::util::SharedProxy<StreamRespondent>;
+
+  std::mutex mutex_;
+  std::vector<std::shared_ptr<rest_in_beast::StreamChannel>> channels_;
+
+public:
+  std::size_t max_queued_size{1'048'576};
+  rest_in_beast::StreamChannel::Overflow overflow{
+      rest_in_beast::StreamChannel::Overflow::reject};
+
+  ~StreamRespondent() = default;
+
+  static std::shared_ptr<StreamRespondent>
+  make_shared(std::unordered_map<std::string_view, string_response> responses) {
+    return std::make_shared<rest_in_beast::util::SharedProxy<StreamRespondent>>(
+        std::move(responses));
+  }
+
+  std::shared_ptr<rest_in_beast::StreamChannel>
+  make_stream(rest_in_beast::RequestView request,
+              rest_in_beast::reusable_response& response) override {
+    return make_channel(request.target(), response);
+  }
+
+  /**
+   * @brief wait_channel waits for the stream number idx
+   */
+  std::shared_ptr<rest_in_beast::StreamChannel> wait_channel(std::size_t idx) {
+    for (int attempt{}; attempt < 500; ++attempt) {
+      {
+        const std::scoped_lock lock{mutex_};
+        if (idx < std::size(channels_))
+          return channels_[idx];
+      }
+      std::this_thread::sleep_for(std::chrono::milliseconds{10});
     }
+    return nullptr;
+  }
+
+private:
+  std::shared_ptr<rest_in_beast::StreamChannel>
+  make_channel(std::string_view target,
+               rest_in_beast::reusable_response& response) {
+    if (target != "/events")
+      return nullptr;
+
+    response.set(boost::beast::http::field::content_type,
+                 "text/event-stream");
+    response.set(boost::beast::http::field::cache_control, "no-cache");
+
+    auto channel =
+        rest_in_beast::StreamChannel::make_shared(max_queued_size, overflow);
+    const std::scoped_lock lock{mutex_};
+    channels_.push_back(channel);
+    return channel;
   }
 };
 
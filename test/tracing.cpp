@@ -0,0 +1,117 @@
+//
+// Author: Dmitriy Gavryushin (https://github.com/Gawrjuschin)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#define BOOST_TEST_MODULE TracingTests
+#include <boost/test/unit_test.hpp>
+
+#include "support/test_asio_thread.hpp"
+#include "support/test_logger.hpp"
+#include "support/test_requests.hpp"
+#include "support/test_respondent.hpp"
+#include "support/test_signal_handler.hpp"
+
+#include <rest_in_beast/server.hpp>
+#include <rest_in_beast/tracing.hpp>
+
+#include <boost/asio/ip/address.hpp>
+#include <boost/asio/signal_set.hpp>
+#include <boost/beast/http.hpp>
+
+#include <chrono>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace rib = rest_in_beast;
+namespace net = boost::asio;
+namespace beast = boost::beast;
+
+BOOST_AUTO_TEST_CASE(plain_tracing) {
+  static_assert(rib::tracing_enabled);
+
+  const net::ip::tcp::endpoint endpoint{net::ip::make_address("127.0.0.1"),
+                                        5001};
+  auto server_logger = test::Logger::make_shared();
+
+  boost::asio::io_context io_ctx;
+
+  net::signal_set signals(io_ctx, SIGINT);
+  signals.async_wait(test::SignalsHandler{io_ctx, server_logger});
+
+  test::ASIOThread server_worker{io_ctx};
+  std::thread server_thread{server_worker.thread_body()};
+
+  // Every second request is traced
+  const auto ring = rib::RingTraceSink::make_shared(16, true);
+  rib::PlainServer::start(
+      io_ctx, endpoint, server_logger,
+      {.respondent = test::ReusableRespondent::make_shared(
+           test::responses_map()),
+       .logger = server_logger,
+       .trace_sink = rib::SamplingTraceSink::make_shared(ring, 2)});
+
+  constexpr std::size_t requests{4};
+  std::vector<std::string> timings;
+  {
+    net::io_context client_ctx;
+    net::ip::tcp::socket socket{client_ctx};
+    socket.connect(endpoint);
+
+    beast::flat_buffer buffer;
+    for (std::size_t idx{}; idx < requests; ++idx) {
+      beast::http::request<beast::http::string_body> request{
+          beast::http::verb::get, "/", 11};
+      request.set(beast::http::field::host, "127.0.0.1");
+      beast::http::write(socket, request);
+
+      test::string_response response;
+      beast::http::read(socket, buffer, response);
+      BOOST_REQUIRE(response.result() == beast::http::status::ok);
+      timings.emplace_back(response["Server-Timing"]);
+    }
+  }
+
+  BOOST_REQUIRE(timings[0].find("strand;dur=") != std::string::npos);
+  BOOST_REQUIRE(timings[0].find("handler;dur=") != std::string::npos);
+  BOOST_REQUIRE(std::empty(timings[1]));
+  BOOST_REQUIRE(timings[2].find("strand;dur=") == std::string::npos);
+  BOOST_REQUIRE(timings[2].find("read;dur=") != std::string::npos);
+  BOOST_REQUIRE(std::empty(timings[3]));
+
+  // Traces are delivered after the write completes
+  for (int idx{}; idx < 500 && std::size(ring->traces()) != 2; ++idx) {
+    std::this_thread::sleep_for(std::chrono::milliseconds{10});
+  }
+
+  io_ctx.stop();
+  server_thread.join();
+
+  BOOST_REQUIRE(not server_worker.thread_exception);
+  if (server_worker.thread_exception) {
+    std::rethrow_exception(server_worker.thread_exception);
+  }
+
+  const auto traces = ring->traces();
+  BOOST_REQUIRE(std::size(traces) == 2);
+  BOOST_REQUIRE(traces[0].request == 1);
+  BOOST_REQUIRE(traces[1].request == 3);
+
+  using Point = rib::Trace::Point;
+  for (const auto& trace : traces) {
+    BOOST_REQUIRE(trace.method == beast::http::verb::get);
+    BOOST_REQUIRE(trace.target() == "/");
+    BOOST_REQUIRE(not trace.reached(Point::handshake_start));
+    BOOST_REQUIRE(trace.point(Point::accepted) <= trace.point(Point::strand));
+    BOOST_REQUIRE(trace.point(Point::read_start) <=
+                  trace.point(Point::read_end));
+    BOOST_REQUIRE(trace.point(Point::read_end) <=
+                  trace.point(Point::respond_end));
+    BOOST_REQUIRE(trace.point(Point::respond_end) <=
+                  trace.point(Point::write_end));
+  }
+}
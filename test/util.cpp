@@ -0,0 +1,418 @@
+//
+// Author: Dmitriy Gavryushin (https://github.com/Gawrjuschin)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#define BOOST_TEST_MODULE UtilTests
+#include <boost/test/unit_test.hpp>
+
+#include <rest_in_beast/util/flat_map.hpp>
+#include <rest_in_beast/util/hasher.hpp>
+#include <rest_in_beast/util/hpack.hpp>
+#include <rest_in_beast/util/query.hpp>
+#include <rest_in_beast/util/route_table.hpp>
+
+#include <boost/utility/string_view.hpp>
+
+#include <array>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+namespace rib = rest_in_beast;
+
+using namespace std::string_view_literals;
+
+BOOST_AUTO_TEST_SUITE(hasher)
+
+BOOST_AUTO_TEST_CASE(same_hash_for_all_string_types) {
+  const rib::util::string_view_hash hash{};
+
+  const std::string text{"/api/v1/users"};
+  const std::size_t expected{hash("/api/v1/users"sv)};
+
+  BOOST_REQUIRE(hash(text) == expected);
+  BOOST_REQUIRE(hash(text.c_str()) == expected);
+  BOOST_REQUIRE(hash(boost::string_view{text}) == expected);
+}
+
+BOOST_AUTO_TEST_CASE(constexpr_hash) {
+  constexpr auto compile_time{rib::util::hash_bytes("/api/v1/users/profile")};
+  const std::string text{"/api/v1/users/profile"};
+
+  BOOST_REQUIRE(compile_time == rib::util::hash_bytes(text));
+}
+
+BOOST_AUTO_TEST_CASE(all_lengths_are_distinct) {
+  // Every branch of the hash: empty, 1-3, 4-16, 17-47, 48+ bytes
+  const std::string text(200, 'a');
+  std::unordered_set<std::uint64_t> hashes;
+
+  for (std::size_t len{}; len <= std::size(text); ++len) {
+    hashes.insert(rib::util::hash_bytes(std::string_view{text}.substr(0, len)));
+  }
+
+  BOOST_REQUIRE(std::size(hashes) == std::size(text) + 1);
+}
+
+BOOST_AUTO_TEST_CASE(seed_changes_hash) {
+  const rib::util::seeded_string_view_hash lhs{.seed = 1};
+  const rib::util::seeded_string_view_hash rhs{.seed = 2};
+
+  BOOST_REQUIRE(lhs("/index.html"sv) != rhs("/index.html"sv));
+  BOOST_REQUIRE(lhs("/index.html"sv) == lhs(std::string{"/index.html"}));
+}
+
+BOOST_AUTO_TEST_SUITE_END();
+
+BOOST_AUTO_TEST_SUITE(flat_map)
+
+BOOST_AUTO_TEST_CASE(insert_find) {
+  rib::util::FlatMap<std::string, int> map;
+
+  BOOST_REQUIRE(map.find("/"sv) == map.end());
+
+  BOOST_REQUIRE(map.emplace("/", 1).second);
+  BOOST_REQUIRE(map.emplace("/index", 2).second);
+  BOOST_REQUIRE(not map.emplace("/", 3).second);
+
+  BOOST_REQUIRE(std::size(map) == 2);
+  BOOST_REQUIRE(map.at("/"sv) == 1);
+  BOOST_REQUIRE(map.at(boost::string_view{"/index"}) == 2);
+  BOOST_REQUIRE(map.contains("/index"));
+  BOOST_REQUIRE(not map.contains("/not_exist"));
+  BOOST_REQUIRE_THROW(static_cast<void>(map.at("/not_exist"sv)),
+                      std::out_of_range);
+}
+
+BOOST_AUTO_TEST_CASE(grow_and_erase) {
+  rib::util::FlatMap<std::string, std::size_t> map;
+
+  constexpr std::size_t count{1000};
+  for (std::size_t idx{}; idx < count; ++idx) {
+    map["/item/" + std::to_string(idx)] = idx;
+  }
+
+  BOOST_REQUIRE(std::size(map) == count);
+
+  for (std::size_t idx{}; idx < count; idx += 2) {
+    BOOST_REQUIRE(map.erase("/item/" + std::to_string(idx)) == 1);
+  }
+
+  BOOST_REQUIRE(std::size(map) == count / 2);
+
+  for (std::size_t idx{}; idx < count; ++idx) {
+    const auto it = map.find("/item/" + std::to_string(idx));
+    if (idx % 2) {
+      BOOST_REQUIRE(it != map.end());
+      BOOST_REQUIRE(it->second == idx);
+    } else {
+      BOOST_REQUIRE(it == map.end());
+    }
+  }
+
+  std::size_t iterated{};
+  for (const auto& [key, value] : map) {
+    BOOST_REQUIRE(value % 2 == 1);
+    ++iterated;
+  }
+  BOOST_REQUIRE(iterated == count / 2);
+}
+
+BOOST_AUTO_TEST_CASE(copy_and_move) {
+  using seeded_map = rib::util::FlatMap<std::string, std::string,
+                                        rib::util::seeded_string_view_hash>;
+  seeded_map map(16);
+  map.emplace("key", "value");
+
+  auto copy{map};
+  BOOST_REQUIRE(copy.at("key"sv) == "value");
+
+  auto moved{std::move(map)};
+  BOOST_REQUIRE(moved.at("key"sv) == "value");
+  BOOST_REQUIRE(std::empty(map));
+  BOOST_REQUIRE(map.find("key"sv) == map.end());
+}
+
+// Copy throws once the budget is spent, move may throw, so rehash copies
+struct ThrowingValue {
+  static inline int copies_left{};
+  static inline int alive{};
+  int value{};
+
+  ThrowingValue(int value) : value{value} { ++alive; }
+  ThrowingValue(const ThrowingValue& other) : value{other.value} {
+    if (copies_left-- == 0)
+      throw std::runtime_error{"copy"};
+    ++alive;
+  }
+  ThrowingValue(ThrowingValue&& other) : value{other.value} { ++alive; }
+  ~ThrowingValue() { --alive; }
+};
+
+BOOST_AUTO_TEST_CASE(rehash_exception_keeps_map) {
+  rib::util::FlatMap<std::string, ThrowingValue> map;
+  for (int idx{}; idx < 6; ++idx) {
+    map.emplace(std::to_string(idx), idx);
+  }
+  const auto capacity = map.capacity();
+
+  ThrowingValue::copies_left = 3;
+  BOOST_REQUIRE_THROW(map.reserve(64), std::runtime_error);
+  BOOST_REQUIRE(map.capacity() == capacity);
+  BOOST_REQUIRE(map.size() == 6);
+  for (int idx{}; idx < 6; ++idx) {
+    BOOST_REQUIRE(map.at(std::to_string(idx)).value == idx);
+  }
+
+  ThrowingValue::copies_left = 1'000;
+  map.reserve(64);
+  BOOST_REQUIRE(map.capacity() >= 64);
+  BOOST_REQUIRE(map.at("5"sv).value == 5);
+}
+
+BOOST_AUTO_TEST_CASE(copy_exception_destroys_copies) {
+  rib::util::FlatMap<std::string, ThrowingValue> map;
+  for (int idx{}; idx < 6; ++idx) {
+    map.emplace(std::to_string(idx), idx);
+  }
+  const auto alive = ThrowingValue::alive;
+
+  ThrowingValue::copies_left = 3;
+  BOOST_REQUIRE_THROW(rib::util::FlatMap{map}, std::runtime_error);
+  BOOST_REQUIRE(ThrowingValue::alive == alive);
+  BOOST_REQUIRE(map.size() == 6);
+  ThrowingValue::copies_left = 1'000;
+}
+
+BOOST_AUTO_TEST_SUITE_END();
+
+BOOST_AUTO_TEST_SUITE(route_table)
+
+BOOST_AUTO_TEST_CASE(compile_time_lookup) {
+  constexpr rib::util::StaticRouteTable routes{
+      std::array{"/"sv, "/users"sv, "/orders"sv, "/users/profile"sv}};
+
+  static_assert(routes.find("/") == 0);
+  static_assert(routes.find("/users") == 1);
+  static_assert(routes.find("/orders") == 2);
+  static_assert(routes.find("/users/profile") == 3);
+  static_assert(routes.find("/not_exist") == routes.npos);
+  static_assert(routes.find("") == routes.npos);
+
+  const std::string target{"/users/profile"};
+  BOOST_REQUIRE(routes.find(target) == 3);
+  BOOST_REQUIRE(routes.path(routes.find(target)) == target);
+}
+
+BOOST_AUTO_TEST_CASE(sixty_four_routes) {
+  constexpr auto paths = [] {
+    std::array<std::string_view, 64> paths{
+        "/api/v1/users",          "/api/v1/users/me",
+        "/api/v1/orders",         "/api/v1/orders/history",
+        "/api/v1/items",          "/api/v1/items/search",
+        "/api/v1/carts",          "/api/v1/carts/checkout",
+        "/api/v1/payments",       "/api/v1/payments/refund",
+        "/api/v1/sessions",       "/api/v1/sessions/refresh",
+        "/api/v1/tokens",         "/api/v1/tokens/revoke",
+        "/api/v1/stats",          "/api/v1/stats/daily",
+        "/api/v2/users",          "/api/v2/users/me",
+        "/api/v2/orders",         "/api/v2/orders/history",
+        "/api/v2/items",          "/api/v2/items/search",
+        "/api/v2/carts",          "/api/v2/carts/checkout",
+        "/api/v2/payments",       "/api/v2/payments/refund",
+        "/api/v2/sessions",       "/api/v2/sessions/refresh",
+        "/api/v2/tokens",         "/api/v2/tokens/revoke",
+        "/api/v2/stats",          "/api/v2/stats/daily",
+        "/health",                "/ready",
+        "/metrics",               "/version",
+        "/",                      "/index.html",
+        "/favicon.ico",           "/robots.txt",
+        "/static/app.js",         "/static/app.css",
+        "/static/vendor.js",      "/static/logo.svg",
+        "/login",                 "/logout",
+        "/signup",                "/reset",
+        "/admin",                 "/admin/users",
+        "/admin/orders",          "/admin/items",
+        "/admin/settings",        "/admin/logs",
+        "/admin/stats",           "/admin/jobs",
+        "/a",                     "/b",
+        "/c",                     "/d",
+        "/aa",                    "/ab",
+        "/ba",                    "/bb"};
+    return paths;
+  }();
+
+  constexpr rib::util::StaticRouteTable routes{paths};
+
+  for (std::size_t idx{}; idx < std::size(paths); ++idx) {
+    BOOST_REQUIRE(routes.find(std::string{paths[idx]}) == idx);
+  }
+  BOOST_REQUIRE(routes.find("/api/v3/users") == routes.npos);
+  BOOST_REQUIRE(routes.find("/ac") == routes.npos);
+}
+
+BOOST_AUTO_TEST_SUITE_END();
+
+BOOST_AUTO_TEST_SUITE(query)
+
+BOOST_AUTO_TEST_CASE(query_of_target) {
+  static_assert(rib::util::query_of("/path?a=1&b=2#top") == "a=1&b=2");
+  static_assert(rib::util::query_of("/path?a=1") == "a=1");
+  static_assert(rib::util::query_of("/path") == "");
+}
+
+BOOST_AUTO_TEST_CASE(iterate_params) {
+  const auto query{rib::util::QueryView::from_target("/p?a=1&&flag&b=&c=x=y")};
+
+  std::vector<std::pair<std::string_view, std::string_view>> params;
+  for (const auto [key, value] : query) {
+    params.emplace_back(key, value);
+  }
+
+  BOOST_REQUIRE(std::size(params) == 4);
+  BOOST_REQUIRE(params[0] == std::pair("a"sv, "1"sv));
+  BOOST_REQUIRE(params[1] == std::pair("flag"sv, ""sv));
+  BOOST_REQUIRE(params[2] == std::pair("b"sv, ""sv));
+  BOOST_REQUIRE(params[3] == std::pair("c"sv, "x=y"sv));
+}
+
+BOOST_AUTO_TEST_CASE(find_by_key) {
+  constexpr rib::util::QueryView form{"first+name=John%20Smith&age=42"};
+
+  static_assert(form.find("age") == "42"sv);
+  static_assert(form.find("first name") == "John%20Smith"sv);
+  static_assert(not form.contains("first"));
+  static_assert(not form.contains("first+name"));
+
+  const auto raw_name = form.find("first name");
+  BOOST_REQUIRE(raw_name.has_value());
+  BOOST_REQUIRE(rib::util::needs_decoding(*raw_name));
+
+  char buffer[16];
+  BOOST_REQUIRE(rib::util::url_decode(*raw_name, buffer) == "John Smith");
+}
+
+BOOST_AUTO_TEST_CASE(decoding) {
+  std::string out;
+  rib::util::url_decode("a%2Fb%2fc+d%zz%4", std::back_inserter(out));
+  BOOST_REQUIRE(out == "a/b/c d%zz%4");
+
+  static_assert(rib::util::decoded_equal("%41%42", "AB"));
+  static_assert(not rib::util::decoded_equal("%41%42", "ABC"));
+  static_assert(not rib::util::decoded_equal("%41%42%43", "AB"));
+}
+
+BOOST_AUTO_TEST_SUITE_END();
+
+BOOST_AUTO_TEST_SUITE(hpack)
+
+using fields = std::vector<std::pair<std::string, std::string>>;
+
+fields decode(rib::util::HpackDecoder& decoder, std::string_view block) {
+  fields decoded;
+  BOOST_REQUIRE(decoder.decode(block, [&](auto name, auto value) {
+    decoded.emplace_back(name, value);
+  }));
+  return decoded;
+}
+
+std::string from_hex(std::string_view hex) {
+  std::string bytes;
+  for (std::size_t idx{}; idx + 1 < std::size(hex); idx += 2) {
+    bytes.push_back(static_cast<char>(
+        std::stoi(std::string{hex.substr(idx, 2)}, nullptr, 16)));
+  }
+  return bytes;
+}
+
+BOOST_AUTO_TEST_CASE(integers) {
+  // RFC 7541 C.1
+  std::string out;
+  rib::util::hpack_encode_integer(out, 0x00, 5, 10);
+  rib::util::hpack_encode_integer(out, 0x00, 5, 1337);
+  rib::util::hpack_encode_integer(out, 0x00, 8, 42);
+  BOOST_REQUIRE(out == from_hex("0a1f9a0a2a"));
+
+  std::string_view in{out};
+  std::size_t value{};
+  BOOST_REQUIRE(rib::util::hpack_decode_integer(in, 5, value) && value == 10);
+  BOOST_REQUIRE(rib::util::hpack_decode_integer(in, 5, value) && value == 1337);
+  BOOST_REQUIRE(rib::util::hpack_decode_integer(in, 8, value) && value == 42);
+  BOOST_REQUIRE(std::empty(in));
+}
+
+BOOST_AUTO_TEST_CASE(rfc_requests_with_huffman) {
+  // RFC 7541 C.4: requests of one connection share the dynamic table
+  rib::util::HpackDecoder decoder;
+
+  const auto first = from_hex("828684418cf1e3c2e5f23a6ba0ab90f4ff");
+  BOOST_REQUIRE(decode(decoder, first) ==
+                (fields{{":method", "GET"},
+                        {":scheme", "http"},
+                        {":path", "/"},
+                        {":authority", "www.example.com"}}));
+  BOOST_REQUIRE(decoder.table_size() == 57);
+
+  BOOST_REQUIRE(decode(decoder, from_hex("828684be5886a8eb10649cbf")) ==
+                (fields{{":method", "GET"},
+                        {":scheme", "http"},
+                        {":path", "/"},
+                        {":authority", "www.example.com"},
+                        {"cache-control", "no-cache"}}));
+  BOOST_REQUIRE(decoder.table_size() == 110);
+
+  BOOST_REQUIRE(
+      decode(decoder, from_hex("828785bf408825a849e95ba97d7f8925a849e95bb8e8"
+                               "b4bf")) ==
+      (fields{{":method", "GET"},
+              {":scheme", "https"},
+              {":path", "/index.html"},
+              {":authority", "www.example.com"},
+              {"custom-key", "custom-value"}}));
+  BOOST_REQUIRE(decoder.table_size() == 164);
+}
+
+BOOST_AUTO_TEST_CASE(encoder_round_trip) {
+  std::string block;
+  rib::util::HpackEncoder::encode_status(block, 200);
+  BOOST_REQUIRE(block == "\x88");
+
+  rib::util::HpackEncoder::encode_status(block, 418);
+  rib::util::HpackEncoder::encode(block, "Content-Type", "text/html");
+  rib::util::HpackEncoder::encode(block, "X-Request-Id", "0123456789");
+  rib::util::HpackEncoder::encode(block, "Server", "\x01\xff");
+
+  rib::util::HpackDecoder decoder;
+  BOOST_REQUIRE(decode(decoder, block) ==
+                (fields{{":status", "200"},
+                        {":status", "418"},
+                        {"content-type", "text/html"},
+                        {"x-request-id", "0123456789"},
+                        {"server", "\x01\xff"}}));
+  BOOST_REQUIRE(decoder.table_size() == 0);
+}
+
+BOOST_AUTO_TEST_CASE(malformed_blocks) {
+  const auto fails = [](std::string_view block) {
+    rib::util::HpackDecoder decoder{64};
+    return not decoder.decode(block, [](auto, auto) {});
+  };
+
+  // Index 0, unknown dynamic index, truncated string
+  BOOST_REQUIRE(fails(from_hex("80")));
+  BOOST_REQUIRE(fails(from_hex("be")));
+  BOOST_REQUIRE(fails(from_hex("410f7777")));
+  // Table size above the limit, size update after a field
+  BOOST_REQUIRE(fails(from_hex("3f22")));
+  BOOST_REQUIRE(fails(from_hex("8220")));
+  // Huffman padding of zeros
+  BOOST_REQUIRE(fails(from_hex("418100")));
+}
+
+BOOST_AUTO_TEST_SUITE_END();